@@ -0,0 +1,490 @@
+/* ========================================
+ *
+ * Runs the event PSOC firmware on the host against psoc_mock and tracker_sim, as the Main PSOC would run it:
+ * configure, start a run, trigger it n times, end the run. Every output frame is checked (run and event numbers,
+ * Tracker boards, hit list CRCs, the end-of-run counts) and the run is timed in virtual and wall-clock time.
+ *    daq_host [-n events] [-r Hz] [-R run] [-f flags] [-d diag] [-k seconds] [-b boards]
+ *             [-m chips[:clusters]] [-l latency us] [-x fault=rate,...] [-e tty] [-c code:data,data...]
+ *             [-s seed] [-t seconds] [-o stream] [-v]
+ * -r 0 (the default) triggers as soon as the trigger is re-armed, so the virtual time per event is the
+ * readout dead time. -o writes the output stream in the format of the run files, for the decoders.
+ * -x injects Tracker faults (see tracker_sim.h); the hit lists the firmware then flags or replaces are counted
+ * rather than failed. -e talks to a Tracker on a serial port or to tkr_emu on its pty instead of tracker_sim;
+ * virtual time is then held back to wall-clock time, and the Tracker has to trigger itself.
+ * Exits with 1 if any check fails.
+ *
+ * =========================================
+ */
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "psoc_mock.h"
+#include "tracker_sim.h"
+
+int fw_main(void);
+
+#define MAX_CMDS 32
+
+enum Phase { CONFIGURE, WAIT_BOR, ENABLE, WAIT_ENABLE, RUN, WAIT_EOR, DRAIN, DONE };
+
+struct Cmd {
+    uint8 code;
+    int nData;
+    uint8 data[32];
+};
+
+struct Host {
+    // Options
+    uint32 nEvents;
+    double rate;
+    uint16 run;
+    uint8 flags;
+    int nBoards;
+    uint32 latencyUs;
+    bool faults;                 // Injected, or possible from an external Tracker
+    int tkrFd;                   // External Tracker, or -1
+    bool verbose;
+    struct Cmd cmds[MAX_CMDS];
+    int nCmds;
+
+    struct TkrSim tkr;
+    uint32 rng;
+    enum Phase phase;
+    uint64 tPhase;               // Cycle at which the phase started
+    uint64 tStart, tEnd;         // First trigger and last event out
+    uint32 nTriggers;            // Accepted
+    size_t parsed;               // Output bytes looked at so far
+
+    // Checks
+    uint32 nEventsOut;
+    uint32 lastEvent;
+    uint32 nBadFrames, nBadEvents, nBadCRC, nErrorRecords, nHousekeeping;
+    uint32 nDummy;               // Hit lists replaced by the firmware after a Tracker error
+    uint32 nTruncated;           // Events with Tracker boards left out to fit the output buffer
+    bool gotEOR;
+    uint32 eorGO;
+    uint8 eorBadCRC;
+    uint64 nHitBytes;
+};
+
+static uint32 rnd(struct Host *h) {
+    uint32 x = h->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    h->rng = x;
+    return x;
+}
+
+static uint32 be32(const uint8 *p) {
+    return ((uint32)p[0] << 24) | ((uint32)p[1] << 16) | ((uint32)p[2] << 8) | p[3];
+}
+
+static void tkrByte(uint8 byte, uint64 tDone, void *arg) {
+    struct Host *h = arg;
+    uint8 reply[TKR_SIM_MAX_REPLY];
+    int n = tkrSimRx(&h->tkr, byte, reply);
+    if (n > 0) mockTkrReply(reply, n, tDone + MOCK_US(h->latencyUs));
+}
+
+// With an external Tracker the virtual clock may not run ahead of the wall clock
+static struct timespec wall0;
+
+static void keepPace(uint64 t) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double ahead = (double)t/MOCK_CLOCK_HZ - ((now.tv_sec - wall0.tv_sec) + 1.e-9*(now.tv_nsec - wall0.tv_nsec));
+    if (ahead <= 0) return;
+    struct timespec wait = {(time_t)ahead, (long)((ahead - (time_t)ahead)*1.e9)};
+    nanosleep(&wait, NULL);
+}
+
+static void extTkrByte(uint8 byte, uint64 tDone, void *arg) {
+    struct Host *h = arg;
+    keepPace(tDone);
+    if (write(h->tkrFd, &byte, 1) != 1) perror("daq_host: tracker");
+}
+
+// Every 100 us of virtual time, pass on what the external Tracker has sent
+static void extTkrPoll(void *arg) {
+    struct Host *h = arg;
+    uint8 buf[256];
+    keepPace(mockCycles());
+    ssize_t n = read(h->tkrFd, buf, sizeof(buf));
+    if (n > 0) mockTkrReply(buf, n, mockCycles());
+    mockAt(mockCycles() + MOCK_US(100), extTkrPoll, h);
+}
+
+static int openTracker(const char *name) {
+    int fd = open(name, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0) return -1;
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    tcflush(fd, TCIOFLUSH);
+    return fd;
+}
+
+// One trigger with random pulse heights and a trigger pattern with both PMT bits and zero to two Tracker bits
+static void trigger(struct Host *h) {
+    static const uint8 trgStatus[4] = {0x03, 0x07, 0x0B, 0x0F};
+    uint16 pha[5];
+    for (int ch=0; ch<5; ++ch) pha[ch] = rnd(h) & 0xFFF;
+    uint8 status = trgStatus[rnd(h) & 3];
+    if (!mockTrigger(status, pha)) return;
+    if (h->verbose) printf("%10.6f s  trigger %u, status %02X\n", mockSeconds(), h->nTriggers + 1, status);
+    if (h->nTriggers++ == 0) h->tStart = mockCycles();
+    uint8 pattern = ((status & 0x04) ? 0x40 : 0) | ((status & 0x08) ? 0x80 : 0);
+    if (h->tkrFd < 0) tkrSimTrigger(&h->tkr, pattern);
+}
+
+static void poisson(void *arg) {
+    struct Host *h = arg;
+    if (h->phase != RUN || h->nTriggers >= h->nEvents) return;
+    trigger(h);
+    double u = (rnd(h) + 1.)/4294967296.;
+    mockAt(mockCycles() + 1 + (uint64)(-log(u)/h->rate*MOCK_CLOCK_HZ), poisson, h);
+}
+
+// Bits pos to pos+nBits of a hit list of n bytes, or -1 past its end
+static int32_t field(const uint8 *b, int n, int *pos, int nBits) {
+    if (*pos + nBits > 8*n) return -1;
+    int32_t v = 0;
+    for (int i=0; i<nBits; ++i, ++*pos) v = (v << 1) | ((b[*pos/8] >> (7 - *pos%8)) & 1);
+    return v;
+}
+
+// Walk a hit list to its CRC and check it against the bits ahead of it
+static bool hitListGood(const uint8 *list, int n) {
+    int bit = 24;
+    if (n < 4 || list[0] != 0xE7) return false;
+    int nChips = field(list, n, &bit, 4);
+    if (nChips > 12) return false;
+    for (int chip=0; chip<nChips; ++chip) {
+        int nClust = field(list, n, &bit, 6);
+        if (field(list, n, &bit, 6) < 0 || nClust > 10) return false;
+        bit += 12*nClust;
+    }
+    int crc = field(list, n, &bit, 6);
+    return crc >= 0 && crc == tkrSimCRC6(list, bit - 6);
+}
+
+// The empty hit list the firmware puts in for a board, with a code in place of the CRC: 9 when the board no
+// longer fits in the event, others for Tracker errors (makeDummyHitList)
+static int dummyHitList(const uint8 *list, int n, int brd) {
+    if (n != 5 || list[0] != 0xE7 || list[1] != brd || list[2] != 0 || list[3] > 0x0F || list[4] != 0x30) return -1;
+    return list[3];
+}
+
+static void checkEvent(struct Host *h, uint8 type, const uint8 *d, int n) {
+    int p = type == 0xDB ? 49 : 39;
+    bool good = n >= p + 5 && memcmp(d, "ZERO", 4) == 0 && memcmp(d + n - 4, "FINI", 4) == 0;
+    bool truncated = false;
+    uint32 evt = good ? be32(d + 6) : 0;
+    if (good && (d[4] << 8 | d[5]) != h->run) good = false;
+    if (good && evt != h->lastEvent + 1) good = false;
+    if (good && (d[38] & 0x08)) p += 4;
+    if (good && d[p] > h->nBoards) good = false;
+    for (int brd=0, q=p+1; good && brd<d[p]; ++brd) {
+        int nBytes = d[q++];
+        if (q + nBytes > n - 4) {
+            good = false;
+        } else if (dummyHitList(d + q, nBytes, brd) == 9) {
+            truncated = true;
+        } else if (dummyHitList(d + q, nBytes, brd) >= 0) {
+            h->nDummy++;
+        } else if (!hitListGood(d + q, nBytes)) {
+            h->nBadCRC++;
+        }
+        h->nHitBytes += nBytes;
+        q += nBytes;
+    }
+    if (good && d[p] < h->nBoards) truncated = true;
+    h->nEventsOut++;
+    h->lastEvent = evt;
+    if (truncated) h->nTruncated++;
+    if (!good) {
+        if (h->nBadEvents++ < 10) fprintf(stderr, "daq_host: bad event %u (%d bytes)\n", h->nEventsOut, n);
+    }
+    if (h->nEventsOut == h->nEvents) h->tEnd = mockCycles();
+}
+
+// Look at the output frames completed since the last call
+static void parseOutput(struct Host *h) {
+    size_t n;
+    const uint8 *out = mockOutput(&n);
+    while (h->parsed + 9 <= n) {
+        const uint8 *f = out + h->parsed;
+        if (f[0] != 0xDC || f[1] != 0x00 || f[2] != 0xFF) {
+            h->nBadFrames++;
+            h->parsed++;
+            continue;
+        }
+        int len = f[3];
+        size_t frame = 9 + len + (3 - len%3)%3;
+        if (h->parsed + frame > n) break;
+        h->parsed += frame;
+        if (f[frame-3] != 0xFF || f[frame-2] != 0x00 || f[frame-1] != 0xFF || f[5] > len) {
+            h->nBadFrames++;
+            continue;
+        }
+        uint8 type = f[4];
+        const uint8 *d = f + 6 + f[5];
+        int nd = len - f[5];
+        if (h->verbose) printf("%10.6f s  frame %02X, %d bytes\n", mockSeconds(), type, len);
+        switch (type) {
+            case 0xDD:
+            case 0xDB:
+                checkEvent(h, type, d, nd);
+                break;
+            case 0xDA:
+            case 0xD9:
+                if (h->nErrorRecords++ < 10) {
+                    fprintf(stderr, "daq_host: error record %02X:", type);
+                    for (int i=0; i<nd && i<16; ++i) fprintf(stderr, " %02X", d[i]);
+                    fprintf(stderr, "\n");
+                }
+                break;
+            case 0xDE:
+            case 0xDF:
+                h->nHousekeeping++;
+                break;
+            case 0x3C:
+                if (h->phase == WAIT_BOR) {
+                    h->phase = ENABLE;
+                    h->tPhase = mockCycles();
+                }
+                break;
+            case 0x44:
+                if (nd >= 14 && memcmp(d, "EOR", 3) == 0) {
+                    h->gotEOR = true;
+                    h->eorGO = be32(d + 9);
+                    h->eorBadCRC = d[13];
+                }
+                if (h->phase == WAIT_EOR) {
+                    h->phase = DRAIN;
+                    h->tPhase = mockCycles();
+                }
+                break;
+        }
+    }
+}
+
+static int onLoop(void *arg) {
+    struct Host *h = arg;
+    parseOutput(h);
+    switch (h->phase) {
+        case CONFIGURE:
+            for (int i=0; i<h->nCmds; ++i) mockCommand(h->cmds[i].code, h->cmds[i].nData, h->cmds[i].data);
+            mockCommand(0x3C, 4, (uint8[]){h->run >> 8, h->run & 0xFF, 1, h->flags});
+            h->phase = WAIT_BOR;
+            break;
+        case ENABLE:
+            mockCommand(0x3B, 1, (uint8[]){1});
+            h->phase = WAIT_ENABLE;
+            h->tPhase = mockCycles();
+            break;
+        case WAIT_ENABLE:   // Until the trigger enable command is surely in
+            if (mockCycles() - h->tPhase < MOCK_US(20000)) break;
+            h->phase = RUN;
+            if (h->rate > 0) poisson(h);
+            break;
+        case RUN:
+            if (h->rate == 0 && h->nTriggers < h->nEvents && mockTriggerArmed()) trigger(h);
+            if (h->nEventsOut >= h->nEvents || (h->nTriggers >= h->nEvents && mockTriggerArmed())) {
+                mockCommand(0x44, 0, NULL);
+                h->phase = WAIT_EOR;
+            }
+            break;
+        case DRAIN:   // Let the error records that follow the end of run come out
+            if (mockCycles() - h->tPhase > MOCK_US(50000)) h->phase = DONE;
+            break;
+        default:
+            break;
+    }
+    return h->phase == DONE;
+}
+
+// "code:data,data..." in hex
+static bool parseCmd(const char *s, struct Cmd *cmd) {
+    char *end;
+    cmd->code = strtoul(s, &end, 16);
+    cmd->nData = 0;
+    if (end == s) return false;
+    while (*end == ':' || *end == ',') {
+        if (cmd->nData == (int)sizeof(cmd->data)) return false;
+        s = end + 1;
+        cmd->data[cmd->nData++] = strtoul(s, &end, 16);
+        if (end == s) return false;
+    }
+    return *end == '\0';
+}
+
+static void addCmd(struct Host *h, uint8 code, int nData, const uint8 *data) {
+    if (h->nCmds == MAX_CMDS) return;
+    struct Cmd *cmd = &h->cmds[h->nCmds++];
+    cmd->code = code;
+    cmd->nData = nData;
+    memcpy(cmd->data, data, nData);
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: daq_host [-n events] [-r Hz] [-R run] [-f flags] [-d diag] [-k seconds] [-b boards]\n"
+                    "                [-m chips[:clusters]] [-l latency us] [-x fault=rate,...] [-e tty]\n"
+                    "                [-c code:data,...] [-s seed] [-t seconds] [-o stream] [-v]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static struct Host host;
+    struct Host *h = &host;
+    struct TkrSimConfig tkrConfig = {.nBoards = 1, .maxChips = 4, .maxClusters = 2, .seed = 1};
+    struct Cmd extra[MAX_CMDS];
+    int nExtra = 0, diag = -1, houseKeeping = 0;
+    const char *outName = NULL, *tkrName = NULL;
+    double timeLimit = 0;
+    h->nEvents = 1000;
+    h->run = 1;
+    h->nBoards = 1;
+    h->latencyUs = 10;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:r:R:f:d:k:b:m:l:x:e:c:s:t:o:v")) != -1) {
+        switch (opt) {
+            case 'n': h->nEvents = strtoul(optarg, NULL, 0); break;
+            case 'r': h->rate = atof(optarg); break;
+            case 'R': h->run = strtoul(optarg, NULL, 0); break;
+            case 'f': h->flags = strtoul(optarg, NULL, 0); break;
+            case 'd': diag = atoi(optarg); break;
+            case 'k': houseKeeping = atoi(optarg); break;
+            case 'b': h->nBoards = atoi(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d", &tkrConfig.maxChips, &tkrConfig.maxClusters) < 1) return usage();
+                break;
+            case 'l': h->latencyUs = strtoul(optarg, NULL, 0); break;
+            case 'x':
+                if (!tkrSimFaults(&tkrConfig, optarg)) return usage();
+                break;
+            case 'e': tkrName = optarg; break;
+            case 's': tkrConfig.seed = strtoul(optarg, NULL, 0); break;
+            case 't': timeLimit = atof(optarg); break;
+            case 'o': outName = optarg; break;
+            case 'v': h->verbose = true; break;
+            case 'c':
+                if (nExtra == MAX_CMDS || !parseCmd(optarg, &extra[nExtra++])) return usage();
+                break;
+            default: return usage();
+        }
+    }
+    if (optind != argc || h->nEvents == 0 || h->nBoards < 1 || h->nBoards > TKR_SIM_MAX_BOARDS) return usage();
+
+    tkrConfig.nBoards = h->nBoards;
+    tkrSimInit(&h->tkr, &tkrConfig);
+    for (int f=0; f<TKR_NUM_FAULTS; ++f) h->faults |= tkrConfig.faultRate[f] > 0;
+    h->tkrFd = -1;
+    if (tkrName != NULL) {
+        h->tkrFd = openTracker(tkrName);
+        if (h->tkrFd < 0) {
+            perror(tkrName);
+            return 1;
+        }
+        h->faults = true;
+    }
+    h->rng = tkrConfig.seed*2654435761u + 1;
+    addCmd(h, 0x10, 4, (uint8[]){0, 0x0F, 1, h->nBoards});
+    if (diag >= 0) addCmd(h, 0x4E, 1, (uint8[]){diag});
+    if (houseKeeping > 0) addCmd(h, 0x57, 2, (uint8[]){houseKeeping, 0});
+    for (int i=0; i<nExtra; ++i) addCmd(h, extra[i].code, extra[i].nData, extra[i].data);
+
+    // Enough for a slow readout of every event, for the Poisson gaps at the rate asked for, and for the 2 s
+    // Tracker reset that may follow a fault
+    double faultsPerEvent = h->nBoards*(tkrConfig.faultRate[TKR_FAULT_BAD_ID] + tkrConfig.faultRate[TKR_FAULT_SHORT_BOARD]
+                            + tkrConfig.faultRate[TKR_FAULT_BAD_CRC]) + 3*tkrConfig.faultRate[TKR_FAULT_TIMEOUT];
+    mockConfig.timeLimit = timeLimit > 0 ? timeLimit : 5. + h->nEvents*(0.05 + (h->rate > 0 ? 3./h->rate : 0)
+                                                                        + 5*faultsPerEvent);
+    mockInit();
+    FILE *out = NULL;
+    if (outName != NULL) {
+        out = fopen(outName, "wb");
+        if (out == NULL) {
+            perror(outName);
+            return 1;
+        }
+        mockOutputFile(out);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (h->tkrFd >= 0) {
+        wall0 = t0;
+        mockTracker(extTkrByte, h);
+        mockAt(MOCK_US(100), extTkrPoll, h);
+    } else {
+        mockTracker(tkrByte, h);
+    }
+    int stop = mockRun(fw_main, onLoop, h);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    parseOutput(h);
+    if (out != NULL) fclose(out);
+    if (h->tkrFd >= 0) close(h->tkrFd);
+    double wall = (t1.tv_sec - t0.tv_sec) + 1.e-9*(t1.tv_nsec - t0.tv_nsec);
+
+    size_t nOut;
+    mockOutput(&nOut);
+    double tRun = h->tEnd > h->tStart ? (double)(h->tEnd - h->tStart)/MOCK_CLOCK_HZ : 0;
+    printf("%u triggers accepted of %u, %u events out (%u truncated), %u error records, %u housekeeping records\n",
+           h->nTriggers, mockStats.triggers, h->nEventsOut, h->nTruncated, h->nErrorRecords, h->nHousekeeping);
+    printf("virtual: %.3f s in all, %.3f s of run, %.3f ms per event, %.1f events/s\n", mockSeconds(), tRun,
+           h->nEventsOut > 1 ? 1000.*tRun/(h->nEventsOut - 1) : 0., tRun > 0 ? (h->nEventsOut - 1)/tRun : 0.);
+    printf("wall: %.3f s, %.0f events/s, %.0f ns per API call, %llu calls, %llu loop passes\n", wall,
+           h->nEventsOut/wall, 1.e9*wall/(mockStats.calls ? mockStats.calls : 1),
+           (unsigned long long)mockStats.calls, (unsigned long long)mockStats.loops);
+    printf("tracker: %llu bytes out, %llu bytes in, %llu overruns, %llu hit list bytes; %llu bytes output\n",
+           (unsigned long long)mockStats.tkrTxBytes, (unsigned long long)mockStats.tkrRxBytes,
+           (unsigned long long)mockStats.tkrOverruns, (unsigned long long)h->nHitBytes, (unsigned long long)nOut);
+    if (h->faults) {
+        printf("faults:");
+        if (h->tkrFd >= 0) printf(" from the external Tracker,");
+        else for (int f=0; f<TKR_NUM_FAULTS; ++f) printf(" %s %u,", tkrFaultName[f], h->tkr.nFaults[f]);
+        printf(" hit lists with a bad CRC %u, replaced %u; EOR bad CRC count %u\n", h->nBadCRC, h->nDummy,
+               h->eorBadCRC);
+    }
+
+    int failed = 0;
+    if (stop != MOCK_STOPPED) {
+        fprintf(stderr, "daq_host: run %s\n", stop == MOCK_TIME_LIMIT ? "hit the virtual time limit" :
+                                              stop == MOCK_RESET ? "ended in a software reset" : "returned from main");
+        failed = 1;
+    }
+    if (h->nEventsOut != h->nTriggers || h->nEventsOut != h->nEvents) {
+        fprintf(stderr, "daq_host: %u events out for %u triggers\n", h->nEventsOut, h->nTriggers);
+        failed = 1;
+    }
+    if (h->nBadEvents > 0 || h->nBadFrames > 0 || (!h->faults && (h->nBadCRC > 0 || h->nDummy > 0))) {
+        fprintf(stderr, "daq_host: %u bad events, %u bad hit lists, %u replaced, %u bytes outside frames\n",
+                h->nBadEvents, h->nBadCRC, h->nDummy, h->nBadFrames);
+        failed = 1;
+    }
+    if (!h->gotEOR || h->eorGO != h->nTriggers || (!h->faults && h->eorBadCRC != 0)) {
+        fprintf(stderr, "daq_host: end of run %s, %u GO, %u bad CRC\n", h->gotEOR ? "received" : "missing",
+                h->eorGO, h->eorBadCRC);
+        failed = 1;
+    }
+    if (mockStats.tkrOverruns > 0 || mockStats.cmdOverruns > 0) {
+        fprintf(stderr, "daq_host: UART overruns\n");
+        failed = 1;
+    }
+    return failed;
+}
+
+/* [] END OF FILE */
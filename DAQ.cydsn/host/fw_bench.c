@@ -0,0 +1,343 @@
+/* ========================================
+ *
+ * Benchmark of the hot paths of the event PSOC firmware. The probes in main.c (PROBE_BEGIN/PROBE_END, compiled
+ * in with BENCH_PROBES) bracket makeEvent, copyTOF_DMA, the TOF matching, checkCRC with CRC6, the decoding of a
+ * command frame and interpretCommand. fw_bench runs the firmware against psoc_mock and tracker_sim as daq_host
+ * does, with the CRC checked on every event, canned TOF stops in both channels for every trigger and, after the
+ * run, rounds of a canned mix of commands. For each probe it prints the passes and the mean, minimum and maximum
+ * cost, and the mean cost without the probes nested in it (the self column).
+ *    fw_bench [-n events] [-b boards] [-m chips[:clusters]] [-c rounds] [-w baud] [-s seed]
+ * The cost is in nanoseconds of wall-clock time.
+ * Everything the firmware calls inside a probe is counted in it, psoc_mock and the handlers it runs included, so
+ * the mean number of component API calls per pass is printed too. The Tracker and command links run at -w baud
+ * (default 4 Mbaud) so that the counts measure the code rather than polls of a slow UART.
+ * Exits with 1 if the run does not complete.
+ *
+ * =========================================
+ */
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "psoc_mock.h"
+#include "tracker_sim.h"
+
+int fw_main(void);
+
+// In the order of enum Probes in main.c
+#define NUM_PROBES 6
+static const char *const probeName[NUM_PROBES] = {"makeEvent", "copyTOF_DMA", "TOF matching", "checkCRC",
+                                                  "command frame", "interpretCommand"};
+
+// Where the TOF DMA leaves the stops for makeEvent
+extern volatile uint32 tofA_sampleArray[], tofB_sampleArray[];
+extern volatile uint8 tofA_clkArray[], tofB_clkArray[];
+extern uint8 nTOF_DMA_samples;
+
+// Wall-clock nanoseconds, modulo 2^32
+static inline uint32 counter(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint32)(t.tv_sec*1000000000ull + t.tv_nsec);
+}
+
+struct Probe {
+    uint32 n;
+    int64_t total, self;
+    uint32 min, max;
+    uint64 apiCalls;
+};
+
+#define MAX_DEPTH 8
+
+static struct Probe probes[NUM_PROBES];
+static struct {
+    uint8 probe;
+    uint32 t0;
+    uint64 calls0;
+    int64_t nested;    // Spent in the probes inside this one
+} stack[MAX_DEPTH];
+static int depth;
+static bool benchOn;          // Statistics are kept only for the parts of the run being measured
+static uint32 nMismatched;    // PROBE_END without its PROBE_BEGIN
+static int64_t inner;         // Counts a begin-end pair adds to its own span
+static int64_t outer;         // and to the span of the probe around it
+
+void benchProbe(uint8 probe, bool begin) {
+    uint32 t = counter();
+    if (probe >= NUM_PROBES) {
+        nMismatched++;
+        return;
+    }
+    if (begin) {
+        if (depth == MAX_DEPTH) {
+            nMismatched++;
+            return;
+        }
+        stack[depth].probe = probe;
+        stack[depth].calls0 = mockStats.calls;
+        stack[depth].nested = 0;
+        stack[depth++].t0 = counter();    // Last, to leave the bookkeeping out
+        return;
+    }
+    if (depth == 0 || stack[depth-1].probe != probe) {
+        nMismatched++;
+        depth = 0;
+        return;
+    }
+    --depth;
+    int64_t dt = (int64_t)(uint32)(t - stack[depth].t0) - inner;
+    if (dt < 0) dt = 0;
+    if (depth > 0) stack[depth-1].nested += dt + outer;
+    if (!benchOn) return;
+    struct Probe *p = &probes[probe];
+    if (p->n == 0 || dt < p->min) p->min = (uint32)dt;
+    if (dt > p->max) p->max = (uint32)dt;
+    p->n++;
+    p->total += dt;
+    p->self += dt - stack[depth].nested;
+    p->apiCalls += mockStats.calls - stack[depth].calls0;
+}
+
+// The cost of the probes themselves, from empty and nested empty pairs
+static void calibrate(void) {
+    enum { N = 64 };
+    benchOn = true;
+    for (int i=0; i<N; ++i) {
+        benchProbe(0, true);
+        benchProbe(0, false);
+    }
+    inner = probes[0].total/N;
+    memset(probes, 0, sizeof(probes));
+    for (int i=0; i<N; ++i) {
+        benchProbe(0, true);
+        benchProbe(1, true);
+        benchProbe(1, false);
+        benchProbe(0, false);
+    }
+    outer = probes[0].total/N;
+    memset(probes, 0, sizeof(probes));
+    benchOn = false;
+}
+
+enum Phase { CONFIGURE, WAIT_BOR, ENABLE, WAIT_ENABLE, RUN, WAIT_EOR, COMMANDS, DONE };
+
+struct Cmd {
+    uint8 code;
+    int nData;
+    uint8 data[4];
+};
+
+// Read-only commands, answered from memory or the counters
+static const struct Cmd cmdMix[] = {{0x07, 0, {0}}, {0x3D, 0, {0}}, {0x37, 1, {1}}, {0x51, 0, {0}},
+                                    {0x53, 0, {0}}, {0x5A, 0, {0}}};
+#define N_CMD_MIX (int)(sizeof(cmdMix)/sizeof(cmdMix[0]))
+
+struct Bench {
+    uint32 nEvents;
+    int nBoards;
+    int nRounds;
+    struct TkrSim tkr;
+    uint32 rng;
+    enum Phase phase;
+    uint64 tPhase;
+    uint32 nTriggers, nEventsOut;
+    int nCmdsSent;
+    size_t parsed;
+};
+
+static uint32 rnd(struct Bench *b) {
+    uint32 x = b->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    b->rng = x;
+    return x;
+}
+
+static void tkrByte(uint8 byte, uint64 tDone, void *arg) {
+    struct Bench *b = arg;
+    uint8 reply[TKR_SIM_MAX_REPLY];
+    int n = tkrSimRx(&b->tkr, byte, reply);
+    if (n > 0) mockTkrReply(reply, n, tDone + MOCK_US(10));
+}
+
+// Four stops in each TOF channel in the current 5 ms tick, as the DMA would have stored them, the first two
+// within a few ns of each other
+static void tofStops(struct Bench *b) {
+    uint8 clk = Cntr8_Timer_ReadCount();
+    int n = nTOF_DMA_samples < 4 ? nTOF_DMA_samples : 4;
+    for (int i=0; i<n; ++i) {
+        uint32 ref = rnd(b)%60000;
+        uint32 stop = rnd(b)%8333;
+        tofA_sampleArray[i] = (ref << 16) | stop | 1;
+        tofA_clkArray[i] = clk;
+        if (i > 0) {
+            ref = rnd(b)%60000;
+            stop = rnd(b)%8333;
+        }
+        tofB_sampleArray[i] = (ref << 16) | (stop + rnd(b)%300) | 1;
+        tofB_clkArray[i] = clk;
+    }
+}
+
+static void trigger(struct Bench *b) {
+    uint16 pha[5];
+    for (int ch=0; ch<5; ++ch) pha[ch] = rnd(b) & 0xFFF;
+    tofStops(b);
+    if (!mockTrigger(0x0F, pha)) return;
+    b->nTriggers++;
+    tkrSimTrigger(&b->tkr, 0xC0);
+}
+
+// Count the events and catch the run start and end echoes
+static void parseOutput(struct Bench *b) {
+    size_t n;
+    const uint8 *out = mockOutput(&n);
+    while (b->parsed + 9 <= n) {
+        const uint8 *f = out + b->parsed;
+        if (f[0] != 0xDC || f[1] != 0x00 || f[2] != 0xFF) {
+            b->parsed++;
+            continue;
+        }
+        int len = f[3];
+        size_t frame = 9 + len + (3 - len%3)%3;
+        if (b->parsed + frame > n) break;
+        b->parsed += frame;
+        switch (f[4]) {
+            case 0xDD:
+            case 0xDB:
+                b->nEventsOut++;
+                break;
+            case 0x3C:
+                if (b->phase == WAIT_BOR) b->phase = ENABLE;
+                break;
+            case 0x44:
+                if (b->phase == WAIT_EOR) {
+                    b->phase = COMMANDS;
+                    b->tPhase = mockCycles();
+                    benchOn = true;
+                }
+                break;
+        }
+    }
+}
+
+static int onLoop(void *arg) {
+    struct Bench *b = arg;
+    parseOutput(b);
+    switch (b->phase) {
+        case CONFIGURE:
+            mockCommand(0x10, 4, (uint8[]){0, 0x0F, 1, b->nBoards});
+            mockCommand(0x4E, 1, (uint8[]){1});
+            mockCommand(0x3C, 4, (uint8[]){0, 1, 1, 0});
+            b->phase = WAIT_BOR;
+            break;
+        case ENABLE:
+            mockCommand(0x3B, 1, (uint8[]){1});
+            b->phase = WAIT_ENABLE;
+            b->tPhase = mockCycles();
+            break;
+        case WAIT_ENABLE:   // Until the trigger enable command is surely in
+            if (mockCycles() - b->tPhase < MOCK_US(20000)) break;
+            b->phase = RUN;
+            benchOn = true;
+            break;
+        case RUN:
+            if (b->nTriggers < b->nEvents && mockTriggerArmed()) trigger(b);
+            if (b->nEventsOut >= b->nEvents) {
+                benchOn = false;
+                mockCommand(0x44, 0, NULL);
+                b->phase = WAIT_EOR;
+            }
+            break;
+        case COMMANDS:   // One command every 2 ms, time enough for its answer to go out
+            if (mockCycles() - b->tPhase < MOCK_US(2000)) break;
+            b->tPhase = mockCycles();
+            if (b->nCmdsSent == b->nRounds*N_CMD_MIX) {
+                benchOn = false;
+                b->phase = DONE;
+                break;
+            }
+            const struct Cmd *cmd = &cmdMix[b->nCmdsSent++ % N_CMD_MIX];
+            mockCommand(cmd->code, cmd->nData, cmd->data);
+            break;
+        default:
+            break;
+    }
+    return b->phase == DONE;
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: fw_bench [-n events] [-b boards] [-m chips[:clusters]] [-c rounds] [-w baud] [-s seed]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    static struct Bench bench;
+    struct Bench *b = &bench;
+    struct TkrSimConfig tkrConfig = {.nBoards = 4, .maxChips = 4, .maxClusters = 2, .seed = 1};
+    uint32 baud = 4000000;
+    b->nEvents = 1000;
+    b->nBoards = 4;
+    b->nRounds = 20;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:m:c:w:s:")) != -1) {
+        switch (opt) {
+            case 'n': b->nEvents = strtoul(optarg, NULL, 0); break;
+            case 'b': b->nBoards = atoi(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d", &tkrConfig.maxChips, &tkrConfig.maxClusters) < 1) return usage();
+                break;
+            case 'c': b->nRounds = atoi(optarg); break;
+            case 'w': baud = strtoul(optarg, NULL, 0); break;
+            case 's': tkrConfig.seed = strtoul(optarg, NULL, 0); break;
+            default: return usage();
+        }
+    }
+    if (optind != argc || b->nEvents == 0 || b->nBoards < 1 || b->nBoards > TKR_SIM_MAX_BOARDS || baud == 0) {
+        return usage();
+    }
+
+    tkrConfig.nBoards = b->nBoards;
+    tkrSimInit(&b->tkr, &tkrConfig);
+    b->rng = tkrConfig.seed*2654435761u + 1;
+    mockConfig.tkrBaud = baud;
+    mockConfig.cmdBaud = baud;
+    mockConfig.timeLimit = 5. + 0.05*b->nEvents + 0.002*b->nRounds*N_CMD_MIX;
+    mockInit();
+    mockTracker(tkrByte, b);
+    calibrate();
+    int stop = mockRun(fw_main, onLoop, b);
+
+    printf("%u events, %d boards, %d rounds of %d commands; cost in ns, probe overhead %.1f inside, %.1f outside\n",
+           b->nEventsOut, b->nBoards, b->nRounds, N_CMD_MIX, (double)inner, (double)outer);
+    printf("%-17s %8s %10s %10s %10s %10s %10s\n", "", "passes", "mean", "min", "max", "self", "API calls");
+    for (int i=0; i<NUM_PROBES; ++i) {
+        const struct Probe *p = &probes[i];
+        double n = p->n > 0 ? p->n : 1;
+        printf("%-17s %8u %10.1f %10.1f %10.1f %10.1f %10.1f\n", probeName[i], p->n, p->total/n,
+               (double)p->min, (double)p->max, p->self/n, p->apiCalls/n);
+    }
+
+    int failed = 0;
+    if (stop != MOCK_STOPPED) {
+        fprintf(stderr, "fw_bench: run %s\n", stop == MOCK_TIME_LIMIT ? "hit the virtual time limit" :
+                                              stop == MOCK_RESET ? "ended in a software reset" : "returned from main");
+        failed = 1;
+    }
+    if (b->nEventsOut != b->nEvents || nMismatched > 0) {
+        fprintf(stderr, "fw_bench: %u events out of %u, %u unmatched probes\n", b->nEventsOut, b->nEvents,
+                nMismatched);
+        failed = 1;
+    }
+    if (mockStats.tkrOverruns > 0 || mockStats.cmdOverruns > 0) {
+        fprintf(stderr, "fw_bench: UART overruns at %u baud\n", baud);
+        failed = 1;
+    }
+    return failed;
+}
+
+/* [] END OF FILE */
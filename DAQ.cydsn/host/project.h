@@ -0,0 +1,315 @@
+/* ========================================
+ *
+ * Host build of the event PSOC firmware: stand-in for the project.h that PSoC Creator generates.
+ * It declares the same component APIs that main.c calls, with the same names, signatures and status bits,
+ * and psoc_mock.c implements them on a virtual clock. Only what main.c uses is here. The harness side of the
+ * mock (scripting registers, injecting commands and triggers, capturing output) is in psoc_mock.h.
+ *
+ * =========================================
+ */
+#ifndef PROJECT_H
+#define PROJECT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+typedef unsigned int uint;
+typedef volatile uint8 reg8;
+typedef volatile uint32 reg32;
+typedef uint8 cystatus;
+typedef void (*cyisraddress)(void);
+
+#define CY_ISR(FuncName) void FuncName(void)
+#define CYRET_SUCCESS 0x00u
+#define CYDEV_PERIPH_BASE 0x40000000u
+#define CYDEV_SRAM_BASE 0x1FFF8000u
+#define BCLK__BUS_CLK__MHZ 64u
+#define HI16(x) ((uint16)((uint32)(x) >> 16))
+#define LO16(x) ((uint16)(uint32)(x))
+
+// Global interrupt enable and critical sections (PRIMASK)
+void mock_GlobalIntEnable(void);
+#define CyGlobalIntEnable mock_GlobalIntEnable()
+uint8 CyEnterCriticalSection(void);
+void CyExitCriticalSection(uint8 savedIntrStatus);
+void CyDelay(uint32 milliseconds);
+void CyDelayUs(uint16 microseconds);
+void CySoftwareReset(void);
+
+// Cortex-M3 debug registers. The cycle counter is the virtual clock; writes to it are ignored.
+extern volatile uint32 mock_DWT_CTRL;
+extern volatile uint32 mock_DEMCR;
+volatile uint32 *mock_DWT_CYCCNT(void);
+#define DWT_CTRL mock_DWT_CTRL
+#define DWT_CYCCNT (*mock_DWT_CYCCNT())
+#define DEMCR mock_DEMCR
+
+// DMA
+#define CY_DMA_CPU_REQ 0x01u
+#define CY_DMA_CPU_TERM_TD 0x02u
+#define CY_DMA_CPU_TERM_CHAIN 0x04u
+#define CY_DMA_TD_INC_SRC_ADR 0x01u
+#define CY_DMA_TD_INC_DST_ADR 0x02u
+#define CY_DMA_TD_AUTO_EXEC_NEXT 0x20u
+#define DMA_TOFA__TD_TERMOUT_EN 0x04u
+#define DMA_TOFB__TD_TERMOUT_EN 0x04u
+cystatus CyDmaChEnable(uint8 chHandle, uint8 preserveTds);
+cystatus CyDmaChDisable(uint8 chHandle);
+cystatus CyDmaChGetRequest(uint8 chHandle);
+cystatus CyDmaChSetRequest(uint8 chHandle, uint8 request);
+cystatus CyDmaChPriority(uint8 chHandle, uint8 priority);
+cystatus CyDmaChRoundRobin(uint8 chHandle, uint8 enableRR);
+cystatus CyDmaChSetInitialTd(uint8 chHandle, uint8 startTd);
+uint8 CyDmaTdAllocate(void);
+uint8 CyDmaTdFreeCount(void);
+cystatus CyDmaTdSetAddress(uint8 tdHandle, uint16 source, uint16 destination);
+cystatus CyDmaTdSetConfiguration(uint8 tdHandle, uint16 transferCount, uint8 nextTd, uint8 configuration);
+uint8 DMA_TOFA_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress);
+uint8 DMA_TOFB_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress);
+
+// Interrupt components
+#define MOCK_ISR_API(name) \
+    void name##_StartEx(cyisraddress address); \
+    void name##_Enable(void); \
+    void name##_Disable(void); \
+    void name##_SetPriority(uint8 priority); \
+    void name##_ClearPending(void); \
+    uint8 name##_GetState(void);
+MOCK_ISR_API(isr_timer)
+MOCK_ISR_API(isr_clk200)
+MOCK_ISR_API(isr_Store_A)
+MOCK_ISR_API(isr_Store_B)
+MOCK_ISR_API(isr_TOFnrqA)
+MOCK_ISR_API(isr_TOFnrqB)
+MOCK_ISR_API(isr_Ch1)
+MOCK_ISR_API(isr_Ch2)
+MOCK_ISR_API(isr_Ch3)
+MOCK_ISR_API(isr_Ch4)
+MOCK_ISR_API(isr_Ch5)
+MOCK_ISR_API(isr_GO1)
+MOCK_ISR_API(isr_GO)
+MOCK_ISR_API(isr_UART)
+MOCK_ISR_API(isr_rst)
+MOCK_ISR_API(isr_TKR)
+MOCK_ISR_API(isr_1Hz)
+
+// Interrupt controller pending register, for reading the singles counter turnovers
+extern reg32 mock_INTC_SET_PD;
+#define isr_Ch1_INTC_SET_PD (&mock_INTC_SET_PD)
+#define isr_Ch2_INTC_SET_PD (&mock_INTC_SET_PD)
+#define isr_Ch3_INTC_SET_PD (&mock_INTC_SET_PD)
+#define isr_Ch4_INTC_SET_PD (&mock_INTC_SET_PD)
+#define isr_Ch5_INTC_SET_PD (&mock_INTC_SET_PD)
+#define isr_Ch1__INTC_MASK 0x01u
+#define isr_Ch2__INTC_MASK 0x02u
+#define isr_Ch3__INTC_MASK 0x04u
+#define isr_Ch4__INTC_MASK 0x08u
+#define isr_Ch5__INTC_MASK 0x10u
+
+// Control and status registers
+void Control_Reg_ADC_Write(uint8 control);
+void Control_Reg_Pls_Write(uint8 control);
+void Control_Reg_SSN_Write(uint8 control);
+uint8 Control_Reg_SSN_Read(void);
+void Control_Reg_Trg_Write(uint8 control);
+uint8 Control_Reg_Trg_Read(void);
+void Control_Reg_Trg1_Write(uint8 control);
+uint8 Control_Reg_Trg1_Read(void);
+void Control_Reg_Trg2_Write(uint8 control);
+uint8 Control_Reg_Trg2_Read(void);
+uint8 Status_Reg_Trg_Read(void);
+uint8 Status_Reg_M_Read(void);
+uint8 Status_Reg_DeadTime_Read(void);
+
+// Counters: the 200 Hz time base, the trigger prescalers, the singles counters and the 7-bit delay counters
+extern reg8 mock_Cntr8_Timer_Result_Reg;
+#define Cntr8_Timer_Result_Reg mock_Cntr8_Timer_Result_Reg
+uint8 Cntr8_Timer_ReadCount(void);
+void Cntr8_Timer_WritePeriod(uint8 period);
+uint8 Cntr8_V1_PMT_ReadPeriod(void);
+void Cntr8_V1_PMT_WritePeriod(uint8 period);
+uint8 Cntr8_V1_TKR_ReadPeriod(void);
+void Cntr8_V1_TKR_WritePeriod(uint8 period);
+uint8 Cntr8_V1_1_ReadCount(void);
+uint8 Cntr8_V1_2_ReadCount(void);
+uint8 Cntr8_V1_3_ReadCount(void);
+uint8 Cntr8_V1_4_ReadCount(void);
+uint8 Cntr8_V1_5_ReadCount(void);
+#define MOCK_COUNT7_API(name) \
+    void name##_Start(void); \
+    uint8 name##_ReadPeriod(void); \
+    void name##_WritePeriod(uint8 period);
+MOCK_COUNT7_API(Count7_1)
+MOCK_COUNT7_API(Count7_2)
+MOCK_COUNT7_API(Count7_3)
+MOCK_COUNT7_API(Count7_Trg)
+MOCK_COUNT7_API(TrigWindow_V1_2_Count7_1)
+MOCK_COUNT7_API(TrigWindow_V1_3_Count7_1)
+MOCK_COUNT7_API(TrigWindow_V1_4_Count7_1)
+MOCK_COUNT7_API(TrigWindow_V1_5_Count7_1)
+void Timer_1_Start(void);
+void Timer_1_Stop(void);
+uint8 Timer_1_ReadStatusRegister(void);
+
+// Analog
+void Comp_Ch1_Start(void);
+void Comp_Ch2_Start(void);
+void Comp_Ch3_Start(void);
+void Comp_Ch4_Start(void);
+void VDAC8_Ch1_Start(void);
+void VDAC8_Ch1_SetValue(uint8 value);
+void VDAC8_Ch2_Start(void);
+void VDAC8_Ch2_SetValue(uint8 value);
+void VDAC8_Ch3_Start(void);
+void VDAC8_Ch3_SetValue(uint8 value);
+void VDAC8_Ch4_Start(void);
+void VDAC8_Ch4_SetValue(uint8 value);
+cystatus DieTemp_1_GetTemp(int16 *temperature);
+
+// Pins
+uint8 Pin_Busy_Read(void);
+uint8 Pin_LED1_Read(void);
+void Pin_LED1_Write(uint8 value);
+void Pin_LED2_Write(uint8 value);
+void Pin_LED_DAT_Write(uint8 value);
+void Pin_LED_TKR_Write(uint8 value);
+void Pin_SSN_Main_Write(uint8 value);
+
+// Shift registers: TOF channels A and B, and the external SAR ADCs
+#define ShiftReg_A_IN_FIFO 0x01u
+#define ShiftReg_A_OUT_FIFO 0x02u
+#define ShiftReg_A_RET_FIFO_FULL 0x00u
+#define ShiftReg_A_RET_FIFO_NOT_EMPTY 0x01u
+#define ShiftReg_A_RET_FIFO_EMPTY 0x02u
+#define ShiftReg_A_LOAD 0x01u
+#define ShiftReg_A_STORE 0x02u
+#define ShiftReg_A_STORE_INT_EN 0x02u
+#define ShiftReg_B_IN_FIFO ShiftReg_A_IN_FIFO
+#define ShiftReg_B_OUT_FIFO ShiftReg_A_OUT_FIFO
+#define ShiftReg_B_RET_FIFO_FULL ShiftReg_A_RET_FIFO_FULL
+#define ShiftReg_B_RET_FIFO_NOT_EMPTY ShiftReg_A_RET_FIFO_NOT_EMPTY
+#define ShiftReg_B_RET_FIFO_EMPTY ShiftReg_A_RET_FIFO_EMPTY
+#define ShiftReg_B_LOAD ShiftReg_A_LOAD
+#define ShiftReg_B_STORE ShiftReg_A_STORE
+#define ShiftReg_B_STORE_INT_EN ShiftReg_A_STORE_INT_EN
+extern reg32 mock_ShiftReg_A_OUT_FIFO_VAL;
+extern reg32 mock_ShiftReg_B_OUT_FIFO_VAL;
+#define ShiftReg_A_OUT_FIFO_VAL_LSB_PTR (&mock_ShiftReg_A_OUT_FIFO_VAL)
+#define ShiftReg_B_OUT_FIFO_VAL_LSB_PTR (&mock_ShiftReg_B_OUT_FIFO_VAL)
+#define MOCK_SHIFTREG_API(name) \
+    void name##_Start(void); \
+    void name##_EnableInt(void); \
+    void name##_DisableInt(void); \
+    void name##_SetIntMode(uint8 interruptSource); \
+    uint8 name##_GetIntStatus(void); \
+    uint8 name##_GetFIFOStatus(uint8 fifoId); \
+    uint32 name##_ReadData(void);
+MOCK_SHIFTREG_API(ShiftReg_A)
+MOCK_SHIFTREG_API(ShiftReg_B)
+void ShiftReg_ADC_Start(void);
+uint32 ShiftReg_ADC_ReadRegValue(void);
+
+// SPI master shared by the TOF chip and the Main PSOC
+#define SPIM_DATA_WIDTH 8u
+#define SPIM_STS_SPI_DONE 0x01u
+#define SPIM_STS_TX_FIFO_EMPTY 0x02u
+#define SPIM_STS_TX_FIFO_NOT_FULL 0x04u
+#define SPIM_STS_BYTE_COMPLETE 0x08u
+#define SPIM_STS_SPI_IDLE 0x10u
+void SPIM_Start(void);
+void SPIM_Init(void);
+void SPIM_Enable(void);
+void SPIM_WriteTxData(uint8 txData);
+uint8 SPIM_ReadRxData(void);
+uint8 SPIM_GetRxBufferSize(void);
+uint8 SPIM_ReadTxStatus(void);
+void SPIM_ClearRxBuffer(void);
+void SPIM_ClearTxBuffer(void);
+
+// UARTs: commands from the Main PSOC, and the Tracker
+#define UART_CMD_RX_STS_OVERRUN 0x10u
+#define UART_CMD_RX_STS_FIFO_NOTEMPTY 0x20u
+#define UART_TKR_RX_STS_BREAK 0x02u
+#define UART_TKR_RX_STS_PAR_ERROR 0x04u
+#define UART_TKR_RX_STS_STOP_ERROR 0x08u
+#define UART_TKR_RX_STS_OVERRUN 0x10u
+#define UART_TKR_RX_STS_FIFO_NOTEMPTY 0x20u
+#define UART_TKR_TX_STS_COMPLETE 0x01u
+#define UART_TKR_TX_STS_FIFO_EMPTY 0x02u
+#define UART_TKR_TX_STS_FIFO_FULL 0x04u
+#define UART_TKR_TX_STS_FIFO_NOT_FULL 0x08u
+void UART_CMD_Start(void);
+uint8 UART_CMD_ReadRxStatus(void);
+uint16 UART_CMD_GetByte(void);
+void UART_TKR_Start(void);
+uint8 UART_TKR_ReadRxStatus(void);
+uint8 UART_TKR_ReadRxData(void);
+uint16 UART_TKR_GetByte(void);
+void UART_TKR_ClearRxBuffer(void);
+uint8 UART_TKR_ReadTxStatus(void);
+void UART_TKR_WriteTxData(uint8 txDataByte);
+void UART_TKR_ClearTxBuffer(void);
+
+// USB-UART
+#define USBUART_3V_OPERATION 0x00u
+#define USBUART_5V_OPERATION 0x01u
+void USBUART_Start(uint8 device, uint8 mode);
+uint8 USBUART_IsConfigurationChanged(void);
+uint8 USBUART_GetConfiguration(void);
+uint8 USBUART_CDC_Init(void);
+uint8 USBUART_CDCIsReady(void);
+uint8 USBUART_DataIsReady(void);
+uint16 USBUART_GetAll(uint8 *pData);
+void USBUART_PutData(const uint8 *pData, uint16 length);
+
+// I2C master
+#define I2C_2_MODE_COMPLETE_XFER 0x00u
+#define I2C_2_MSTR_NO_ERROR 0x00u
+#define I2C_2_MSTR_BUS_BUSY 0x01u
+#define I2C_2_MSTR_NOT_READY 0x02u
+#define I2C_2_MSTAT_CLEAR 0x00u
+#define I2C_2_MSTAT_RD_CMPLT 0x01u
+#define I2C_2_MSTAT_WR_CMPLT 0x02u
+#define I2C_2_MSTAT_XFER_INP 0x04u
+#define I2C_2_MSTAT_XFER_HALT 0x08u
+#define I2C_2_MSTAT_ERR_SHORT_XFER 0x10u
+#define I2C_2_MSTAT_ERR_ADDR_NAK 0x20u
+#define I2C_2_MSTAT_ERR_ARB_LOST 0x40u
+#define I2C_2_MSTAT_ERR_XFER 0x80u
+void I2C_2_Start(void);
+void I2C_2_Stop(void);
+uint8 I2C_2_MasterWriteBuf(uint8 slaveAddress, uint8 *wrData, uint8 cnt, uint8 mode);
+uint8 I2C_2_MasterReadBuf(uint8 slaveAddress, uint8 *rdData, uint8 cnt, uint8 mode);
+uint8 I2C_2_MasterStatus(void);
+uint8 I2C_2_MasterClearStatus(void);
+
+// EEPROM and real-time clock
+#define SIZEOF_EEPROM_ROW 16u
+#define CY_EEPROM_SIZE 2048u
+void EEPROM_1_Start(void);
+uint8 EEPROM_1_ReadByte(uint16 address);
+typedef struct {
+    uint8 Sec;
+    uint8 Min;
+    uint8 Hour;
+    uint8 DayOfWeek;
+    uint8 DayOfMonth;
+    uint16 DayOfYear;
+    uint8 Month;
+    uint16 Year;
+} RTC_1_TIME_DATE;
+void RTC_1_Start(void);
+RTC_1_TIME_DATE *RTC_1_ReadTime(void);
+void RTC_1_WriteTime(const RTC_1_TIME_DATE *timeDate);
+void RTC_1_EnableInt(void);
+void RTC_1_DisableInt(void);
+
+#endif
+/* [] END OF FILE */
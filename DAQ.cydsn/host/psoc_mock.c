@@ -0,0 +1,974 @@
+/* ========================================
+ *
+ * Host build of the event PSOC firmware: the component APIs of project.h on a virtual clock, and the harness
+ * API of psoc_mock.h. See psoc_mock.h for what is modelled.
+ *
+ * =========================================
+ */
+#define _DEFAULT_SOURCE
+#include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "psoc_mock.h"
+
+#define NEVER UINT64_MAX
+#define MS(ms) ((uint64)(ms)*BCLK__BUS_CLK__MHZ*1000u)
+#define TICK_5MS MS(5)
+#define HW_FIFO 4            // Depth of the UART and SPI hardware FIFOs
+#define MAX_AT 16
+#define MAX_RX_QUEUE 8192
+#define MAX_USB_PACKETS 64
+#define RTC_BASE 1704067200  // 2024-01-01 00:00:00 UTC
+#define PMT_WRAP 255u        // Counts per turnover of the singles counters, PMT_CNTR_WRAP in main.c
+#define CMD_FRAME 29         // CMD_LENGTH in main.c
+
+struct MockConfig mockConfig = {16, 115200, 115200, 1000, 90, 100, 60.};
+struct MockStats mockStats;
+uint8 mockI2cRegs[128][256];
+uint8 mockEeprom[CY_EEPROM_SIZE];
+volatile uint32 mock_DWT_CTRL;
+volatile uint32 mock_DEMCR;
+reg32 mock_INTC_SET_PD;
+reg8 mock_Cntr8_Timer_Result_Reg;
+reg32 mock_ShiftReg_A_OUT_FIFO_VAL;
+reg32 mock_ShiftReg_B_OUT_FIFO_VAL;
+
+// Virtual clock and run control
+static uint64 now;
+static uint64 limit;
+static jmp_buf runJump;
+static bool running;
+static int (*loopHook)(void *arg);
+static void *loopArg;
+
+// Interrupt controller
+static struct {
+    cyisraddress handler;
+    bool enabled, pending;
+    uint8 priority;
+} irq[MOCK_NUM_IRQ];
+static bool primask;
+static int activePriority;     // Of the running handler; 8 in thread mode
+
+// Scripted registers
+#define MAX_PUSHED 64
+static struct {
+    bool set;
+    uint32 value;
+    uint32 pushed[MAX_PUSHED];
+    int nPushed, next;
+} script[MOCK_NUM_REG];
+
+// Trigger logic and time base
+static bool armed;
+static uint8 trgStatusLatch;
+static uint16 phaLatch[5];
+static uint8 ctrlTrg, ctrlTrg1, ctrlTrg2, ctrlSSN;
+static uint64 nextSecond;
+static uint64 ledTimerDue;
+
+// Singles counters: counts n(t) = pmtOffset + floor((t - pmtBase)*rate/clock)
+static double pmtRate[5];
+static uint64 pmtBase[5], pmtOffset[5], pmtNext[5];
+
+// Timed callbacks from the harness
+static struct { uint64 t; void (*fn)(void *arg); void *arg; } at[MAX_AT];
+static int nAt;
+
+// A UART receiver: bytes in flight with their arrival times, then the hardware FIFO
+struct RxLine {
+    uint8 byte[MAX_RX_QUEUE];
+    uint64 t[MAX_RX_QUEUE];
+    int head, tail;
+    uint8 fifo[HW_FIFO];
+    int fifoHead, nFifo;
+    uint8 status;             // Sticky error bits
+    uint64 lastArrival;
+};
+static struct RxLine tkrRx, cmdRx;
+static uint64 tkrTxBusy;      // When the last byte written to the tracker finishes
+static void (*tkrListener)(uint8 byte, uint64 tDone, void *arg);
+static void *tkrListenerArg;
+
+// SPI master
+static uint64 spiBusy;
+static int spiRx;
+static uint8 pinSSNMain = 1, pinLED1;
+
+// USB-UART
+static bool usbConnected, usbChanged;
+static struct { uint8 data[64]; uint16 n; } usbPacket[MAX_USB_PACKETS];
+static int usbHead, usbTail;
+
+// I2C master
+static bool i2cAbsent[128];
+static uint8 i2cPtr[128];
+static uint8 i2cStatus;
+static uint8 i2cResult;
+static uint64 i2cDone;
+
+// EEPROM and RTC
+static int64_t rtcOffset;
+static RTC_1_TIME_DATE rtcTime;
+
+// Output to the Main PSOC or the USB host
+static uint8 *outBuf;
+static size_t nOut, outCapacity;
+static FILE *outFile;
+
+static void deliver(void);
+static void advanceTo(uint64 t);
+
+static uint64 byteCycles(uint32 baud) {
+    return (MOCK_CLOCK_HZ*10 + baud - 1)/baud;
+}
+
+static void tick(void) {
+    mockStats.calls++;
+    advanceTo(now + mockConfig.cyclesPerCall);
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * Event sources
+ */
+
+static uint64 pmtCount(int ch, uint64 t) {
+    if (pmtRate[ch] <= 0.) return pmtOffset[ch];
+    return pmtOffset[ch] + (uint64)((double)(t - pmtBase[ch])*pmtRate[ch]/MOCK_CLOCK_HZ);
+}
+
+static void pmtSchedule(int ch) {
+    if (pmtRate[ch] <= 0.) {
+        pmtNext[ch] = NEVER;
+        return;
+    }
+    uint64 target = (pmtCount(ch, now)/PMT_WRAP + 1)*PMT_WRAP - pmtOffset[ch];
+    pmtNext[ch] = pmtBase[ch] + (uint64)((double)target*MOCK_CLOCK_HZ/pmtRate[ch]) + 1;
+}
+
+static void pmtRebase(int ch, bool zero) {
+    pmtOffset[ch] = zero ? 0 : pmtCount(ch, now);
+    pmtBase[ch] = now;
+    pmtSchedule(ch);
+}
+
+static void rxArrive(struct RxLine *line, uint64 *overruns, uint8 overrunBit) {
+    uint8 byte = line->byte[line->head];
+    line->head = (line->head + 1)%MAX_RX_QUEUE;
+    if (line->nFifo == HW_FIFO) {
+        line->status |= overrunBit;
+        (*overruns)++;
+        return;
+    }
+    line->fifo[(line->fifoHead + line->nFifo)%HW_FIFO] = byte;
+    line->nFifo++;
+}
+
+static void rxQueue(struct RxLine *line, const uint8 *bytes, int n, uint64 tFirst, uint64 dt) {
+    uint64 t = tFirst;
+    if (t < line->lastArrival + dt) t = line->lastArrival + dt;
+    if (t < now) t = now;
+    for (int i=0; i<n; ++i) {
+        int next = (line->tail + 1)%MAX_RX_QUEUE;
+        if (next == line->head) break;     // Dropped on the floor: the harness is far ahead of the firmware
+        line->byte[line->tail] = bytes[i];
+        line->t[line->tail] = t;
+        line->tail = next;
+        line->lastArrival = t;
+        t += dt;
+    }
+}
+
+static uint64 nextEvent(void) {
+    uint64 t = nextSecond;
+    if (tkrRx.head != tkrRx.tail && tkrRx.t[tkrRx.head] < t) t = tkrRx.t[tkrRx.head];
+    if (cmdRx.head != cmdRx.tail && cmdRx.t[cmdRx.head] < t) t = cmdRx.t[cmdRx.head];
+    for (int ch=0; ch<5; ++ch) if (pmtNext[ch] < t) t = pmtNext[ch];
+    if (ledTimerDue < t) t = ledTimerDue;
+    for (int i=0; i<nAt; ++i) if (at[i].t < t) t = at[i].t;
+    return t;
+}
+
+// Fire everything due at the current time
+static void fireEvents(void) {
+    if (nextSecond <= now) {
+        irq[MOCK_IRQ_CLK200].pending = true;
+        irq[MOCK_IRQ_1HZ].pending = true;
+        nextSecond += MOCK_CLOCK_HZ;
+    }
+    while (tkrRx.head != tkrRx.tail && tkrRx.t[tkrRx.head] <= now) {
+        rxArrive(&tkrRx, &mockStats.tkrOverruns, UART_TKR_RX_STS_OVERRUN);
+        mockStats.tkrRxBytes++;
+    }
+    while (cmdRx.head != cmdRx.tail && cmdRx.t[cmdRx.head] <= now) {
+        rxArrive(&cmdRx, &mockStats.cmdOverruns, UART_CMD_RX_STS_OVERRUN);
+        mockStats.cmdBytes++;
+    }
+    for (int ch=0; ch<5; ++ch) {
+        if (pmtNext[ch] <= now) {
+            mock_INTC_SET_PD |= 1u << ch;
+            pmtSchedule(ch);
+        }
+    }
+    if (ledTimerDue <= now) {
+        irq[MOCK_IRQ_TIMER].pending = true;
+        ledTimerDue = now + MS(mockConfig.ledTimerMs);   // Free-running until the handler stops it
+    }
+    for (int i=0; i<nAt; ) {
+        if (at[i].t <= now) {
+            void (*fn)(void *) = at[i].fn;
+            void *arg = at[i].arg;
+            at[i] = at[--nAt];
+            fn(arg);
+        } else {
+            ++i;
+        }
+    }
+}
+
+static void advanceTo(uint64 t) {
+    for (;;) {
+        uint64 next = nextEvent();
+        if (next > t || next > limit) break;
+        if (next > now) now = next;
+        fireEvents();
+        deliver();
+    }
+    if (t > now) now = t;
+    if (now >= limit && running) longjmp(runJump, MOCK_TIME_LIMIT);
+    deliver();
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * Interrupt delivery
+ */
+
+static void deliver(void) {
+    for (;;) {
+        // Level-sensitive lines follow their sources
+        irq[MOCK_IRQ_UART].pending = cmdRx.nFifo > 0;
+        irq[MOCK_IRQ_TKR].pending = tkrRx.nFifo > 0;
+        for (int ch=0; ch<5; ++ch) irq[MOCK_IRQ_CH1 + ch].pending = (mock_INTC_SET_PD >> ch) & 1u;
+        if (primask) return;
+        int best = -1;
+        for (int i=0; i<MOCK_NUM_IRQ; ++i) {
+            if (!irq[i].pending || !irq[i].enabled || irq[i].handler == NULL) continue;
+            if (irq[i].priority >= activePriority) continue;
+            if (best < 0 || irq[i].priority < irq[best].priority) best = i;
+        }
+        if (best < 0) return;
+        irq[best].pending = false;
+        if (best >= MOCK_IRQ_CH1 && best <= MOCK_IRQ_CH5) mock_INTC_SET_PD &= ~(1u << (best - MOCK_IRQ_CH1));
+        int saved = activePriority;
+        activePriority = irq[best].priority;
+        mockStats.irqs[best]++;
+        irq[best].handler();
+        activePriority = saved;
+    }
+}
+
+void mock_GlobalIntEnable(void) {
+    primask = false;
+    tick();
+}
+
+uint8 CyEnterCriticalSection(void) {
+    uint8 saved = primask;
+    tick();
+    primask = true;
+    return saved;
+}
+
+void CyExitCriticalSection(uint8 savedIntrStatus) {
+    primask = savedIntrStatus;
+    tick();
+}
+
+void CyDelay(uint32 milliseconds) {
+    tick();
+    advanceTo(now + MS(milliseconds));
+}
+
+void CyDelayUs(uint16 microseconds) {
+    tick();
+    advanceTo(now + MOCK_US(microseconds));
+}
+
+void CySoftwareReset(void) {
+    if (running) longjmp(runJump, MOCK_RESET);
+}
+
+volatile uint32 *mock_DWT_CYCCNT(void) {
+    static volatile uint32 cycles;
+    cycles = (uint32)now;
+    return &cycles;
+}
+
+static void clearPending(enum MockIrq line) {
+    irq[line].pending = false;
+    if (line >= MOCK_IRQ_CH1 && line <= MOCK_IRQ_CH5) mock_INTC_SET_PD &= ~(1u << (line - MOCK_IRQ_CH1));
+    tick();
+}
+
+#define MOCK_ISR_IMPL(name, line) \
+    void name##_StartEx(cyisraddress address) { tick(); irq[line].handler = address; irq[line].enabled = true; } \
+    void name##_Enable(void) { irq[line].enabled = true; tick(); } \
+    void name##_Disable(void) { irq[line].enabled = false; tick(); } \
+    void name##_SetPriority(uint8 priority) { irq[line].priority = priority & 7; tick(); } \
+    void name##_ClearPending(void) { clearPending(line); } \
+    uint8 name##_GetState(void) { tick(); return irq[line].enabled; }
+MOCK_ISR_IMPL(isr_timer, MOCK_IRQ_TIMER)
+MOCK_ISR_IMPL(isr_clk200, MOCK_IRQ_CLK200)
+MOCK_ISR_IMPL(isr_Store_A, MOCK_IRQ_STORE_A)
+MOCK_ISR_IMPL(isr_Store_B, MOCK_IRQ_STORE_B)
+MOCK_ISR_IMPL(isr_TOFnrqA, MOCK_IRQ_TOFNRQA)
+MOCK_ISR_IMPL(isr_TOFnrqB, MOCK_IRQ_TOFNRQB)
+MOCK_ISR_IMPL(isr_Ch1, MOCK_IRQ_CH1)
+MOCK_ISR_IMPL(isr_Ch2, MOCK_IRQ_CH2)
+MOCK_ISR_IMPL(isr_Ch3, MOCK_IRQ_CH3)
+MOCK_ISR_IMPL(isr_Ch4, MOCK_IRQ_CH4)
+MOCK_ISR_IMPL(isr_Ch5, MOCK_IRQ_CH5)
+MOCK_ISR_IMPL(isr_GO1, MOCK_IRQ_GO1)
+MOCK_ISR_IMPL(isr_GO, MOCK_IRQ_GO)
+MOCK_ISR_IMPL(isr_UART, MOCK_IRQ_UART)
+MOCK_ISR_IMPL(isr_rst, MOCK_IRQ_RST)
+MOCK_ISR_IMPL(isr_TKR, MOCK_IRQ_TKR)
+MOCK_ISR_IMPL(isr_1Hz, MOCK_IRQ_1HZ)
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * Scripted registers
+ */
+
+static bool scripted(enum MockReg reg, uint32 *value) {
+    if (script[reg].next < script[reg].nPushed) {
+        *value = script[reg].pushed[script[reg].next++];
+        if (script[reg].next == script[reg].nPushed) script[reg].next = script[reg].nPushed = 0;
+        return true;
+    }
+    if (script[reg].set) *value = script[reg].value;
+    return script[reg].set;
+}
+
+void mockRegPush(enum MockReg reg, uint32 value) {
+    if (script[reg].nPushed < MAX_PUSHED) script[reg].pushed[script[reg].nPushed++] = value;
+}
+
+void mockRegSet(enum MockReg reg, uint32 value) {
+    script[reg].set = true;
+    script[reg].value = value;
+}
+
+void mockRegModel(enum MockReg reg) {
+    script[reg].set = false;
+    script[reg].nPushed = script[reg].next = 0;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * Control and status registers, counters
+ */
+
+void Control_Reg_ADC_Write(uint8 control) { (void)control; tick(); }
+
+void Control_Reg_Pls_Write(uint8 control) {
+    tick();
+    if (control & 0x01) armed = false;                       // PULSE_LOGIC_RST
+    if (control & 0x02) for (int ch=0; ch<5; ++ch) pmtRebase(ch, true);   // PULSE_CNTR_RST
+    if (control & 0x04) armed = true;                        // PULSE_TRIG_SET
+}
+
+void Control_Reg_SSN_Write(uint8 control) { ctrlSSN = control; tick(); }
+uint8 Control_Reg_SSN_Read(void) { tick(); return ctrlSSN; }
+
+void Control_Reg_Trg_Write(uint8 control) {
+    tick();
+    ctrlTrg = control;
+}
+
+uint8 Control_Reg_Trg_Read(void) { tick(); return ctrlTrg; }
+void Control_Reg_Trg1_Write(uint8 control) { ctrlTrg1 = control; tick(); }
+uint8 Control_Reg_Trg1_Read(void) { tick(); return ctrlTrg1; }
+void Control_Reg_Trg2_Write(uint8 control) { ctrlTrg2 = control; tick(); }
+uint8 Control_Reg_Trg2_Read(void) { tick(); return ctrlTrg2; }
+
+uint8 Status_Reg_Trg_Read(void) {
+    uint32 value = trgStatusLatch;
+    tick();
+    scripted(MOCK_REG_STATUS_TRG, &value);
+    return (uint8)value;
+}
+
+uint8 Status_Reg_M_Read(void) {
+    uint32 value = 0x28;
+    tick();
+    scripted(MOCK_REG_STATUS_M, &value);
+    return (uint8)value;
+}
+
+uint8 Status_Reg_DeadTime_Read(void) {
+    uint32 value = armed;
+    tick();
+    scripted(MOCK_REG_DEADTIME, &value);
+    return (uint8)value;
+}
+
+uint8 Cntr8_Timer_ReadCount(void) {
+    tick();
+    return (uint8)(((now + MOCK_CLOCK_HZ - nextSecond)/TICK_5MS)%200);
+}
+void Cntr8_Timer_WritePeriod(uint8 period) { (void)period; tick(); }
+
+static uint8 prescalePMT = 255, prescaleTKR = 255;
+uint8 Cntr8_V1_PMT_ReadPeriod(void) { tick(); return prescalePMT; }
+void Cntr8_V1_PMT_WritePeriod(uint8 period) { prescalePMT = period; tick(); }
+uint8 Cntr8_V1_TKR_ReadPeriod(void) { tick(); return prescaleTKR; }
+void Cntr8_V1_TKR_WritePeriod(uint8 period) { prescaleTKR = period; tick(); }
+
+static uint8 singlesCount(int ch) {
+    tick();
+    return (uint8)(pmtCount(ch, now)%PMT_WRAP);
+}
+uint8 Cntr8_V1_1_ReadCount(void) { return singlesCount(0); }
+uint8 Cntr8_V1_2_ReadCount(void) { return singlesCount(1); }
+uint8 Cntr8_V1_3_ReadCount(void) { return singlesCount(2); }
+uint8 Cntr8_V1_4_ReadCount(void) { return singlesCount(3); }
+uint8 Cntr8_V1_5_ReadCount(void) { return singlesCount(4); }
+
+#define MOCK_COUNT7_IMPL(name) \
+    static uint8 name##_period; \
+    void name##_Start(void) { tick(); } \
+    uint8 name##_ReadPeriod(void) { tick(); return name##_period; } \
+    void name##_WritePeriod(uint8 period) { name##_period = period & 0x7F; tick(); }
+MOCK_COUNT7_IMPL(Count7_1)
+MOCK_COUNT7_IMPL(Count7_2)
+MOCK_COUNT7_IMPL(Count7_3)
+MOCK_COUNT7_IMPL(Count7_Trg)
+MOCK_COUNT7_IMPL(TrigWindow_V1_2_Count7_1)
+MOCK_COUNT7_IMPL(TrigWindow_V1_3_Count7_1)
+MOCK_COUNT7_IMPL(TrigWindow_V1_4_Count7_1)
+MOCK_COUNT7_IMPL(TrigWindow_V1_5_Count7_1)
+
+void Timer_1_Start(void) {
+    tick();
+    if (ledTimerDue == NEVER) ledTimerDue = now + MS(mockConfig.ledTimerMs);
+}
+void Timer_1_Stop(void) { ledTimerDue = NEVER; tick(); }
+uint8 Timer_1_ReadStatusRegister(void) { tick(); return 0; }
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * Analog, pins, DMA and the TOF shift registers
+ */
+
+void Comp_Ch1_Start(void) { tick(); }
+void Comp_Ch2_Start(void) { tick(); }
+void Comp_Ch3_Start(void) { tick(); }
+void Comp_Ch4_Start(void) { tick(); }
+void VDAC8_Ch1_Start(void) { tick(); }
+void VDAC8_Ch1_SetValue(uint8 value) { (void)value; tick(); }
+void VDAC8_Ch2_Start(void) { tick(); }
+void VDAC8_Ch2_SetValue(uint8 value) { (void)value; tick(); }
+void VDAC8_Ch3_Start(void) { tick(); }
+void VDAC8_Ch3_SetValue(uint8 value) { (void)value; tick(); }
+void VDAC8_Ch4_Start(void) { tick(); }
+void VDAC8_Ch4_SetValue(uint8 value) { (void)value; tick(); }
+
+cystatus DieTemp_1_GetTemp(int16 *temperature) {
+    uint32 value = 25;
+    advanceTo(now + MOCK_US(30));     // The conversion blocks for tens of microseconds
+    tick();
+    scripted(MOCK_REG_DIETEMP, &value);
+    *temperature = (int16)value;
+    return CYRET_SUCCESS;
+}
+
+uint8 Pin_Busy_Read(void) {
+    uint32 value = 0;
+    tick();
+    scripted(MOCK_REG_BUSY, &value);
+    return (uint8)value;
+}
+uint8 Pin_LED1_Read(void) { tick(); return pinLED1; }
+void Pin_LED1_Write(uint8 value) { pinLED1 = value & 1; tick(); }
+void Pin_LED2_Write(uint8 value) { (void)value; tick(); }
+void Pin_LED_DAT_Write(uint8 value) { (void)value; tick(); }
+void Pin_LED_TKR_Write(uint8 value) { (void)value; tick(); }
+void Pin_SSN_Main_Write(uint8 value) { pinSSNMain = value & 1; tick(); }
+
+static uint8 tdNext;
+cystatus CyDmaChEnable(uint8 chHandle, uint8 preserveTds) { (void)chHandle; (void)preserveTds; tick(); return CYRET_SUCCESS; }
+cystatus CyDmaChDisable(uint8 chHandle) { (void)chHandle; tick(); return CYRET_SUCCESS; }
+cystatus CyDmaChGetRequest(uint8 chHandle) { (void)chHandle; tick(); return 0; }
+cystatus CyDmaChSetRequest(uint8 chHandle, uint8 request) { (void)chHandle; (void)request; tick(); return CYRET_SUCCESS; }
+cystatus CyDmaChPriority(uint8 chHandle, uint8 priority) { (void)chHandle; (void)priority; tick(); return CYRET_SUCCESS; }
+cystatus CyDmaChRoundRobin(uint8 chHandle, uint8 enableRR) { (void)chHandle; (void)enableRR; tick(); return CYRET_SUCCESS; }
+cystatus CyDmaChSetInitialTd(uint8 chHandle, uint8 startTd) { (void)chHandle; (void)startTd; tick(); return CYRET_SUCCESS; }
+uint8 CyDmaTdAllocate(void) { tick(); return tdNext < 128 ? tdNext++ : 0xFF; }
+uint8 CyDmaTdFreeCount(void) { tick(); return 128 - tdNext; }
+cystatus CyDmaTdSetAddress(uint8 tdHandle, uint16 source, uint16 destination) {
+    (void)tdHandle; (void)source; (void)destination;
+    tick();
+    return CYRET_SUCCESS;
+}
+cystatus CyDmaTdSetConfiguration(uint8 tdHandle, uint16 transferCount, uint8 nextTd, uint8 configuration) {
+    (void)tdHandle; (void)transferCount; (void)nextTd; (void)configuration;
+    tick();
+    return CYRET_SUCCESS;
+}
+uint8 DMA_TOFA_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress) {
+    (void)burstCount; (void)requestPerBurst; (void)upperSrcAddress; (void)upperDestAddress;
+    tick();
+    return 0;
+}
+uint8 DMA_TOFB_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress, uint16 upperDestAddress) {
+    (void)burstCount; (void)requestPerBurst; (void)upperSrcAddress; (void)upperDestAddress;
+    tick();
+    return 1;
+}
+
+#define MOCK_SHIFTREG_IMPL(name) \
+    void name##_Start(void) { tick(); } \
+    void name##_EnableInt(void) { tick(); } \
+    void name##_DisableInt(void) { tick(); } \
+    void name##_SetIntMode(uint8 interruptSource) { (void)interruptSource; tick(); } \
+    uint8 name##_GetIntStatus(void) { tick(); return 0; } \
+    uint8 name##_GetFIFOStatus(uint8 fifoId) { (void)fifoId; tick(); return name##_RET_FIFO_EMPTY; } \
+    uint32 name##_ReadData(void) { tick(); return 0; }
+MOCK_SHIFTREG_IMPL(ShiftReg_A)
+MOCK_SHIFTREG_IMPL(ShiftReg_B)
+
+void ShiftReg_ADC_Start(void) { tick(); }
+
+// The SAR ADC being read is the one selected by the chip-select decoder: SSN_CH1-5 & 7 = 1, 3, 7, 6, 4
+uint32 ShiftReg_ADC_ReadRegValue(void) {
+    static const int8 channel[8] = {-1, 0, -1, 1, 4, -1, 3, 2};
+    uint32 value = 0;
+    tick();
+    if (channel[ctrlSSN & 7] >= 0) value = phaLatch[channel[ctrlSSN & 7]];
+    scripted(MOCK_REG_ADC, &value);
+    return value & 0x0FFF;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * SPI master
+ */
+
+static uint64 spiByte(void) {
+    return ((uint64)mockConfig.spiByteNs*BCLK__BUS_CLK__MHZ + 999)/1000;
+}
+
+static void output(const uint8 *bytes, size_t n) {
+    if (nOut + n > outCapacity) {
+        outCapacity = 2*(nOut + n) + 4096;
+        outBuf = realloc(outBuf, outCapacity);
+        if (outBuf == NULL) abort();
+    }
+    memcpy(&outBuf[nOut], bytes, n);
+    nOut += n;
+    mockStats.outBytes += n;
+    if (outFile != NULL) fwrite(bytes, 1, n, outFile);
+}
+
+void SPIM_Start(void) { tick(); }
+void SPIM_Init(void) { tick(); }
+void SPIM_Enable(void) { tick(); }
+
+void SPIM_WriteTxData(uint8 txData) {
+    tick();
+    uint64 dt = spiByte();
+    if (spiBusy > now + HW_FIFO*dt) advanceTo(spiBusy - HW_FIFO*dt);   // Wait for room in the FIFO
+    spiBusy = (spiBusy > now ? spiBusy : now) + dt;
+    if (spiRx < HW_FIFO) spiRx++;
+    mockStats.spiBytes++;
+    if (pinSSNMain == 0) output(&txData, 1);
+}
+
+uint8 SPIM_ReadRxData(void) {
+    tick();
+    if (spiRx > 0) spiRx--;
+    return 0;
+}
+
+uint8 SPIM_GetRxBufferSize(void) { tick(); return (uint8)spiRx; }
+
+uint8 SPIM_ReadTxStatus(void) {
+    tick();
+    uint64 dt = spiByte();
+    if (now >= spiBusy) return SPIM_STS_SPI_DONE | SPIM_STS_TX_FIFO_EMPTY | SPIM_STS_TX_FIFO_NOT_FULL | SPIM_STS_SPI_IDLE;
+    uint8 status = 0;
+    if (spiBusy <= now + dt) status |= SPIM_STS_TX_FIFO_EMPTY;
+    if (spiBusy <= now + HW_FIFO*dt) status |= SPIM_STS_TX_FIFO_NOT_FULL;
+    return status;
+}
+
+void SPIM_ClearRxBuffer(void) { spiRx = 0; tick(); }
+void SPIM_ClearTxBuffer(void) {
+    tick();
+    uint64 dt = spiByte();
+    if (spiBusy > now + dt) spiBusy = now + dt;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * UARTs
+ */
+
+static uint16 rxGetByte(struct RxLine *line, uint8 notEmpty) {
+    uint16 status = line->status;
+    line->status = 0;
+    if (line->nFifo == 0) return status << 8;
+    uint8 byte = line->fifo[line->fifoHead];
+    line->fifoHead = (line->fifoHead + 1)%HW_FIFO;
+    line->nFifo--;
+    return ((status | notEmpty) << 8) | byte;
+}
+
+static uint8 rxStatus(struct RxLine *line, uint8 notEmpty) {
+    uint8 status = line->status;
+    line->status = 0;
+    return status | (line->nFifo > 0 ? notEmpty : 0);
+}
+
+void UART_CMD_Start(void) { tick(); }
+uint8 UART_CMD_ReadRxStatus(void) { tick(); return rxStatus(&cmdRx, UART_CMD_RX_STS_FIFO_NOTEMPTY); }
+uint16 UART_CMD_GetByte(void) { tick(); return rxGetByte(&cmdRx, UART_CMD_RX_STS_FIFO_NOTEMPTY); }
+
+void UART_TKR_Start(void) { tick(); }
+uint8 UART_TKR_ReadRxStatus(void) { tick(); return rxStatus(&tkrRx, UART_TKR_RX_STS_FIFO_NOTEMPTY); }
+uint8 UART_TKR_ReadRxData(void) { tick(); return (uint8)rxGetByte(&tkrRx, UART_TKR_RX_STS_FIFO_NOTEMPTY); }
+uint16 UART_TKR_GetByte(void) { tick(); return rxGetByte(&tkrRx, UART_TKR_RX_STS_FIFO_NOTEMPTY); }
+void UART_TKR_ClearRxBuffer(void) { tkrRx.nFifo = 0; tick(); }
+
+uint8 UART_TKR_ReadTxStatus(void) {
+    tick();
+    uint64 dt = byteCycles(mockConfig.tkrBaud);
+    uint8 status = 0;
+    if (tkrTxBusy <= now) status |= UART_TKR_TX_STS_COMPLETE;
+    if (tkrTxBusy <= now + dt) status |= UART_TKR_TX_STS_FIFO_EMPTY;    // The last byte is in the shifter
+    if (tkrTxBusy > now + (HW_FIFO + 1)*dt) status |= UART_TKR_TX_STS_FIFO_FULL;
+    else status |= UART_TKR_TX_STS_FIFO_NOT_FULL;
+    return status;
+}
+
+void UART_TKR_WriteTxData(uint8 txDataByte) {
+    tick();
+    uint64 dt = byteCycles(mockConfig.tkrBaud);
+    if (tkrTxBusy > now + (HW_FIFO + 1)*dt) advanceTo(tkrTxBusy - (HW_FIFO + 1)*dt);
+    tkrTxBusy = (tkrTxBusy > now ? tkrTxBusy : now) + dt;
+    mockStats.tkrTxBytes++;
+    if (tkrListener != NULL) tkrListener(txDataByte, tkrTxBusy, tkrListenerArg);
+}
+
+void UART_TKR_ClearTxBuffer(void) {
+    tick();
+    uint64 dt = byteCycles(mockConfig.tkrBaud);
+    if (tkrTxBusy > now + dt) tkrTxBusy = now + dt;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * USB-UART
+ */
+
+void USBUART_Start(uint8 device, uint8 mode) { (void)device; (void)mode; tick(); }
+
+// Called at the top of every main loop pass, which is where the harness gets control
+uint8 USBUART_IsConfigurationChanged(void) {
+    tick();
+    mockStats.loops++;
+    if (loopHook != NULL && loopHook(loopArg) != 0) longjmp(runJump, MOCK_STOPPED);
+    uint8 changed = usbChanged;
+    usbChanged = false;
+    return changed;
+}
+
+uint8 USBUART_GetConfiguration(void) { tick(); return usbConnected; }
+uint8 USBUART_CDC_Init(void) { tick(); return 1; }
+uint8 USBUART_CDCIsReady(void) { tick(); return 1; }
+uint8 USBUART_DataIsReady(void) { tick(); return usbHead != usbTail; }
+
+uint16 USBUART_GetAll(uint8 *pData) {
+    tick();
+    if (usbHead == usbTail) return 0;
+    uint16 n = usbPacket[usbHead].n;
+    memcpy(pData, usbPacket[usbHead].data, n);
+    usbHead = (usbHead + 1)%MAX_USB_PACKETS;
+    mockStats.cmdBytes += n;
+    return n;
+}
+
+void USBUART_PutData(const uint8 *pData, uint16 length) {
+    tick();
+    advanceTo(now + MOCK_US(1 + length/16));     // About 12 Mbit/s on the bus
+    if (usbConnected) output(pData, length);
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * I2C master
+ */
+
+static void i2cStart(uint8 slaveAddress, uint8 cnt, bool write) {
+    i2cStatus = I2C_2_MSTAT_XFER_INP;
+    mockStats.i2cTxn++;
+    if (i2cAbsent[slaveAddress & 0x7F]) {
+        mockStats.i2cNak++;
+        i2cDone = now + MOCK_US(mockConfig.i2cByteUs);
+        i2cResult = I2C_2_MSTAT_ERR_ADDR_NAK | I2C_2_MSTAT_ERR_XFER | (write ? I2C_2_MSTAT_WR_CMPLT : I2C_2_MSTAT_RD_CMPLT);
+    } else {
+        i2cDone = now + MOCK_US((uint32)mockConfig.i2cByteUs*(cnt + 1u));
+        i2cResult = write ? I2C_2_MSTAT_WR_CMPLT : I2C_2_MSTAT_RD_CMPLT;
+    }
+}
+
+void I2C_2_Start(void) { tick(); }
+
+// Abandons the transfer in progress; the bytes of a read already copied stay where they are
+void I2C_2_Stop(void) {
+    tick();
+    i2cStatus = I2C_2_MSTAT_CLEAR;
+}
+
+uint8 I2C_2_MasterWriteBuf(uint8 slaveAddress, uint8 *wrData, uint8 cnt, uint8 mode) {
+    (void)mode;
+    tick();
+    if (i2cStatus & I2C_2_MSTAT_XFER_INP) return I2C_2_MSTR_BUS_BUSY;
+    uint8 a = slaveAddress & 0x7F;
+    if (!i2cAbsent[a] && cnt > 0) {
+        i2cPtr[a] = wrData[0];
+        for (int i=1; i<cnt; ++i) mockI2cRegs[a][(uint8)(i2cPtr[a] + i - 1)] = wrData[i];
+    }
+    i2cStart(slaveAddress, cnt, true);
+    return I2C_2_MSTR_NO_ERROR;
+}
+
+uint8 I2C_2_MasterReadBuf(uint8 slaveAddress, uint8 *rdData, uint8 cnt, uint8 mode) {
+    (void)mode;
+    tick();
+    if (i2cStatus & I2C_2_MSTAT_XFER_INP) return I2C_2_MSTR_BUS_BUSY;
+    uint8 a = slaveAddress & 0x7F;
+    if (!i2cAbsent[a]) {
+        for (int i=0; i<cnt; ++i) rdData[i] = mockI2cRegs[a][(uint8)(i2cPtr[a] + i)];
+    }
+    i2cStart(slaveAddress, cnt, false);
+    return I2C_2_MSTR_NO_ERROR;
+}
+
+uint8 I2C_2_MasterStatus(void) {
+    tick();
+    if ((i2cStatus & I2C_2_MSTAT_XFER_INP) && now >= i2cDone) i2cStatus = i2cResult;
+    return i2cStatus;
+}
+
+uint8 I2C_2_MasterClearStatus(void) {
+    uint8 status = I2C_2_MasterStatus();
+    i2cStatus &= I2C_2_MSTAT_XFER_INP;
+    return status;
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * EEPROM and real-time clock
+ */
+
+void EEPROM_1_Start(void) { tick(); }
+uint8 EEPROM_1_ReadByte(uint16 address) { tick(); return mockEeprom[address%CY_EEPROM_SIZE]; }
+
+void RTC_1_Start(void) { tick(); }
+void RTC_1_EnableInt(void) { tick(); }
+void RTC_1_DisableInt(void) { tick(); }
+
+RTC_1_TIME_DATE *RTC_1_ReadTime(void) {
+    tick();
+    time_t t = (time_t)(RTC_BASE + rtcOffset + (int64_t)(now/MOCK_CLOCK_HZ));
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    rtcTime.Sec = tm.tm_sec;
+    rtcTime.Min = tm.tm_min;
+    rtcTime.Hour = tm.tm_hour;
+    rtcTime.DayOfWeek = tm.tm_wday + 1;
+    rtcTime.DayOfMonth = tm.tm_mday;
+    rtcTime.DayOfYear = tm.tm_yday + 1;
+    rtcTime.Month = tm.tm_mon + 1;
+    rtcTime.Year = tm.tm_year + 1900;
+    return &rtcTime;
+}
+
+void RTC_1_WriteTime(const RTC_1_TIME_DATE *timeDate) {
+    tick();
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_sec = timeDate->Sec;
+    tm.tm_min = timeDate->Min;
+    tm.tm_hour = timeDate->Hour;
+    tm.tm_mday = timeDate->DayOfMonth;
+    tm.tm_mon = timeDate->Month - 1;
+    tm.tm_year = timeDate->Year - 1900;
+    rtcOffset = (int64_t)timegm(&tm) - RTC_BASE - (int64_t)(now/MOCK_CLOCK_HZ);
+}
+
+/* ---------------------------------------------------------------------------------------------------------------
+ * Harness API
+ */
+
+void mockInit(void) {
+    now = 0;
+    limit = (uint64)(mockConfig.timeLimit*MOCK_CLOCK_HZ);
+    running = false;
+    memset(&mockStats, 0, sizeof(mockStats));
+    memset(irq, 0, sizeof(irq));
+    for (int i=0; i<MOCK_NUM_IRQ; ++i) irq[i].priority = 7;
+    primask = true;
+    activePriority = 8;
+    for (int reg=0; reg<MOCK_NUM_REG; ++reg) mockRegModel(reg);
+    armed = false;
+    trgStatusLatch = 0;
+    memset(phaLatch, 0, sizeof(phaLatch));
+    ctrlTrg = ctrlTrg1 = ctrlTrg2 = ctrlSSN = 0;
+    nextSecond = MOCK_CLOCK_HZ;
+    ledTimerDue = NEVER;
+    mock_INTC_SET_PD = 0;
+    for (int ch=0; ch<5; ++ch) {
+        pmtRate[ch] = 0.;
+        pmtRebase(ch, true);
+    }
+    nAt = 0;
+    memset(&tkrRx, 0, sizeof(tkrRx));
+    memset(&cmdRx, 0, sizeof(cmdRx));
+    tkrTxBusy = 0;
+    spiBusy = 0;
+    spiRx = 0;
+    pinSSNMain = 1;
+    pinLED1 = 0;
+    usbConnected = usbChanged = false;
+    usbHead = usbTail = 0;
+    memset(i2cPtr, 0, sizeof(i2cPtr));
+    i2cStatus = 0;
+    tdNext = 0;
+    rtcOffset = 0;
+    nOut = 0;
+}
+
+uint64 mockCycles(void) {
+    return now;
+}
+
+double mockSeconds(void) {
+    return (double)now/MOCK_CLOCK_HZ;
+}
+
+bool mockAt(uint64 t, void (*fn)(void *arg), void *arg) {
+    if (nAt == MAX_AT) return false;
+    at[nAt].t = t;
+    at[nAt].fn = fn;
+    at[nAt].arg = arg;
+    nAt++;
+    return true;
+}
+
+void mockSinglesRate(int ch, double hz) {
+    if (ch < 0 || ch >= 5) return;
+    pmtRebase(ch, false);
+    pmtRate[ch] = hz;
+    pmtSchedule(ch);
+}
+
+void mockCmdBytes(const uint8 *bytes, int n) {
+    if (usbConnected) {
+        int next = (usbTail + 1)%MAX_USB_PACKETS;
+        if (next == usbHead || n > 64) return;
+        memcpy(usbPacket[usbTail].data, bytes, n);
+        usbPacket[usbTail].n = n;
+        usbTail = next;
+        return;
+    }
+    uint64 dt = byteCycles(mockConfig.cmdBaud);
+    rxQueue(&cmdRx, bytes, n, now + dt, dt);
+}
+
+// One 29-byte frame: "S", the data byte and the address byte as lower-case hex, " xyW", three times, then CR LF
+static void cmdFrame(uint8 dataByte, uint8 addressByte) {
+    static const char hex[] = "0123456789abcdef";
+    uint8 frame[CMD_FRAME];
+    for (int i=0; i<3; ++i) {
+        uint8 *f = &frame[9*i];
+        f[0] = 'S';
+        f[1] = hex[dataByte >> 4];
+        f[2] = hex[dataByte & 0x0F];
+        f[3] = hex[addressByte >> 4];
+        f[4] = hex[addressByte & 0x0F];
+        f[5] = ' ';
+        f[6] = 'x';
+        f[7] = 'y';
+        f[8] = 'W';
+    }
+    frame[27] = '\r';
+    frame[28] = '\n';
+    mockCmdBytes(frame, CMD_FRAME);
+}
+
+void mockCommand(uint8 code, int nData, const uint8 *data) {
+    const uint8 address = 0x08 << 2;     // The event PSOC
+    cmdFrame(code, ((nData & 0x0C) << 4) | address | (nData & 0x03));
+    for (int i=1; i<=nData; ++i) cmdFrame(data[i-1], ((i & 0x0C) << 4) | address | (i & 0x03));
+}
+
+void mockUsbConnect(bool connected) {
+    if (connected && !usbConnected) usbChanged = true;
+    usbConnected = connected;
+}
+
+bool mockTriggerArmed(void) {
+    return armed && (ctrlTrg & 0x01);
+}
+
+bool mockTrigger(uint8 trgStatus, const uint16 pha[5]) {
+    mockStats.triggers++;
+    if (!mockTriggerArmed()) {
+        irq[MOCK_IRQ_GO1].pending = true;
+        return false;
+    }
+    armed = false;
+    trgStatusLatch = trgStatus;
+    for (int ch=0; ch<5; ++ch) phaLatch[ch] = pha != NULL ? pha[ch] : 0;
+    irq[MOCK_IRQ_GO].pending = true;
+    mockStats.triggersAccepted++;
+    return true;
+}
+
+void mockResetPulse(void) {
+    irq[MOCK_IRQ_RST].pending = true;
+}
+
+void mockTracker(void (*rx)(uint8 byte, uint64 tDone, void *arg), void *arg) {
+    tkrListener = rx;
+    tkrListenerArg = arg;
+}
+
+void mockTkrReply(const uint8 *bytes, int n, uint64 tFirst) {
+    rxQueue(&tkrRx, bytes, n, tFirst, byteCycles(mockConfig.tkrBaud));
+}
+
+void mockI2cAbsent(uint8 address, bool absent) {
+    i2cAbsent[address & 0x7F] = absent;
+}
+
+void mockOutputFile(FILE *f) {
+    outFile = f;
+}
+
+const uint8 *mockOutput(size_t *n) {
+    *n = nOut;
+    return outBuf;
+}
+
+int mockRun(int (*firmwareMain)(void), int (*onLoop)(void *arg), void *arg) {
+    loopHook = onLoop;
+    loopArg = arg;
+    int rc = setjmp(runJump);
+    if (rc == 0) {
+        running = true;
+        firmwareMain();
+        rc = MOCK_RETURNED;
+    }
+    running = false;
+    if (outFile != NULL) fflush(outFile);
+    return rc;
+}
+
+/* [] END OF FILE */
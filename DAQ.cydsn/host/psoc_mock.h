@@ -0,0 +1,135 @@
+/* ========================================
+ *
+ * Harness side of the host build of the event PSOC firmware.
+ *
+ * psoc_mock.c implements the component APIs declared in the host project.h on a virtual clock of bus cycles
+ * (64 MHz). Every API call costs mockConfig.cyclesPerCall cycles, CyDelay/CyDelayUs advance the clock, and the
+ * UARTs, SPI and I2C take the time their bytes take on the wire. The instructions between API calls are not
+ * counted, so virtual time measures waits and bus traffic, and wall-clock time measures the host CPU.
+ *
+ * Interrupts are delivered at API calls, as on the chip: a pending, enabled line runs its handler when PRIMASK
+ * is clear and its priority is above that of the running handler. The sources are
+ *    clk200 and 1Hz        every second of virtual time
+ *    UART (commands)       while its receive FIFO holds bytes, from mockCommand/mockCmdBytes
+ *    TKR (tracker)         while its receive FIFO holds bytes, from mockTkrReply
+ *    GO, GO1               from mockTrigger, depending on whether the trigger is armed
+ *    Ch1-Ch5               turnovers of the singles counters, at the rates from mockSinglesRate
+ *    timer                 the LED timer, after mockConfig.ledTimerMs
+ *    rst                   mockResetPulse
+ * The TOF shift registers and DMA never see a stop, so events carry no TOF time.
+ *
+ * The firmware is built with main renamed to fw_main and run by mockRun, which calls the harness at the top of
+ * each main loop pass (from USBUART_IsConfigurationChanged) and returns when the harness says so, when the
+ * virtual time limit is reached, or on CySoftwareReset.
+ *
+ * =========================================
+ */
+#ifndef PSOC_MOCK_H
+#define PSOC_MOCK_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "project.h"
+
+#define MOCK_CLOCK_HZ (BCLK__BUS_CLK__MHZ*1000000ull)
+#define MOCK_US(us) ((uint64)(us)*BCLK__BUS_CLK__MHZ)
+
+// Interrupt lines
+enum MockIrq {
+    MOCK_IRQ_TIMER, MOCK_IRQ_CLK200, MOCK_IRQ_STORE_A, MOCK_IRQ_STORE_B, MOCK_IRQ_TOFNRQA, MOCK_IRQ_TOFNRQB,
+    MOCK_IRQ_CH1, MOCK_IRQ_CH2, MOCK_IRQ_CH3, MOCK_IRQ_CH4, MOCK_IRQ_CH5, MOCK_IRQ_GO1, MOCK_IRQ_GO,
+    MOCK_IRQ_UART, MOCK_IRQ_RST, MOCK_IRQ_TKR, MOCK_IRQ_1HZ, MOCK_NUM_IRQ
+};
+
+// Registers whose reads can be scripted. Without a script each follows the model:
+//    STATUS_TRG    trigger status latched by the last accepted mockTrigger
+//    STATUS_M      0x28, the digitizers and the SAR ADC done
+//    DEADTIME      1 while the trigger is armed (live)
+//    ADC           the mockTrigger pulse height of the channel selected by Control_Reg_SSN
+//    BUSY          0, the Main PSOC is ready
+//    DIETEMP       25 degrees
+enum MockReg { MOCK_REG_STATUS_TRG, MOCK_REG_STATUS_M, MOCK_REG_DEADTIME, MOCK_REG_ADC, MOCK_REG_BUSY,
+               MOCK_REG_DIETEMP, MOCK_NUM_REG };
+
+struct MockConfig {
+    uint32 cyclesPerCall;    // Virtual cost of every API call
+    uint32 tkrBaud;          // Tracker UART, 10 bits per byte
+    uint32 cmdBaud;          // Command UART from the Main PSOC
+    uint32 spiByteNs;        // SPI byte time to the Main PSOC and the TOF chip
+    uint32 i2cByteUs;        // I2C byte time including the acknowledge
+    uint32 ledTimerMs;       // Period of the LED timer
+    double timeLimit;        // Seconds of virtual time after which mockRun gives up
+};
+extern struct MockConfig mockConfig;
+
+struct MockStats {
+    uint64 calls;                  // API calls made by the firmware
+    uint64 loops;                  // Main loop passes
+    uint64 irqs[MOCK_NUM_IRQ];     // Handler runs per line
+    uint64 tkrTxBytes, tkrRxBytes; // Tracker link, each way
+    uint64 tkrOverruns;            // Tracker bytes lost to a full receive FIFO
+    uint64 cmdBytes, cmdOverruns;
+    uint64 spiBytes;               // All SPI bytes, including the TOF chip setup
+    uint64 outBytes;               // Bytes sent to the Main PSOC or the USB host
+    uint64 i2cTxn, i2cNak;
+    uint32 triggers, triggersAccepted;
+};
+extern struct MockStats mockStats;
+
+// Power-on state of all the hardware, using mockConfig. Call before mockRun.
+void mockInit(void);
+
+// Virtual clock
+uint64 mockCycles(void);
+double mockSeconds(void);
+
+// Call fn(arg) at cycle t from inside the clock, as hardware would (up to 16 pending). It may raise triggers,
+// queue command or tracker bytes or schedule itself again, but must not call the firmware.
+bool mockAt(uint64 t, void (*fn)(void *arg), void *arg);
+
+// Scripted register reads: values pushed are returned once each, in order, and then the value set, if any,
+// on every read. mockRegModel goes back to the model.
+void mockRegPush(enum MockReg reg, uint32 value);
+void mockRegSet(enum MockReg reg, uint32 value);
+void mockRegModel(enum MockReg reg);
+
+// Singles rate of PMT channel 0-4 (G, T3, T1, T4, T2 as wired to Cntr8_V1_1-5), counts per second
+void mockSinglesRate(int ch, double hz);
+
+// Commands from the Main PSOC: raw bytes on the command UART (or one USB packet when USB is connected), or a
+// command in the triplicated ASCII format, one 29-byte frame for the code and one per data byte.
+void mockCmdBytes(const uint8 *bytes, int n);
+void mockCommand(uint8 code, int nData, const uint8 *data);
+void mockUsbConnect(bool connected);
+
+// Triggers. The hardware accepts one when the trigger is armed (PULSE_TRIG_SET since the last GO) and enabled
+// (Control_Reg_Trg bit 0): it latches the trigger status and the 5 pulse heights, disarms and raises GO.
+// Otherwise it raises GO1. Returns whether it was accepted.
+bool mockTriggerArmed(void);
+bool mockTrigger(uint8 trgStatus, const uint16 pha[5]);
+void mockResetPulse(void);
+
+// Tracker UART. Each byte the firmware writes is passed to rx with the cycle at which its stop bit ends.
+// Replies are queued with mockTkrReply, the first byte arriving at tFirst (or after the bytes already queued)
+// and the rest at the baud rate.
+void mockTracker(void (*rx)(uint8 byte, uint64 tDone, void *arg), void *arg);
+void mockTkrReply(const uint8 *bytes, int n, uint64 tFirst);
+
+// I2C devices answer at every address unless marked absent. Each has 256 registers addressed by the first
+// byte written; reads return the registers from there on.
+void mockI2cAbsent(uint8 address, bool absent);
+extern uint8 mockI2cRegs[128][256];
+
+extern uint8 mockEeprom[CY_EEPROM_SIZE];
+
+// Output to the Main PSOC (SPI bytes while Pin_SSN_Main is low) or to the USB host: kept in memory and, if a
+// file is given, written to it as it goes
+void mockOutputFile(FILE *f);
+const uint8 *mockOutput(size_t *n);
+
+// Run the firmware. onLoop(arg) is called at the top of each main loop pass; a nonzero return stops the run.
+enum MockStop { MOCK_STOPPED = 1, MOCK_TIME_LIMIT, MOCK_RESET, MOCK_RETURNED };
+int mockRun(int (*firmwareMain)(void), int (*onLoop)(void *arg), void *arg);
+
+#endif
+/* [] END OF FILE */
@@ -0,0 +1,161 @@
+/* ========================================
+ *
+ * Tracker emulator on a pseudo-terminal: tracker_sim speaking the UART_TKR protocol to whatever opens the pty,
+ * such as daq_host -e or a host tool on a serial port.
+ *    tkr_emu [-b boards] [-m chips[:clusters]] [-l latency us] [-r Hz] [-x fault=rate,...] [-s seed]
+ *            [-L link] [-v]
+ * The pty name is printed on startup, and -L also links it to a fixed path. Each reply goes out after the
+ * latency, paced at 115200 baud. With no trigger line the Tracker triggers itself: every event read finds an
+ * event, unless -r gives a Poisson trigger rate. On SIGINT or SIGTERM the command and fault counts are printed.
+ *
+ * =========================================
+ */
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "tracker_sim.h"
+
+#define BYTE_NS 86806   // 10 bits at 115200 baud
+
+static volatile sig_atomic_t stop;
+
+static void onSignal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + 1.e-9*t.tv_nsec;
+}
+
+static void sleepNs(long ns) {
+    struct timespec t = {ns/1000000000, ns%1000000000};
+    while (nanosleep(&t, &t) != 0 && errno == EINTR && !stop) {}
+}
+
+static void send(int fd, const uint8_t *reply, int n) {
+    for (int i=0; i<n && !stop; ++i) {
+        while (write(fd, &reply[i], 1) != 1) {
+            if (errno != EAGAIN && errno != EINTR) return;
+            sleepNs(BYTE_NS);
+        }
+        sleepNs(BYTE_NS);
+    }
+}
+
+static int usage(void) {
+    fprintf(stderr, "usage: tkr_emu [-b boards] [-m chips[:clusters]] [-l latency us] [-r Hz] [-x fault=rate,...]\n"
+                    "               [-s seed] [-L link] [-v]\n");
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    struct TkrSimConfig config = {.nBoards = 1, .maxChips = 4, .maxClusters = 2, .seed = 1};
+    long latencyUs = 10;
+    double rate = 0;
+    const char *link = NULL;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b:m:l:r:x:s:L:v")) != -1) {
+        switch (opt) {
+            case 'b': config.nBoards = atoi(optarg); break;
+            case 'm':
+                if (sscanf(optarg, "%d:%d", &config.maxChips, &config.maxClusters) < 1) return usage();
+                break;
+            case 'l': latencyUs = atol(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'x':
+                if (!tkrSimFaults(&config, optarg)) return usage();
+                break;
+            case 's': config.seed = strtoul(optarg, NULL, 0); break;
+            case 'L': link = optarg; break;
+            case 'v': verbose = true; break;
+            default: return usage();
+        }
+    }
+    if (optind != argc || config.nBoards < 1 || config.nBoards > TKR_SIM_MAX_BOARDS) return usage();
+    config.selfTrigger = rate <= 0;
+
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        perror("tkr_emu: pty");
+        return 1;
+    }
+    const char *name = ptsname(fd);
+    // Hold the slave open, raw, so that the master neither echoes nor sees a hangup between clients
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+        perror(name);
+        return 1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    if (link != NULL) {
+        unlink(link);
+        if (symlink(name, link) != 0) {
+            perror(link);
+            return 1;
+        }
+    }
+    printf("tracker emulator on %s\n", name);
+    fflush(stdout);
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    struct TkrSim sim;
+    tkrSimInit(&sim, &config);
+    uint32_t rng = config.seed*2654435761u + 1;
+    double tTrigger = rate > 0 ? now() : INFINITY;
+    uint32_t nTriggers = 0, nMissed = 0;
+    static uint8_t reply[TKR_SIM_MAX_REPLY];
+    while (!stop) {
+        double wait = tTrigger - now();
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int timeout = isinf(wait) ? -1 : wait <= 0 ? 0 : (int)(1000*wait) + 1;
+        if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) break;
+        if (now() >= tTrigger) {
+            if (tkrSimTrigger(&sim, 0xC0)) nTriggers++;
+            else if (sim.trgEnabled) nMissed++;
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            tTrigger += -log((rng + 1.)/4294967296.)/rate;
+        }
+        if (!(pfd.revents & POLLIN)) continue;
+        uint8_t buf[256];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        for (ssize_t i=0; i<n; ++i) {
+            int nReply = tkrSimRx(&sim, buf[i], reply);
+            if (verbose && sim.nCmd == 0) {
+                printf("command %02X to FPGA %d, %d bytes back\n", sim.cmd[1], sim.cmd[0], nReply);
+                fflush(stdout);
+            }
+            if (nReply == 0) continue;
+            sleepNs(1000*latencyUs);
+            send(fd, reply, nReply);
+        }
+    }
+
+    printf("%u commands, %u triggers, %u missed; faults:", sim.cmdCount, nTriggers, nMissed);
+    for (int f=0; f<TKR_NUM_FAULTS; ++f) printf(" %s %u", tkrFaultName[f], sim.nFaults[f]);
+    printf("\n");
+    if (link != NULL) unlink(link);
+    close(slave);
+    close(fd);
+    return 0;
+}
+
+/* [] END OF FILE */
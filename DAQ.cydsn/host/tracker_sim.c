@@ -0,0 +1,233 @@
+/* ========================================
+ *
+ * Model of the Tracker FPGA chain as the event PSOC sees it. See tracker_sim.h.
+ *
+ * =========================================
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "tracker_sim.h"
+
+#define TKR_EVT_DATA 0xD3
+#define TKR_HOUSE_DATA 0xC7
+#define TKR_ECHO_DATA 0xF1
+
+// The command tables of main.c: codes answered with housekeeping data and their data counts less the trailer
+static const uint8_t cmdWithData[] = {0x57, 0x0A, 0x0B, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25,
+                  0x46, 0x54, 0x55, 0x07, 0x58, 0x59, 0x5C,
+                  0x60, 0x68, 0x69, 0x6A, 0x6B, 0x6D, 0x71, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x84};
+static const uint8_t cmdNumData[] = {1, 1, 1, 2, 1, 8, 8, 8, 8, 8, 8, 0, 1, 1, 2, 2, 1, 2,
+                  2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 1, 2, 2};
+
+static uint32_t rnd(struct TkrSim *sim) {
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return x;
+}
+
+const char *const tkrFaultName[TKR_NUM_FAULTS] = {"id", "short", "crc", "timeout"};
+
+static bool fault(struct TkrSim *sim, enum TkrFault f) {
+    double rate = sim->config.faultRate[f];
+    if (rate <= 0 || (rnd(sim) & 0xFFFFFF) >= rate*16777216.) return false;
+    sim->nFaults[f]++;
+    return true;
+}
+
+bool tkrSimFaults(struct TkrSimConfig *config, const char *spec) {
+    while (*spec != '\0') {
+        int f = 0;
+        size_t n = strcspn(spec, "=");
+        while (f < TKR_NUM_FAULTS && (strlen(tkrFaultName[f]) != n || strncmp(spec, tkrFaultName[f], n) != 0)) ++f;
+        if (f == TKR_NUM_FAULTS || spec[n] != '=') return false;
+        char *end;
+        config->faultRate[f] = strtod(spec + n + 1, &end);
+        if (end == spec + n + 1) return false;
+        if (*end == ',') ++end;
+        else if (*end != '\0') return false;
+        spec = end;
+    }
+    return true;
+}
+
+void tkrSimInit(struct TkrSim *sim, const struct TkrSimConfig *config) {
+    memset(sim, 0, sizeof(*sim));
+    sim->config = *config;
+    sim->nBoards = config->nBoards;
+    sim->rng = config->seed != 0 ? config->seed : 0x2545F491u;
+}
+
+bool tkrSimTrigger(struct TkrSim *sim, uint8_t pattern) {
+    if (!sim->trgEnabled || sim->nEvents == TKR_SIM_MAX_EVENTS) return false;
+    sim->pattern[sim->nEvents++] = pattern & 0xC0;
+    sim->trgCount++;
+    return true;
+}
+
+// Same division as CRC6() in main.c: a start bit, then the message, divided by 1100101 without augmentation
+uint8_t tkrSimCRC6(const uint8_t *bytes, int nBits) {
+    static const uint8_t divisor[7] = {1, 1, 0, 0, 1, 0, 1};
+    uint8_t A[8*TKR_SIM_MAX_REPLY + 1];
+    int n = nBits + 1;
+    A[0] = 1;
+    for (int i=0; i<nBits; ++i) A[i+1] = (bytes[i/8] >> (7 - i%8)) & 1;
+    for (int i=0; i<n-6; ++i) {
+        if (A[i]) for (int j=0; j<7; ++j) A[i+j] ^= divisor[j];
+    }
+    uint8_t crc = 0;
+    for (int i=0; i<6; ++i) crc = (crc << 1) | A[n-6+i];
+    return crc;
+}
+
+struct Bits {
+    uint8_t *bytes;
+    int n;
+};
+
+static void put(struct Bits *w, uint32_t value, int nBits) {
+    for (int i=nBits-1; i>=0; --i) {
+        if (w->n%8 == 0) w->bytes[w->n/8] = 0;
+        if ((value >> i) & 1) w->bytes[w->n/8] |= 0x80 >> (w->n%8);
+        w->n++;
+    }
+}
+
+static int makeHitList(struct TkrSim *sim, uint8_t fpga, uint8_t tag, uint8_t *hitList, int *crcBit) {
+    struct Bits w = {hitList, 0};
+    put(&w, 0xE7, 8);
+    put(&w, fpga, 8);
+    put(&w, tag & 0x7F, 7);
+    put(&w, 0, 1);                       // Error bit
+    int nChips = sim->config.maxChips > 0 ? rnd(sim)%(sim->config.maxChips + 1) : 0;
+    if (nChips > 12) nChips = 12;
+    put(&w, nChips, 4);
+    int chip = -1;
+    for (int i=0; i<nChips; ++i) {
+        chip += 1 + rnd(sim)%((12 - chip - 1) - (nChips - i) + 1);   // Increasing, leaving room for the rest
+        int nClust = 1 + (sim->config.maxClusters > 1 ? rnd(sim)%sim->config.maxClusters : 0);
+        if (nClust > 10) nClust = 10;
+        put(&w, nClust, 6);
+        put(&w, chip, 6);                // Chip error and parity bits clear
+        for (int c=0; c<nClust; ++c) {
+            int width = 1 + rnd(sim)%4;
+            put(&w, width - 1, 6);
+            put(&w, rnd(sim)%(64 - width + 1), 6);
+        }
+    }
+    *crcBit = w.n;
+    put(&w, tkrSimCRC6(hitList, w.n), 6);
+    put(&w, 3, 2);
+    return (w.n + 7)/8;
+}
+
+int tkrSimHitList(struct TkrSim *sim, uint8_t fpga, uint8_t tag, uint8_t *hitList) {
+    int crcBit;
+    return makeHitList(sim, fpga, tag, hitList, &crcBit);
+}
+
+static int housekeeping(struct TkrSim *sim, uint8_t fpga, uint8_t code, uint8_t *reply) {
+    int nData = 1;
+    for (unsigned i=0; i<sizeof(cmdWithData); ++i) {
+        if (cmdWithData[i] == code) nData = cmdNumData[i] + 1;
+    }
+    reply[0] = nData + 6;
+    reply[1] = TKR_HOUSE_DATA;
+    reply[2] = nData;
+    reply[3] = sim->cmdCount >> 8;
+    reply[4] = sim->cmdCount & 0xFF;
+    reply[5] = fpga;
+    reply[6] = code;
+    memset(&reply[7], 0, nData);
+    if (code == 0x57) reply[7] = sim->nEvents > 0 || (sim->config.selfTrigger && sim->trgEnabled) ? 0x59 : 0x4E;
+    reply[6 + nData] = 0x0F;
+    return 7 + nData;
+}
+
+static int event(struct TkrSim *sim, uint8_t *reply) {
+    uint8_t pattern = 0;
+    if (sim->nEvents == 0 && sim->config.selfTrigger && sim->trgEnabled) tkrSimTrigger(sim, 0xC0);
+    if (sim->nEvents > 0) {
+        pattern = sim->pattern[0];
+        memmove(sim->pattern, sim->pattern + 1, --sim->nEvents);
+    }
+    uint16_t trgCount = sim->trgCount - sim->nEvents;
+    reply[0] = 5;
+    reply[1] = TKR_EVT_DATA;
+    reply[2] = trgCount >> 8;
+    reply[3] = trgCount & 0xFF;
+    reply[4] = sim->cmdCount & 0xFF;
+    reply[5] = (sim->nBoards & 0x3F) | pattern;
+    int n = 6;
+    for (int brd=0; brd<sim->nBoards; ++brd) {
+        int crcBit;
+        uint8_t *list = &reply[n+1];
+        int nBytes = makeHitList(sim, brd == 0 ? 8 : brd, trgCount, list, &crcBit);
+        if (fault(sim, TKR_FAULT_BAD_CRC)) list[crcBit/8] ^= 0x80 >> (crcBit%8);
+        if (fault(sim, TKR_FAULT_BAD_ID)) list[0] ^= 1 << rnd(sim)%8;
+        if (fault(sim, TKR_FAULT_SHORT_BOARD)) nBytes = 1 + rnd(sim)%3;
+        reply[n] = nBytes;
+        n += 1 + nBytes;
+    }
+    return n;
+}
+
+static int reply(struct TkrSim *sim, uint8_t *out) {
+    uint8_t fpga = sim->cmd[0];
+    uint8_t code = sim->cmd[1];
+    const uint8_t *data = &sim->cmd[3];
+    sim->cmdCount++;
+    switch (code) {
+        case 0x01:
+            return event(sim, out);
+        case 0x04:
+            if (fpga == 0) {
+                sim->trgCount = 0;
+                sim->nEvents = 0;
+            }
+            break;
+        case 0x0F:
+            if (sim->cmd[2] > 0) sim->nBoards = data[0] > TKR_SIM_MAX_BOARDS ? TKR_SIM_MAX_BOARDS : data[0];
+            break;
+        case 0x65:
+            sim->trgEnabled = true;
+            break;
+        case 0x66:
+            sim->trgEnabled = false;
+            break;
+        case 0x67:
+        case 0x6C:
+            return 0;
+        case 0x46:
+            memset(out, 0, 4);
+            return 4;
+    }
+    if (code >= 0x20 && code <= 0x25) {
+        out[0] = 9;
+        memset(&out[1], 0, 9);
+        out[1] = (code - 0x1F) << 4;
+        return 10;
+    }
+    for (unsigned i=0; i<sizeof(cmdWithData); ++i) {
+        if (cmdWithData[i] == code) return housekeeping(sim, fpga, code, out);
+    }
+    out[0] = 4;
+    out[1] = TKR_ECHO_DATA;
+    out[2] = sim->cmdCount >> 8;
+    out[3] = sim->cmdCount & 0xFF;
+    out[4] = code;
+    return 5;
+}
+
+int tkrSimRx(struct TkrSim *sim, uint8_t byte, uint8_t *out) {
+    sim->cmd[sim->nCmd++] = byte;
+    if (sim->nCmd < 3 || sim->nCmd < 3 + sim->cmd[2]) return 0;
+    sim->nCmd = 0;
+    int n = reply(sim, out);
+    if (n > 0 && fault(sim, TKR_FAULT_TIMEOUT)) n = rnd(sim)%n;
+    return n;
+}
+
+/* [] END OF FILE */
@@ -0,0 +1,82 @@
+/* ========================================
+ *
+ * Model of the Tracker FPGA chain as the event PSOC sees it over the Tracker UART: it parses the command bytes
+ * (FPGA address, command code, number of data bytes, data) and builds the reply the master board would send.
+ *    Event read 0x01            5, D3, trigger count (2), command count, boards | trigger pattern, then per board
+ *                               the hit list length and a hit list (E7, FPGA, tag and error bit, chips, clusters,
+ *                               CRC6, 11) with random occupancy and a good CRC
+ *    Housekeeping (C7) codes    nData+6, C7, nData, command count (2), FPGA, code, data ending in 0x0F. For 0x57
+ *                               the first data byte is 0x59 when an event is waiting, 0x4E otherwise.
+ *    ASIC reads 0x20-0x25       9, then the register type (code - 0x1F) in bits 6:4 of the first of 9 bytes
+ *    I2C read 0x46              4 bytes
+ *    Echo (F1) codes            4, F1, command count (2), code
+ *    0x67, 0x6C                 nothing
+ * 0x0F sets the number of boards read out, 0x04 to the master board resets the counters and drops buffered
+ * events, 0x65 and 0x66 enable and disable the trigger.
+ * Nothing here knows about time: the caller decides when the reply bytes go on the wire.
+ *
+ * Faults are injected at the configured rates, per board for the first three and per reply for the last:
+ *    id         the hit list identifier is not 0xE7
+ *    short      the board sends a hit list length of 1 to 3, with only that many bytes
+ *    crc        one CRC bit is flipped
+ *    timeout    the reply stops short, anywhere from the first byte to the last
+ *
+ * =========================================
+ */
+#ifndef TRACKER_SIM_H
+#define TRACKER_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TKR_SIM_MAX_BOARDS 8
+#define TKR_SIM_MAX_EVENTS 16
+#define TKR_SIM_MAX_REPLY 2048
+
+enum TkrFault { TKR_FAULT_BAD_ID, TKR_FAULT_SHORT_BOARD, TKR_FAULT_BAD_CRC, TKR_FAULT_TIMEOUT, TKR_NUM_FAULTS };
+
+struct TkrSimConfig {
+    int nBoards;         // Boards read out until command 0x0F changes it
+    int maxChips;        // Chips hit per board, 0 to maxChips
+    int maxClusters;     // Clusters per hit chip, 1 to maxClusters
+    bool selfTrigger;    // Every event read and ready check finds an event, for use without a trigger line
+    double faultRate[TKR_NUM_FAULTS];   // Probability per board or per reply
+    uint32_t seed;
+};
+
+struct TkrSim {
+    struct TkrSimConfig config;
+    int nBoards;
+    bool trgEnabled;
+    uint16_t cmdCount;
+    uint16_t trgCount;
+    uint8_t pattern[TKR_SIM_MAX_EVENTS];  // Trigger patterns of the events waiting to be read
+    int nEvents;
+    uint32_t rng;
+    uint8_t cmd[3 + 255];                 // Command being received
+    int nCmd;
+    uint32_t nFaults[TKR_NUM_FAULTS];     // Injected so far
+};
+
+void tkrSimInit(struct TkrSim *sim, const struct TkrSimConfig *config);
+
+// A trigger reaching the Tracker, with the pattern bits (0x80 non-bending, 0x40 bending) it will report. Returns
+// false if the Tracker trigger is disabled or the event buffer is full.
+bool tkrSimTrigger(struct TkrSim *sim, uint8_t pattern);
+
+// Feed one byte from the event PSOC. When it completes a command, the reply is put in reply (up to
+// TKR_SIM_MAX_REPLY bytes) and its length returned; otherwise 0.
+int tkrSimRx(struct TkrSim *sim, uint8_t byte, uint8_t *reply);
+
+// A hit list for one board, as in the event reply: returns its length. Exposed for tests of the decoders.
+int tkrSimHitList(struct TkrSim *sim, uint8_t fpga, uint8_t tag, uint8_t *hitList);
+
+// Set fault rates from a list such as "id=0.01,timeout=0.001". Returns false if it does not parse.
+bool tkrSimFaults(struct TkrSimConfig *config, const char *spec);
+extern const char *const tkrFaultName[TKR_NUM_FAULTS];
+
+// The Tracker FPGA CRC6 of the first nBits bits of a byte string
+uint8_t tkrSimCRC6(const uint8_t *bytes, int nBits);
+
+#endif
+/* [] END OF FILE */
@@ -96,6 +96,32 @@
  * V28.5:  Increased wait time for tracker uart transmit and receive
  * V28.6:  Check command code and FPGA address for all tracker command calls
  * V28.7:  Correct length of Tracker housekeeping
+ * V28.8:  Sampled diagnostics mode: check 1 in N events, and escalate to checking every event for a while when the
+ *         CRC or cluster error rate of the sampled events exceeds a threshold. Sample rate and escalations in housekeeping.
+ * V28.9:  Errors are counted per error code, keeping the first and last occurrence, in place of the 64-entry list.
+ *         Command 0x03 now returns 15 bytes per error code.
+ * V28.10: Errors raised in interrupt routines go through lock-free per-ISR rings with a microsecond time stamp and
+ *         event count. New command 0x65 streams the timestamped errors during runs as 0xD9 records.
+ * V28.11: Commands from the Main PSOC are delimited in the UART ISR, which hands complete 29-byte frames to the main loop
+ *         through the command queue, instead of the main loop rescanning a byte FIFO.
+ * V28.12: Optional binary bulk command frames (0xA5 0x5A, length, payload of up to 256 bytes, CRC16) on the UART and
+ *         USB command paths, each carrying a sequence of commands, whose replies are dropped. The triplicated ASCII
+ *         protocol is unchanged.
+ * V28.13: ASIC configuration streams the register writes to the Tracker without waiting for each echo, broadcasting
+ *         to all chips of a board where the settings agree, followed by a single verification pass.
+ * V28.14: Commands not allowed during a run are queued and executed between events with the trigger briefly off,
+ *         instead of being ignored. Each is acknowledged with "DF", and its own reply is dropped. New command 0x68
+ *         returns the number executed and their latencies.
+ * V28.15: Queued, interrupt-driven I2C transactions with completion callbacks, polled from the main loop, in place of
+ *         the blocking I2C calls. DAC loads no longer wait, and are read back in the background. New command 0x66
+ *         returns I2C transaction timing statistics.
+ * V28.16: Tracker temperatures, local INA226 voltages, the TMP100 and die temperatures are refreshed in the background
+ *         during idle gaps, and the housekeeping record copies them from that cache, with age stamps (now 118 bytes).
+ * V28.17: PMT singles counters are snapshot every second into a ring, so rates have no gaps between measurements.
+ *         New command 0x67 returns counts over consecutive windows of the ring. Housekeeping byte 118 is the window.
+ * V28.18: Housekeeping bytes 119-120 give the sampled live fraction of the ADC state machine in 0.01% units.
+ * V28.19: Optional 4-byte per-event field (bit 1 of the 4th start-of-run data byte) with the microseconds from the
+ *         trigger re-arm to the GO and the GO1 count in that interval. Flagged by bit 3 of event byte 38.
  * =========================================
  */
 #include "project.h"
@@ -106,7 +132,7 @@
 #include <math.h>
 
 #define MAJOR_VERSION 28
-#define MINOR_VERSION 07
+#define MINOR_VERSION 19
 
 /*=========================================================================
  * Calibration/PMT input connections, from left to right looking down at the end of the DAQ board:
@@ -199,7 +225,6 @@
     asm (".global _printf_float");
 #endif
  
-#define MXERR 64
 #define MAX_CMD_DATA 16
 #define TOFSIZE 17
 #define TKRHOUSE_LEN 70
@@ -209,9 +234,9 @@
 #define MAX_TKR_ASIC 12
 #define MAX_TKR_BOARD_BYTES 203     // Two leading bytes, 12 bit header, 12 chips * (12-bit header and up to 10 12-bit cluster words) + CRC byte
 #define USBFS_DEVICE (0u)
-#define BUFFER_LEN  32u
+#define BUFFER_LEN  64u     // A full USB packet
 #define MAX_DATA_OUT 255
-#define MXERR 64
+#define ERR_RECORD_LEN 15u    // Bytes per error code in the 0x03 readout
 #define SPI_OUTPUT 0u
 #define USBUART_OUTPUT 1u
 #define CALMASK 1u
@@ -219,7 +244,7 @@
 #define TRIGMASK 3u
 #define TKR_DATA_READY 0x59
 #define TKR_DATA_NOT_READY 0x4E
-#define NUM_CMDS_IN_RUN 11
+#define NUM_CMDS_IN_RUN 12
 #define MAX_CMD_TRY 3
 #define TKR_TRG_OR 1
 #define TKR_TRG_AND 0
@@ -299,6 +324,12 @@
 #define ERR_TKR_BAD_TRG_MASK 72u
 #define ERR_INVALID_COMMAND 73u
 #define ERR_BAD_FPGA 74u
+#define ERR_ERR_RING_FULL 75u
+#define ERR_BULK_CRC 76u
+#define ERR_BULK_FORMAT 77u
+#define ERR_BULK_BUSY 78u
+#define ERR_I2C_FAIL 79u           // Second byte is the I2C status, or 0xFE for a time-out, 0xFF for a full queue
+#define MAX_ERR_CODE 79u
 
 #define WRAPINC(a,b) ((a + 1) % (b))
 #define ACTIVELEN(a,b,c) ((((c) - (a)) + (b)) % (c)) //Macro to calculate active length in a circular buffer.
@@ -331,7 +362,7 @@ uint TKR_timePerByte;          // Time in microseconds to transmit a single byte
 uint TKR_timeFirstByte;        // Time in microseconds to wait for the first byte to show up
 
 // Some variables defined only for housekeeping information
-#define HOUSESIZE 81u
+#define HOUSESIZE 121u
 #define TKRHOUSESIZE 202u
 #define BOR_LENGTH 85u
 uint8 dataBOR[BOR_LENGTH];
@@ -365,8 +396,6 @@ uint16 nIgnoredCmd;
 volatile uint32 cntSeconds;
 uint8 houseKeepPeriod;
 volatile bool houseKeepingDue, tkrHouseKeepingDue;
-uint16 tkrTemp0 = 0;
-uint16 tkrTemp7 = 0;
 uint32 nEvtH = 0;
 uint32 nTOFAavgH = 0;
 uint32 nTOFBavgH = 0;
@@ -398,6 +427,19 @@ uint16 cmdCountGLB = 0;           // Count of all command packets received
 uint16 cmdCount = 0;              // Count of all event PSOC commands received
 uint8 nCmdTimeOut = 0;            // Count the number of command timeouts
 uint32 numTkrResets = 0;
+
+// Sampled diagnostics. In this mode only 1 in diagSamplePeriod events gets the hit-list checks, unless the
+// fraction of sampled events with CRC or cluster errors goes over threshold, in which case every event gets
+// checked for diagEscalateTime seconds.
+#define DIAG_WINDOW 64u            // Number of sampled events over which the error fraction is evaluated
+bool diagSampled;                  // True if the sampled diagnostics mode is selected
+uint8 diagSamplePeriod = 100;      // Check 1 out of this many events
+uint8 diagThreshold = 5;           // Escalate if this percentage of the sampled events have errors
+uint8 diagEscalateTime = 60;       // Time in seconds to keep checking every event after an escalation
+bool diagEscalated;                // Every event is being checked following an escalation
+uint32 diagEscalateStart;          // Time at which the present escalation started
+uint8 nDiagSampled, nDiagBad;      // Sampled events and those with errors in the present window
+uint16 nDiagEscalations = 0;       // Number of escalations since the start of the run
 uint32 readTimeAvg = 0;
 uint32 nReadAvg = 0;
 uint32 lastNumTkrResets = 0;
@@ -431,6 +473,33 @@ const uint8 I2C_Address_TKR_A21 = '\x44';
 const uint8 I2C_Address_TKR_A33 = '\x43';
 const uint8 I2C_Address_TKR_bias = '\x46';
 
+// Snapshot of the slow sensors for the housekeeping record, refreshed one step at a time by sensorPoll()
+// in idle gaps of the main loop, so that building a housekeeping record never waits on a bus.
+#define NUM_LOCAL_INA226 7u
+#define SENSOR_PERIOD 200u             // Ticks between refreshes of the local sensors (1 second)
+#define TKR_TEMP_STEP_USEC 600u        // Wait between the Tracker I2C steps of a temperature read
+#define SNS_TKR 0x01u                  // Bits in sensorValid
+#define SNS_DIE 0x02u
+#define SNS_BOARD 0x04u
+#define SNS_INA 0x08u
+// DVDD5, DVDD33, AVDD5, AVDD33, Back15, TkrBias, TKR
+const uint8 localINA226[NUM_LOCAL_INA226] = {'\x41', '\x44', '\x45', '\x43', '\x42', '\x46', '\x40'};
+struct SensorCache {
+    uint16 tkrTemp[2];                 // Tracker layers 0 and 7
+    int16 dieTemp;
+    uint8 boardTemp[2];                // TMP100 register, as read
+    uint8 busV[NUM_LOCAL_INA226][2];   // INA226 registers, as read
+    uint8 shuntV[NUM_LOCAL_INA226][2];
+    uint32 tkrTempTime, dieTempTime, boardTempTime, inaTime;   // time() of the last update
+} sensors;
+uint8 sensorValid;                     // Which sensors have been read at least once
+uint8 sensorMissing;                   // INA226 chips (bits 0-6) or TMP100 (bit 7) that did not respond
+uint8 nSensorSweeps;                   // Missing sensors are tried again every 64 sweeps
+uint8 sensorStep;                      // Next local sensor read in the sweep
+uint32 sensorSweepStart;               // time() at the start of the present sweep
+uint8 tkrTempStep;                     // Step of the Tracker temperature read in progress
+uint32 tkrTempStepTime;                // usecTime() of the last Tracker temperature step
+
 // Save AD5602 or AD5622 settings read back from the DAC.
 // This is needed because the DAC setting can only be read back once after setting it.
 #define NUMDACs 3u
@@ -454,6 +523,12 @@ uint8 thrDACsettings[] = {THRDEF, THRDEF, THRDEF, THRDEF};
 #define PULSE_CNTR_RST 0x02     // Resets the counter on each of the PMT channels
 #define PULSE_TRIG_SET 0x04     // Enables the trigger logic
 
+// Live fraction in units of 0.01%
+uint16 liveFraction10k(uint32 live, uint32 dead) {
+    if (live + dead == 0) return 0;
+    return (uint16)((10000*(uint64)live)/((uint64)live + dead));
+}
+
 // 4-bit slave addresses for the SPI interface
 // Bits 0,1,2 drive the 3-to-8 decoder and are active high
 // Bit 3 goes directly to the Main PSOC SS and is active low
@@ -468,6 +543,7 @@ const uint8 SSN_CH4  = 0x0E;
 const uint8 SSN_CH5  = 0x0C;
 uint8 outputMode;              // Data output mode (SPI or USB-UART)
 bool debugTOF;
+bool deadTimeField;            // Add the re-arm to GO interval and its GO1 count to each event
 
 #define END_DATA_SIZE 146u
 bool endingRun;                // Set true when the run is ending
@@ -493,30 +569,65 @@ bool waitingTkrRateCnt;
 
 #define MAX_PMT_CHANNELS 5
 // Data structures for PMT singles rate monitoring
-uint8  pmtDeltaT;            // rough time in seconds for each rate measurement
-uint32 pmtMonitorInterval;   // time interval in seconds between successive rate accumulations
-uint32 pmtCntInit[MAX_PMT_CHANNELS];
+uint8  pmtDeltaT;            // time in seconds for each rate measurement
 uint16 pmtMonitorSums[MAX_PMT_CHANNELS];
 uint16 pmtMonitorTime;
 bool monitorPmtRates;
-uint32 pmtClkAtStart;
-uint32 pmtClkCntStart;
-bool waitingPmtRateCnt;
-
-// Circular FIFO buffer of bytes received from the Main PSOC via the UART.
-// This buffer gets searched for 29-byte commands, which then go into the cmd_buffer structure
-#define MX_FIFO 1024
-volatile uint8 cmdFIFO[MX_FIFO];
-volatile int fifoWritePtr, fifoReadPtr;
-
-// Circular FIFO buffer of 29-byte UART commands from the Main PSOC
+uint8 pmtLastRingPtr;        // Ring position at the last rate update
+
+// Snapshots of the PMT singles counters, taken every second in the clk200 interrupt. Rates over any window up to
+// PMT_RING_LEN-1 seconds come from differences of two snapshots, so consecutive measurements have no gaps.
+#define PMT_RING_LEN 64u
+#define PMT_CNTR_WRAP 255u   // Counts per turnover interrupt of the 8-bit hardware counters
+#define PMT_WINDOW_LEN 17u   // Bytes per window returned by command 0x67: ticks, then 24-bit counts
+#define PMT_MAX_WINDOWS 14u
+struct PmtSnapshot {
+    uint32 time;             // clkCnt at the snapshot
+    uint32 count[MAX_PMT_CHANNELS];
+} pmtRing[PMT_RING_LEN];
+volatile uint8 pmtRingPtr;   // Next snapshot to write
+volatile uint8 pmtRingCount; // Number of valid snapshots
+
+// Circular FIFO buffer of 29-byte UART commands from the Main PSOC. The UART ISR is the only writer
+// (cmdWritePtr) and the main loop the only reader (cmdReadPtr).
 #define CMD_LENGTH 29
 #define MX_CMDS 35u
 struct MainPSOCcmds {
     uint8 buf[CMD_LENGTH];    // An actual command is made up of multiple buf elements
     uint8 nBytes;
 } cmd_buffer[MX_CMDS];
-uint8 cmdWritePtr, cmdReadPtr;
+volatile uint8 cmdWritePtr, cmdReadPtr;
+
+// The last CMD_LENGTH bytes received by the UART ISR, kept as a circular window. A command is complete when
+// <CR><LF> arrives with at least CMD_LENGTH bytes in the window.
+uint8 cmdWindow[CMD_LENGTH];
+volatile uint8 cmdWinPtr, cmdWinCount;
+uint8 lastCmdByte;
+
+// Binary bulk command frames, an alternative to the triplicated ASCII commands for large uploads:
+//    0xA5 0x5A, payload length (2 bytes), payload, CRC16-CCITT of the length and payload bytes (2 bytes)
+// The payload is the PSOC address followed by any number of commands, each as: command code, number of
+// data bytes, data bytes. The sync byte 0xA5 never occurs in the ASCII protocol.
+#define BULK_SYNC0 0xA5u
+#define BULK_SYNC1 0x5Au
+#define BULK_MAX_PAYLOAD 256u
+#define BULK_TIMEOUT 40u       // Abandon a partial frame after this many 5 ms ticks
+#define BULK_IDLE 0u
+#define BULK_SYNC 1u
+#define BULK_LEN 2u
+#define BULK_DATA 3u
+#define BULK_SKIP 4u
+struct BulkFrame {
+    uint8 state;
+    uint16 len;                        // Payload length
+    uint16 rxLen;                      // Length field being received, kept out of len and buf until accepted
+    uint16 cnt;                        // Bytes stored in buf
+    uint32 tStart;
+    uint8 buf[BULK_MAX_PAYLOAD+4];     // Length, payload and CRC
+    volatile bool ready;               // A complete frame awaits the main loop
+} bulkUART, bulkUSB;                   // Assembled in isrUART and in the main loop, respectively
+struct BulkFrame *bulkCmd = NULL;      // Frame whose commands are being executed
+uint16 bulkPtr;                        // Position of the next command in bulkCmd->buf
 
 // Circular FIFO buffer for bytes coming from the Tracker UART
 #define MAX_TKR 2048
@@ -567,6 +678,10 @@ volatile uint32 timeStamp;     // Internal event time stamp, in 5 millisecond un
 uint32 timeLastEvent = 0;      // Save the timestamp of the previous event
 volatile uint8 timeStamp8;     // Place to store the timestamp counter reading
 volatile uint32 cntGO1save;    // Word to save the trigger counter in each time there is an accepted trigger
+volatile uint32 goCycles;      // CPU cycle counter at the GO
+uint32 rearmCycles;            // CPU cycle counter, time() and GO1 count when the trigger was last re-armed
+uint32 rearmTime;
+uint32 rearmGO1;
 volatile uint8 trgStatus;      // Contents read from trigger status register
 volatile bool triggered;       // The system is triggered, so a readout is needed.
 
@@ -623,6 +738,20 @@ uint8 cmdData[MAX_CMD_DATA];       // Data sent with commands
 uint8 nDataBytes = 0;              // Number of data bytes in the current command
 bool cmdInputComplete;             // The command and command bytes are all received and ready to execute
 
+// Commands received during a run that are not in the allowed list. They get executed between events.
+#define MX_DEFERRED 8u
+#define DEFER_INTERVAL 20u         // Minimum time between deferred commands, in 5 ms ticks
+struct DeferredCmd {
+    uint8 command;
+    uint8 nData;
+    uint8 data[MAX_CMD_DATA];
+    uint32 tQueued;                // Time at which the command was received
+} deferredCmds[MX_DEFERRED];
+uint8 deferredReadPtr, deferredWritePtr;
+uint32 lastDeferredTime;
+uint16 nDeferredRun;               // Deferred commands executed, readable by command 0x68
+uint32 deferredSumLatency, deferredMaxLatency;   // 5 ms ticks
+
 // Extract 1 of 4 bytes from a 32-bit word and return it as uint8
 uint8 byte32(uint32 word, int byte) {
     const uint32 mask[4] = {0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF};
@@ -635,7 +764,7 @@ uint8 byte16(uint16 word, int byte) {
 }
 
 bool cmdAllowedInRun(uint8 cmd) {
-    static uint8 cmdsAllowed[NUM_CMDS_IN_RUN] = {0x44, 0x03, 0x39, 0x3B, 0x4C, 0x5C, 0x5D, 0x57, 0x58, 0x5E, 0x5F};
+    static uint8 cmdsAllowed[NUM_CMDS_IN_RUN] = {0x44, 0x03, 0x39, 0x3B, 0x4C, 0x5C, 0x5D, 0x57, 0x58, 0x5E, 0x5F, 0x68};
     for (int i=0; i<NUM_CMDS_IN_RUN; ++i) {
         if (cmd == cmdsAllowed[i]) {
             return true;
@@ -700,38 +829,175 @@ uint32 packTime() {
     return timeWord;
 }
 
-// Errors are logged into this structure pending reading them out by command
+// Errors are counted in this structure, indexed by error code, pending reading them out by command
 struct Error {
-    uint8 errorCode;  // Use error codes defined above
-    uint8 value0;     // First information byte
-    uint8 value1;     // Second information byte
-} errors[MXERR];
-uint8 nErrors = 0;
+    uint16 count;      // Number of occurrences, saturating at 0xFFFF
+    uint8 firstVal0;   // Information bytes of the first occurrence
+    uint8 firstVal1;
+    uint32 firstEvt;   // Event count cntGO at the first occurrence
+    uint8 lastVal0;    // Information bytes of the most recent occurrence
+    uint8 lastVal1;
+    uint32 lastEvt;    // Event count cntGO at the most recent occurrence
+} errors[MAX_ERR_CODE+1];
+uint8 nErrors = 0;     // Number of distinct error codes logged
+
+// Probes around the hot paths, for the benchmark of the host build (host/fw_bench.c). They compile to nothing in
+// the firmware.
+enum Probes {PROBE_MAKE_EVENT, PROBE_TOF_DMA, PROBE_TOF_MATCH, PROBE_CHECK_CRC, PROBE_CMD_FRAME, PROBE_CMD_EXEC,
+             NUM_PROBES};
+#if BENCH_PROBES
+void benchProbe(uint8 probe, bool begin);
+#define PROBE_BEGIN(p) benchProbe(p, true)
+#define PROBE_END(p) benchProbe(p, false)
+#else
+#define PROBE_BEGIN(p)
+#define PROBE_END(p)
+#endif
 
-// Function used to log internal errors
-void addError(uint8 code, uint8 val0, uint8 val1) {
-    if (nErrors < MXERR) {
-        errors[nErrors].errorCode = code;
-        errors[nErrors].value0 = val0;
-        errors[nErrors].value1 = val1;
+// Time in microseconds, from the Cortex-M3 cycle counter referenced to the 1 second clock interrupt.
+// Rolls over after about 71 minutes; use the event count of the error to resolve the ambiguity.
+#ifndef DWT_CTRL                   // The host build (host/project.h) supplies its own
+#define DWT_CTRL (*(volatile uint32 *)0xE0001000u)
+#define DWT_CYCCNT (*(volatile uint32 *)0xE0001004u)
+#define DEMCR (*(volatile uint32 *)0xE000EDFCu)
+#endif
+volatile uint32 cycAtSecond;       // Cycle counter value when clkCnt was last incremented
+uint32 usecTime() {
+    int InterruptState = CyEnterCriticalSection();
+    uint32 sec = clkCnt/200;
+    uint32 cyc = DWT_CYCCNT - cycAtSecond;
+    CyExitCriticalSection(InterruptState);
+    return sec*1000000u + cyc/BCLK__BUS_CLK__MHZ;
+}
+
+// Timestamped error events. Each interrupt context that logs errors has its own ring with a single producer (the ISR)
+// and a single consumer (the main loop), so no locking is needed. The main loop moves the events into the per-code
+// counters and, during runs, into the error stream.
+#define ERR_CTX_UART 0u       // isrUART
+#define ERR_CTX_TKR 1u        // isrTkrUART
+#define ERR_CTX_GO 2u         // isrGO
+#define N_ERR_CTX 3u
+#define ERR_RING_LEN 16u      // Must be a power of 2
+struct ErrorEvent {
+    uint8 code;
+    uint8 val0;
+    uint8 val1;
+    uint32 usec;       // Microsecond time stamp
+    uint32 evt;        // Event count cntGO
+};
+struct ErrorRing {
+    struct ErrorEvent evt[ERR_RING_LEN];
+    volatile uint8 head;      // Written only by the ISR
+    volatile uint8 tail;      // Written only by the main loop
+    volatile uint8 nLost;     // Events dropped because the ring was full
+} errRing[N_ERR_CTX];
+
+// Error stream sent out during runs, filled only from the main loop
+#define ERR_STREAM_LEN 22u    // Fits in one output packet at 11 bytes per error
+struct ErrorEvent errStream[ERR_STREAM_LEN];
+uint8 nErrStream = 0;
+uint8 nErrStreamLost = 0;
+uint8 errStreamPeriod = 0;         // Seconds between error stream packets during a run; 0 = off
+volatile bool errStreamDue;
+
+// Increment the counter for an error code and keep track of the first and last occurrence
+void countError(uint8 code, uint8 val0, uint8 val1, uint32 evt) {
+    if (code > MAX_ERR_CODE) return;
+    struct Error *err = &errors[code];
+    if (err->count == 0) {
+        err->firstVal0 = val0;
+        err->firstVal1 = val1;
+        err->firstEvt = evt;
         nErrors++;
     }
+    if (err->count < 0xFFFF) err->count++;
+    err->lastVal0 = val0;
+    err->lastVal1 = val1;
+    err->lastEvt = evt;
+}
+
+// Buffer a timestamped error for the in-run error stream. Only called from the main loop.
+void streamError(uint8 code, uint8 val0, uint8 val1, uint32 usec, uint32 evt) {
+    if (errStreamPeriod == 0 || runNumber == 0) return;
+    if (nErrStream >= ERR_STREAM_LEN) {
+        if (nErrStreamLost < 255) nErrStreamLost++;
+        return;
+    }
+    struct ErrorEvent *ev = &errStream[nErrStream++];
+    ev->code = code;
+    ev->val0 = val0;
+    ev->val1 = val1;
+    ev->usec = usec;
+    ev->evt = evt;
+}
+
+// Function used to log internal errors from the main loop. Do not call this from an interrupt routine.
+void addError(uint8 code, uint8 val0, uint8 val1) {
+    countError(code, val0, val1, cntGO);
+    streamError(code, val0, val1, usecTime(), cntGO);
 }
-// Function used to log an internal error only if that error is not already logged
-// The second byte is used to count the number of occurances
+// Function used to log an internal error that has only one information byte
 void addErrorOnce(uint8 code, uint8 val0) {
-    for (int i=0; i<nErrors; ++i) {
-        if (errors[i].errorCode == code) {
-            if (errors[1].value1 < 255) errors[i].value1++;
-            return;
+    addError(code, val0, 0);
+}
+
+// Function used to log internal errors from an interrupt routine, into the ring belonging to that routine
+void addErrorISR(uint8 ctx, uint8 code, uint8 val0, uint8 val1) {
+    struct ErrorRing *ring = &errRing[ctx];
+    uint8 head = ring->head;
+    if (((head + 1) & (ERR_RING_LEN - 1)) == ring->tail) {
+        if (ring->nLost < 255) ring->nLost++;
+        return;
+    }
+    struct ErrorEvent *ev = &ring->evt[head];
+    ev->code = code;
+    ev->val0 = val0;
+    ev->val1 = val1;
+    ev->usec = usecTime();
+    ev->evt = cntGO;
+    ring->head = (head + 1) & (ERR_RING_LEN - 1);   // Publish the entry only after it is complete
+}
+
+// Move the errors logged by interrupt routines into the counters and the error stream
+void drainErrorRings() {
+    for (uint8 ctx=0; ctx<N_ERR_CTX; ++ctx) {
+        struct ErrorRing *ring = &errRing[ctx];
+        uint8 tail = ring->tail;
+        while (tail != ring->head) {
+            struct ErrorEvent *ev = &ring->evt[tail];
+            countError(ev->code, ev->val0, ev->val1, ev->evt);
+            streamError(ev->code, ev->val0, ev->val1, ev->usec, ev->evt);
+            tail = (tail + 1) & (ERR_RING_LEN - 1);
+            ring->tail = tail;
+        }
+        if (ring->nLost > 0) {
+            int InterruptState = CyEnterCriticalSection();
+            uint8 nLost = ring->nLost;
+            ring->nLost = 0;
+            CyExitCriticalSection(InterruptState);
+            addError(ERR_ERR_RING_FULL, ctx, nLost);
         }
     }
-    if (nErrors < MXERR) {
-        errors[nErrors].errorCode = code;
-        errors[nErrors].value0 = val0;
-        errors[nErrors].value1 = 1;
-        nErrors++;
+}
+
+// Build a packet with the buffered error stream. Format: "ERS", number of errors, number lost, then 11 bytes
+// per error: code, two information bytes, microsecond time stamp (4 bytes), event count (4 bytes)
+void makeErrorStream() {
+    dataOut[0] = 0x45;
+    dataOut[1] = 0x52;
+    dataOut[2] = 0x53;
+    dataOut[3] = nErrStream;
+    dataOut[4] = nErrStreamLost;
+    nDataReady = 5;
+    for (int i=0; i<nErrStream; ++i) {
+        dataOut[nDataReady++] = errStream[i].code;
+        dataOut[nDataReady++] = errStream[i].val0;
+        dataOut[nDataReady++] = errStream[i].val1;
+        for (int j=0; j<4; ++j) dataOut[nDataReady++] = byte32(errStream[i].usec, j);
+        for (int j=0; j<4; ++j) dataOut[nDataReady++] = byte32(errStream[i].evt, j);
     }
+    nErrStream = 0;
+    nErrStreamLost = 0;
 }
 
 // Get a byte of data from the Tracker UART software buffer, with a time-out in case nothing is coming.
@@ -1018,9 +1284,7 @@ int getTrackerData(uint8 idExpected) {
         }
     } else {  // WTF?!?   Not sure what to do with this situation, besides flag it.
         if (nTkrDatErr < 0xFF) nTkrDatErr++;
-        if (nErrors < MXERR) {
-            addErrorOnce(ERR_TKR_BAD_ID, IDcode);
-        }
+        addErrorOnce(ERR_TKR_BAD_ID, IDcode);
         // Wait a short time on the UART and then empty the Tracker buffer
         // and send out whatever crap came in, hoping for the best. . .
         CyDelay(2);
@@ -1271,14 +1535,16 @@ void makeErrorRecord(uint32 *errCodes) {
     numErrRec++;
 }
 
-// Routine to fill in the housekeeping array
+// Age in seconds of a cached sensor reading, 255 if never read or older than that
+uint8 sensorAge(uint8 sensor, uint32 tUpdate) {
+    if (!(sensorValid & sensor)) return 255;
+    uint32 age = timeElapsed(tUpdate)/200;
+    if (age > 255) return 255;
+    return (uint8)age;
+}
+
+// Routine to fill in the housekeeping array. All sensor values come from the cache kept by sensorPoll().
 void makeHouseKeeping() {
-    if (numTkrBrds > 0 && nHouseKeepMade%tkrRatesMult == 0) {
-        tkrTemp0 = getTkrTemp(0);
-    }
-    if (numTkrBrds > 7 && nHouseKeepMade%tkrRatesMult == 0) {
-        tkrTemp7 = getTkrTemp(7);
-    }
     nHouseKeepMade++;
     dataOut[0] = 0x48;  // 4 header bytes spell "HAUS" in ASCII
     dataOut[1] = 0x41;
@@ -1356,18 +1622,13 @@ void makeHouseKeeping() {
         dataOut[50 + brd*2] = byte16(tkrMonitorRates[brd],0);
         dataOut[50 + brd*2 + 1] = byte16(tkrMonitorRates[brd],1);
     }
-    int16 dieTemp;
-    cystatus ret = DieTemp_1_GetTemp(&dieTemp);
-    if (ret != CYRET_SUCCESS) {
-        addErrorOnce(BAD_DIE_TEMP, ret);
-    }
-    dataOut[66] = byte16(dieTemp, 0);
-    dataOut[67] = byte16(dieTemp, 1);
+    dataOut[66] = byte16(sensors.dieTemp, 0);
+    dataOut[67] = byte16(sensors.dieTemp, 1);
 
-    dataOut[68] = byte16(tkrTemp0, 0);
-    dataOut[69] = byte16(tkrTemp0, 1);
-    dataOut[70] = byte16(tkrTemp7, 0);
-    dataOut[71] = byte16(tkrTemp7, 1);
+    dataOut[68] = byte16(sensors.tkrTemp[0], 0);
+    dataOut[69] = byte16(sensors.tkrTemp[0], 1);
+    dataOut[70] = byte16(sensors.tkrTemp[1], 0);
+    dataOut[71] = byte16(sensors.tkrTemp[1], 1);
     
     if (nEvtH > 0) {
         dataOut[72] = (uint8)(nTOFAavgH/nEvtH);
@@ -1399,7 +1660,29 @@ void makeHouseKeeping() {
     } else {
         liveFraction = 0.;
     }
-    dataOut[80] = (uint8)(100.*liveFraction);
+    uint16 live10k = liveFraction10k(cntLive, cntTrials - cntLive);
+    dataOut[80] = (uint8)(live10k/100);
+    uint8 sampleRate = 0;           // Effective diagnostics sample period: 1 = every event, 0 = no checks
+    if (doDiagnostics || diagEscalated) sampleRate = 1;
+    else if (diagSampled) sampleRate = diagSamplePeriod;
+    dataOut[81] = sampleRate;
+    dataOut[82] = byte16(nDiagEscalations, 0);
+    dataOut[83] = byte16(nDiagEscalations, 1);
+    dataOut[84] = sensors.boardTemp[0];
+    dataOut[85] = sensors.boardTemp[1];
+    for (uint i=0; i<NUM_LOCAL_INA226; ++i) {
+        dataOut[86 + 4*i] = sensors.busV[i][0];
+        dataOut[86 + 4*i + 1] = sensors.busV[i][1];
+        dataOut[86 + 4*i + 2] = sensors.shuntV[i][0];
+        dataOut[86 + 4*i + 3] = sensors.shuntV[i][1];
+    }
+    dataOut[114] = sensorAge(SNS_TKR, sensors.tkrTempTime);
+    dataOut[115] = sensorAge(SNS_DIE, sensors.dieTempTime);
+    dataOut[116] = sensorAge(SNS_BOARD, sensors.boardTempTime);
+    dataOut[117] = sensorAge(SNS_INA, sensors.inaTime);
+    dataOut[118] = (uint8)(pmtMonitorTime/200);   // Seconds covered by the PMT rates
+    dataOut[119] = byte16(live10k, 0);            // Live fraction of the ADC state machine, in 0.01%
+    dataOut[120] = byte16(live10k, 1);
     nEvtH = 0;
     nTOFAavgH = 0;
     nTOFBavgH = 0;
@@ -1431,6 +1714,15 @@ uint16 tkrGetShuntVoltage(uint8 FPGA, uint8 i2cAddress) {
     return result;
 }
 
+// Note the time and GO1 count when the trigger is re-armed for the next event, for the per-event dead-time field
+void markRearm() {
+    int InterruptState = CyEnterCriticalSection();
+    rearmCycles = DWT_CYCCNT;
+    rearmTime = time();
+    rearmGO1 = cntGO1;
+    CyExitCriticalSection(InterruptState);
+}
+
 // Control of the trigger enable bit. Always make sure that the tracker trigger is disabled after disabling the trigger here.
 // And enable the tracker trigger before enabling this. That ensures that the tracker trigger is always active when the isr_GO is
 // active. The control register should ensure that when isr_GO is enabled there will not be any pending triggers. It is crucial that
@@ -1438,6 +1730,7 @@ uint16 tkrGetShuntVoltage(uint8 FPGA, uint8 i2cAddress) {
 void triggerEnable(bool enable) {
     uint8 status = Control_Reg_Trg_Read();
     if (enable) {
+        markRearm();
         Control_Reg_Pls_Write(PULSE_TRIG_SET);
         isr_GO_Enable();
         status = status | 0x01;
@@ -1545,165 +1838,307 @@ void LED2_OnOff(bool on) {
     }
 }
 
-// Load a single I2C byte register
-uint8 loadI2Creg(uint8 I2C_Address, uint8 regAddress, uint8 regValue) {
+// Queued I2C transactions. A transaction writes up to 3 bytes and/or reads up to 2 bytes. The byte transfers are
+// done by the I2C component interrupt, and i2cPoll(), called from the main loop, starts the next transaction and
+// calls the completion callback. The callback gets a return code of 0 for success. Bytes are read into the
+// queue entry, and the callback copies them out, so a late transaction cannot write into a record being built.
+#define I2C_QUEUE_LEN 8u
+#define I2C_TIMEOUT 20u        // Time-out for one transaction, in 5 ms ticks
+#define I2C_IDLE 0u
+#define I2C_WRITING 1u
+#define I2C_READING 2u
+struct I2Ctxn;
+typedef void (*I2Ccallback)(struct I2Ctxn *txn, uint8 rc);
+struct I2Ctxn {
+    uint8 address;
+    uint8 nWrite;
+    uint8 wrBuf[3];
+    uint8 nRead;
+    uint8 rdBuf[2];
+    I2Ccallback callback;     // May be NULL
+    uint8 *dest;              // Where the callback should put the result, if anywhere
+    uint32 tStart;            // Microsecond time stamp when the transaction started
+} i2cQueue[I2C_QUEUE_LEN];
+volatile uint8 i2cReadPtr, i2cWritePtr;
+uint8 i2cState = I2C_IDLE;
+uint32 i2cStartTick;          // time() at the start of the current transaction, for the time-out
+
+// Transaction timing statistics, readable by command 0x66
+uint16 i2cNumTxn, i2cNumFail;
+uint32 i2cSumTime, i2cMaxTime;   // Microseconds
+
+// Queue an I2C transaction. Returns false if the queue is full.
+bool i2cSubmit(uint8 address, uint8 nWrite, uint8 *wrData, uint8 nRead, I2Ccallback callback, uint8 *dest) {
+    if (WRAPINC(i2cWritePtr, I2C_QUEUE_LEN) == i2cReadPtr) {
+        addError(ERR_I2C_FAIL, address, 0xFF);
+        return false;
+    }
+    struct I2Ctxn *txn = &i2cQueue[i2cWritePtr];
+    txn->address = address;
+    txn->nWrite = nWrite;
+    for (int i=0; i<nWrite; ++i) txn->wrBuf[i] = wrData[i];
+    txn->nRead = nRead;
+    txn->callback = callback;
+    txn->dest = dest;
+    i2cWritePtr = WRAPINC(i2cWritePtr, I2C_QUEUE_LEN);
+    return true;
+}
 
-    // Send the start byte, with address
-    uint8 rc = I2C_2_MasterSendStart(I2C_Address,I2C_WRITE);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    // Send the register address
-    rc = I2C_2_MasterWriteByte(regAddress);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    // Send the register value
-    rc = I2C_2_MasterWriteByte(regValue);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    // Send the stop condition
-    rc = I2C_2_MasterSendStop();
-    if(rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    /* Wait for the data transfer to complete */
-    rc = I2C_2_MasterStatus();
-    if (rc != I2C_2_MSTAT_CLEAR) {
-        while(I2C_2_MasterStatus() == I2C_2_MSTAT_XFER_INP) CyDelay(100);
-    }  
-    
+void i2cFinish(uint8 rc) {
+    struct I2Ctxn *txn = &i2cQueue[i2cReadPtr];
+    uint32 dt = usecTime() - txn->tStart;
+    if (i2cNumTxn < 0xFFFF) {
+        i2cNumTxn++;
+        i2cSumTime += dt;
+    }
+    if (dt > i2cMaxTime) i2cMaxTime = dt;
+    if (rc != 0) {
+        if (i2cNumFail < 0xFFFF) i2cNumFail++;
+        addError(ERR_I2C_FAIL, txn->address, rc);
+        I2C_2_MasterClearStatus();
+    }
+    i2cState = I2C_IDLE;
+    i2cReadPtr = WRAPINC(i2cReadPtr, I2C_QUEUE_LEN);   // Release the slot first, so the callback can queue more
+    if (txn->callback != NULL) txn->callback(txn, rc);
+}
+
+// Give up on the transaction in progress. Stopping and restarting the component abandons the transfer, so that
+// the next transaction does not find the bus busy.
+void i2cAbort(uint8 rc) {
+    I2C_2_Stop();
+    I2C_2_Start();
+    i2cFinish(rc);
+}
+
+void i2cStartRead(struct I2Ctxn *txn) {
+    I2C_2_MasterClearStatus();
+    uint8 rc = I2C_2_MasterReadBuf(txn->address, txn->rdBuf, txn->nRead, I2C_2_MODE_COMPLETE_XFER);
+    if (rc != I2C_2_MSTR_NO_ERROR) i2cFinish(rc);
+    else i2cState = I2C_READING;
+}
+
+// Advance the I2C transactions. This never waits on the bus.
+void i2cPoll() {
+    if (i2cState == I2C_IDLE) {
+        if (i2cReadPtr == i2cWritePtr) return;
+        struct I2Ctxn *txn = &i2cQueue[i2cReadPtr];
+        txn->tStart = usecTime();
+        i2cStartTick = time();
+        if (txn->nWrite > 0) {
+            I2C_2_MasterClearStatus();
+            uint8 rc = I2C_2_MasterWriteBuf(txn->address, txn->wrBuf, txn->nWrite, I2C_2_MODE_COMPLETE_XFER);
+            if (rc != I2C_2_MSTR_NO_ERROR) i2cFinish(rc);
+            else i2cState = I2C_WRITING;
+        } else {
+            i2cStartRead(txn);
+        }
+        return;
+    }
+    struct I2Ctxn *txn = &i2cQueue[i2cReadPtr];
+    uint8 status = I2C_2_MasterStatus();
+    if (status & I2C_2_MSTAT_ERR_XFER) {
+        i2cFinish(status);
+    } else if (i2cState == I2C_WRITING && (status & I2C_2_MSTAT_WR_CMPLT)) {
+        if (txn->nRead > 0) i2cStartRead(txn);
+        else i2cFinish(0);
+    } else if (i2cState == I2C_READING && (status & I2C_2_MSTAT_RD_CMPLT)) {
+        i2cFinish(0);
+    } else if (timeElapsed(i2cStartTick) > I2C_TIMEOUT) {
+        i2cAbort(0xFE);
+    }
+}
+
+// Run the I2C engine until all queued transactions are done, for the few places that need a result right away.
+// If that takes too long, whatever is left is failed, so that nothing completes after the return.
+void i2cFlush() {
+    uint32 tStart = time();
+    while (i2cState != I2C_IDLE || i2cReadPtr != i2cWritePtr) {
+        i2cPoll();
+        if (timeElapsed(tStart) > I2C_QUEUE_LEN*I2C_TIMEOUT) {
+            if (i2cState != I2C_IDLE) i2cAbort(0xFD);
+            for (uint8 n=0; n<I2C_QUEUE_LEN && i2cReadPtr != i2cWritePtr; ++n) {
+                i2cQueue[i2cReadPtr].tStart = usecTime();
+                i2cFinish(0xFD);
+            }
+            break;
+        }
+    }
+}
+
+// Callback that copies the bytes read into the destination buffer. On failure the destination is left as it is.
+void i2cCopyResult(struct I2Ctxn *txn, uint8 rc) {
+    if (txn->dest == NULL || rc != 0) return;
+    for (int i=0; i<txn->nRead; ++i) txn->dest[i] = txn->rdBuf[i];
+}
+
+// Load a single I2C byte register, without waiting for completion
+uint8 loadI2Creg(uint8 I2C_Address, uint8 regAddress, uint8 regValue) {
+    uint8 bytes[2] = {regAddress, regValue};
+    if (!i2cSubmit(I2C_Address, 2, bytes, 0, NULL, NULL)) return 0xFF;
     return 0;    
 }
 
-// Read bytes from an I2C chip register
+// Read bytes from an I2C chip register. The result lands in regValue once the transaction completes,
+// so call i2cFlush() if the data are needed right away. regValue reads as zeros if the transaction fails.
 uint8 readI2Creg(int nBytes, uint8 I2C_Address, uint8 regAddress, uint8 regValue[]) {
-   
-    // Send the start byte, with address and control set to write
-    uint8 rc = I2C_2_MasterSendStart(I2C_Address,I2C_WRITE);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    // Send the register address
-    rc = I2C_2_MasterWriteByte(regAddress);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-
-    // Send the stop condition
-    rc = I2C_2_MasterSendStop();
-    if(rc != I2C_2_MSTR_NO_ERROR) return rc;    
-
-    // Wait for the data transfer to complete 
-    rc = I2C_2_MasterStatus();
-    if (rc != I2C_2_MSTAT_CLEAR) {
-        while(I2C_2_MasterStatus() == I2C_2_MSTAT_XFER_INP) CyDelay(100);
-    }      
-    
-    // Send the start byte, with address and control set to read
-    rc = I2C_2_MasterSendStart(I2C_Address,I2C_READ);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    for (int i=0; i<nBytes-1; ++i) {
-        regValue[i] = I2C_2_MasterReadByte(ACK);
-    }
-    regValue[nBytes-1] = I2C_2_MasterReadByte(NACK);
-        
-    // Send the stop condition
-    rc = I2C_2_MasterSendStop();
-    if(rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    /* Wait for the data transfer to complete */
-    rc = I2C_2_MasterStatus();
-    if (rc != I2C_2_MSTAT_CLEAR) {
-        while(I2C_2_MasterStatus() == I2C_2_MSTAT_XFER_INP) CyDelay(100);
-    }  
-    
+    for (int i=0; i<nBytes; ++i) regValue[i] = 0;
+    if (!i2cSubmit(I2C_Address, 1, &regAddress, nBytes, i2cCopyResult, regValue)) return 0xFF;
     return 0;    
 }
 
-// Load the AD5622 DAC via the i2c bus
-uint8 loadDAC(uint8 I2C_Address, uint16 voltage) {
-    
-    uint8 nib0 = (voltage & 0x00FF);
-    uint8 nib1 = (voltage & 0x0F00)>>8;
-    
-    uint8 rc;
-    
-    bool foundIt = false;
+struct DACsetting *findDAC(uint8 I2C_Address) {
     for (uint i=0; i<NUMDACs; ++i) {
-        if (DAC5602[i].address == I2C_Address) {
-            foundIt = true;
-            DAC5602[i].setting = 0xFFFF;   // DAC setting not yet read back
-            break;
-        }
+        if (DAC5602[i].address == I2C_Address) return &DAC5602[i];
     }
-    if (!foundIt) {
+    return NULL;
+}
+
+// Save the DAC setting read back from the AD5622
+void dacReadDone(struct I2Ctxn *txn, uint8 rc) {
+    struct DACsetting *dac = findDAC(txn->address);
+    if (dac == NULL || rc != 0) return;
+    uint16 value = ((uint16)(txn->rdBuf[0] & '\x3F'))<<6;
+    dac->setting = value | ((uint16)(txn->rdBuf[1] & '\xFC')>>2);
+}
+
+// After a DAC load, read the setting back right away, since it can be read only once after setting it
+void dacLoadDone(struct I2Ctxn *txn, uint8 rc) {
+    if (rc != 0) {
+        if (txn->address == I2C_Address_DAC_Ch5) addError(ERR_DAC_LOAD, rc, txn->address);
+        else addError(ERR_TOF_DAC_LOAD, rc, txn->address);
+        return;
+    }
+    i2cSubmit(txn->address, 0, NULL, 2, dacReadDone, NULL);
+}
+
+// Load the AD5622 DAC via the i2c bus. This only queues the transfer, so it returns right away.
+uint8 loadDAC(uint8 I2C_Address, uint16 voltage) {
+    struct DACsetting *dac = findDAC(I2C_Address);
+    if (dac == NULL) {
         addError(ERR_NO_SUCH_DAC, I2C_Address, 99);
         return 99;
     }
-    
-    rc = I2C_2_MasterSendStart(I2C_Address,I2C_WRITE);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    rc = I2C_2_MasterWriteByte(nib1);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    rc = I2C_2_MasterWriteByte(nib0);
-    if(rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    rc = I2C_2_MasterSendStop();
-    if(rc != I2C_2_MSTR_NO_ERROR) return rc;
-    
-    /* Wait for the data transfer to complete */
-    rc = I2C_2_MasterStatus();
-    if (rc != I2C_2_MSTAT_CLEAR) {
-        while(I2C_2_MasterStatus() == I2C_2_MSTAT_XFER_INP) CyDelay(100);
-    }  
-    
+    dac->setting = 0xFFFF;   // DAC setting not yet read back
+    uint8 bytes[2];
+    bytes[0] = (voltage & 0x0F00)>>8;
+    bytes[1] = (voltage & 0x00FF);
+    if (!i2cSubmit(I2C_Address, 2, bytes, 0, dacLoadDone, NULL)) return 0xFF;
     return 0;
 } // end of loadDAC
 
-// Read back over the i2c bus the setting from the AD5622 DAC and return it
+// Return the setting of the AD5622 DAC, as read back after the last load.
 // Note that per the datasheet, a second read without an interving write will return 0
 uint8 readDAC(uint8 I2C_Address, uint16* rvalue) {
-           
-    bool foundIt = false;
-    uint idx;
-    for (uint i=0; i<NUMDACs; ++i) {
-        if (DAC5602[i].address == I2C_Address) {
-            foundIt = true;
-            idx = i;
-            if (DAC5602[i].setting != 0xFFFF) {  // The DAC has already been read
-                *rvalue = DAC5602[i].setting;
-                return 0;
-            }
-            break;
-        }
-    }
-    if (!foundIt) {
+    struct DACsetting *dac = findDAC(I2C_Address);
+    if (dac == NULL) {
         addError(ERR_NO_SUCH_DAC, I2C_Address, 98);
         *rvalue = 0;
         return 98;
     }
-    
-    uint8 bytes[2];
-    //I2C_2_MasterClearReadBuf();
-    //uint8 rc = I2C_2_MasterReadBuf(I2C_Address, bytes, 2, I2C_2_MODE_COMPLETE_XFER);
-    uint8 rc = I2C_2_MasterSendStart(I2C_Address,I2C_READ);
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;    
+    if (dac->setting == 0xFFFF) i2cFlush();   // The read-back may still be in the queue
+    if (dac->setting == 0xFFFF) {             // Nothing was queued, so read it now
+        if (!i2cSubmit(I2C_Address, 0, NULL, 2, dacReadDone, NULL)) return 0xFF;
+        i2cFlush();
+    }
+    if (dac->setting == 0xFFFF) {
+        *rvalue = 0;
+        return 0xFE;
+    }
+    *rvalue = dac->setting;
+    return 0;
+}
 
-    bytes[0] = I2C_2_MasterReadByte(ACK);
-    bytes[1] = I2C_2_MasterReadByte(NACK);
+// Callback for the background sensor reads: keep the old value and skip the chip for a while if it does not answer
+void sensorReadDone(struct I2Ctxn *txn, uint8 rc) {
+    uint8 bit = 0x80;
+    for (uint i=0; i<NUM_LOCAL_INA226; ++i) {
+        if (localINA226[i] == txn->address) bit = 0x01<<i;
+    }
+    if (rc != 0) {
+        sensorMissing |= bit;
+        return;
+    }
+    txn->dest[0] = txn->rdBuf[0];
+    txn->dest[1] = txn->rdBuf[1];
+    if (bit == 0x80) {
+        sensors.boardTempTime = time();
+        sensorValid |= SNS_BOARD;
+    }
+}
 
-    rc = I2C_2_MasterSendStop();
-    if (rc != I2C_2_MSTR_NO_ERROR) return rc;
+// One step of a Tracker temperature read, following getTkrTemp() but spacing the steps over passes of the main loop
+// instead of waiting. Layer 0 is read in steps 0-3 and layer 7 in steps 4-7.
+void tkrTempPoll() {
+    if (usecTime() - tkrTempStepTime < TKR_TEMP_STEP_USEC) return;
+    uint8 lyr = tkrTempStep/4;
+    uint8 FPGA = (lyr == 0) ? 0 : 7;
+    switch (tkrTempStep%4) {
+        case 0:
+            tkrLoadI2cReg(FPGA, I2C_Address_TKR_Temp, 0x01, 0x60, 0x00);   // Set config reg
+            break;
+        case 1:
+            tkrLoadI2cReg(FPGA, I2C_Address_TKR_Temp, 0x00, 0x00, 0x00);   // Set pointer reg
+            break;
+        case 2:
+            sensors.tkrTemp[lyr] = tkrReadI2cReg(FPGA, I2C_Address_TKR_Temp);
+            break;
+        case 3:
+            tkrLoadI2cReg(FPGA, I2C_Address_TKR_Temp, 0x01, 0x61, 0x00);
+            break;
+    }
+    tkrTempStep++;
+    if (tkrTempStep == 4 && numTkrBrds <= 7) tkrTempStep = 8;
+    if (tkrTempStep == 8) {
+        tkrTempStep = 0;
+        sensors.tkrTempTime = time();
+        sensorValid |= SNS_TKR;
+    }
+    tkrTempStepTime = usecTime();
+}
 
-    *rvalue = ((uint16)(bytes[0] & '\x3F'))<<6;
-    *rvalue = *rvalue | ((uint16)(bytes[1] & '\xFC')>>2);
-    
-    rc = I2C_2_MasterStatus();    
-    if (rc != I2C_2_MSTAT_CLEAR) {
-        while(I2C_2_MasterStatus() == I2C_2_MSTAT_XFER_INP) CyDelay(100);
-    } 
-    
-    DAC5602[idx].setting = *rvalue;
-    
-    return 0;
+// Background sensor scheduler, called from the main loop only when nothing else is pending. Each call does at most
+// one step: a Tracker temperature step, the die temperature, or queueing one local I2C read. The Tracker temperatures
+// are refreshed on the Tracker rate monitoring period, and the local sensors every second.
+void sensorPoll() {
+    uint32 tkrPeriod = 200*(uint32)tkrRatesMult*(uint32)houseKeepPeriod;
+    if (tkrPeriod < 10*SENSOR_PERIOD) tkrPeriod = 10*SENSOR_PERIOD;
+    if (numTkrBrds > 0 && (tkrTempStep > 0 || !(sensorValid & SNS_TKR) || timeElapsed(sensors.tkrTempTime) >= tkrPeriod)) {
+        tkrTempPoll();
+        return;
+    }
+    if (!(sensorValid & SNS_DIE) || timeElapsed(sensors.dieTempTime) >= SENSOR_PERIOD) {
+        cystatus ret = DieTemp_1_GetTemp(&sensors.dieTemp);
+        if (ret != CYRET_SUCCESS) addErrorOnce(BAD_DIE_TEMP, ret);
+        sensors.dieTempTime = time();
+        sensorValid |= SNS_DIE;
+        return;
+    }
+    // Local I2C sensors, one read queued at a time, and only when the I2C bus is otherwise unused
+    if (i2cState != I2C_IDLE || i2cReadPtr != i2cWritePtr) return;
+    if (sensorStep == 0) {
+        if ((sensorValid & SNS_INA) && timeElapsed(sensorSweepStart) < SENSOR_PERIOD) return;
+        sensorSweepStart = time();
+        if (++nSensorSweeps%64 == 0) sensorMissing = 0;
+        if (!(sensorMissing & 0x80)) {
+            i2cSubmit(I2C_Address_TMP100, 1, (uint8 *)&TMP100_Temp_Reg, 2, sensorReadDone, sensors.boardTemp);
+        }
+        sensorStep = 1;
+        return;
+    }
+    uint8 chip = (sensorStep - 1)/2;
+    if (!(sensorMissing & (0x01<<chip))) {
+        if (sensorStep%2 == 1) {
+            i2cSubmit(localINA226[chip], 1, (uint8 *)&INA226_BusV_Reg, 2, sensorReadDone, sensors.busV[chip]);
+        } else {
+            i2cSubmit(localINA226[chip], 1, (uint8 *)&INA226_ShuntV_Reg, 2, sensorReadDone, sensors.shuntV[chip]);
+        }
+    }
+    sensorStep++;
+    if (sensorStep > 2*NUM_LOCAL_INA226) {
+        sensorStep = 0;
+        sensors.inaTime = time();
+        sensorValid |= SNS_INA;
+    }
 }
 
 // Set the time delays used for coordinating the peak detector readout:
@@ -1813,11 +2248,7 @@ void logicReset() {
     nTkrReadNotReady = 0;
     Control_Reg_Pls_Write(PULSE_LOGIC_RST);
     Control_Reg_Pls_Write(PULSE_CNTR_RST);
-    pmtClkCntStart = time();
-    for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
-        pmtCntInit[cntr] = 0;
-    }
-    waitingPmtRateCnt = true;
+    pmtRingCount = 0;      // The counters start over, so older snapshots are no use
     CyDelay(20);
     
     for (int brd=0; brd<MAX_TKR_BOARDS; ++brd) {
@@ -1905,6 +2336,7 @@ uint8 CRC6(int nBits, uint8 theBytes[]) {
 
 // Recalculate the 6-bit hitlist CRC and compare with the Tracker FPGA calculation.
 bool checkCRC(int nBytes, uint8 hitList[]) {
+    PROBE_BEGIN(PROBE_CHECK_CRC);
     uint8 masks[7] = {0xC0,0x60,0x30,0x18,0x0C,0x06,0x03};
     uint8 crc, crcL, crcR;
     int nBits = nBytes*8 - 2;
@@ -1917,12 +2349,14 @@ bool checkCRC(int nBytes, uint8 hitList[]) {
         nBits--;
         nShift++;
     }
+    PROBE_END(PROBE_CHECK_CRC);
     return false;
     foundIt:
     crcL = (hitList[nBytes-2]<<(8-nShift));
     crcR = (hitList[nBytes-1]>>nShift);
     crc = (crcL | crcR) & 0x3F;
     uint8 crcNew = CRC6(nBits-6, hitList);  // Recalculate the 6-bit CRC
+    PROBE_END(PROBE_CHECK_CRC);
     return (crcNew == crc);                 // Compare with the FPGA value
 }
 
@@ -2023,6 +2457,112 @@ uint64 getTkrASICtrgMask(uint8 FPGA, uint8 chip) {
     return mask;
 }
 
+// Bulk ASIC configuration. Register writes are streamed to the Tracker without waiting for each echo. The echoes
+// are collected after every TKR_BULK_WINDOW writes, to bound what can pile up in the Tracker UART buffer.
+#define TKR_BULK_WINDOW 8
+#define TKR_REG_THR 0
+#define TKR_REG_DATA 1
+#define TKR_REG_TRG 2
+uint8 tkrBulkCodes[TKR_BULK_WINDOW];    // Command codes of the writes still waiting for their echo
+uint8 nTkrBulkPending = 0;
+
+// Read and check the echoes of all of the streamed writes
+void tkrBulkDrain() {
+    for (int i=0; i<nTkrBulkPending; ++i) {
+        tkrCmdCode = tkrBulkCodes[i];
+        int rc = getTrackerData(TKR_ECHO_DATA);
+        if (rc != 0) {
+            uint8 rc8;
+            if (rc < 0) rc8 = rc + 255; else rc8 = rc;
+            addError(ERR_GET_TKR_DATA, rc8, tkrCmdCode);
+        }
+    }
+    nTkrBulkPending = 0;
+    nDataReady = 0;
+}
+
+// Send a register write to the Tracker without waiting for the echo
+void tkrBulkWrite(uint8 FPGA, uint8 code, uint8 nData, uint8 data[]) {
+    if (!readTracker) return;
+    if (nTkrBulkPending >= TKR_BULK_WINDOW) tkrBulkDrain();
+    tkrLED(true);
+    uint32 tStart = time();
+    for (int i=0; i<nData+3; ++i) {
+        uint8 theByte;
+        if (i == 0) theByte = FPGA;
+        else if (i == 1) theByte = code;
+        else if (i == 2) theByte = nData;
+        else theByte = data[i-3];
+        while (UART_TKR_ReadTxStatus() & UART_TKR_TX_STS_FIFO_FULL) {
+            if (timeElapsed(tStart) > TKR_WRITE_TIMEOUT) {
+                addErrorOnce(ERR_TX_FAILED, code);
+                tkrLED(false);
+                return;
+            }
+        }
+        UART_TKR_WriteTxData(theByte);
+    }
+    tkrBulkCodes[nTkrBulkPending++] = code;
+    tkrLED(false);
+}
+
+// Copy one of the RAM settings of a chip into a command data buffer. Returns the number of bytes.
+uint8 tkrSetting(uint8 brd, uint8 chip, uint8 reg, uint8 *bytes) {
+    if (reg == TKR_REG_THR) {
+        bytes[0] = tkrConfig[brd][chip].threshDAC;
+        return 1;
+    }
+    for (int i=0; i<8; ++i) {
+        if (reg == TKR_REG_DATA) bytes[i] = tkrConfig[brd][chip].datMask[i];
+        else bytes[i] = tkrConfig[brd][chip].trgMask[i];
+    }
+    return 8;
+}
+
+bool tkrSameSetting(uint8 brd, uint8 chipA, uint8 chipB, uint8 reg) {
+    uint8 a[8], b[8];
+    uint8 n = tkrSetting(brd, chipA, reg, a);
+    tkrSetting(brd, chipB, reg, b);
+    for (int i=0; i<n; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+
+// Load one type of register for all of the chips on a board. The setting shared by the most chips goes out with
+// a single chip wild-card command, followed by individual writes only for the chips that differ.
+void tkrBulkLoad(uint8 brd, uint8 code, uint8 reg) {
+    uint8 common = 0;
+    uint8 nCommon = 0;
+    for (uint8 chip=0; chip<MAX_TKR_ASIC; ++chip) {
+        uint8 n = 0;
+        for (uint8 other=0; other<MAX_TKR_ASIC; ++other) {
+            if (tkrSameSetting(brd, chip, other, reg)) n++;
+        }
+        if (n > nCommon) {
+            nCommon = n;
+            common = chip;
+        }
+    }
+    uint8 dataBytes[9];
+    dataBytes[0] = 0x1F;
+    uint8 n = tkrSetting(brd, common, reg, &dataBytes[1]);
+    tkrBulkWrite(brd, code, n+1, dataBytes);
+    for (uint8 chip=0; chip<MAX_TKR_ASIC; ++chip) {
+        if (tkrSameSetting(brd, chip, common, reg)) continue;
+        dataBytes[0] = chip;
+        tkrSetting(brd, chip, reg, &dataBytes[1]);
+        tkrBulkWrite(brd, code, n+1, dataBytes);
+    }
+}
+
+// Pack the 8 bytes of a mask as returned by getTkrASICdataMask() and getTkrASICtrgMask()
+uint64 packMask(uint8 *bytes) {
+    uint64 mask = 0;
+    for (int i=0; i<8; ++i) mask = mask<<8 | bytes[i];
+    return mask;
+}
+
 // Configure all of the ASICs according to the settings stored in RAM
 void configureASICs(bool verify) {
     uint8 dataBytes[9];
@@ -2035,113 +2575,42 @@ void configureASICs(bool verify) {
     dataBytes[3] = tkrConfigReg[2];
     sendTrackerCmd(0x00, tkrCmdCode, 4, dataBytes);
     CyDelayUs(10);
-    if (verify) {
-        tkrCmdCode = 0x22;
-        for (uint8 tkrFPGAaddress=0; tkrFPGAaddress<numTkrBrds; ++tkrFPGAaddress) {
-            for (uint8 chip=0; chip<MAX_TKR_ASIC; ++chip) {
-                uint32 config = getTkrASICconfig(tkrFPGAaddress, chip);
-                uint8 regType =  (config & 0x70000000)>>28;
-                if (regType != 0x03) {
-                    addError(ERR_TKR_BAD_CONFIG, tkrFPGAaddress, chip);
-                    continue;
-                }            
-                config = (config & 0xFFFFFFE0)<<8;
-                if (tkrConfigReg[0] != (config & 0xFF000000)>>24 || tkrConfigReg[1] != (config & 0x00FF0000)>>16 || tkrConfigReg[2] != (config & 0x0000FF00)>>8) {
-                    addError(ERR_TKR_BAD_CONFIG, tkrFPGAaddress, chip);
-                }
-            }
-        }
-    }
     
-    // Next load all of the threshold DACs individually
+    // Stream the threshold DACs, data masks and trigger masks to all of the boards
+    clearTkrFIFO();
+    nTkrBulkPending = 0;
     for (uint8 tkrFPGAaddress=0; tkrFPGAaddress<numTkrBrds; ++tkrFPGAaddress) {
-        for (uint8 chipAddress=0; chipAddress<MAX_TKR_ASIC; ++chipAddress) {
-            dataBytes[0] = chipAddress;
-            dataBytes[1] = tkrConfig[tkrFPGAaddress][chipAddress].threshDAC;
-            tkrCmdCode = 0x11;
-            sendTrackerCmd(tkrFPGAaddress, tkrCmdCode, 2, dataBytes);
-            CyDelayUs(10);
-            if (verify) {
-                uint16 regV = getTkrASICthrDAC(tkrFPGAaddress, chipAddress);
-                uint8 regType =  (regV & 0x7000)>>12;
-                if (regType != 0x02) {
-                    addError(ERR_TKR_BAD_DAC, tkrFPGAaddress, chipAddress);
-                    continue;
-                }
-                uint8 DACV = (regV>>3) & 0x00FF;
-                if (DACV != dataBytes[1]) {
-                    addError(ERR_TKR_BAD_DAC, tkrFPGAaddress, chipAddress);
-                }
-            }
-        }
+        tkrBulkLoad(tkrFPGAaddress, 0x11, TKR_REG_THR);
+        tkrBulkLoad(tkrFPGAaddress, 0x13, TKR_REG_DATA);
+        tkrBulkLoad(tkrFPGAaddress, 0x14, TKR_REG_TRG);
     }
+    tkrBulkDrain();
+    if (!verify) return;
     
-    // Next load all of the data masks. Use wild card for the chip if all channels are to be enabled, as is the usual case
-    //uint8 testMask[8] = {0xAB,0xCD,0xEF,0xAD,0xBC,0xDE,0xE2,0x75};
+    // A single pass to read back all of the registers and compare with the settings in RAM
     for (uint8 tkrFPGAaddress=0; tkrFPGAaddress<numTkrBrds; ++tkrFPGAaddress) {
-        dataBytes[0] = 0x1F;
-        for (int i=0; i<8; ++i) dataBytes[1+i] = 0xFF;
-        tkrCmdCode = 0x13;
-        sendTrackerCmd(tkrFPGAaddress, tkrCmdCode, 9, dataBytes);
-        for (uint8 chipAddress=0; chipAddress<MAX_TKR_ASIC; ++chipAddress) {
-            dataBytes[0] = chipAddress;
-            bool allOn = true;
-            for (int i=0; i<8; ++i) {
-                dataBytes[1+i] = tkrConfig[tkrFPGAaddress][chipAddress].datMask[i];
-                if (dataBytes[1+i] != 0xFF) allOn = false;
+        for (uint8 chip=0; chip<MAX_TKR_ASIC; ++chip) {
+            struct TkrConfig *cfg = &tkrConfig[tkrFPGAaddress][chip];
+            uint32 config = getTkrASICconfig(tkrFPGAaddress, chip);
+            uint8 regType =  (config & 0x70000000)>>28;
+            config = (config & 0xFFFFFFE0)<<8;
+            if (regType != 0x03 || tkrConfigReg[0] != (config & 0xFF000000)>>24 || tkrConfigReg[1] != (config & 0x00FF0000)>>16 
+                                || tkrConfigReg[2] != (config & 0x0000FF00)>>8) {
+                addError(ERR_TKR_BAD_CONFIG, tkrFPGAaddress, chip);
             }
-            if (!allOn) {
-                tkrCmdCode = 0x13;
-                sendTrackerCmd(tkrFPGAaddress, tkrCmdCode, 9, dataBytes);
+            uint16 regV = getTkrASICthrDAC(tkrFPGAaddress, chip);
+            regType =  (regV & 0x7000)>>12;
+            if (regType != 0x02 || ((regV>>3) & 0x00FF) != cfg->threshDAC) {
+                addError(ERR_TKR_BAD_DAC, tkrFPGAaddress, chip);
             }
-            CyDelayUs(10);
-            uint64 maskSet = getTkrASICdataMask(tkrFPGAaddress, chipAddress);
-            uint64 maskTst = dataBytes[1];
-            maskTst = maskTst<<8 | dataBytes[2];
-            maskTst = maskTst<<8 | dataBytes[3];
-            maskTst = maskTst<<8 | dataBytes[4];
-            maskTst = maskTst<<8 | dataBytes[5];
-            maskTst = maskTst<<8 | dataBytes[6];
-            maskTst = maskTst<<8 | dataBytes[7];
-            maskTst = maskTst<<8 | dataBytes[8];
-            if (maskTst != maskSet) {
-                addError(ERR_TKR_BAD_DATA_MASK, tkrFPGAaddress, chipAddress);
+            if (getTkrASICdataMask(tkrFPGAaddress, chip) != packMask(cfg->datMask)) {
+                addError(ERR_TKR_BAD_DATA_MASK, tkrFPGAaddress, chip);
             }
-        }
-    }    
-    
-    // Next load all of the trigger masks. Use a wild card to cover the typical case of all enabled.
-    for (uint8 tkrFPGAaddress=0; tkrFPGAaddress<numTkrBrds; ++tkrFPGAaddress) {
-        dataBytes[0] = 0x1F;
-        for (int i=0; i<8; ++i) dataBytes[1+i] = 0xFF;
-        tkrCmdCode = 0x14;
-        sendTrackerCmd(tkrFPGAaddress, tkrCmdCode, 9, dataBytes);
-        for (uint8 chipAddress=0; chipAddress<MAX_TKR_ASIC; ++chipAddress) {
-            dataBytes[0] = chipAddress;
-            bool allOn = true;
-            for (int i=0; i<8; ++i) {
-                dataBytes[1+i] = tkrConfig[tkrFPGAaddress][chipAddress].trgMask[i];
-                if (dataBytes[1+i] != 0xFF) allOn = false;
-            }
-            if (!allOn) {
-                tkrCmdCode = 0x14;
-                sendTrackerCmd(tkrFPGAaddress, tkrCmdCode, 9, dataBytes);
-            }
-            CyDelayUs(10);
-            uint64 maskSet = getTkrASICtrgMask(tkrFPGAaddress, chipAddress);
-            uint64 maskTst = dataBytes[1];
-            maskTst = maskTst<<8 | dataBytes[2];
-            maskTst = maskTst<<8 | dataBytes[3];
-            maskTst = maskTst<<8 | dataBytes[4];
-            maskTst = maskTst<<8 | dataBytes[5];
-            maskTst = maskTst<<8 | dataBytes[6];
-            maskTst = maskTst<<8 | dataBytes[7];
-            maskTst = maskTst<<8 | dataBytes[8];
-            if (maskTst != maskSet) {
-                addError(ERR_TKR_BAD_TRG_MASK, tkrFPGAaddress, chipAddress);
+            if (getTkrASICtrgMask(tkrFPGAaddress, chip) != packMask(cfg->trgMask)) {
+                addError(ERR_TKR_BAD_TRG_MASK, tkrFPGAaddress, chip);
             }
         }
-    }    
+    }
     nDataReady = 0;   // To prevent the last echo from being sent out from the PSOC
 }
 
@@ -2268,7 +2737,8 @@ int resetAllTrackerLogic() {
     // Reset the ASICs only if there are non-parity errors flagged in the configuration register, or if
     // the configuration register read failed, or there are many recent time-outs or resets (stuck).
     uint32 allErrCodes[MAX_TKR_BOARDS];
-    bool bad = getTkrASICerrors(doDiagnostics, allErrCodes, &rc);
+    bool fullDiag = doDiagnostics || diagEscalated;
+    bool bad = getTkrASICerrors(fullDiag, allErrCodes, &rc);
     if (bad || (nTkrTimeOut - lastNTkrTimeOut) > 12 || (numTkrResets - lastNumTkrResets) > 1) {   
         cmdData[0] = 0x1F;   // All chips selected
         if (rc != 0) {
@@ -2280,7 +2750,7 @@ int resetAllTrackerLogic() {
         configureASICs(false);
         addError(ERR_ASICS_RESET, (cntGO>>8), cntGO);
     }
-    if (doDiagnostics) makeErrorRecord(allErrCodes);
+    if (fullDiag) makeErrorRecord(allErrCodes);
     if (trgStat) {
         sendSimpleTrackerCmd(0x00, 0x65);
         triggerEnable(true);
@@ -2313,6 +2783,7 @@ void calibrateAllInputTiming() {
 
 // Copy TOF information from the buffer into which the DMA writes
 void copyTOF_DMA(char which, bool cleanUp) {
+    PROBE_BEGIN(PROBE_TOF_DMA);
     if (which != 'B') {
         for (int i=0; i<nTOF_DMA_samples; ++i) {
             if (tofA_sampleArray[i] == 0) continue;
@@ -2356,6 +2827,7 @@ void copyTOF_DMA(char which, bool cleanUp) {
             }
         }
     }
+    PROBE_END(PROBE_TOF_DMA);
 }
 
 // Functions for loading and reading the configuration of the TOF chip via SPI, either 4-bit or 8-bit.
@@ -2390,29 +2862,63 @@ uint8 readTOFdata() {
     return dataByte;
 }
 
+// Combine the turnover count and the hardware count of a singles counter. Call with interrupts masked. A turnover
+// interrupt that is pending but not yet serviced is included, and if the counter turns over between checking the
+// pending bit and reading it, the count is read again.
+uint32 chCount(uint32 nTurnover, reg32 *pending, uint32 mask, uint8 (*readCount)(void)) {
+    bool turnedOver = (*pending & mask) != 0;
+    uint8 count = readCount();
+    if (!turnedOver && (*pending & mask) != 0) {
+        turnedOver = true;
+        count = readCount();
+    }
+    if (turnedOver) nTurnover++;
+    return nTurnover*PMT_CNTR_WRAP + count;
+}
+
 // Get the current count from one of the channel singles-rate counters G, T3, T1, T4, T2
 uint32 getChCount(int cntr) {
     uint32 count = 0;
+    int InterruptState = CyEnterCriticalSection();
     switch (cntr) {
         case 0:
-          count = ch1Count*255 + Cntr8_V1_1_ReadCount();
+          count = chCount(ch1Count, isr_Ch1_INTC_SET_PD, isr_Ch1__INTC_MASK, Cntr8_V1_1_ReadCount);
           break;
         case 1:
-          count = ch2Count*255 + Cntr8_V1_2_ReadCount();
+          count = chCount(ch2Count, isr_Ch2_INTC_SET_PD, isr_Ch2__INTC_MASK, Cntr8_V1_2_ReadCount);
           break;       
         case 2:
-          count = ch3Count*255 + Cntr8_V1_3_ReadCount();
+          count = chCount(ch3Count, isr_Ch3_INTC_SET_PD, isr_Ch3__INTC_MASK, Cntr8_V1_3_ReadCount);
           break;
         case 3:
-          count = ch4Count*255 + Cntr8_V1_4_ReadCount();
+          count = chCount(ch4Count, isr_Ch4_INTC_SET_PD, isr_Ch4__INTC_MASK, Cntr8_V1_4_ReadCount);
           break;
         case 4:
-          count = ch5Count*255 + Cntr8_V1_5_ReadCount();
+          count = chCount(ch5Count, isr_Ch5_INTC_SET_PD, isr_Ch5__INTC_MASK, Cntr8_V1_5_ReadCount);
           break;
     }
+    CyExitCriticalSection(InterruptState);
     return count;
 }
 
+// Counts in each PMT channel over a window of nSec seconds that ends nBack seconds before the latest snapshot.
+// Returns the window length in 5 ms ticks, or 0 if the ring does not reach back that far.
+uint32 pmtWindow(uint8 nSec, uint16 nBack, uint32 *sums) {
+    int InterruptState = CyEnterCriticalSection();
+    if (nSec == 0 || (uint32)nSec + nBack >= pmtRingCount) {
+        CyExitCriticalSection(InterruptState);
+        return 0;
+    }
+    struct PmtSnapshot *end = &pmtRing[(pmtRingPtr + 2*PMT_RING_LEN - 1 - nBack)%PMT_RING_LEN];
+    struct PmtSnapshot *start = &pmtRing[(pmtRingPtr + 2*PMT_RING_LEN - 1 - nBack - nSec)%PMT_RING_LEN];
+    for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
+        sums[cntr] = end->count[cntr] - start->count[cntr];
+    }
+    uint32 dt = end->time - start->time;
+    CyExitCriticalSection(InterruptState);
+    return dt;
+}
+
 // Move TOF data out of the DMA buffers each time the maximum number of DMA TDs is used up
 CY_ISR(isrTOFnrqA) {
     copyTOF_DMA('A', false);
@@ -2495,6 +3001,12 @@ CY_ISR(intTimer) {
 CY_ISR(clk200) {       // Interrupt every second (200 ticks of the 5ms period clock)
     int InterruptState = CyEnterCriticalSection();  // Don't allow a GO to interrupt while incrementing this counter
     clkCnt += 200;     // Increment the clock counter used for time stamps
+    cycAtSecond = DWT_CYCCNT;
+    struct PmtSnapshot *snap = &pmtRing[pmtRingPtr];
+    snap->time = clkCnt;
+    for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) snap->count[cntr] = getChCount(cntr);
+    pmtRingPtr = WRAPINC(pmtRingPtr, PMT_RING_LEN);
+    if (pmtRingCount < PMT_RING_LEN) pmtRingCount++;
     CyExitCriticalSection(InterruptState);
     uint8 status = Pin_LED1_Read();
     status = ~status;
@@ -2527,20 +3039,116 @@ CY_ISR(isrCh5)
     ch5Count++;
 }
 
-// Receive and store commands from the Main PSOC via the UART, using a circular FIFO buffer
+// CRC16-CCITT (polynomial 0x1021, initial value 0xFFFF)
+uint16 crc16(uint8 *data, uint16 len) {
+    uint16 crc = 0xFFFF;
+    for (uint16 i=0; i<len; ++i) {
+        crc ^= (uint16)data[i] << 8;
+        for (int b=0; b<8; ++b) {
+            if (crc & 0x8000) crc = (crc << 1) ^ 0x1021;
+            else crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+void bulkError(struct BulkFrame *frame, uint8 code, uint8 val0, uint8 val1) {
+    if (frame == &bulkUART) addErrorISR(ERR_CTX_UART, code, val0, val1);
+    else addError(code, val0, val1);
+}
+
+// Abandon a partial bulk frame that has not been completed within BULK_TIMEOUT
+void bulkCheckTimeout(struct BulkFrame *frame) {
+    if (frame->state != BULK_IDLE && timeElapsed(frame->tStart) > BULK_TIMEOUT) {
+        bulkError(frame, ERR_BULK_FORMAT, frame->state, (uint8)frame->cnt);
+        frame->state = BULK_IDLE;
+    }
+}
+
+// Assemble binary bulk command frames one byte at a time. Returns false if the byte is not part of a bulk frame
+// and should go to the ASCII command parser.
+bool bulkRxByte(struct BulkFrame *frame, uint8 theByte) {
+    bulkCheckTimeout(frame);
+    switch (frame->state) {
+        case BULK_IDLE:
+            if (theByte != BULK_SYNC0) return false;
+            frame->state = BULK_SYNC;
+            frame->tStart = time();
+            return true;
+        case BULK_SYNC:
+            if (theByte != BULK_SYNC1) {
+                frame->state = BULK_IDLE;
+                return false;
+            }
+            frame->state = BULK_LEN;
+            frame->cnt = 0;
+            return true;
+        case BULK_LEN:        // buf and len still hold the previous frame if it is being executed
+            if (frame->cnt++ == 0) {
+                frame->rxLen = (uint16)theByte << 8;
+                return true;
+            }
+            frame->rxLen |= theByte;
+            if (frame->rxLen == 0 || frame->rxLen > BULK_MAX_PAYLOAD) {
+                bulkError(frame, ERR_BULK_FORMAT, byte16(frame->rxLen,0), byte16(frame->rxLen,1));
+                frame->state = BULK_IDLE;
+            } else if (frame->ready) {     // The previous frame is still being executed
+                bulkError(frame, ERR_BULK_BUSY, byte16(frame->rxLen,0), byte16(frame->rxLen,1));
+                frame->state = BULK_SKIP;
+            } else {
+                frame->len = frame->rxLen;
+                frame->buf[0] = byte16(frame->rxLen,0);
+                frame->buf[1] = theByte;
+                frame->state = BULK_DATA;
+            }
+            return true;
+        case BULK_DATA:
+            frame->buf[frame->cnt++] = theByte;
+            if (frame->cnt == frame->len + 4) {
+                frame->ready = true;
+                frame->state = BULK_IDLE;
+            }
+            return true;
+        case BULK_SKIP:
+            frame->cnt++;
+            if (frame->cnt == frame->rxLen + 4) frame->state = BULK_IDLE;
+            return true;
+    }
+    return false;
+}
+
+// Receive commands from the Main PSOC via the UART. Commands are delimited here by <CR><LF>, and each complete
+// 29-byte command is moved into the command buffer for the main loop.
 CY_ISR(isrUART) {
     while (UART_CMD_ReadRxStatus() & UART_CMD_RX_STS_FIFO_NOTEMPTY) {
         uint16 theByte = UART_CMD_GetByte();
         if ((theByte & 0xDF00) != 0) {
             uint8 code = (uint8)((theByte & 0xDF00)>>8);
-            addError(ERR_UART_CMD, code, (uint8)theByte);
+            addErrorISR(ERR_CTX_UART, ERR_UART_CMD, code, (uint8)theByte);
         }
-        cmdFIFO[fifoWritePtr] = (uint8)theByte;
-        fifoWritePtr = WRAPINC(fifoWritePtr, MX_FIFO);
-        if (fifoWritePtr == fifoReadPtr) {
-            fifoWritePtr = WRAPDEC(fifoWritePtr, MX_FIFO);  // The byte will get overwritten---we're screwed. . .
-            addError(ERR_FIFO_OVERFLOW, fifoReadPtr, theByte);
+        uint8 newByte = (uint8)theByte;
+        if (bulkRxByte(&bulkUART, newByte)) continue;
+        cmdWindow[cmdWinPtr] = newByte;
+        cmdWinPtr = WRAPINC(cmdWinPtr, CMD_LENGTH);
+        if (cmdWinCount < CMD_LENGTH) cmdWinCount++;
+        if (lastCmdByte == CR && newByte == LF && cmdWinCount == CMD_LENGTH) {
+            uint8 nextWritePtr = WRAPINC(cmdWritePtr, MX_CMDS);
+            if (nextWritePtr == cmdReadPtr) {
+                addErrorISR(ERR_CTX_UART, ERR_CMD_BUF_OVERFLOW, byte32(clkCnt,0), byte32(clkCnt,1));  // The command is lost
+            } else {
+                uint8 *buf = cmd_buffer[cmdWritePtr].buf;
+                uint8 ptr = cmdWinPtr;        // Oldest byte in the window
+                for (int j=0; j<CMD_LENGTH; ++j) {
+                    buf[j] = cmdWindow[ptr];
+                    ptr = WRAPINC(ptr, CMD_LENGTH);
+                }
+                cmd_buffer[cmdWritePtr].nBytes = CMD_LENGTH;
+                cmdWritePtr = nextWritePtr;   // Hand the command to the main loop
+            }
+            cmdWinCount = 0;
+            newByte = 0;
         }
+        lastCmdByte = newByte;
     }
 }
 
@@ -2563,13 +3171,13 @@ CY_ISR(isrTkrUART) {
         uint16 theByte = UART_TKR_GetByte();
         if ((theByte & 0xDF00) != 0) {
             uint8 code = (uint8)((theByte & 0xDF00)>>8);
-            addError(ERR_UART_TKR, code, (uint8)theByte);
+            addErrorISR(ERR_CTX_TKR, ERR_UART_TKR, code, (uint8)theByte);
         }
         tkrBuf[tkrWritePtr] = (uint8)theByte;
         tkrWritePtr = WRAPINC(tkrWritePtr, MAX_TKR);
         if (tkrWritePtr == tkrReadPtr) {   // FIFO overflow condition, very bad!
             tkrWritePtr = WRAPDEC(tkrWritePtr, MAX_TKR);  // The byte will get overwritten!
-            addError(ERR_TKR_BUFFER_OVERFLOW, tkrReadPtr, theByte);
+            addErrorISR(ERR_CTX_TKR, ERR_TKR_BUFFER_OVERFLOW, tkrReadPtr, theByte);
         }
     }
     //Pin_db1_Write(0u);
@@ -2577,12 +3185,15 @@ CY_ISR(isrTkrUART) {
 
 CY_ISR(isr1Hz) {
     cntSeconds++;
-    if (cntSeconds%houseKeepPeriod == 0 && cntSeconds != 0) {
+    if (houseKeepPeriod > 0 && cntSeconds%houseKeepPeriod == 0 && cntSeconds != 0) {
         houseKeepingDue = doHouseKeeping;
     }
-    if (cntSeconds%(tkrHouseKeepPeriod*60) == 0 && cntSeconds != 0) {
+    if (tkrHouseKeepPeriod > 0 && cntSeconds%(tkrHouseKeepPeriod*60) == 0 && cntSeconds != 0) {
         tkrHouseKeepingDue = doTkrHouseKeeping;
     }
+    if (errStreamPeriod > 0 && cntSeconds%errStreamPeriod == 0) {
+        errStreamDue = true;
+    }
 }
 
 // GO signal (system trigger). Start the full event readout.
@@ -2593,10 +3204,11 @@ CY_ISR(isrGO) {
     timeStamp = time();                    // Save for the event readout 
     timeStamp8 = Cntr8_Timer_ReadCount();  // Save for the TOF event analysis and readout
     cntGO1save = cntGO1;                   // Save for the event readout
+    goCycles = DWT_CYCCNT;
     triggerEnable(false);                  // Disable the trigger until readout is complete
     cntGO++;                               // The event number counter
     if (cntGO == nTkrReadReady + nTkrReadNotReady) {  // Look for a trigger coming before the previous event is read out (shoudn't happen)
-        addError(ERR_TRG_NOT_READY,(uint8)(cntGO>>8),(uint8)(cntGO));
+        addErrorISR(ERR_CTX_GO, ERR_TRG_NOT_READY,(uint8)(cntGO>>8),(uint8)(cntGO));
     }
     // At this point execution returns to its normal flow, allowing other interrupts. The remainder of the
     // event readout process is done in main(), in the infinite for loop.
@@ -2634,7 +3246,39 @@ void setSettlingWindow(uint8 chan, uint8 dt) {
     }
 }
 
+// Decide whether the tracker hit lists of the current event should get the diagnostic checks
+bool diagnoseThisEvent() {
+    if (doDiagnostics) return true;
+    if (!diagSampled) return false;
+    if (diagEscalated) {
+        if (timeElapsed(diagEscalateStart) < 200*(uint32)diagEscalateTime) return true;
+        diagEscalated = false;           // Go back to sampling
+        nDiagSampled = 0;
+        nDiagBad = 0;
+    }
+    if (diagSamplePeriod <= 1) return true;
+    return (cntGO % diagSamplePeriod == 0);
+}
+
+// Accumulate the error fraction of sampled events and escalate to checking every event if it is too high
+void diagnosticsUpdate(bool bad) {
+    if (!diagSampled || diagEscalated) return;
+    nDiagSampled++;
+    if (bad) nDiagBad++;
+    if (100*(uint16)nDiagBad > (uint16)diagThreshold*DIAG_WINDOW) {  // Escalate as soon as the threshold is crossed
+        diagEscalated = true;
+        diagEscalateStart = time();
+        if (nDiagEscalations < 0xFFFF) nDiagEscalations++;
+        nDiagSampled = 0;
+        nDiagBad = 0;
+    } else if (nDiagSampled >= DIAG_WINDOW) {
+        nDiagSampled = 0;
+        nDiagBad = 0;
+    }
+}
+
 void makeEvent() {
+    PROBE_BEGIN(PROBE_MAKE_EVENT);
 
     // Stop acquiring TOF hits until the trigger is re-enabled.
     // This will terminate the TD chains and disable the TOF DMA channels.
@@ -2757,6 +3401,7 @@ void makeEvent() {
     // Search for nearly coincident TOF data. Note that each TOF chip channel operates asynchronously w.r.t. the
     // instrument trigger, so we have to correlate the two channels with each other and with the event
     // by looking at the course timing information.
+    PROBE_BEGIN(PROBE_TOF_MATCH);
     uint8 timeStamp8m1;
     if (timeStamp8 == 0) timeStamp8m1 = 199;
     else timeStamp8m1 = timeStamp8 - 1; 
@@ -2819,6 +3464,7 @@ void makeEvent() {
             }
         }
     }
+    PROBE_END(PROBE_TOF_MATCH);
     
     // Build the event by filling the output buffer according to the output format.
     // Pack the time and date information into a 4-byte unsigned integer
@@ -2877,6 +3523,7 @@ void makeEvent() {
     dataOut[37] = tkrData.cmdCount;
     lastTkrCmdCount = tkrData.cmdCount;
     dataOut[38] = (tkrData.trgPattern & 0xC0) | (evtStatus & 0x37);
+    nDataReady = 39;
     if (debugTOF) {  // Extra TOF information for debugging
         dataOut[39] = nI;   // Number of TOF readouts since the last trigger
         dataOut[40] = nJ; 
@@ -2888,12 +3535,20 @@ void makeEvent() {
         dataOut[46] = byte16(aCLK,1);
         dataOut[47] = byte16(bCLK,0);
         dataOut[48] = byte16(bCLK,1);
-        dataOut[49] = tkrData.nTkrBoards;
-        nDataReady = 50;
-    } else {
-        dataOut[39] = tkrData.nTkrBoards;
-        nDataReady = 40;
+        nDataReady = 49;
     }
+    if (deadTimeField) {  // Microseconds from the re-arm of the trigger to this GO (24 bits), and GO1 count in that time
+        uint32 usec = (goCycles - rearmCycles)/BCLK__BUS_CLK__MHZ;
+        if (timeStamp - rearmTime > 3200 || usec > 0xFFFFFF) usec = 0xFFFFFF;   // Past 16 s, or the cycle counter wrapped
+        uint32 nGO1 = cntGO1save - rearmGO1;
+        dataOut[38] |= 0x08;
+        dataOut[nDataReady++] = byte32(usec, 1);
+        dataOut[nDataReady++] = byte32(usec, 2);
+        dataOut[nDataReady++] = byte32(usec, 3);
+        dataOut[nDataReady++] = (nGO1 > 255) ? 255 : (uint8)nGO1;
+    }
+    uint8 nBrdsPtr = nDataReady;
+    dataOut[nDataReady++] = tkrData.nTkrBoards;
     // Calculate the rate of TOF interrupts since the previous event
     //uint32 deltaTime;
     //if (timeStamp > timeLastEvent) deltaTime = timeStamp - timeLastEvent;
@@ -2915,11 +3570,14 @@ void makeEvent() {
     nTOFBavgH += nStopB;
     if (nStopA > nTOFAmaxH) nTOFAmaxH = nStopA;
     if (nStopB > nTOFBmaxH) nTOFBmaxH = nStopB;
-    if (doDiagnostics) {  // Check whether the hitslist CRCs match what the TKR calculated.
+    bool diagEvt = diagnoseThisEvent();
+    bool diagBad = false;
+    if (diagEvt) {  // Check whether the hitslist CRCs match what the TKR calculated.
         for (int brd=0; brd<tkrData.nTkrBoards; ++brd) {
             if (!checkCRC(tkrData.boardHits[brd].nBytes, tkrData.boardHits[brd].hitList)) {
                     addErrorOnce(ERR_BAD_CRC, brd);
                     if (nBadCRC < 255) nBadCRC++;
+                    diagBad = true;
                 }
         }
     }
@@ -2937,11 +3595,7 @@ void makeEvent() {
                 dataOut[nDataReady++] = 0x30;    // 2 more CRC bits, set to 0, followed by 11, followed by 0 to byte boundary
                 continue;
             }
-            if (debugTOF) {        // For a truncated event, enter the number of boards that did read out.
-                dataOut[49] = brd;
-            } else {
-                dataOut[39] = brd;
-            }
+            dataOut[nBrdsPtr] = brd;   // For a truncated event, enter the number of boards that did read out.
             addErrorOnce(ERR_EVT_TOO_BIG, dataOut[6]);
             if (nEvtTooBig < 255) nEvtTooBig++;
             break;  // We're really out of space. The event will be truncated.
@@ -2968,7 +3622,7 @@ void makeEvent() {
         } 
         uint8 nChips = (tkrData.boardHits[brd].hitList[3])>>4;
         nChipsHit[brd] += nChips;  // Adding the number of chips with hits
-        if (nChips > 0 && doDiagnostics) {
+        if (nChips > 0 && diagEvt) {
             uint8* words = (uint8*) malloc(2*tkrData.boardHits[brd].nBytes);
             if (words == NULL) {
                 addErrorOnce(ERR_HEAP_NO_MEMORY, brd);
@@ -3004,12 +3658,14 @@ void makeEvent() {
                     if (idx > nWords-1) {
                         addError(ERR_TKR_LIST_OVERFLOW, chip, brd);
                         if (nTkrOverFlow < 255) nTkrOverFlow++;
+                        diagBad = true;
                         break;
                     }
                     uint8 nClust = words[idx++] & 0x1F;
                     if (nClust > 10) {
                         addError(ERR_TKR_TOO_MANY_CLUST, nClust, chip);
                         if (nBigClust < 255) nBigClust++;
+                        diagBad = true;
                         break;
                     }
                     uint8 chipErr = (words[idx] & 0x20)>>5;           
@@ -3028,6 +3684,7 @@ void makeEvent() {
                         if (idx > nWords-1) {
                             addErrorOnce(ERR_TKR_LIST_OVERFLOW, brd);
                             if (nTkrOverFlow < 255) nTkrOverFlow++;
+                            diagBad = true;
                             break;
                         }
                         int nStripsM1 = words[idx++];
@@ -3035,6 +3692,7 @@ void makeEvent() {
                         if (strip0 + nStripsM1 > 63) {
                             addErrorOnce(ERR_TKR_BAD_CLUST, nStripsM1);
                             if (nBadClust < 255) nBadClust++;
+                            diagBad = true;
                         }
                     }
                 }
@@ -3044,6 +3702,7 @@ void makeEvent() {
         tkrData.boardHits[brd].nBytes = 0;  // Zero this out to facilitate debugging
     }
     tkrData.nTkrBoards = 0;  // Zero this out to facilitate debugging
+    if (diagEvt) diagnosticsUpdate(diagBad);
     
     // Four byte trailer, spells FINI in ASCII
     dataOut[nDataReady++] = 0x46;
@@ -3072,6 +3731,7 @@ void makeEvent() {
     //nTOFintA = 0;
     //nTOFintB = 0;
     if (Pin_Busy_Read()) cntBusy++;        // To track the BUSY fraction
+    PROBE_END(PROBE_MAKE_EVENT);
 } // end of subroutine makeEvent
 
 void tkrRateMonitor() {
@@ -3122,32 +3782,21 @@ void tkrRateMonitor() {
     }
 } // end of subroutine trkRateMonitor
 
-// Monitoring of PMT singles rates
+// Monitoring of PMT singles rates, over the last pmtDeltaT seconds of the snapshot ring, updated once per snapshot.
+// Until the ring is that long, the window covers whatever is there.
 void pmtRateMonitor() {
-    uint32 diff;
-    if (waitingPmtRateCnt) {
-        diff = timeElapsed(pmtClkCntStart);
-        if (diff >= 200*pmtDeltaT) {  // Allow some time to get good precision
-            waitingPmtRateCnt = false;
-            int InterruptState = CyEnterCriticalSection();
-            pmtMonitorTime = (uint16)timeElapsed(pmtClkCntStart);
-            for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
-                pmtMonitorSums[cntr] = (uint16)(getChCount(cntr) - pmtCntInit[cntr]);
-            }
-            pmtClkAtStart = time();
-            CyExitCriticalSection(InterruptState);
-        }
-    } else {
-        diff = timeElapsed(pmtClkAtStart);
-        if (diff >= 200*pmtMonitorInterval) {
-            int InterruptState = CyEnterCriticalSection();
-            pmtClkCntStart = time();
-            waitingPmtRateCnt = true;
-            for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
-                pmtCntInit[cntr] = getChCount(cntr);
-            }
-            CyExitCriticalSection(InterruptState);
-        }
+    if (pmtRingPtr == pmtLastRingPtr) return;
+    pmtLastRingPtr = pmtRingPtr;
+    if (pmtRingCount < 2) return;
+    uint8 nSec = pmtDeltaT;
+    if (nSec >= pmtRingCount) nSec = pmtRingCount - 1;
+    if (nSec == 0) nSec = 1;
+    uint32 sums[MAX_PMT_CHANNELS];
+    uint32 dt = pmtWindow(nSec, 0, sums);
+    if (dt == 0) return;
+    pmtMonitorTime = (uint16)dt;
+    for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
+        pmtMonitorSums[cntr] = (sums[cntr] > 0xFFFF) ? 0xFFFF : (uint16)sums[cntr];
     }
 } // end of subroutine pmtRateMonitor
 
@@ -3176,6 +3825,8 @@ void sendAllData(uint8 dataPacket[], uint8 command, uint8 cmdData[]) {
                     } else {
                         if (dataOut[0] == 0x45 && dataOut[1] == 0x52 && dataOut[2] == 0x52) {
                             dataPacket[4] = 0xDA;    // Error record
+                        } else if (dataOut[0] == 0x45 && dataOut[1] == 0x52 && dataOut[2] == 0x53) {
+                            dataPacket[4] = 0xD9;    // Error stream
                         } else {
                             dataPacket[4] = 0x3F;    // ?
                         }
@@ -3197,7 +3848,7 @@ void sendAllData(uint8 dataPacket[], uint8 command, uint8 cmdData[]) {
         // 0x00
         // 0xFF
         // data record length
-        // command echo or 0xDB or 0xDD or 0xDE or 0xDF
+        // command echo or 0xD9 or 0xDA or 0xDB or 0xDD or 0xDE or 0xDF
         // number command data bytes
         if (outputMode != USBUART_OUTPUT) set_SPI_SSN(SSN_Main, false);
         if (outputMode == USBUART_OUTPUT) {  // Output the header
@@ -3308,16 +3959,16 @@ void readEEprom() {
 
 // Check whether a byte represents a valid command and return the number of expected data bytes
 // Bits 6 and 7 of the number of data bytes are set if the number is a lower limit (variable data)
-#define NUM_COMMANDS 70
+#define NUM_COMMANDS 74
 uint8 isAcommand(uint8 cmd) {
     static uint8 validCommands[NUM_COMMANDS] = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x10, 0x54, 0x55, 0x41, 0x42, 0x43,
         0x7A, 0x0C, 0x0D, 0x0E, 0x20, 0x21, 0x22, 0x23, 0x24, 0x26, 0x27, 0x30, 0x31, 0x32, 0x3F, 0x34, 0x35, 0x36, 0x37, 0x38,
         0x39, 0x3A, 0x3B, 0x44, 0x50, 0x3C, 0x3D, 0x3E, 0x33, 0x40, 0x45, 0x46, 0x47, 0x48, 0x49, 0x53, 0x4B, 0x4C, 0x4D,
-        0x4E, 0x4F, 0x51, 0x56, 0x5C, 0x5E, 0x5F, 0x5D, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x60, 0x61, 0x62, 0x63, 0x64};
+        0x4E, 0x4F, 0x51, 0x56, 0x5C, 0x5E, 0x5F, 0x5D, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x60, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68};
     static uint8 numData[NUM_COMMANDS] = {0x32, 0x11, 0, 0x33, 0x11, 0x11, 0, 0xE3, 0x33, 0x33, 0xF5, 0x33, 0x11,
         0, 0, 0x22, 0, 0x11, 0x11, 0, 0x11, 0x22, 0x11, 0x22, 0x11, 0, 0, 0, 0, 0x11, 0x22, 0x11, 0,
         0x22, 0x21, 0x11, 0, 0, 0x44, 0, 0x11, 0x11, 0, 0xAA, 0, 0, 0x11, 0, 0, 0x11, 0x11, 0x11,
-        0x11, 0x11, 0, 0x11, 0x11, 0, 0, 0, 0x22, 0, 0x88, 0, 0x81, 0x11, 0, 0x11, 0x11, 0};
+        0x41, 0x11, 0, 0x11, 0x11, 0, 0, 0, 0x22, 0, 0x88, 0, 0x81, 0x11, 0, 0x11, 0x11, 0, 0x11, 0x10, 0x21, 0x10};
     for (int i=0; i<NUM_COMMANDS; ++i) {
         if (validCommands[i] == cmd) {
             return numData[i];
@@ -3327,6 +3978,59 @@ uint8 isAcommand(uint8 cmd) {
     return 0xFF;
 }
 
+// Start executing a complete bulk command frame, if it is valid and addressed to this PSOC
+void bulkStart(struct BulkFrame *frame, uint8 address) {
+    uint16 len = frame->len;
+    uint16 crc = ((uint16)frame->buf[len+2] << 8) | frame->buf[len+3];
+    if (crc16(frame->buf, len+2) != crc) {
+        addError(ERR_BULK_CRC, byte16(crc,0), byte16(crc,1));
+        if (nBadCmd<0xFF) nBadCmd++;
+        frame->ready = false;
+        return;
+    }
+    cmdCountGLB++;
+    if (frame->buf[2] != address) {
+        frame->ready = false;
+        return;
+    }
+    bulkCmd = frame;
+    bulkPtr = 3;
+}
+
+// Set up the next command from the bulk frame for execution, in the same way as a completed ASCII command
+void bulkNextCommand() {
+    uint16 end = bulkCmd->len + 2;
+    if (bulkPtr + 2 > end) {       // Done with this frame
+        bulkCmd->ready = false;
+        bulkCmd = NULL;
+        return;
+    }
+    uint8 cmd = bulkCmd->buf[bulkPtr];
+    uint8 nData = bulkCmd->buf[bulkPtr+1];
+    if (nData > MAX_CMD_DATA || bulkPtr + 2 + nData > end) {
+        addError(ERR_BULK_FORMAT, cmd, nData);
+        if (nBadCmd<0xFF) nBadCmd++;
+        bulkCmd->ready = false;
+        bulkCmd = NULL;
+        return;
+    }
+    uint8 stuff = isAcommand(cmd);
+    if (nData < (stuff & 0x0F) || nData > ((stuff & 0xF0)>>4)) {
+        addError(ERR_WRONG_NUM_BYTES, cmd, nData);
+        bulkPtr += 2 + nData;
+        return;
+    }
+    command = cmd;
+    nDataBytes = nData;
+    for (int i=0; i<nData; ++i) cmdData[i] = bulkCmd->buf[bulkPtr+2+i];
+    bulkPtr += 2 + nData;
+    lastCommand = (uint16)cmd << 8;
+    commandCount++;
+    cmdCount++;
+    awaitingCommand = false;
+    cmdInputComplete = true;
+}
+
 // Put together some counter information for end-of-run records and command 0x50
 uint8 loadCntResults(uint8 *toOutput) {
     toOutput[0] = byte16(cmdCountGLB, 0); 
@@ -3446,6 +4150,7 @@ void interpretCommand(uint8 tofConfig[]) {
                 }
                 break;
             case '\x03':         // Read back all of the accumulated error codes
+                drainErrorRings();
                 if (nErrors == 0) {
                     nDataReady = 3;
                     dataOut[0] = 0x00;
@@ -3453,13 +4158,24 @@ void interpretCommand(uint8 tofConfig[]) {
                     dataOut[2] = 0xFF;
                     break;
                 }
-                nDataReady = nErrors*3;
-                for (int i=0; i<nErrors; ++i) {
-                    dataOut[i*3] = errors[i].errorCode;
-                    dataOut[i*3 + 1] = errors[i].value0;
-                    dataOut[i*3 + 2] = errors[i].value1;                                    
+                // Codes that don't fit in one packet are left for the next 0x03 command
+                nDataReady = 0;
+                for (uint8 code=1; code<=MAX_ERR_CODE; ++code) {
+                    struct Error *err = &errors[code];
+                    if (err->count == 0) continue;
+                    if (nDataReady + ERR_RECORD_LEN > MAX_DATA_OUT) break;
+                    dataOut[nDataReady++] = code;
+                    dataOut[nDataReady++] = byte16(err->count, 0);
+                    dataOut[nDataReady++] = byte16(err->count, 1);
+                    dataOut[nDataReady++] = err->firstVal0;
+                    dataOut[nDataReady++] = err->firstVal1;
+                    for (int j=0; j<4; ++j) dataOut[nDataReady++] = byte32(err->firstEvt, j);
+                    dataOut[nDataReady++] = err->lastVal0;
+                    dataOut[nDataReady++] = err->lastVal1;
+                    for (int j=0; j<4; ++j) dataOut[nDataReady++] = byte32(err->lastEvt, j);
+                    err->count = 0;
+                    nErrors--;
                 }
-                nErrors = 0;
                 break;
             case '\x04':        // Load the TOF DACs
                 if (cmdData[0] == 1) {
@@ -3707,18 +4423,22 @@ void interpretCommand(uint8 tofConfig[]) {
                 break;
             case '\x20':        // Read bus voltages (positive only)
                 readI2Creg(2, cmdData[0], INA226_BusV_Reg, dataOut);
+                i2cFlush();
                 nDataReady = 2;
                 break;
             case '\x21':        // Read currents (Note: bit 15 is a sign bit, 2's complement)
                 readI2Creg(2, cmdData[0], INA226_ShuntV_Reg, dataOut);
+                i2cFlush();
                 nDataReady = 2;
                 break;
             case '\x22':        // Read the board temperature
                 readI2Creg(2, I2C_Address_TMP100, TMP100_Temp_Reg, dataOut);
+                i2cFlush();
                 nDataReady = 2;
                 break;
             case '\x23':        // Read an RTC register
                 readI2Creg(1, I2C_Address_RTC, cmdData[0], dataOut);
+                i2cFlush();
                 nDataReady = 1;
                 break;
             case '\x24':        // Write an RTC register
@@ -3726,6 +4446,7 @@ void interpretCommand(uint8 tofConfig[]) {
                 break;
             case '\x26':       // Read a barometer register
                 readI2Creg(1, I2C_Address_Barometer, cmdData[0], dataOut);
+                i2cFlush();
                 nDataReady = 1;
                 break;
             case '\x27':       // Load a barometer register
@@ -4023,16 +4744,12 @@ void interpretCommand(uint8 tofConfig[]) {
                 nTOF_B_max = 0;
                 //nTOFintA = 0;
                 //nTOFintB = 0;
-                pmtClkCntStart = time();
-                for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
-                    pmtCntInit[cntr] = getChCount(cntr);
-                }
-                waitingPmtRateCnt = true;
                 runNumber = cmdData[0];
                 runNumber = (runNumber<<8) | cmdData[1];
                 readTracker = (cmdData[2] == 1);
                 if (numTkrBrds == 0) readTracker = false;
-                debugTOF = (cmdData[3] == 1);
+                debugTOF = (cmdData[3] & 0x01);
+                deadTimeField = (cmdData[3] & 0x02);
                 cntGO = 0;
                 lastGOcnt = 0;
                 lastGO1cnt = 0;
@@ -4043,6 +4760,10 @@ void interpretCommand(uint8 tofConfig[]) {
                 lastNumTkrResets = 0;
                 nASICerrorEvts = 0;
                 nASICparityErr = 0;
+                nDiagEscalations = 0;
+                diagEscalated = false;
+                nDiagSampled = 0;
+                nDiagBad = 0;
                 cntLive = 0;
                 cntTrials = 0;
                 cntTrialsMax = 0;
@@ -4270,12 +4991,17 @@ void interpretCommand(uint8 tofConfig[]) {
                     ShiftReg_B_EnableInt();
                 }
                 break;
-            case '\x4E': // Select whether to check the Tracker CRC
-                if (cmdData[0] == 1) {
-                    doDiagnostics = true;
-                } else {
-                    doDiagnostics = false;
+            case '\x4E': // Select whether to check the Tracker CRC: 0=off, 1=every event, 2=sampled
+                doDiagnostics = (cmdData[0] == 1);
+                diagSampled = (cmdData[0] == 2);
+                if (diagSampled && nDataBytes > 1) {
+                    if (cmdData[1] > 0) diagSamplePeriod = cmdData[1];
+                    if (nDataBytes > 2) diagThreshold = cmdData[2];
+                    if (nDataBytes > 3) diagEscalateTime = cmdData[3];
                 }
+                diagEscalated = false;
+                nDiagSampled = 0;
+                nDiagBad = 0;
                 break;
             case '\x4F': // Set the tracker trigger delay for PMT triggers
                 Count7_Trg_WritePeriod(cmdData[0]);
@@ -4324,7 +5050,7 @@ void interpretCommand(uint8 tofConfig[]) {
             case '\x5D': // Stop sending tracker housekeeping packets
                 doTkrHouseKeeping = false;
                 tkrHouseKeepingDue = false;
-                if (!doHouseKeeping) isr_1Hz_Disable();
+                if (!doHouseKeeping && errStreamPeriod == 0) isr_1Hz_Disable();
                 break;
             case '\x57': // Start monitoring processes to create the housekeeping data packets
                 houseKeepPeriod = cmdData[0];
@@ -4332,15 +5058,8 @@ void interpretCommand(uint8 tofConfig[]) {
                 houseKeepingDue = false;
                 cntSeconds = 0;
                 pmtDeltaT = houseKeepPeriod;         // Number of seconds over which to accumulate PMT counts
-                pmtMonitorInterval = 2*pmtDeltaT;    // Interval in seconds between successive measurements
-                InterruptState = CyEnterCriticalSection();
-                pmtClkCntStart = time();
-                for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
-                    pmtCntInit[cntr] = getChCount(cntr);
-                }
-                CyExitCriticalSection(InterruptState);
+                pmtLastRingPtr = pmtRingPtr;
                 monitorPmtRates = true;
-                waitingPmtRateCnt = true;
                 if (cmdData[1] > 0 && numTkrBrds > 0) {  // This allows tracker rate monitoring to be disabled, in case it is problematic
                     tkrMonitorInterval = tkrRatesMult*houseKeepPeriod;  // Number of seconds between TKR monitoring events
                     if (tkrMonitorInterval < 2) tkrMonitorInterval = 2;
@@ -4358,7 +5077,7 @@ void interpretCommand(uint8 tofConfig[]) {
                 houseKeepingDue = false;
                 monitorPmtRates = false;
                 monitorTkrRates = false;
-                if (!doTkrHouseKeeping) isr_1Hz_Disable();
+                if (!doTkrHouseKeeping && errStreamPeriod == 0) isr_1Hz_Disable();
                 break;
             case '\x59': // Reset the Tracker layer configuration
                 boardMAP[0] = cmdData[0];
@@ -4418,16 +5137,129 @@ void interpretCommand(uint8 tofConfig[]) {
                 nDataReady = 1;
                 dataOut[0] = getTkrLogic();
                 break;
+            case '\x67': // Get PMT counts over consecutive windows of the 1-second snapshot ring, latest first
+                {
+                    uint8 nSec = cmdData[0];
+                    uint8 nWin = (nDataBytes > 1) ? cmdData[1] : 1;
+                    if (nWin > PMT_MAX_WINDOWS) nWin = PMT_MAX_WINDOWS;
+                    dataOut[0] = nSec;
+                    uint8 n = 0;
+                    for (uint8 w=0; w<nWin; ++w) {
+                        uint32 sums[MAX_PMT_CHANNELS];
+                        uint32 dt = pmtWindow(nSec, (uint16)w*nSec, sums);
+                        if (dt == 0) break;
+                        uint8 *rec = &dataOut[2 + w*PMT_WINDOW_LEN];
+                        rec[0] = byte16(dt, 0);
+                        rec[1] = byte16(dt, 1);
+                        for (int cntr=0; cntr<MAX_PMT_CHANNELS; ++cntr) {
+                            rec[2+3*cntr] = byte32(sums[cntr], 1);
+                            rec[3+3*cntr] = byte32(sums[cntr], 2);
+                            rec[4+3*cntr] = byte32(sums[cntr], 3);
+                        }
+                        n++;
+                    }
+                    dataOut[1] = n;
+                    nDataReady = 2 + n*PMT_WINDOW_LEN;
+                }
+                break;
+            case '\x66': // Get the I2C transaction statistics (times in microseconds)
+                {
+                    nDataReady = 12;
+                    dataOut[0] = byte16(i2cNumTxn, 0);
+                    dataOut[1] = byte16(i2cNumTxn, 1);
+                    dataOut[2] = byte16(i2cNumFail, 0);
+                    dataOut[3] = byte16(i2cNumFail, 1);
+                    uint32 avgTime = (i2cNumTxn > 0) ? i2cSumTime/i2cNumTxn : 0;
+                    for (int j=0; j<4; ++j) dataOut[4+j] = byte32(avgTime, j);
+                    for (int j=0; j<4; ++j) dataOut[8+j] = byte32(i2cMaxTime, j);
+                    if (nDataBytes > 0 && cmdData[0] == 1) {     // Reset the statistics
+                        i2cNumTxn = 0;
+                        i2cNumFail = 0;
+                        i2cSumTime = 0;
+                        i2cMaxTime = 0;
+                    }
+                }
+                break;
+            case '\x68': // Get the deferred command statistics (latencies in milliseconds)
+                {
+                    nDataReady = 11;
+                    dataOut[0] = byte16(nDeferredRun, 0);
+                    dataOut[1] = byte16(nDeferredRun, 1);
+                    uint32 avgLatency = (nDeferredRun > 0) ? 5*deferredSumLatency/nDeferredRun : 0;
+                    for (int j=0; j<4; ++j) dataOut[2+j] = byte32(avgLatency, j);
+                    for (int j=0; j<4; ++j) dataOut[6+j] = byte32(5*deferredMaxLatency, j);
+                    dataOut[10] = ACTIVELEN(deferredReadPtr, deferredWritePtr, MX_DEFERRED);
+                    if (nDataBytes > 0 && cmdData[0] == 1) {     // Reset the statistics
+                        nDeferredRun = 0;
+                        deferredSumLatency = 0;
+                        deferredMaxLatency = 0;
+                    }
+                }
+                break;
+            case '\x65': // Set the number of seconds between error stream packets during runs (0 = off)
+                errStreamPeriod = cmdData[0];
+                nErrStream = 0;
+                nErrStreamLost = 0;
+                errStreamDue = false;
+                if (errStreamPeriod > 0) isr_1Hz_Enable();    // The stream is timed by isr1Hz, as housekeeping is
+                else if (!doHouseKeeping && !doTkrHouseKeeping) isr_1Hz_Disable();
+                break;
             case '\x7A': // NOOP
                 nNOOP++;
                 break;
         } // End of command switch
+    } else if (command != 0x3C && WRAPINC(deferredWritePtr, MX_DEFERRED) != deferredReadPtr) {
+        // Queue the command for execution between events and acknowledge it with "DF" and the queue depth
+        struct DeferredCmd *dc = &deferredCmds[deferredWritePtr];
+        dc->command = command;
+        dc->nData = nDataBytes;
+        for (int i=0; i<nDataBytes; ++i) dc->data[i] = cmdData[i];
+        dc->tQueued = time();
+        deferredWritePtr = WRAPINC(deferredWritePtr, MX_DEFERRED);
+        nDataReady = 3;
+        dataOut[0] = 0x44;
+        dataOut[1] = 0x46;
+        dataOut[2] = ACTIVELEN(deferredReadPtr, deferredWritePtr, MX_DEFERRED);
     } else { // Log an error if the user is sending spurious commands while the trigger is enabled
         addErrorOnce(ERR_CMD_IGNORE, command);
         nIgnoredCmd++;
     }
 } // end of interpretCommand subroutine
 
+// Execute the oldest deferred command, at a limited rate. During a run the trigger is turned off around the
+// command, in between events, and then turned back on.
+void runDeferredCommand(uint8 tofConfig[]) {
+    if (deferredReadPtr == deferredWritePtr) return;
+    if (timeElapsed(lastDeferredTime) < DEFER_INTERVAL) return;
+    bool inRun = false;
+    int InterruptState = CyEnterCriticalSection();
+    if (!triggered && !eventDataReady && isTriggerEnabled()) {
+        triggerEnable(false);
+        inRun = true;
+    }
+    CyExitCriticalSection(InterruptState);
+    if (!inRun && (runNumber != 0 || endingRun)) return;  // Wait for the end of the event readout
+    if (inRun) sendSimpleTrackerCmd(0x00, 0x66);   // Most deferred commands talk to the Tracker
+    struct DeferredCmd *dc = &deferredCmds[deferredReadPtr];
+    command = dc->command;
+    nDataBytes = dc->nData;
+    for (int i=0; i<nDataBytes; ++i) cmdData[i] = dc->data[i];
+    uint32 latency = timeElapsed(dc->tQueued);
+    deferredReadPtr = WRAPINC(deferredReadPtr, MX_DEFERRED);
+    awaitingCommand = false;
+    cmdInputComplete = true;
+    interpretCommand(tofConfig);
+    nDataReady = 0;     // The host already has the "DF" ack, and a reply now would land in the middle of the run data
+    if (inRun && runNumber != 0 && !endingRun) {
+        sendSimpleTrackerCmd(0x00, 0x65);
+        triggerEnable(true);
+    }
+    lastDeferredTime = time();
+    nDeferredRun++;
+    deferredSumLatency += latency;
+    if (latency > deferredMaxLatency) deferredMaxLatency = latency;
+}
+
 // Set up the Time-of-Flight DMA (to reduce the number of CPU interrupts if the TOF channels are noisy)
 void tofDMAsetup() {
     TOF_DMA = true;
@@ -4514,6 +5346,10 @@ int main(void)
     
     outputMode = SPI_OUTPUT;  // Default mode for sending out data  
     doDiagnostics = false;
+    diagSampled = false;
+    diagEscalated = false;
+    nDiagSampled = 0;
+    nDiagBad = 0;
     triggered = false;
     tkrData.nTkrBoards = 0;
     tofA.ptr = 0;
@@ -4536,11 +5372,23 @@ int main(void)
     doHouseKeeping = false;
     readTracker = true;
     debugTOF = false;
+    deadTimeField = false;
     lastTkrCmdCount = 0;
     nIgnoredCmd = 0;
+    deferredReadPtr = 0;
+    deferredWritePtr = 0;
+    lastDeferredTime = 0;
+    nDeferredRun = 0;
+    deferredSumLatency = 0;
+    deferredMaxLatency = 0;
     
-    fifoWritePtr = 0;
-    fifoReadPtr = 0;
+    cmdWinPtr = 0;
+    cmdWinCount = 0;
+    lastCmdByte = 0;
+    bulkUART.state = BULK_IDLE;
+    bulkUART.ready = false;
+    bulkUSB.state = BULK_IDLE;
+    bulkUSB.ready = false;
     
     runNumber = 0;
     timeStamp = time();
@@ -4580,6 +5428,7 @@ int main(void)
     TKR_timeFirstByte = 2 * TKR_timePerByte;
     
     uint8 *buffer;        // Buffer for incoming commands
+    uint8 cmdCopy[CMD_LENGTH];   // Command taken from the UART command buffer
     uint8 USBUART_buf[BUFFER_LEN];
     
     pmtMonitorTime = 0;
@@ -4633,6 +5482,12 @@ int main(void)
     
     CyGlobalIntEnable; /* Enable global interrupts. */
 
+    // Start the cycle counter used for the microsecond error time stamps
+    DEMCR |= 0x01000000u;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= 1u;
+    cycAtSecond = 0;
+
     /* Initialize interrupts */
     isr_timer_StartEx(intTimer);
     isr_timer_Disable();
@@ -4883,7 +5738,6 @@ int main(void)
     waitingTkrRateCnt = false;
     
     monitorPmtRates = false;
-    waitingPmtRateCnt = false;
     pmtDeltaT = 10;
     
     ADCsoftReset=true;
@@ -4897,7 +5751,10 @@ int main(void)
             /* Enumeration is done, enable OUT endpoint to receive data from Host */
             USBUART_CDC_Init();
         }
+        i2cPoll();
         if (awaitingCommand) {   // Don't do other stuff while command bytes are coming in
+            drainErrorRings();
+
             // Tracker rate monitoring
             if (nDataReady == 0 && monitorTkrRates && !endingRun) {
                 tkrRateMonitor();
@@ -4937,6 +5794,17 @@ int main(void)
                 }
             }
             
+            // Error stream during runs
+            if (nDataReady == 0 && errStreamDue) {
+                if (runNumber != 0 && !endingRun && (nErrStream > 0 || nErrStreamLost > 0)) makeErrorStream();
+                errStreamDue = false;
+            }
+            
+            // Refresh the sensor cache for housekeeping when there is nothing else to do
+            if (nDataReady == 0 && !triggered && !endingRun && !houseKeepingDue && !tkrHouseKeepingDue) {
+                sensorPoll();
+            }
+            
             // Tracker housekeeping. Note that nDataReady is checked here, because if a regular housekeeping packet
             // is going out now, then we need to wait for the next loop iteration to avoid overwriting it.
             if (nDataReady == 0) {
@@ -4968,7 +5836,8 @@ int main(void)
                 cmdInputComplete = false;
                 nDataBytes = 0;     
                 cmdReadPtr = cmdWritePtr;
-                fifoReadPtr = fifoWritePtr;
+                cmdWinCount = 0;
+                lastCmdByte = 0;
                 CyExitCriticalSection(InterruptState);
                 nCmdTimeOut++;
                 addError(ERR_CMD_TIMEOUT,command,dCnt);
@@ -4980,42 +5849,6 @@ int main(void)
             sendAllData(dataPacket, command, cmdData);
         }
             
-        // Parse the FIFO of commands from the Main PSOC, via UART. Identify commands
-        // from the <CR><LF> characters, and move complete commands into the command buffer.
-        // Get ALL of the complete commands now that are currently in the fifo buffer.
-        isr_UART_Disable();
-        int numBytes = ACTIVELEN(fifoReadPtr, fifoWritePtr, MX_FIFO);
-        isr_UART_Enable();
-        if (numBytes >= CMD_LENGTH) {  // Only move forward if there are enough bytes in the buffer for >= 1 command
-            int fifoWritePtrNow = fifoWritePtr;   // Save this, to allow bytes to continue to flow in via interrupt
-            int tmpRdPtr = (fifoReadPtr + CMD_LENGTH - 2) % MX_FIFO;  // Jump ahead to look for <CR><LF>
-            int lastByte = WRAPDEC(fifoWritePtrNow, MX_FIFO);
-            while (true) {
-                if (cmdFIFO[tmpRdPtr] == CR && cmdFIFO[WRAPINC(tmpRdPtr, MX_FIFO)] == LF) {
-                    fifoReadPtr = (tmpRdPtr + 2 - CMD_LENGTH + MX_FIFO) % MX_FIFO;
-                    for (int j=0; j<CMD_LENGTH; ++j) {
-                        cmd_buffer[cmdWritePtr].buf[j] = cmdFIFO[fifoReadPtr];
-                        fifoReadPtr = WRAPINC(fifoReadPtr, MX_FIFO);
-                    }
-                    cmd_buffer[cmdWritePtr].nBytes = CMD_LENGTH;
-                    if (WRAPINC(cmdWritePtr, MX_CMDS) == cmdReadPtr) {
-                        addError(ERR_CMD_BUF_OVERFLOW, byte32(clkCnt,0), byte32(clkCnt,1)); // This will almost certainly make a mess if it happens!
-                    } else {
-                        cmdWritePtr = WRAPINC(cmdWritePtr, MX_CMDS);  
-                        cmd_buffer[cmdWritePtr].nBytes = 0;
-                    }
-                    isr_UART_Disable();
-                    numBytes = ACTIVELEN(fifoReadPtr, fifoWritePtrNow, MX_FIFO);
-                    isr_UART_Enable();
-                    if (numBytes < CMD_LENGTH) break;
-                    tmpRdPtr = (fifoReadPtr + CMD_LENGTH - 2) % MX_FIFO; // Jump ahead to look for the next <CR><LF>
-                } else {
-                    tmpRdPtr = WRAPINC(tmpRdPtr, MX_FIFO);  // <CR><LF> wasn't where expected. Keep looking. . .
-                    if (tmpRdPtr == lastByte) break;
-                }
-            }
-        } 
-        
         // Get a 9-byte command input from the UART or USB-UART
         // The two should not be used at the same time (no reason for that, anyway)
         int count = 0;
@@ -5024,16 +5857,25 @@ int main(void)
                 buffer = USBUART_buf;
                 if (USBUART_DataIsReady()) {
                     count = USBUART_GetAll(buffer);
+                    if (count > 0 && (buffer[0] == BULK_SYNC0 || bulkUSB.state != BULK_IDLE)) {  // Binary bulk command frame
+                        int nASCII = 0;    // Bytes that are not part of the frame go on to the ASCII parser
+                        for (int i=0; i<count; ++i) {
+                            if (!bulkRxByte(&bulkUSB, buffer[i])) buffer[nASCII++] = buffer[i];
+                        }
+                        count = nASCII;
+                    }
                 }
             }
             if (count == 0 && cmdReadPtr != cmdWritePtr) { // Looking for a command from UART 
                 count = cmd_buffer[cmdReadPtr].nBytes;
-                buffer = cmd_buffer[cmdReadPtr].buf;
+                for (int j=0; j<count; ++j) cmdCopy[j] = cmd_buffer[cmdReadPtr].buf[j];  // The ISR may reuse the slot once released
+                buffer = cmdCopy;
                 cmd_buffer[cmdReadPtr].nBytes = 0;
                 cmdReadPtr = WRAPINC(cmdReadPtr, MX_CMDS);
             }
         }
         if (count == CMD_LENGTH) {  // We got a complete command string in triplicate. Accept it if 2 out of 3 agree.
+            PROBE_BEGIN(PROBE_CMD_FRAME);
             bool badCMD = false;
             for (int i=0; i<9; ++i) {   // Check that all 3 command copies are identical
                 if (buffer[i] != buffer[i+9] || buffer[i] != buffer[i+18]) {
@@ -5151,12 +5993,43 @@ int main(void)
                             awaitingCommand = true;  // Abort a command with a bad data byte or missing data bytes
                             nDataBytes = 0;
                         } else {
+                            PROBE_BEGIN(PROBE_CMD_EXEC);
                             interpretCommand(tofConfig);
+                            PROBE_END(PROBE_CMD_EXEC);
                         }
                     }
                 }
             } // End of command polling  
             if (badCMD && nBadCmd<0xFF) nBadCmd++;
+            PROBE_END(PROBE_CMD_FRAME);
+        }
+        
+        // Drop partial bulk frames that have stalled, rather than wait for the next byte to notice
+        bulkCheckTimeout(&bulkUSB);
+        if (bulkUART.state != BULK_IDLE) {
+            int InterruptState = CyEnterCriticalSection();
+            bulkCheckTimeout(&bulkUART);
+            CyExitCriticalSection(InterruptState);
+        }
+        
+        // Execute commands from binary bulk frames, one per pass, when no ASCII command is in progress
+        if (count == 0 && nDataReady == 0 && awaitingCommand) {
+            if (bulkCmd == NULL) {
+                if (bulkUART.ready) bulkStart(&bulkUART, eventPSOCaddress);
+                else if (bulkUSB.ready) bulkStart(&bulkUSB, eventPSOCaddress);
+            }
+            if (bulkCmd != NULL) {
+                bulkNextCommand();
+                if (cmdInputComplete) {
+                    interpretCommand(tofConfig);
+                    nDataReady = 0;    // The host reads no replies to a bulk frame; errors go to the error table
+                }
+            }
+        }
+        
+        // Commands deferred during a run
+        if (count == 0 && nDataReady == 0 && awaitingCommand) {
+            runDeferredCommand(tofConfig);
         }
         
         // Send out Tracker housekeeping data immediately after receiving it from the Tracker
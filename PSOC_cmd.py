@@ -5,6 +5,11 @@ from bitstring import BitArray
 import math
 import numpy as np
 import random
+from frameReader import FrameReader
+from hitDecoder import parseHitList, decodeHitList, printHitList
+from runFile import RunWriter
+from runIndex import RunIndex
+from acqPipeline import AcqPipeline
 
 # Address = 8 for the event PSOC, 10 for the main PSOC
 addrMain = 10
@@ -15,8 +20,9 @@ DATAMASK = 2
 TRIGMASK = 3
 
 def openCOM(portName):
-  global ser
+  global ser, frames
   ser = serial.Serial(portName, 115200, timeout=.2)
+  frames = FrameReader(ser)
   
 def closeCOM():
   ser.close()
@@ -91,6 +97,37 @@ def mkDataByte(dataByte, address, byteID):
    end2 = LF.to_bytes(1,'big')   # LF
    return cmd1 + cmd1 + cmd1 + end1 + end2
 
+# CRC16-CCITT (polynomial 0x1021, initial value 0xFFFF), as used for the binary bulk command frames
+def crc16(data):
+   crc = 0xFFFF
+   for byte in data:
+       crc ^= byte << 8
+       for b in range(8):
+           if crc & 0x8000: crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+           else: crc = (crc << 1) & 0xFFFF
+   return crc
+
+# Assemble a binary bulk command frame from a list of commands, each given as (cmdCode, [data bytes])
+def mkBulkFrame(cmdList, address):
+   payload = bytearray([address])
+   for cmdCode, data in cmdList:
+       payload.append(cmdCode)
+       payload.append(len(data))
+       payload.extend(data)
+   if len(payload) > 256:
+       print("mkBulkFrame: payload of " + str(len(payload)) + " bytes is too long")
+       return None
+   frame = bytearray([len(payload) >> 8, len(payload) & 0xFF]) + payload
+   crc = crc16(frame)
+   return bytes([0xA5, 0x5A]) + bytes(frame) + bytes([crc >> 8, crc & 0xFF])
+
+# Send many commands in one binary frame. The Event PSOC sends no replies to the commands of a bulk frame, not even
+# those that return data when sent singly, so use it for configuration and read back with the single commands.
+def sendBulkCommands(cmdList, address):
+   frame = mkBulkFrame(cmdList, address)
+   if frame is None: return
+   ser.write(frame)
+
 def badCMD(FPGA):
     print("sending a bad command to the tracker board " + str(FPGA))
     address = addrEvnt
@@ -109,99 +146,64 @@ def badCMD(FPGA):
     
 
 def getData(address, debug = False): 
-    ret = b''
     if debug: print("Entering getData for PSOC address " + str(address))
-    success = False
-    while not success:
-        for i in range(360):  #Sometimes the read starts with blank bytes, so search for the header
-            ret = ser.read(1)
-            if debug: print("getData: i= " + str(i) + " ret = " + str(ret))
-            if ret == b'\xDC': break
-            if ret != b'':
-                print("getData: expected 'DC' but received " + str(ret))
-        if ret != b'\xDC':
+    while True:
+        frame = frames.readFrame(timeout = 360*ser.timeout)   #Sometimes the read starts with blank bytes, so search for the header
+        if frame is None:
             print("getData: failed to find the header 'DC'")
             if address > 0: readErrors(address)
             raise IOError("getData: failed to find the header 'DC'")
-            return
-
-        ret = ser.read(2)
-        if debug: print("getData: remainder of header = " + str(ret))
-        if ret != b'\x00\xFF':
-            print("getData: invalid header returned: b'\\xDC' " + str(ret))
-            return
-        ret = ser.read(1)
-        dataLength = bytes2int(ret)
-        command = ser.read(1)
-        if command == b'\xDE' or command == b'\xDF' or command == b'\xDB' or command == b'\xDD' or command == b'\xDA' or command == b'\xde' or command == b'\xdf' or command == b'\xdb' or command == b'\xdd' or command == b'\xda':
-            nCmdData = bytes2int(ser.read(1))
+        packetType, body = frame
+        if frames.nSkipped > 0:
+            print("getData: skipped " + str(frames.nSkipped) + " bytes looking for the header 'DC'")
+            frames.nSkipped = 0
+        command = bytes([packetType])
+        dataLength = len(body) - 1
+        if packetType in asyncPackets:
+            nCmdData = body[0]
             if nCmdData != 0: print("getData: # command bytes " + str(nCmdData) + " != 0 for packet " + str(command))
-            dataList = []
-            byteList = []
-            for m in range(dataLength):
-                byte = ser.read()
-                dataList.append(bytes2int(byte))
-                byteList.append(byte)
-            numPad = 3 - dataLength%3
-            if numPad == 3: numPad = 0
-            #print("getData: dataLength = " + str(dataLength) + " # padding bytes=" + str(numPad))
-            for m in range(numPad):
-                byte = ser.read()
-                #print("getData: padding byte = " + str(byte))
-            trailer = ser.read(3)
-            if trailer != b'\xff\x00\xff':
-                print("getData: bad trailer = " + str(trailer))
-            if command == b'\xDE' or command == b'\xde':    # housekeeping packet
-                print("getData: housekeeping packet received with " + str(dataLength) + " bytes")
-                printHousekeeping(dataList, byteList)
-            elif command == b'\xDF' or command == b'\xdf':  # tracker housekeeping packet
-                print("getData: tracker housekeeping packet received with " + str(dataLength) + " bytes")
-                printTkrHousekeeping(dataList)
-            elif command == b'\xDB' or command == b'\xdb':
-                print("getData: TOF debug event data packet received with " + str(dataLength) + " bytes") 
-            elif command == b'\xDD' or command == b'\xdd':  # data packet
-                print("getData: event data packet received with " + str(dataLength) + " bytes")
-            elif command == b'\xDA' or command == b'\xda':  # error record
-                print("getData: error record received with " + str(dataLength) + " bytes")
-                for i in range(dataLength):
-                    ret = byteList[i]
-                    print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
+            dataList = list(body[1:])
+            byteList = [bytes([b]) for b in dataList]
+            printAsyncPacket(packetType, dataLength, dataList, byteList)
         else: 
-            success = True
-            #print("getData: received data for command " + str(command))
-    if debug: print("getData: command = " + str(command) + " " + str(bytes2int(command)) + " " + str(command.hex()) + " data length = " + str(dataLength))
-    nCmdBytes = bytes2int(ser.read(1))
+            break
+    if debug: print("getData: command = " + str(command) + " " + str(packetType) + " " + str(command.hex()) + " data length = " + str(dataLength))
+    nCmdBytes = body[0]
     if debug: print("getData: number of command data bytes = " + str(nCmdBytes)) 
-    nPadding = 3 - dataLength%3
-    if nPadding == 3: nPadding = 0
-    if debug: print("getData: number of padding bytes = " + str(nPadding))
-    dataLength = dataLength - nCmdBytes
-    cmdDataBytes = []
-    for i in range(nCmdBytes):
-        ret = ser.read(1)
-        cmdDataBytes.append(ret)
-        if debug: print("getData: command data byte " + str(i) + ": " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
-    dataBytes = []
-    for i in range(dataLength):
-        ret = ser.read(1)
-        dataBytes.append(ret)
-        if debug: print("getData: output data byte " + str(i) + ": " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
-    for i in range(nPadding):
-        ret = ser.read(1)
-        if debug: print("getData: padding byte " + str(i) + ": " + str(ret))
-    trailer = ser.read(3)
-    if debug: print("getData: trailing bytes: " + str(trailer))
-    if trailer != b'\xFF\x00\xFF':
-        print("getData: invalid trailer returned: " + str(trailer))
+    cmdDataBytes = [bytes([b]) for b in body[1:1+nCmdBytes]]
+    dataBytes = [bytes([b]) for b in body[1+nCmdBytes:]]
     if debug: print("getData: command=" + str(command) + " # cmdDataBytes=" + str(len(cmdDataBytes)) + " # dataBytes=" + str(len(dataBytes)))
     return command,cmdDataBytes,dataBytes
 
+# Packets that the PSOC sends on its own, not in response to a command
+asyncPackets = (0xD9, 0xDA, 0xDB, 0xDD, 0xDE, 0xDF)
+
+def printAsyncPacket(packetType, dataLength, dataList, byteList):
+    if packetType == 0xDE:    # housekeeping packet
+        print("getData: housekeeping packet received with " + str(dataLength) + " bytes")
+        printHousekeeping(dataList, byteList)
+    elif packetType == 0xDF:  # tracker housekeeping packet
+        print("getData: tracker housekeeping packet received with " + str(dataLength) + " bytes")
+        printTkrHousekeeping(dataList)
+    elif packetType == 0xDB:
+        print("getData: TOF debug event data packet received with " + str(dataLength) + " bytes") 
+    elif packetType == 0xDD:  # data packet
+        print("getData: event data packet received with " + str(dataLength) + " bytes")
+    elif packetType == 0xDA:  # error record
+        print("getData: error record received with " + str(dataLength) + " bytes")
+        for i in range(dataLength):
+            ret = byteList[i]
+            print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
+    elif packetType == 0xD9:  # error stream
+        print("getData: error stream packet received with " + str(dataLength) + " bytes")
+        printErrorStream(dataList)
+
 # Retrieve the data for a short data packet coming from the PSOC (<= 3 bytes)
 # This is no longer used, because of the addition of the command echo to the returning data
 def getShortData(address, nBytes):
     ret = b''
     for i in range(36):  #Sometimes the read starts with blank bytes, so search for the header
-        ret = ser.read(1)
+        ret = frames.read(1)
         #print("getShortData: i= " + str(i) + " ret = " + str(ret))
         if ret == b'\xDC':
             print("getShortData: wrong header 'DC' found, expected 'DB'")
@@ -210,21 +212,21 @@ def getShortData(address, nBytes):
     if ret != b'\xDB':
         print("getShortData: failed to find the header 'DB' for a short data return")
         return b''
-    ret = ser.read(2)
+    ret = frames.read(2)
     #print("getShortData: remainder of header = " + str(ret))
     if ret != b'\x00\xFF':
         print("getShortData: invalid header returned: b'\\xDB' " + str(ret))
     if nBytes >= 3:
-        ret = ser.read(3)
+        ret = frames.read(3)
     elif nBytes == 2:
-        ret = ser.read(2)
+        ret = frames.read(2)
         #print("getShortData: two bytes of data = " + str(ret))
-        extra = ser.read(1)
+        extra = frames.read(1)
         #print("getShortData: extra byte = " + str(extra))
     else:
-        ret = ser.read(1)
-        ser.read(2)
-    trailer = ser.read(3)
+        ret = frames.read(1)
+        frames.read(2)
+    trailer = frames.read(3)
     if trailer != b'\xFF\x00\xFF':
         print("getShortData: invalid trailer returned: " + str(trailer))
     return ret
@@ -286,6 +288,27 @@ def getPmtRates():
     print("T1 rate =    " + str(T1) + " Hz")
     print("T4 rate =    " + str(T4) + " Hz")
     print("T2 rate =    " + str(T2) + " Hz")
+
+# Get the PMT counts over nWindows consecutive windows of nSec seconds each, latest first, with no gaps between them.
+# Returns a list of [Guard, T3, T1, T4, T2] rates in Hz per window.
+def getPmtRateHistory(nSec, nWindows=1):
+    cmdHeader = mkCmdHdr(2, 0x67, addrEvnt)
+    ser.write(cmdHeader)
+    data1 = mkDataByte(nSec, addrEvnt, 1)
+    ser.write(data1)
+    data2 = mkDataByte(nWindows, addrEvnt, 2)
+    ser.write(data2)
+    time.sleep(0.1)
+    cmd,cmdData,dataBytes = getData(addrEvnt)
+    d = [bytes2int(b) for b in dataBytes]
+    rates = []
+    for w in range(d[1]):
+        rec = d[2+17*w : 19+17*w]
+        dt = (rec[0]*256 + rec[1])/200.
+        counts = [rec[2+3*i]*65536 + rec[3+3*i]*256 + rec[4+3*i] for i in range(5)]
+        rates.append([c/dt for c in counts])
+        print("getPmtRateHistory: window " + str(w) + " of " + str(dt) + " s: Guard, T3, T1, T4, T2 = " + str(rates[-1]) + " Hz")
+    return rates
     
 def getTkrLyrRates():
     print("getTkrLyrRates: getting rates from all tracker layers")
@@ -419,6 +442,19 @@ def tkrSetCRCcheck(choice):
     ser.write(data1)
     print("tkrSetCRCcheck: will CRC checks be made on Tracker hit lists?: " + choice)
 
+def tkrSetSampledDiagnostics(period, threshold, escalateTime):   # Check 1 in period events, escalate on threshold % errors
+    cmdHeader = mkCmdHdr(4, 0x4E, addrEvnt)
+    ser.write(cmdHeader)
+    data1 = mkDataByte(2, addrEvnt, 1)
+    ser.write(data1)
+    data2 = mkDataByte(period, addrEvnt, 2)
+    ser.write(data2)
+    data3 = mkDataByte(threshold, addrEvnt, 3)
+    ser.write(data3)
+    data4 = mkDataByte(escalateTime, addrEvnt, 4)
+    ser.write(data4)
+    print("tkrSetSampledDiagnostics: check 1 in " + str(period) + " events, escalate for " + str(escalateTime) + " s above " + str(threshold) + "% errors")
+
 def setSettlingWindowAll(count):
     if count > 126:
         print("setSettlingWindow: input count of " + str(count) + " is too large. Must be < 127")
@@ -603,6 +639,7 @@ def CRC6(bitString): # The key is 1'100101
     #print " "*i+divisor
   return result[len(result)-6:]
   
+# Bit-string version of hitDecoder.parseHitList, kept as the reference for testHitDecoder.py
 def ParseASIChitList(bitString, verbose):
   pointer = 0    
   firstStripChip = [] 
@@ -844,7 +881,7 @@ def readCalEvent(trgTag, verbose):
         hitList.append(dataList[iPtr])
         iPtr = iPtr + 1
     print("           Hit list= " + getBinaryString(hitList))
-    if verbose: rc = ParseASIChitList(getBinaryString(hitList),True)[0]
+    if verbose: rc = parseHitList(hitList,True)[0]
     return hitList
             
 def setTKRlayers(lyr0, lyr1, lyr2, lyr3, lyr4, lyr5, lyr6, lyr7):
@@ -979,6 +1016,31 @@ def printHousekeeping(dataList, byteList):
     numLiveSamples = dataList[78]*256 + dataList[79]
     print("   Number of samples for the ADC state-machine live-time = " + str(numLiveSamples))
     print("   ADC state-machine live-time = " + str(dataList[80]) + "%")
+    print("   Diagnostics sample period (1=every event, 0=off) = " + str(dataList[81]))
+    print("   Number of diagnostics escalations = " + str(dataList[82]*256 + dataList[83]))
+    if len(dataList) < 118: return
+    value = (dataList[84]*256 + dataList[85]) >> 4
+    print("   Board temperature = " + str(value*0.0625) + " Celsius")
+    names = ['DVDD5', 'DVDD33', 'AVDD5', 'AVDD33', 'Back15', 'TkrBias', 'TKR']
+    for i in range(7):
+        busV = (dataList[86+4*i]*256 + dataList[87+4*i])*1.25/1000.
+        current = (dataList[88+4*i]*256 + dataList[89+4*i])*0.03
+        print("   " + names[i] + " bus voltage = " + str(busV) + " V, current reading = " + str(current))
+    print("   Age of tracker temperatures = " + str(dataList[114]) + " s, die temperature = " + str(dataList[115]) + " s")
+    print("   Age of board temperature = " + str(dataList[116]) + " s, power monitors = " + str(dataList[117]) + " s")
+    if len(dataList) < 119: return
+    print("   PMT rates measured over the last " + str(dataList[118]) + " seconds")
+    if len(dataList) < 121: return
+    print("   ADC state-machine live fraction = " + str((dataList[119]*256 + dataList[120])/100.) + "%")
+
+def printErrorStream(dataList):
+    nErr = dataList[3]
+    print("Error stream packet with " + str(nErr) + " errors, " + str(dataList[4]) + " lost")
+    for i in range(nErr):
+        d = dataList[5+11*i : 16+11*i]
+        usec = d[3]*16777216 + d[4]*65536 + d[5]*256 + d[6]
+        evt = d[7]*16777216 + d[8]*65536 + d[9]*256 + d[10]
+        print("   Error code " + str(d[0]) + " info " + hex(d[1]) + " " + hex(d[2]) + " at t=" + str(usec) + " us, event " + str(evt))
 
 def printTkrHousekeeping(dataList):
     run = dataList[4]*256 + dataList[5]
@@ -1080,8 +1142,69 @@ def printBOR(dataBytes):
         print("       Trigger output length = " + str(dataList[45+lyr*5+3]))
         print("       Trigger output delay = " + str(dataList[45+lyr*5+4]))
            
-# Execute a run for a specified number of events to be acquired
-def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, debugTOF = False):
+# Decode an event packet into a dictionary, in a decoder thread of the limitedRun pipeline. Housekeeping packets
+# are returned as their data lists only.
+def decodeEventPacket(packetType, body, debugTOF):
+    dataList = list(body[1:])
+    evt = {"nCmdData": body[0], "dataList": dataList, "byteList": [bytes([b]) for b in dataList]}
+    if packetType == 0xDE or packetType == 0xDF: return evt
+    evt["run"] = dataList[4]*256 + dataList[5]
+    evt["trigger"] = dataList[6]*16777216 + dataList[7]*65536 + dataList[8]*256 + dataList[9]
+    evt["timeStamp"] = dataList[10]*16777216 + dataList[11]*65536 + dataList[12]*256 + dataList[13]
+    evt["cntGo1"] = dataList[14]*16777216 + dataList[15]*65536 + dataList[16]*256 + dataList[17]
+    timeDate = dataList[18]*16777216 + dataList[19]*65536 + dataList[20]*256 + dataList[21]
+    evt["timeDate"] = timeDate
+    evt["date"] = (((timeDate & 0x7C000000) >> 26) + 2000, (timeDate & 0x03C00000) >> 22, (timeDate & 0x003E0000) >> 17,
+                   (timeDate & 0x0001F000) >> 12, (timeDate & 0x00000FC0) >> 6, timeDate & 0x0000003F)
+    evt["trgStatus"] = dataList[22]
+    evt["T1"] = dataList[23]*256 + dataList[24]
+    evt["T2"] = dataList[25]*256 + dataList[26]
+    evt["T3"] = dataList[27]*256 + dataList[28]
+    evt["T4"] = dataList[29]*256 + dataList[30]
+    evt["G"] =  dataList[31]*256 + dataList[32]
+    evt["dtmin"] = 10*int(np.int16(dataList[33]*256 + dataList[34]))
+    evt["trgCount"] = dataList[35]*256 + dataList[36]
+    if debugTOF:
+        evt["nTOFA"] = dataList[39]
+        evt["nTOFB"] = dataList[40]
+        evt["tofA"] = 10*(dataList[41]*256 + dataList[42])
+        evt["tofB"] = 10*(dataList[43]*256 + dataList[44])
+        evt["clkA"] = dataList[45]*256 + dataList[46]
+        evt["clkB"] = dataList[47]*256 + dataList[48]
+        iPtr = 49
+    else: 
+        evt["nTOFA"] = 0
+        evt["nTOFB"] = 0
+        evt["tofA"] = 9999
+        evt["tofB"] = 9999
+        evt["clkA"] = 9999
+        evt["clkB"] = 9999
+        iPtr = 39
+    evt["liveUsec"] = -1
+    evt["nGO1live"] = 0
+    if dataList[38] & 0x08:   # Re-arm to GO interval and missed triggers in it
+        evt["liveUsec"] = dataList[iPtr]*65536 + dataList[iPtr+1]*256 + dataList[iPtr+2]
+        evt["nGO1live"] = dataList[iPtr+3]
+        iPtr = iPtr + 4
+    nTkrLyrs = dataList[iPtr]
+    evt["nTkrLyrs"] = nTkrLyrs
+    iPtr = iPtr + 1
+    evt["layers"] = []
+    for brd in range(nTkrLyrs):
+        nBytes = dataList[iPtr]
+        iPtr = iPtr + 1
+        evt["layers"].append(decodeHitList(bytes(body[1+iPtr:1+iPtr+nBytes])))
+        iPtr = iPtr + nBytes
+    return evt
+
+# Execute a run for a specified number of events to be acquired.
+# The port is read by a separate thread (see acqPipeline.py), which drops packets only if
+# more than queueDepth of them are waiting to be decoded and printed.
+# With saveStream, everything read from the port from the start-of-run command to the EOR record is also saved as
+# run<N>_stream.bin, the raw stream read by aesop_reprocess and runIndex.py.
+def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, debugTOF = False, deadTime = False,
+               nDecoders = 1, queueDepth = 2000, saveStream = True):
+    if saveStream: frames.dump = open("run" + str(runNumber) + "_stream.bin", "wb")
     cmdHeader = mkCmdHdr(4, 0x3C, addrEvnt)
     ser.write(cmdHeader)
     data1 = mkDataByte(runNumber>>8, addrEvnt, 1)
@@ -1094,6 +1217,7 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
     ser.write(data3)
     doDebug = 0
     if debugTOF: doDebug = 1
+    if deadTime: doDebug = doDebug | 2
     data4 = mkDataByte(doDebug, addrEvnt, 4)
     ser.write(data4)
 
@@ -1110,8 +1234,7 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
     
     print("limitedRun: starting run number " + str(runNumber) + " for " + str(numEvnts) + " events")
     if not readTracker: print("            The tracking detector will not be read out")
-    f = open("nTuple_run" + str(runNumber) + ".txt", "w")
-    #f.write("N  T1  T2  T3  T4  G   NH  TOFA    TOFB    DTMIN   NTOFA   NTOFB   DELTAT  RC\n")
+    output = RunWriter(runNumber)     # run<N>_events.npy, run<N>_clusters.npy and run<N>_occupancy.npy, see runFile.py
     if outputEvents:
         f2 = open("dataOutput_run" + str(runNumber) + ".txt", "w")
         f2.write("Starting run " + str(runNumber) + " on " + time.strftime("%c") + "\n") 
@@ -1133,163 +1256,88 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
     timeSum = 0
     numHits = 0
     nPlotted = 0
-    occ = []
-    for lyr in range(8):
-        hits = []
-        for strip in range(768):
-            hits.append(0)
-        occ.append(hits)
         
-    for event in range(numEvnts):
-        # Wait for an event to show up
-        cnt = 0
-        while True:
-            ret = ser.read(1)
-            if cnt%1 == 0:
-                print("limitedRun " + str(cnt) + ": looking for start of event. Received byte " + str(ret))
-            if ret == b'\xDC': break
-            time.sleep(0.1)
-            cnt = cnt + 1
-            if cnt%30 == 0: readErrors(addrEvnt);
-        ret = ser.read(2)
-        if ret != b'\x00\xFF':
-            print("limitedRun: bad header found: b'\\xdc' " + str(ret))
+    def onIdle(cnt):     # Called by the reader thread while no packet is coming in
+        if cnt%10 == 0:
+            print("limitedRun " + str(cnt) + ": looking for start of event")
+        if (cnt+1)%30 == 0: readErrors(addrEvnt)
+    pipeline = AcqPipeline(frames, numEvnts, lambda packetType, body: decodeEventPacket(packetType, body, debugTOF),
+                           nDecoders, queueDepth, onIdle)
+    pipeline.start()
+    event = -1
+    for packetType, evt in pipeline.results():
+        event = event + 1
         print("limitedRun: reading packet " + str(event) + " of run " + str(runNumber))
-        ret = ser.read(1)
-        nData = bytes2int(ret)
-        ret = ser.read(1)
-        dataID = str(ret.hex())
+        dataID = "{:02x}".format(packetType)
         print("   Data type ID is " + dataID)
-        ret = ser.read(1)
-        if bytes2int(ret) != 0: print("   Bad number of command data bytes = " + str(bytes2int(ret)))
-        R = nData % 3
-        nPackets = int(nData/3)
-        if (R != 0): nPackets = nPackets + 1
-        dataList = []
-        byteList = []
-        if verbose: print("   Reading " + str(nData) + " data bytes in " + str(nPackets) + " packets")
-        #if event == 0:   # Read the command echo
-        #    ret = ser.read(2)
-        #    print("limitedRun: echo of the run number = " + str(bytes2int(ret)))
-        #    ret = ser.read(1)
-        #    print("limitedRun: echo of the readTracker flag = " + str(ret))
-        for i in range(nPackets):
-            byte1 = ser.read()
-            #if verbose: print("   Packet " + str(i) + ", byte 1 = " + str(bytes2int(byte1)) + " decimal, " + str(byte1.hex()) + " hex")
-            dataList.append(bytes2int(byte1))
-            byteList.append(byte1)
-            byte2 = ser.read()
-            #if verbose: print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(byte2)) + " decimal, " + str(byte2.hex()) + " hex")
-            dataList.append(bytes2int(byte2))
-            byteList.append(byte2)
-            byte3 = ser.read()
-            #if verbose: print("   Packet " + str(i) + ", byte 3 = " + str(bytes2int(byte3)) + " decimal, " + str(byte3.hex()) + " hex")
-            dataList.append(bytes2int(byte3))
-            byteList.append(byte3)
-        ret = ser.read(3)
-        if ret != b'\xFF\x00\xFF':
-            print("limitedRun: invalid trailer returned: " + str(ret))
+        if isinstance(evt, Exception):
+            print("   Failed to decode the packet: " + repr(evt))
+            continue
+        if evt["nCmdData"] != 0: print("   Bad number of command data bytes = " + str(evt["nCmdData"]))
+        if verbose: print("   Read " + str(len(evt["dataList"])) + " data bytes")
         if dataID == "DE" or dataID == "de":   # Parse the housekeeping packet
-            printHousekeeping(dataList, byteList)
+            printHousekeeping(evt["dataList"], evt["byteList"])
         elif dataID == "DF" or dataID == "df":
-            printTkrHousekeeping(dataList)
+            printTkrHousekeeping(evt["dataList"])
         else:
-            run = dataList[4]*256 + dataList[5]
-            trigger = dataList[6]*16777216 + dataList[7]*65536 + dataList[8]*256 + dataList[9]
-            cntGo1 = dataList[14]*16777216 + dataList[15]*65536 + dataList[16]*256 + dataList[17]
-            timeDate = dataList[18]*16777216 + dataList[19]*65536 + dataList[20]*256 + dataList[21]
-            if verbose: print("   Trigger: " + str(trigger) + " accepted, " + str(trigger+cntGo1) + " generated.  Data List length = " + str(len(dataList)))
-            timeStamp = dataList[10]*16777216 + dataList[11]*65536 + dataList[12]*256 + dataList[13]
-            year = ((timeDate & 0x7C000000) >> 26) + 2000
-            month = (timeDate & 0x03C00000) >> 22
-            day = (timeDate & 0x003E0000) >> 17
-            hour = (timeDate & 0x0001F000) >> 12
-            minute = (timeDate & 0x00000FC0) >> 6
-            second = (timeDate & 0x0000003F)
-
-            T1 = dataList[23]*256 + dataList[24]
-            T2 = dataList[25]*256 + dataList[26]
-            T3 = dataList[27]*256 + dataList[28]
-            T4 = dataList[29]*256 + dataList[30]
-            G =  dataList[31]*256 + dataList[32]
-            if verbose:
+            trigger = evt["trigger"]
+            timeStamp = evt["timeStamp"]
+            T1, T2, T3, T4, G = evt["T1"], evt["T2"], evt["T3"], evt["T4"], evt["G"]
+            dtmin = evt["dtmin"]
+            trgStatus = evt["trgStatus"]
+            year, month, day, hour, minute, second = evt["date"]
+            if verbose: 
+                print("   Trigger: " + str(trigger) + " accepted, " + str(trigger+evt["cntGo1"]) + " generated.  Data List length = " + str(len(evt["dataList"])))
                 print("        T1 ADC=" + str(T1))
                 print("        T2 ADC=" + str(T2))
                 print("        T3 ADC=" + str(T3))
                 print("        T4 ADC=" + str(T4))
                 print("         G ADC=" + str(G))
-            dtmin = 10*np.int16(dataList[33]*256 + dataList[34])
-            trgCount = dataList[35]*256 + dataList[36]
-            if debugTOF:
-                nTOFA = dataList[39]
-                nTOFB = dataList[40]
-                tofA = 10*(dataList[41]*256 + dataList[42])
-                tofB = 10*(dataList[43]*256 + dataList[44])
-                clkA = dataList[45]*256 + dataList[46]
-                clkB = dataList[47]*256 + dataList[48]
-                nTkrLyrs = dataList[49]
-                iPtr = 50
-            else: 
-                nTOFA = 0
-                nTOFB = 0
-                tofA = 9999
-                tofB = 9999
-                clkA = 9999
-                clkB = 9999
-                nTkrLyrs = dataList[39]
-                iPtr = 40
-            if verbose:
                 print("        TimeStamp = " + str(timeStamp))
-                print("        TOF=" + str(dtmin) + " Number A=" + str(nTOFA) + " Number B=" + str(nTOFB))
-                print("        run=" + str(run) + "  trigger " + str(trigger) + " Tkr Trig Cnt = " + str(trgCount))
-            trgStatus = dataList[22]
-            rc = 0
-            numHitEvt = 0
-            if verbose: 
+                print("        TOF=" + str(dtmin) + " Number A=" + str(evt["nTOFA"]) + " Number B=" + str(evt["nTOFB"]))
+                print("        run=" + str(evt["run"]) + "  trigger " + str(trigger) + " Tkr Trig Cnt = " + str(evt["trgCount"]))
+                if evt["liveUsec"] >= 0: print("        Re-arm to GO = " + str(evt["liveUsec"]) + " us with " + str(evt["nGO1live"]) + " GO1 counts")
                 if month > 12 or month < 1: month = 1
                 print("        Event time = " + str(hour) + ":" + str(minute) + ":" + str(second) + " on " + months[month] + " " + str(day) + ", " + str(year))
-                if debugTOF: print("        REF-A=" + str(tofA) + "  REF-B=" + str(tofB))
-                if debugTOF: print("        TOF clkA=" + str(clkA) + "  TOF clkB=" + str(clkB))
+                if debugTOF: print("        REF-A=" + str(evt["tofA"]) + "  REF-B=" + str(evt["tofB"]))
+                if debugTOF: print("        TOF clkA=" + str(evt["clkA"]) + "  TOF clkB=" + str(evt["clkB"]))
                 print("        Trigger status = " + str(hex(trgStatus)))
-                print("        Number of tracker layers read out = " + str(nTkrLyrs))          
+                print("        Number of tracker layers read out = " + str(evt["nTkrLyrs"]))          
             deltaTime = timeStamp - lastTime
             deltaTimeSec = deltaTime * (1./200.)
             if event > 0:
                 if verbose: print("    Time since the previous event = " + str(deltaTime) + " counts, or " + str(deltaTimeSec) + " seconds")
                 timeSum += deltaTime
             lastTime = timeStamp
-            if verbose:             
-                FPGAs = []
-                stripHits = []
-                hitWidths = []
-                for brd in range(nTkrLyrs):
-                    ##brdNum = dataList[iPtr]
-                    ##iPtr = iPtr + 1
-                    nBytes = dataList[iPtr]
-                    iPtr = iPtr + 1
-                    hitList = []
-                    for hit in range(nBytes):
-                        #print("                      " + str(hit) + "  " + hex(dataList[iPtr]))
-                        hitList.append(byteList[iPtr])
-                        iPtr = iPtr + 1
-                    #print("           Hit list= " + getBinaryString(hitList))
-                    rc, FPGA, strips, widths = ParseASIChitList(getBinaryString(hitList),True)
-                    if rc != 0: nBadTkr = nBadTkr + 1
-                    numHitEvt = len(strips)
-                    numHits = numHits + numHitEvt
-                    FPGAs.append(FPGA)
-                    stripHits.append(strips)
-                    hitWidths.append(widths)
-                if nPlotted < nToPlot: 
-                    plotTkrEvnt(run, trigger, FPGAs, stripHits)
-                    nPlotted = nPlotted + 1
+            rc = 0
+            tkrErrors = 0
+            FPGAs = []
+            stripHits = []
+            hitWidths = []
+            for decoded in evt["layers"]:
+                if verbose: printHitList(decoded)
+                rc = decoded["rc"]
+                if rc != 0: nBadTkr = nBadTkr + 1
+                tkrErrors = tkrErrors + abs(rc)
+                clusters = decoded["clusters"]
+                output.addClusters(decoded["FPGA"], clusters)
+                strips = (64*(clusters["chip"].astype(int) + 1) - clusters["firstStrip"]).tolist()
+                numHits = numHits + len(strips)
+                FPGAs.append(decoded["FPGA"])
+                stripHits.append(strips)
+                hitWidths.append(clusters["width"].tolist())
+            if verbose and nPlotted < nToPlot: 
+                plotTkrEvnt(evt["run"], trigger, FPGAs, stripHits)
+                nPlotted = nPlotted + 1
             if trgStatus & 0x01: pmtTrg1 = pmtTrg1 + 1
             if trgStatus & 0x02: pmtTrg2 = pmtTrg2 + 1
             if trgStatus & 0x04: tkrTrg0 = tkrTrg0 + 1
             if trgStatus & 0x08: tkrTrg1 = tkrTrg1 + 1
             if trgStatus & 0x10: pmtGrd = pmtGrd + 1
-            strOut = '{} {} {} {} {} {} {} {} {} {} {} {} {} {}\n'.format(trigger, T1, T2, T3, T4, G, numHitEvt, tofA, tofB, dtmin, nTOFA, nTOFB, deltaTime, rc)
-            f.write(strOut)   
+            output.addEvent(deltaTime=deltaTime, tkrErrors=tkrErrors,
+                            **{key: evt[key] for key in ("trigger", "run", "timeStamp", "timeDate", "cntGo1", "trgStatus",
+                            "trgCount", "T1", "T2", "T3", "T4", "G", "dtmin", "nTOFA", "nTOFB", "tofA", "tofB", "clkA", "clkB",
+                            "liveUsec", "nGO1live", "nTkrLyrs")})
             TOFavg = TOFavg + float(dtmin)
             TOFavg2 = TOFavg2 + float(dtmin)*float(dtmin)
             if event != 0:
@@ -1309,30 +1357,26 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
                 timeStr = str(hour) + ":" + str(minute) + ":" + str(second) + " on " + months[month] + " " + str(day) + ", " + str(year)
                 f2.write("Event {:d}: {} {:s}   rc={}\n".format(trigger, timeStamp, timeStr, rc))
                 f2.write("  ADC: {}, {}, {}, {}, {}\n".format(T1, T2, T3, T4, G))
-                f2.write("  TOF: {}  nA={}  nB={}  refA={}  refB={}  clkA={}  clkB={} \n".format(dtmin, nTOFA, nTOFB, tofA, tofB, clkA, clkB))
+                f2.write("  TOF: {}  nA={}  nB={}  refA={}  refB={}  clkA={}  clkB={} \n".format(dtmin, evt["nTOFA"], evt["nTOFB"], evt["tofA"], evt["tofB"], evt["clkA"], evt["clkB"]))
                 for lyr, hits, widths in zip(FPGAs,stripHits,hitWidths):
                     f2.write("    Lyr {}:".format(lyr))
                     for strip, width in zip(hits, widths):
                         f2.write(" {} ".format(strip + (width/2)))
                     f2.write("\n")
-            if verbose:
-                for FPGA, hits, widths in zip(FPGAs,stripHits,hitWidths):
-                    lyr = FPGA
-                    if FPGA == 8: lyr = 0;
-                    for hit, width in zip(hits, widths):
-                        for j in range(width):
-                            strip = hit - j
-                            occ[lyr][strip] = occ[lyr][strip] + 1
+    pipeline.stop()
+    print(pipeline.status())
+    nPackets = event + 1
 
     endTime = time.time()
     runTime = endTime - startTime
     print("Elapsed time for the run = " + str(runTime) + " seconds")
-    if numEvnts > 1: timeSum = timeSum/float(numEvnts - 1)
+    if nPackets > 1: timeSum = timeSum/float(nPackets - 1)
     timeSumSec = timeSum*(1./200.)
     print("Average time between event time stamps = " + str(timeSum) + " counts = " + str(timeSumSec) + " seconds")
   
+    output.flush()
     print("Strip hit occupancy of layer 0:")
-    print(occ[0])
+    print(output.occupancy[0].tolist())
     
     # Tell the Event PSOC to stop the run
     cmdHeader = mkCmdHdr(0, 0x44, addrEvnt)
@@ -1345,62 +1389,38 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
             print("Cannot find an EOR record. Print accumulated errors instead")
             readErrors(addrEvnt)
             break
-        ret = ser.read(1)
-        if cnt%1 == 0:
-            print("limitedRun " + str(cnt) + ": looking for start of EOR record. Received byte " + str(ret))
-        if ret == b'\xDC': 
-            ret = ser.read(2)
-            if ret != b'\x00\xFF':
-                print("limitedRun: bad header found: b'\\xdc' " + str(ret)) 
-            nBytes = bytes2int(ser.read(1))
-            print("limitedRun: number of header bytes = " + str(nBytes))
-            ret = ser.read(1)
-            print("return = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex  = " + str(ret))
-            if ret == b'\xDB' or ret == b'\xDD' or ret == b'\xDE' or ret == b'\xDF':
-                ret = ser.read(1)
-                if ret != b'\x00': print("limitedRun: invalid command data bytes " + str(ret) + " received for EOR header")
-                print("limitedRun: dumping the bytes for an extra event trigger that came in while ending the run:")
+        frame = frames.readFrame(timeout = 0.1)
+        if frame is None:
+            print("limitedRun " + str(cnt) + ": looking for start of EOR record")
+            cnt = cnt + 1
+            continue
+        packetType, body = frame
+        nBytes = len(body) - 1
+        print("limitedRun: packet type = " + hex(packetType) + ", number of data bytes = " + str(nBytes))
+        if body[0] != 0: print("limitedRun: invalid command data bytes " + str(body[0]) + " received for EOR header")
+        byteList = [bytes([b]) for b in body[1:]]
+        if packetType in asyncPackets:
+            print("limitedRun: dumping the bytes for an extra event trigger that came in while ending the run:")
+            if verbose:
                 for i in range(nBytes):
-                    ret = ser.read(1);      
-                    if verbose: print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex  = " + str(ret))
-                nPadding = 3 - nBytes%3
-                if nPadding == 3: nPadding = 0
-                for i in range(nPadding): ser.read(1)
-                ret = ser.read(3)
-                if ret != b'\xFF\x00\xFF':
-                    print("limitedRun: invalid trailer returned: " + str(ret))     
-                continue
-            print("limitedRun: command code = " + str(ret.hex()))
-            print("limitedRun: found EOR record, number of header bytes = " + str(nBytes))
-            ret = ser.read(1)
-            if ret != b'\x00': print("limitedRun: invalid command data bytes " + str(ret) + " received for EOR header")
-            for i in range(3):
-                ret = ser.read(1)
-                if verbose: print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex  = " + str(ret))
-                byteList.append(ret)
-            if (byteList[0] == b'\x45' and  byteList[1] == b'\x52' and byteList[2] == b'\x52'):
-                print("limitedRun: printing out an error record:")
+                    ret = byteList[i]
+                    print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex  = " + str(ret))
+            byteList = []
+            continue
+        if (byteList[0] == b'\x45' and  byteList[1] == b'\x52' and byteList[2] == b'\x52'):
+            print("limitedRun: printing out an error record:")
+            if verbose:
                 for i in range(3,nBytes):
-                    ret = ser.read(1)
-                    if verbose: print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
-                ret = ser.read(1)   # padding byte
-                ret = ser.read(3)
-                if ret != b'\xFF\x00\xFF':
-                    print("limitedRun: invalid trailer returned: " + str(ret))    
-                byteList = []
-                continue                
-            break               
-        time.sleep(0.1)
-        cnt = cnt + 1       
-
-    for i in range(2,nBytes):
-        ret = ser.read(1)
-        if verbose: print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
-        byteList.append(ret)
-    ret = ser.read(1)   # padding byte
-    ret = ser.read(3)
-    if ret != b'\xFF\x00\xFF':
-        print("limitedRun: invalid trailer returned: " + str(ret))         
+                    ret = byteList[i]
+                    print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(ret)) + " decimal, " + str(ret.hex()) + " hex")
+            byteList = []
+            continue
+        print("limitedRun: found EOR record, number of data bytes = " + str(nBytes))
+        break
+    if frames.dump is not None:
+        frames.dump.close()
+        frames.dump = None
+
     go0 = bytes2int(byteList[5])
     go1 = bytes2int(byteList[6])
     go2 = bytes2int(byteList[7])
@@ -1449,19 +1469,20 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
     printRunCounters(cntBytes)
     
     Sigma = [0.,0.,0.,0.,0.,0.]
-    TOFavg = TOFavg/float(numEvnts)
-    TOFavg2 = TOFavg2/float(numEvnts)
-    numHitsAvg = numHits/float(numEvnts)
+    nPackets = max(nPackets, 1)
+    TOFavg = TOFavg/float(nPackets)
+    TOFavg2 = TOFavg2/float(nPackets)
+    numHitsAvg = numHits/float(nPackets)
     print("Average number of hits per event = " + str(numHitsAvg))
     sigmaTOF = math.sqrt(TOFavg2 - TOFavg*TOFavg)
     for ch in range(5):
-        if numEvnts > 1:
+        if nAvg > 0:
             ADCavg[ch] = ADCavg[ch]/float(nAvg)
             ADCavg2[ch] = ADCavg2[ch]/float(nAvg)
             Sigma[ch] = math.sqrt(ADCavg2[ch] - ADCavg[ch]*ADCavg[ch])
         else:
             Sigma[ch] = 0.
-    f.close()
+    output.close()
     if outputEvents: f2.close()
     if (cntGo+cntGo1 == 0):
         live = 0.
@@ -1477,6 +1498,36 @@ def limitedRun(runNumber, numEvnts, readTracker = True, outputEvents = False, de
     print("Number of events included in the ADC averages = " + str(nAvg))
     return ADCavg, Sigma, TOFavg, sigmaTOF
 
+# Plot one event of a raw stream file with plotTkrEvnt, going straight to it through the stream index (see
+# runIndex.py). Returns the decoded event, or None if the event is not in the stream.
+def plotStreamEvent(streamFile, event, run = None):
+    index = RunIndex(streamFile)
+    found = index.findEvent(event, run)
+    if len(found) == 0:
+        print("plotStreamEvent: event " + str(event) + " not found in " + streamFile)
+        return None
+    packetType, body = index.record(found[0])
+    evt = decodeEventPacket(packetType, body, packetType == 0xDB)
+    FPGAs = []
+    stripHits = []
+    for decoded in evt["layers"]:
+        clusters = decoded["clusters"]
+        FPGAs.append(decoded["FPGA"])
+        stripHits.append((64*(clusters["chip"].astype(int) + 1) - clusters["firstStrip"]).tolist())
+    plotTkrEvnt(evt["run"], evt["trigger"], FPGAs, stripHits)
+    return evt
+
+# Print the error records and error streams of a raw stream file, optionally only those of one run or with time
+# stamps t0 <= t < t1, found through the stream index
+def printStreamErrors(streamFile, run = None, t0 = 0, t1 = 0xFFFFFFFF):
+    index = RunIndex(streamFile)
+    for i in index.errors(run):
+        if not t0 <= index.index['timeStamp'][i] < t1: continue
+        packetType, body = index.record(i)
+        dataList = list(body[1+body[0]:])
+        print("Run " + str(index.index['run'][i]) + ", event " + str(index.index['event'][i]) + ", byte " + str(index.index['offset'][i]) + ":")
+        printAsyncPacket(packetType, len(dataList), dataList, [bytes([b]) for b in dataList])
+
 def plotTkrEvnt(run, event, layers, hitList):
     f = open("plot_run" + str(run) + "_evt_" + str(event) + ".plt", "w")
     f.write("set title 'Event Number {:d}\n".format(event))
@@ -1640,6 +1691,55 @@ def getTkrLogic():
         type = "OR" 
     print("getTkrLogic: tracker logic is set to type " + type)
 
+# Read the I2C transaction statistics of the Event PSOC, optionally resetting them
+def getI2Cstats(reset=False):
+    if reset:
+        cmdHeader = mkCmdHdr(1, 0x66, addrEvnt)
+        ser.write(cmdHeader)
+        data1 = mkDataByte(1, addrEvnt, 1)
+        ser.write(data1)
+    else:
+        cmdHeader = mkCmdHdr(0, 0x66, addrEvnt)
+        ser.write(cmdHeader)
+    time.sleep(0.1)
+    cmd,cmdData,dataBytes = getData(addrEvnt)
+    d = [bytes2int(b) for b in dataBytes]
+    nTxn = d[0]*256 + d[1]
+    nFail = d[2]*256 + d[3]
+    avgTime = d[4]*16777216 + d[5]*65536 + d[6]*256 + d[7]
+    maxTime = d[8]*16777216 + d[9]*65536 + d[10]*256 + d[11]
+    print("getI2Cstats: " + str(nTxn) + " transactions, " + str(nFail) + " failures, average " + str(avgTime) + " us, maximum " + str(maxTime) + " us")
+    return nTxn, nFail, avgTime, maxTime
+
+# Read the statistics of the commands that the Event PSOC deferred during a run, optionally resetting them.
+# A deferred command is acknowledged only by "DF" when it arrives; its own reply is dropped when it executes.
+def getDeferredStats(reset=False):
+    if reset:
+        cmdHeader = mkCmdHdr(1, 0x68, addrEvnt)
+        ser.write(cmdHeader)
+        data1 = mkDataByte(1, addrEvnt, 1)
+        ser.write(data1)
+    else:
+        cmdHeader = mkCmdHdr(0, 0x68, addrEvnt)
+        ser.write(cmdHeader)
+    time.sleep(0.1)
+    cmd,cmdData,dataBytes = getData(addrEvnt)
+    d = [bytes2int(b) for b in dataBytes]
+    nRun = d[0]*256 + d[1]
+    avgLatency = d[2]*16777216 + d[3]*65536 + d[4]*256 + d[5]
+    maxLatency = d[6]*16777216 + d[7]*65536 + d[8]*256 + d[9]
+    nQueued = d[10]
+    print("getDeferredStats: " + str(nRun) + " commands executed, average latency " + str(avgLatency) + " ms, maximum " + str(maxLatency) + " ms, " + str(nQueued) + " queued")
+    return nRun, avgLatency, maxLatency, nQueued
+
+# Set the number of seconds between error stream packets sent during a run (0 turns the stream off)
+def setErrorStream(period):
+    cmdHeader = mkCmdHdr(1, 0x65, addrEvnt)
+    ser.write(cmdHeader)
+    data1 = mkDataByte(period, addrEvnt, 1)
+    ser.write(data1)
+    print("setErrorStream: error stream period set to " + str(period) + " seconds")
+
 # Load a 12-bit DAC for the TOF threshold
 def setTofDAC(channel, value, address):
     if channel > 2 or channel < 1: return 1
@@ -1899,17 +1999,32 @@ def readErrors(address):
         print("readErrors for PSOC address " + str(address) + ": no errors encountered.")
         return
     print("readErrors for PSOC address " + str(address) + ": number of data bytes = " + str(nData))
-    if nData%3 != 0:
+    if address != addrEvnt:    # The main PSOC returns 3 bytes per error
+        if nData%3 != 0:
+            print("readErrors: bad nData; abort")
+            return
+        nPackets = int((nData-1)/3) + 1;
+        for packet in range(nPackets):
+            ret = dataBytes[packet*3]
+            print("Error code returned to readErrors is " + str(bytes2int(ret)))  
+            ret = dataBytes[packet*3+1]
+            print("    First information byte = " + str(binascii.hexlify(ret)))
+            ret = dataBytes[packet*3+2]
+            print("    Second information byte = " + str(binascii.hexlify(ret)))
+        return
+    if nData%15 != 0:
         print("readErrors: bad nData; abort")
         return
-    nPackets = int((nData-1)/3) + 1;
+    nPackets = int(nData/15)
     for packet in range(nPackets):
-        ret = dataBytes[packet*3]
-        print("Error code returned to readErrors is " + str(bytes2int(ret)))  
-        ret = dataBytes[packet*3+1]
-        print("    First information byte = " + str(binascii.hexlify(ret)))
-        ret = dataBytes[packet*3+2]
-        print("    Second information byte = " + str(binascii.hexlify(ret)))
+        d = [bytes2int(b) for b in dataBytes[packet*15:packet*15+15]]
+        print("Error code returned to readErrors is " + str(d[0]) + ", count = " + str(d[1]*256 + d[2]))
+        firstEvt = d[5]*16777216 + d[6]*65536 + d[7]*256 + d[8]
+        print("    First occurrence: information bytes = " + hex(d[3]) + " " + hex(d[4]) + " at event " + str(firstEvt))
+        lastEvt = d[11]*16777216 + d[12]*65536 + d[13]*256 + d[14]
+        print("    Last occurrence:  information bytes = " + hex(d[9]) + " " + hex(d[10]) + " at event " + str(lastEvt))
+    if nData + 15 > 255:
+        print("readErrors: more error codes may be pending; call readErrors again")
 
 # Read back the voltage of the 5V supply on the backplane, digitized by the main PSOC Sigma-Delta ADC
 def readBackplaneVoltage():
@@ -2032,41 +2147,41 @@ def readTOFevent(address, channel):
     data1 = mkDataByte(channel, address, 1)
     ser.write(data1)
     time.sleep(0.1)
-    ret = ser.read(3)
+    ret = frames.read(3)
     if ret != b'\xDC\x00\xFF':
         print("readTOFevent: invalid header returned: " + str(ret))
-    ret = ser.read(1)
+    ret = frames.read(1)
     print("    readTOFevent: number of data bytes = " + str(bytes2int(ret)))
-    ret = ser.read(2)       
+    ret = frames.read(2)       
     #ret = ser.read(3)
     #if ret != b'\xFF\x00\xFF':
     #    print("readTOFevent: invalid trailer returned: " + str(ret))    
     #ret = ser.read(3)
     #if ret != b'\xDC\x00\xFF':
     #    print("readTOFevent: invalid header returned: " + str(ret))
-    ref = bytes2int(ser.read(2))
+    ref = bytes2int(frames.read(2))
     print("    readTOFevent: reference index = " + str(ref))
-    ret = ser.read(1)       
+    ret = frames.read(1)       
     #ret = ser.read(3)
     #if ret != b'\xFF\x00\xFF':
     #    print("readTOFevent: invalid trailer returned: " + str(ret))
     #ret = ser.read(3)
     #if ret != b'\xDC\x00\xFF':
     #    print("readTOFevent: invalid header returned: " + str(ret))
-    tim = bytes2int(ser.read(2))
+    tim = bytes2int(frames.read(2))
     print("    readTOFevent: stop time = " + str(tim))
-    ret = ser.read(1)       
+    ret = frames.read(1)       
     #ret = ser.read(3)
     #if ret != b'\xFF\x00\xFF':
     #    print("readTOFevent: invalid trailer returned: " + str(ret))
     #ret = ser.read(3)
     #if ret != b'\xDC\x00\xFF':
     #    print("readTOFevent: invalid header returned: " + str(ret))
-    clk = bytes2int(ser.read(2))
+    clk = bytes2int(frames.read(2))
     print("    readTOFevent: clock count = " + str(clk))
-    idx = bytes2int(ser.read(1))
+    idx = bytes2int(frames.read(1))
     print("    readTOFevent: number = " + str(idx)) 
-    ret = ser.read(3)
+    ret = frames.read(3)
     if ret != b'\xFF\x00\xFF':
         print("readTOFevent: invalid trailer returned: " + str(ret))   
     return 10*(ref*8333 + tim)      
@@ -3035,34 +3150,34 @@ def startTOF(numEvt):
         # Wait for an event to show up
         channel1 = b'  '
         while True:
-            ret = ser.read(1)
+            ret = frames.read(1)
             #print("startTOF: looking for start of packet. Received bytes " + str(ret.hex()))
             channel1 = binascii.hexlify(ret)
             if channel1 == b'aa' or channel1 == b'cc': break
             time.sleep(0.01)
         if channel1 == b'aa': print("startTOF: reading event " + str(event) + " for channel " + str(channel1))
-        value = bytes2int(ser.read(2))
+        value = bytes2int(frames.read(2))
         if channel1 == b'aa': print("  Channel " + str(channel1) +  " stop result=" + str(value) + " " + str(hex(value))) 
-        ref = bytes2int(ser.read(2))
+        ref = bytes2int(frames.read(2))
         if channel1 == b'aa': print("  Channel " + str(channel1) + " reference index=" + str(ref) + " " + str(hex(ref)))
         timev1 = (ref*8333 + value)*10
         if channel1 == b'aa': print("  Channel " + str(channel1) + " time = " + str(timev1))   
-        clkcnt = bytes2int(ser.read(2))
+        clkcnt = bytes2int(frames.read(2))
         if channel1 == b'aa': print("  Channel " + str(channel1) + " clock count = " + str(clkcnt)) 
-        cntr = bytes2int(ser.read(1))
+        cntr = bytes2int(frames.read(1))
         if channel1 == b'aa': print("  Channel " + str(channel1) + " FIFO length = " + str(cntr))
-        ret = ser.read(1)
+        ret = frames.read(1)
         channel2 = binascii.hexlify(ret)
         if channel2 == b'bb': print("startTOF: reading event " + str(event) + " for channel " + str(channel2))
-        value = bytes2int(ser.read(2))
+        value = bytes2int(frames.read(2))
         if channel2 == b'bb': print("  Channel " + str(channel2) +  " stop result=" + str(value) + " " + str(hex(value))) 
-        ref = bytes2int(ser.read(2))
+        ref = bytes2int(frames.read(2))
         if channel2 == b'bb': print("  Channel " + str(channel2) + " reference index=" + str(ref) + " " + str(hex(ref)))
         timev2 = (ref*8333 + value)*10
         if channel2 == b'bb': print("  Channel " + str(channel2) + " time = " + str(timev2))   
-        clkcnt = bytes2int(ser.read(2))
+        clkcnt = bytes2int(frames.read(2))
         if channel2 == b'bb': print("  Channel " + str(channel2) + " clock count = " + str(clkcnt)) 
-        cntr = bytes2int(ser.read(1))
+        cntr = bytes2int(frames.read(1))
         if channel2 == b'bb': print("  Channel " + str(channel2) + " FIFO length = " + str(cntr))
         if channel1 == b'aa' and channel2 == b'bb':
             tof = timev1 - timev2
@@ -0,0 +1,97 @@
+# Producer/consumer pipeline for reading a run from the event PSOC.
+# A reader thread does nothing but drain the port into a bounded queue of raw packets, so that printing, plotting
+# or file output can never back up the serial buffer. Decoder threads turn the raw packets into events, and the
+# caller (the writer stage) gets them back in the order in which they arrived. When the raw queue is full the
+# reader drops the packet and counts it, rather than stop reading the port.
+import heapq
+import queue
+import threading
+import time
+
+class AcqPipeline:
+    def __init__(self, frames, nPackets, decode, nDecoders = 1, queueDepth = 2000, onIdle = None):
+        self.frames = frames            # frameReader.FrameReader on the port
+        self.nPackets = nPackets        # Stop reading after this many packets
+        self.decode = decode            # decode(packetType, body) runs in the decoder threads
+        self.onIdle = onIdle            # onIdle(count) is called by the reader after each 0.1 s with no packet
+        self.queueDepth = queueDepth
+        self.rawQueue = queue.Queue(maxsize=queueDepth)
+        self.outQueue = queue.Queue(maxsize=queueDepth)
+        self.nRead = 0
+        self.nDropped = 0
+        self.maxDepth = 0               # Largest raw queue depth seen
+        self.stopping = threading.Event()
+        self.reader = threading.Thread(target=self._read, daemon=True)
+        self.decoders = [threading.Thread(target=self._decode, daemon=True) for i in range(max(nDecoders, 1))]
+
+    def start(self):
+        for thread in self.decoders: thread.start()
+        self.reader.start()
+
+    def stop(self):
+        self.stopping.set()
+        self.reader.join()
+
+    def status(self):
+        return ("pipeline: {} packets read, {} dropped, raw queue {}/{} (max {}), decoded queue {}, "
+                "{} bytes skipped, {} bad frames").format(self.nRead, self.nDropped, self.rawQueue.qsize(), self.queueDepth,
+                self.maxDepth, self.outQueue.qsize(), self.frames.nSkipped, self.frames.nBadFrames)
+
+    def _read(self):
+        seq = 0
+        nIdle = 0
+        while self.nRead < self.nPackets and not self.stopping.is_set():
+            frame = self.frames.readFrame(timeout = 0.1)
+            if frame is None:
+                if self.onIdle is not None: self.onIdle(nIdle)
+                nIdle = nIdle + 1
+                continue
+            nIdle = 0
+            self.nRead = self.nRead + 1
+            packetType, body = frame
+            try:
+                self.rawQueue.put_nowait((seq, packetType, body))
+                seq = seq + 1
+            except queue.Full:
+                self.nDropped = self.nDropped + 1
+            self.maxDepth = max(self.maxDepth, self.rawQueue.qsize())
+        for thread in self.decoders: self.rawQueue.put(None)
+
+    def _decode(self):
+        while True:
+            item = self.rawQueue.get()
+            if item is None:
+                self.outQueue.put(None)
+                return
+            seq, packetType, body = item
+            try:
+                result = self.decode(packetType, body)
+            except Exception as err:        # Handed to the writer, which reports it
+                result = err
+            self.outQueue.put((seq, packetType, result))
+
+    # Yield (packet type, decoded packet or the exception raised decoding it) in arrival order, printing the
+    # status line every statusInterval seconds
+    def results(self, statusInterval = 1.0):
+        pending = []
+        nextSeq = 0
+        nDone = 0
+        tStatus = time.time()
+        while nDone < len(self.decoders) or pending:
+            item = False
+            if nDone < len(self.decoders):
+                try:
+                    item = self.outQueue.get(timeout = statusInterval)
+                except queue.Empty:
+                    pass
+            if time.time() - tStatus >= statusInterval:
+                print(self.status())
+                tStatus = time.time()
+            if item is None:
+                nDone = nDone + 1
+            elif item is not False:
+                heapq.heappush(pending, (item[0], id(item), item))
+            while pending and (pending[0][0] == nextSeq or nDone == len(self.decoders)):
+                seq, key, (seq, packetType, result) = heapq.heappop(pending)
+                nextSeq = seq + 1
+                yield packetType, result
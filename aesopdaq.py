@@ -0,0 +1,220 @@
+# Python binding of libaesopdaq, the C++ decoder of the event PSOC output stream (see libaesopdaq/CMakeLists.txt).
+# It goes through the library's C interface with ctypes, so it needs nothing beyond numpy:
+#    frames(buffer)         yields (offset, packet type, command data, output data) for each frame, as memoryviews
+#    decodeEvents(buffer)   decodes all of the event frames into arrays of runFile.eventDtype and runFile.clusterDtype
+#    decodeHitList(data)    the same dictionary as hitDecoder.decodeHitList
+#    reprocess(fileName, runNumber)  decodes a raw stream file on all cores into the run files of runFile.py
+#    indexFile(fileName, indexFile)  writes the record index of a raw stream file, as read by runIndex.py
+#    decodeHousekeeping(data), decodeTkrHousekeeping, decodeBOR, decodeEOR, decodeErrorStream, decodeErrorRecord
+#                           a dictionary of the record fields (raw values, as sent), or None if the data are not such
+#                           a record
+# The library is looked for in libaesopdaq/build next to this file, unless AESOPDAQ_LIB gives its path.
+import ctypes
+import os
+import numpy as np
+import hitDecoder
+import runFile
+import runIndex
+
+class Frame(ctypes.Structure):
+    _fields_ = [("offset", ctypes.c_uint64), ("dataOffset", ctypes.c_uint64), ("dataLength", ctypes.c_uint16),
+                ("packetType", ctypes.c_uint8), ("nCmdData", ctypes.c_uint8)]
+
+class Stats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in ("consumed", "nFrames", "nEvents", "nClusters", "nBadEvents",
+                                                     "nOther", "nSkipped", "nBadFrames")]
+
+class HitList(ctypes.Structure):
+    _fields_ = [("rc", ctypes.c_int32), ("FPGA", ctypes.c_uint8), ("tag", ctypes.c_uint8), ("errorFlag", ctypes.c_uint8),
+                ("nChips", ctypes.c_uint8), ("crc", ctypes.c_uint8), ("crcLength", ctypes.c_uint8),
+                ("crcCalc", ctypes.c_uint8), ("trailerOK", ctypes.c_uint8), ("nChipHeaders", ctypes.c_int32),
+                ("nClusters", ctypes.c_int32), ("chips", ctypes.c_uint8*(15*5)), ("clusters", ctypes.c_uint8*(225*5))]
+
+u8 = ctypes.c_uint8
+u16 = ctypes.c_uint16
+u32 = ctypes.c_uint32
+
+class Housekeeping(ctypes.Structure):
+    _fields_ = [("run", u16), ("timeDate", u32), ("lastCommand", u16), ("cmdCount", u16), ("nBadCmd", u8),
+                ("nErrors", u8), ("cntGO", u32), ("cntGO1", u32), ("avgReadTime", u16), ("pmtRate", u16*5),
+                ("tkrCmdCount", u16), ("tkrTrigPercent", u8*2), ("nTkrDataErrors", u8), ("nTkrTimeouts", u8),
+                ("chipsHitX10", u8*8), ("layerRate", u16*8), ("dieTemp", u16), ("tkrTempRaw", u16*2),
+                ("tofStops", u8*4), ("spiBusyPercent", u8), ("livePercent", u8), ("nLiveSamples", u16),
+                ("adcLivePercent", u8), ("diagPeriod", u8), ("nDiagEscalations", u16), ("hasPower", u8),
+                ("hasPmtWindow", u8), ("hasLiveFraction", u8), ("boardTempRaw", u16), ("busRaw", u16*7),
+                ("shuntRaw", u16*7), ("sensorAge", u8*4), ("pmtWindow", u8), ("liveFraction10k", u16)]
+
+class TkrHousekeeping(ctypes.Structure):
+    _fields_ = [("run", u16), ("timeDate", u32), ("nBoards", ctypes.c_int32), ("value", (u16*12)*8)]
+
+class BOR(ctypes.Structure):
+    _fields_ = [("run", u16), ("timeDate", u32), ("version", u8*2), ("pmtDAC", u16*5), ("tofDAC", u16*2),
+                ("setting", u8*12), ("tkrThresholdOffset", u8*8), ("tkrMasterDelay", u8), ("tkrTriggerSource", u8),
+                ("tkrLogic", u8), ("tkrBoard", (u8*5)*8)]
+
+class EOR(ctypes.Structure):
+    _fields_ = [("run", u16), ("cntGo1", u32), ("cntGo", u32), ("nBadCRC", u8), ("nTkrReadReady", u32),
+                ("nTkrReadNotReady", u16), ("tofStops", u8*4), ("nBusy", u32), ("nTkrMasterGo", u16),
+                ("layerTriggers", u16*8), ("layerReads", u16*8), ("layerCounts", (u8*5)*8), ("runCounters", u8*47)]
+
+class ErrorEntry(ctypes.Structure):
+    _fields_ = [("code", u8), ("info", u8*2), ("usec", u32), ("event", u32)]
+
+class ErrorStream(ctypes.Structure):
+    _fields_ = [("nErrors", u8), ("nLost", u8), ("entries", ErrorEntry*255)]
+
+class ErrorRecord(ctypes.Structure):
+    _fields_ = [("eventCount", u32), ("timeDate", u32), ("payloadOffset", ctypes.c_uint64)]
+
+_lib = None
+
+def library():
+    global _lib
+    if _lib is not None: return _lib
+    path = os.environ.get("AESOPDAQ_LIB",
+                          os.path.join(os.path.dirname(os.path.abspath(__file__)), "libaesopdaq", "build", "libaesopdaq.so"))
+    lib = ctypes.CDLL(path)
+    lib.adq_sizeof.restype = ctypes.c_size_t
+    lib.adq_sizeof.argtypes = [ctypes.c_char_p]
+    for name, size in (("event", runFile.eventDtype.itemsize), ("cluster", runFile.clusterDtype.itemsize),
+                       ("frame", ctypes.sizeof(Frame)), ("stats", ctypes.sizeof(Stats)),
+                       ("hitlist", ctypes.sizeof(HitList)), ("housekeeping", ctypes.sizeof(Housekeeping)),
+                       ("tkr_housekeeping", ctypes.sizeof(TkrHousekeeping)), ("bor", ctypes.sizeof(BOR)),
+                       ("eor", ctypes.sizeof(EOR)), ("error_stream", ctypes.sizeof(ErrorStream)),
+                       ("error_record", ctypes.sizeof(ErrorRecord)), ("index_entry", runIndex.indexDtype.itemsize)):
+        if lib.adq_sizeof(name.encode()) != size:
+            raise ImportError(path + ": the size of " + name + " does not match aesopdaq.py")
+    buf = ctypes.c_void_p
+    lib.adq_frames.restype = ctypes.c_size_t
+    lib.adq_frames.argtypes = [buf, ctypes.c_size_t, ctypes.POINTER(Frame), ctypes.c_size_t, ctypes.POINTER(Stats)]
+    lib.adq_decode_events.restype = ctypes.c_size_t
+    lib.adq_decode_events.argtypes = [buf, ctypes.c_size_t, ctypes.c_uint32, ctypes.c_uint32,
+                                      ctypes.POINTER(ctypes.c_int64), buf, ctypes.c_size_t, buf, ctypes.c_size_t,
+                                      ctypes.POINTER(Stats)]
+    lib.adq_reprocess.restype = ctypes.c_int
+    lib.adq_reprocess.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_uint, ctypes.c_size_t,
+                                  ctypes.POINTER(Stats), ctypes.c_char_p, ctypes.c_size_t]
+    lib.adq_index_file.restype = ctypes.c_int64
+    lib.adq_index_file.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(Stats), ctypes.c_char_p,
+                                   ctypes.c_size_t]
+    lib.adq_crc6.restype = ctypes.c_uint8
+    lib.adq_crc6.argtypes = [buf, ctypes.c_size_t]
+    for name, struct in (("hitlist", HitList), ("housekeeping", Housekeeping), ("tkr_housekeeping", TkrHousekeeping),
+                         ("bor", BOR), ("eor", EOR), ("error_stream", ErrorStream), ("error_record", ErrorRecord)):
+        func = getattr(lib, "adq_decode_" + name)
+        func.restype = ctypes.c_int
+        func.argtypes = [buf, ctypes.c_size_t, ctypes.POINTER(struct)]
+    _lib = lib
+    return lib
+
+# Address and length of a bytes-like object, without copying it if it is writable or bytes
+def _buffer(data):
+    if isinstance(data, list): data = b''.join(data)
+    array = np.frombuffer(data, dtype=np.uint8)
+    return array, array.ctypes.data, len(array)
+
+def _toPython(value):
+    if isinstance(value, ctypes.Array): return [_toPython(v) for v in value]
+    if isinstance(value, ctypes.Structure): return {name: _toPython(getattr(value, name)) for name, t in value._fields_}
+    return value
+
+# Yield (offset, packet type, command data, output data) for each good frame in the buffer
+def frames(buffer, batch = 4096):
+    lib = library()
+    array, address, length = _buffer(buffer)
+    view = memoryview(array)
+    out = (Frame*batch)()
+    stats = Stats()
+    pos = 0
+    while True:
+        n = lib.adq_frames(address + pos, length - pos, out, batch, ctypes.byref(stats))
+        for f in out[:n]:
+            start = pos + f.dataOffset
+            yield pos + f.offset, f.packetType, view[start - f.nCmdData:start], view[start:start + f.dataLength]
+        pos += stats.consumed
+        if n < batch: return
+
+# Decode the event frames in the buffer. Returns (events, clusters, stats), with the events and clusters in the
+# layouts of runFile.eventDtype and runFile.clusterDtype, and stats a dictionary of counts, including the bytes
+# consumed (anything after that is an incomplete frame, to be decoded with the next buffer).
+def decodeEvents(buffer, firstEvent = 0, firstCluster = 0, lastTime = 0):
+    lib = library()
+    array, address, length = _buffer(buffer)
+    nMax = length//48 + 1                      # An event frame is at least 48 bytes long
+    events = np.zeros(nMax, dtype=runFile.eventDtype)
+    clusters = np.zeros(1024 + nMax*40, dtype=runFile.clusterDtype)
+    time = ctypes.c_int64(lastTime)
+    stats = Stats()
+    total = dict.fromkeys(name for name, t in Stats._fields_)
+    for name in total: total[name] = 0
+    nEvents = 0
+    nClusters = 0
+    pos = 0
+    while True:
+        if len(clusters) - nClusters < 8*225: clusters = np.resize(clusters, 2*len(clusters))
+        n = lib.adq_decode_events(address + pos, length - pos, firstEvent + nEvents, firstCluster + nClusters,
+                                  ctypes.byref(time), events[nEvents:].ctypes.data, len(events) - nEvents,
+                                  clusters[nClusters:].ctypes.data, len(clusters) - nClusters, ctypes.byref(stats))
+        for name in total: total[name] += getattr(stats, name)
+        nEvents += n
+        nClusters += stats.nClusters
+        pos += stats.consumed
+        if stats.consumed == 0 or pos == length or nEvents == len(events): break
+    total["lastTime"] = time.value
+    return events[:nEvents], clusters[:nClusters], total
+
+# Decode a raw event PSOC stream saved in a file into run<N>_events.npy, run<N>_clusters.npy and
+# run<N>_occupancy.npy, as limitedRun would have written them, splitting the file into chunks of chunkMB
+# megabytes decoded on nThreads threads (0 for all cores). Returns the dictionary of counts; read the output
+# with runFile.loadRun(runNumber, directory).
+def reprocess(fileName, runNumber, directory = ".", nThreads = 0, chunkMB = 8):
+    stats = Stats()
+    error = ctypes.create_string_buffer(512)
+    if library().adq_reprocess(os.fsencode(fileName), os.fsencode(directory), runNumber, nThreads,
+                               int(chunkMB*(1 << 20)), ctypes.byref(stats), error, len(error)) != 0:
+        raise IOError(error.value.decode())
+    return _toPython(stats)
+
+# Returns the number of records indexed and the frame statistics
+def indexFile(fileName, indexFile):
+    stats = Stats()
+    error = ctypes.create_string_buffer(512)
+    n = library().adq_index_file(os.fsencode(fileName), os.fsencode(indexFile), ctypes.byref(stats), error, len(error))
+    if n < 0: raise IOError(error.value.decode())
+    return n, _toPython(stats)
+
+def decodeHitList(data):
+    lib = library()
+    array, address, length = _buffer(data)
+    out = HitList()
+    lib.adq_decode_hitlist(address, length, ctypes.byref(out))
+    result = {name: getattr(out, name) for name in ("rc", "FPGA", "tag", "errorFlag", "nChips")}
+    result["chips"] = np.frombuffer(bytes(out.chips), dtype=hitDecoder.chipDtype)[:out.nChipHeaders].copy()
+    result["clusters"] = np.frombuffer(bytes(out.clusters), dtype=hitDecoder.clusterDtype)[:out.nClusters].copy()
+    if out.rc < 0:
+        result.update({"crc": None, "crcLength": 0, "crcCalc": None, "trailerOK": False})
+    else:
+        result.update({"crc": out.crc, "crcLength": out.crcLength, "crcCalc": out.crcCalc, "trailerOK": bool(out.trailerOK)})
+    return result
+
+# CRC6 of a 1 followed by the first nBits bits of the data
+def crc6(data, nBits):
+    array, address, length = _buffer(data)
+    return library().adq_crc6(address, nBits)
+
+def _decodeRecord(name, struct, data):
+    array, address, length = _buffer(data)
+    out = struct()
+    if getattr(library(), "adq_decode_" + name)(address, length, ctypes.byref(out)) != 0: return None
+    return _toPython(out)
+
+def decodeHousekeeping(data): return _decodeRecord("housekeeping", Housekeeping, data)
+def decodeTkrHousekeeping(data): return _decodeRecord("tkr_housekeeping", TkrHousekeeping, data)
+def decodeBOR(data): return _decodeRecord("bor", BOR, data)
+def decodeEOR(data): return _decodeRecord("eor", EOR, data)
+def decodeErrorRecord(data): return _decodeRecord("error_record", ErrorRecord, data)
+
+def decodeErrorStream(data):
+    record = _decodeRecord("error_stream", ErrorStream, data)
+    if record is not None: record["entries"] = record["entries"][:record["nErrors"]]
+    return record
@@ -0,0 +1,91 @@
+# Buffered reader for the packets sent by the event PSOC. Each packet is framed as
+#    DC 00 FF, length L, packet type, number of command data bytes N, L bytes (N command data bytes followed by
+#    the output data), padding to a multiple of 3 bytes, FF 00 FF
+# The port is read in large chunks into a bytearray, instead of one byte per call, and the frames are found with
+# bytes.find, so that the Python loop keeps up with the data rate.
+import time
+
+HEADER = b'\xDC\x00\xFF'
+TRAILER = b'\xFF\x00\xFF'
+
+# Number of bytes in a frame with L data bytes
+def frameLength(L):
+    return 9 + L + (3 - L%3)%3
+
+class FrameReader:
+    def __init__(self, port, chunkSize = 4096):
+        self.port = port            # A serial port, or any object with a read(n) method, such as an open file
+        self.chunkSize = chunkSize
+        self.buf = bytearray()
+        self.pos = 0                # Start of the unread data in buf
+        self.nSkipped = 0           # Bytes thrown away while looking for a header
+        self.nBadFrames = 0         # Frames with a bad trailer
+        self.dump = None            # File open for writing that gets a copy of every byte read from the port
+
+    # Read whatever the port has available, waiting up to the port time-out for at least one byte.
+    # Returns False if nothing arrived.
+    def fill(self):
+        nWaiting = getattr(self.port, 'in_waiting', self.chunkSize)
+        data = self.port.read(min(max(nWaiting, 1), self.chunkSize))
+        if not data: return False
+        if self.dump is not None: self.dump.write(data)
+        if self.pos > 0 and self.pos >= len(self.buf)//2:   # Drop consumed bytes now and then, not on every frame
+            del self.buf[:self.pos]
+            self.pos = 0
+        self.buf += data
+        return True
+
+    # Drop everything buffered and anything waiting on the port
+    def flush(self):
+        self.buf = bytearray()
+        self.pos = 0
+        if hasattr(self.port, 'reset_input_buffer'): self.port.reset_input_buffer()
+
+    # Read n raw bytes, taking buffered bytes first, for the few replies that are not framed packets
+    def read(self, n = 1):
+        while len(self.buf) - self.pos < n:
+            if not self.fill(): break
+        data = bytes(self.buf[self.pos:self.pos + n])
+        self.pos += len(data)
+        return data
+
+    # Return the next good frame as (packet type, memoryview), where the view starts with the number of command
+    # data bytes, followed by the command data and the output data (padding excluded). Returns None if no complete
+    # frame arrives within timeout seconds (None means wait for as long as the port keeps delivering data).
+    def readFrame(self, timeout = None):
+        tStart = time.time()
+        while True:
+            frame = self.nextBuffered()
+            if frame is not None: return frame
+            if timeout is not None and time.time() - tStart > timeout: return None
+            if not self.fill() and timeout is None: return None
+
+    # Look for a complete frame in the bytes already buffered
+    def nextBuffered(self):
+        while True:
+            start = self.buf.find(HEADER, self.pos)
+            if start < 0:
+                keep = max(self.pos, len(self.buf) - 2)   # The end could be the start of a header
+                self.nSkipped += keep - self.pos
+                self.pos = keep
+                return None
+            self.nSkipped += start - self.pos
+            self.pos = start
+            if len(self.buf) - start < 6: return None
+            L = self.buf[start + 3]
+            end = start + frameLength(L)
+            if len(self.buf) < end: return None
+            if self.buf[end - 3:end] != TRAILER:
+                self.nBadFrames += 1
+                self.pos = start + 1                        # Resynchronize on the next header
+                continue
+            packetType = self.buf[start + 4]
+            body = memoryview(bytes(self.buf[start + 5:start + 6 + L]))
+            self.pos = end
+            return packetType, body
+
+    def __iter__(self):
+        while True:
+            frame = self.readFrame()
+            if frame is None: return
+            yield frame
@@ -0,0 +1,209 @@
+# Decoder for the ASIC hit lists sent by the tracker FPGAs, working directly on the raw bytes.
+# The hit list is a bit stream (most significant bit of each byte first):
+#    11100111, 1 bit (not used), 7-bit FPGA address,
+#    FPGA header: 7-bit event tag, error flag, 4-bit number of chips,
+#    for each chip: 12-bit header (overflow, unused, 4-bit number of clusters, error, parity error, 4-bit chip address)
+#                   followed by 12 bits per cluster (6-bit width-1, 6-bit first strip),
+#    6-bit CRC, trailing 11
+# The whole list is held in one Python integer and the fields are pulled out with shifts and masks, instead of
+# slicing a string of '0' and '1' characters, and the CRC is computed a byte at a time from a lookup table.
+import numpy as np
+
+CRC6_POLY = 0x65          # 1'100101
+
+# Remainder of every 14-bit value (6-bit remainder followed by a new byte) divided by the CRC polynomial
+def _mkCRC6table():
+    table = np.zeros(1 << 14, dtype=np.uint8)
+    for v in range(1 << 14):
+        r = v
+        for bit in range(13, 5, -1):
+            if r & (1 << bit): r ^= CRC6_POLY << (bit - 6)
+        table[v] = r
+    return table.tolist()
+
+CRC6_TABLE = _mkCRC6table()
+
+# CRC6 of the nBits least significant bits of value, the same as PSOC_cmd.CRC6 on the equivalent bit string
+def crc6(value, nBits):
+    r = 0
+    nLead = nBits % 8
+    for i in range(nBits - 1, nBits - 1 - nLead, -1):
+        r = (r << 1) | ((value >> i) & 1)
+        if r & 0x40: r ^= CRC6_POLY
+    for shift in range(nBits - nLead - 8, -1, -8):
+        r = CRC6_TABLE[(r << 8) | ((value >> shift) & 0xFF)]
+    return r
+
+chipDtype = np.dtype([('chip', np.uint8), ('nClusters', np.uint8), ('overflow', np.uint8),
+                      ('error', np.uint8), ('parity', np.uint8)])
+clusterDtype = np.dtype([('chip', np.uint8), ('firstStrip', np.uint8), ('width', np.uint8),
+                         ('error', np.uint8), ('parity', np.uint8)])
+
+# Decode one hit list, given as bytes (or a list of single bytes, as returned by getData).
+# Returns a dictionary with rc (number of errors found, -1 for an empty list and -2 for a bad start), the FPGA
+# address, event tag, error flag and number of chips from the FPGA header, an array of chip headers, an array of
+# clusters, and the received and calculated CRC.
+def decodeHitList(data):
+    if isinstance(data, list): data = b''.join(data)
+    result = {"rc": 0, "FPGA": 0, "tag": 0, "errorFlag": 0, "nChips": 0,
+              "chips": np.zeros(0, dtype=chipDtype), "clusters": np.zeros(0, dtype=clusterDtype),
+              "crc": None, "crcLength": 0, "crcCalc": None, "trailerOK": False}
+    nBits = 8*len(data)
+    if nBits == 0:
+        result["rc"] = -1
+        return result
+    if data[0] != 0xE7:
+        result["rc"] = -2
+        return result
+    value = int.from_bytes(data, 'big')
+
+    def field(pointer, n):    # n bits starting at bit pointer, counted from the start of the list
+        end = min(pointer + n, nBits)
+        if end <= pointer: return 0
+        return (value >> (nBits - end)) & ((1 << (end - pointer)) - 1)
+
+    rc = 0
+    result["FPGA"] = field(9, 7)
+    FPGAheader = field(16, 12)
+    result["tag"] = FPGAheader >> 5
+    result["errorFlag"] = (FPGAheader >> 4) & 1
+    nChips = FPGAheader & 0xF
+    result["nChips"] = nChips
+    pointer = 28
+    chips = []
+    clusters = []
+    for chip in range(nChips):
+        if nBits < pointer + 12: continue
+        head = field(pointer, 12)
+        nClust = (head >> 6) & 0xF
+        chipNum = head & 0xF
+        overflow = head >> 11
+        error = (head >> 5) & 1
+        parity = (head >> 4) & 1
+        if chipNum > 12: rc += 1
+        chips.append((chipNum, nClust, overflow, error, parity))
+        if nBits < pointer + 12 + 12*nClust:     # Truncated cluster list
+            rc += 1
+            pointer = nBits
+            break
+        if nClust == 0:
+            rc += 1
+        else:
+            words = field(pointer + 12, 12*nClust)
+            for i in range(nClust - 1, -1, -1):
+                word = (words >> (12*i)) & 0xFFF
+                clusters.append((chipNum, word & 0x3F, (word >> 6) + 1, error, parity))
+        pointer += 12 + 12*nClust
+    result["chips"] = np.array(chips, dtype=chipDtype)
+    result["clusters"] = np.array(clusters, dtype=clusterDtype)
+    result["crc"] = field(pointer, 6)
+    result["crcLength"] = max(0, min(6, nBits - pointer))
+    result["crcCalc"] = crc6((1 << pointer) | field(0, pointer), pointer + 1)   # The FPGA included the suppressed start bit
+    if nBits < pointer + 6 or result["crc"] != result["crcCalc"]: rc += 1
+    result["trailerOK"] = nBits >= pointer + 8 and field(pointer + 6, 2) == 3
+    if not result["trailerOK"]: rc += 1
+    result["rc"] = rc
+    return result
+
+def _bits(value, n):
+    return format(value, '0{:d}b'.format(n)) if n > 0 else ""
+
+# Print a hit list decoded by decodeHitList, in the format of parseHitList. Errors are always printed, the chip and
+# cluster contents only if verbose.
+def printHitList(result, verbose = True):
+    if result["rc"] == -1:
+        print("    Error: ASIC hit list is empty")
+        return
+    if result["rc"] == -2:
+        print("    Error: ASIC hit list does not begin with 11100111")
+        return
+    if verbose:
+        print("      ASIC hit list for FPGA address " + str(result["FPGA"]))
+        print("          Event tag= " + str(result["tag"]) + " Error flag= " + str(result["errorFlag"]) + " Number of chips= " + str(result["nChips"]))
+    clusters = result["clusters"]
+    iClust = 0
+    for chip in result["chips"]:
+        if chip["chip"] > 12: print("    Error: Chip number " + str(chip["chip"]) + " > 12")
+        if verbose:
+            print("          Chip {:d}: {:d} clusters, Overflow={:d}, Error={:d}, Parity error={:d}".format(chip["chip"],chip["nClusters"],chip["overflow"],chip["error"],chip["parity"]))
+        nClust = min(int(chip["nClusters"]), len(clusters) - iClust)
+        if nClust < chip["nClusters"]: print("    Error:       Wrong length cluster list for " + str(chip["nClusters"]) + " clusters.")
+        if verbose:
+            for clust in clusters[iClust:iClust + nClust]:
+                print("              Cluster width={:d}   First strip={:d}".format(clust["width"],clust["firstStrip"]))
+        iClust += nClust
+    if result["crcLength"] != 6 or result["crc"] != result["crcCalc"]:
+        print("    CRC mismatch: received " + _bits(result["crc"], result["crcLength"]) + " and calculated " + _bits(result["crcCalc"], 6))
+    if not result["trailerOK"]: print("    Error: the trailing '11' bits are missing")
+
+# Drop-in replacement for PSOC_cmd.ParseASIChitList(getBinaryString(data), verbose), with the same printout and
+# the same return value [rc, FPGA address, first strip of each cluster, widths of the clusters of the last chip].
+# A hit list too short for the FPGA header or with a truncated cluster list, on which the bit-string parser raises an
+# exception, is reported as a truncated hit list and counted in rc, in the same way as by decodeHitList.
+def parseHitList(data, verbose):
+    if isinstance(data, list): data = b''.join(data)
+    nBits = 8*len(data)
+    if nBits == 0:
+        print("    Error: ASIC hit list is empty")
+        return [-1,0]
+    if data[0] != 0xE7:
+        print("    Error: ASIC hit list " + _bits(data[0], 8) + "... does not begin with 11100111")
+        return [-2,0]
+    value = int.from_bytes(data, 'big')
+
+    def field(pointer, n):
+        end = min(pointer + n, nBits)
+        if end <= pointer: return 0, 0
+        return (value >> (nBits - end)) & ((1 << (end - pointer)) - 1), end - pointer
+
+    rc = 0
+    FPGAaddress = field(9, 7)[0]
+    if verbose and nBits >= 16: print("      ASIC hit list for FPGA address " + str(FPGAaddress))
+    if nBits < 28:
+        print("    Error: truncated hit list, " + str(nBits) + " bits")
+        numberOfChips = 0
+    else:
+        FPGAheader = field(16, 12)[0]
+        numberOfChips = FPGAheader & 0xF
+        if verbose: print("          Event tag= " + str(FPGAheader >> 5) + " Error flag= " + str((FPGAheader >> 4) & 1) + " Number of chips= " + str(numberOfChips))
+    pointer = 28
+    firstStripChip = []
+    clustWidthList = []
+    for chip in range(numberOfChips):
+        if nBits < pointer + 12: continue
+        head = field(pointer, 12)[0]
+        numberOfClusters = (head >> 6) & 0xF
+        chipNum = head & 0xF
+        if chipNum > 12:
+            rc = rc + 1
+            print("    Error: Chip number " + str(chipNum) + " > 12")
+        if verbose:
+            print("          Chip {:d}: {:d} clusters, Overflow={:d}, Error={:d}, Parity error={:d}".format(chipNum,numberOfClusters,head >> 11,(head >> 5) & 1,(head >> 4) & 1))
+        nClustBits = min(12*numberOfClusters, nBits - pointer - 12)
+        if nClustBits != 12*numberOfClusters:
+            print("    Error:       Wrong length cluster list. " + str(12 + nClustBits) + " bits for " + str(numberOfClusters) + " clusters.")
+            print("    Error: truncated hit list, " + str(nBits) + " bits")
+            rc = rc + 1
+            clustWidthList = []
+            pointer = nBits
+            break
+        words = field(pointer + 12, nClustBits)[0]
+        clustWidthList = []
+        for i in range(numberOfClusters - 1, -1, -1):
+            word = (words >> (12*i)) & 0xFFF
+            firstStrip = word & 0x3F
+            if verbose: print("              Cluster width={:d}   First strip={:d}".format((word >> 6) + 1,firstStrip))
+            firstStripChip.append(64*(chipNum+1) - firstStrip)
+            clustWidthList.append((word >> 6) + 1)
+        if numberOfClusters == 0: rc = rc + 1
+        pointer = pointer + 12 + numberOfClusters*12
+    CRC, nCRC = field(pointer, 6)
+    newCRC = crc6((1 << pointer) | field(0, pointer)[0], pointer + 1)
+    if nCRC != 6 or CRC != newCRC:
+        rc = rc + 1
+        print("    CRC mismatch: received " + _bits(CRC, nCRC) + " and calculated " + _bits(newCRC, 6))
+    trailer, nTrailer = field(pointer + 6, 2)
+    if nTrailer != 2 or trailer != 3:
+        rc = rc + 1
+        print("    Error: the trailing '11' bits are missing")
+    return [rc,FPGAaddress,firstStripChip,clustWidthList]
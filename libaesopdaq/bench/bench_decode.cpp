@@ -0,0 +1,44 @@
+// Decoding rate of libaesopdaq on a synthetic event stream.
+//    bench_decode [number of events] [number of passes]
+// The stream (mkEventStream in synthetic.hpp) holds event records with 8 tracker layers of well formed hit lists
+// at flight occupancy, with a housekeeping record every 1000 events, all framed as the event PSOC sends them.
+// Each pass decodes the whole stream into event and cluster arrays with adq_decode_events, as aesopdaq.py does.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "aesopdaq/capi.h"
+#include "aesopdaq/records.hpp"
+#include "synthetic.hpp"
+
+using namespace aesopdaq;
+using namespace aesopdaq::bench;
+
+int main(int argc, char** argv) {
+    int nEvents = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int nPasses = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::vector<uint8_t> stream = mkEventStream(nEvents);
+    std::vector<adq_event> events(nEvents);
+    std::vector<adq_cluster> clusters(size_t(nEvents)*40 + MAX_TKR_LAYERS*MAX_HIT_CLUSTERS);
+    std::printf("%d events, %zu bytes\n", nEvents, stream.size());
+
+    double best = 1.e9;
+    adq_stats stats;
+    for (int pass = 0; pass < nPasses; ++pass) {
+        int64_t lastTime = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        adq_decode_events(stream.data(), stream.size(), 0, 0, &lastTime, events.data(), events.size(),
+                          clusters.data(), clusters.size(), &stats);
+        std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+        if (dt.count() < best) best = dt.count();
+    }
+    unsigned long nBadTkr = 0;
+    for (const adq_event& e : events) nBadTkr += e.tkrErrors;
+    std::printf("%llu events, %llu clusters, %llu other frames, %llu bad events, %lu tracker errors\n",
+                (unsigned long long)stats.nEvents, (unsigned long long)stats.nClusters,
+                (unsigned long long)stats.nOther, (unsigned long long)stats.nBadEvents, nBadTkr);
+    std::printf("best of %d passes: %.3f s, %.0f events/s, %.1f MB/s\n", nPasses, best, stats.nEvents/best,
+                stream.size()/best/1.e6);
+    return stats.nEvents == size_t(nEvents) && nBadTkr == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Hit list decoding rate: the field-by-field reference decoder against the unpacked decoder at each SIMD level.
+//    bench_hitlist [number of lists] [number of passes]
+// Two samples are generated (see synthetic.hpp): flight occupancy, mostly one chip with one narrow cluster per
+// layer, and shower occupancy, 4 to 12 chips with several clusters each. Copies of the lists with a flipped bit or
+// cut short are added to check that all of the decoders give the same result; the timing uses the good lists only.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "aesopdaq/hitlist.hpp"
+#include "aesopdaq/unpack.hpp"
+#include "synthetic.hpp"
+
+using namespace aesopdaq;
+using namespace aesopdaq::bench;
+
+namespace {
+
+using List = std::vector<uint8_t>;
+
+bool sameResult(const HitList& a, const HitList& b) {
+    if (a.rc != b.rc || a.fpga != b.fpga || a.tag != b.tag || a.errorFlag != b.errorFlag || a.nChips != b.nChips ||
+        a.crc != b.crc || a.crcLength != b.crcLength || a.crcCalc != b.crcCalc || a.trailerOK != b.trailerOK ||
+        a.nChipHeaders != b.nChipHeaders || a.nClusters != b.nClusters) return false;
+    return std::memcmp(a.chips, b.chips, a.nChipHeaders*sizeof(ChipHeader)) == 0 &&
+           std::memcmp(a.clusters, b.clusters, a.nClusters*sizeof(HitCluster)) == 0;
+}
+
+template <typename Decode>
+double timeDecoder(const std::vector<List>& lists, int nPasses, Decode decode, long& checksum) {
+    HitList out;
+    double best = 1.e9;
+    for (int pass = 0; pass < nPasses; ++pass) {
+        checksum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (const List& l : lists) {
+            decode(ByteSpan(l.data(), l.size()), out);
+            checksum += out.rc + out.nClusters + (out.nClusters ? out.clusters[out.nClusters-1].firstStrip : 0);
+        }
+        std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+        if (dt.count() < best) best = dt.count();
+    }
+    return best;
+}
+
+int runSample(const char* name, Occupancy occ, int nLists, int nPasses, const std::vector<SimdLevel>& levels) {
+    std::mt19937 rng(4321);
+    std::vector<List> lists;
+    std::vector<List> damaged;
+    size_t nBytes = 0;
+    for (int i = 0; i < nLists; ++i) {
+        lists.push_back(mkHitList(rng, 1 + i%8, occ));
+        nBytes += lists.back().size();
+        List bad = lists.back();
+        if (i%2 == 0) {
+            size_t bit = rng() % (8*bad.size());
+            bad[bit/8] ^= uint8_t(0x80 >> (bit%8));
+        } else {
+            bad.resize(rng() % (bad.size() + 1));
+        }
+        damaged.push_back(bad);
+    }
+
+    int nBad = 0;
+    HitList ref;
+    HitList out;
+    for (const std::vector<List>* sample : {&lists, &damaged}) {
+        for (const List& l : *sample) {
+            decodeHitListScalar(ByteSpan(l.data(), l.size()), ref);
+            for (SimdLevel level : levels) {
+                decodeHitList(ByteSpan(l.data(), l.size()), out, level);
+                if (!sameResult(ref, out)) ++nBad;
+            }
+        }
+    }
+
+    std::printf("%s occupancy: %d lists, %.1f bytes per list, %d mismatches\n", name, nLists, double(nBytes)/nLists, nBad);
+    long refSum = 0;
+    double tRef = timeDecoder(lists, nPasses, decodeHitListScalar, refSum);
+    std::printf("   %-22s %7.1f ns per list\n", "field by field", 1.e9*tRef/nLists);
+    for (SimdLevel level : levels) {
+        long sum = 0;
+        double t = timeDecoder(lists, nPasses, [level](ByteSpan d, HitList& h) { decodeHitList(d, h, level); }, sum);
+        if (sum != refSum) ++nBad;
+        std::printf("   unpacked, %-12s %7.1f ns per list, %.2fx\n", simdName(level), 1.e9*t/nLists, tRef/t);
+    }
+
+    // The unpacking step alone, over whole lists
+    uint16_t words[MAX_HIT_WORDS + 16];
+    uint8_t fields[2*MAX_HIT_WORDS + 32];
+    for (SimdLevel level : levels) {
+        double best = 1.e9;
+        size_t nWords = 0;
+        for (int pass = 0; pass < nPasses; ++pass) {
+            nWords = 0;
+            auto t0 = std::chrono::steady_clock::now();
+            for (const List& l : lists) {
+                size_t n = (8*l.size() - 16)/12;
+                unpack12(l.data() + 2, l.size() - 2, n, words, fields, level);
+                nWords += n + words[n/2];
+            }
+            std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+            if (dt.count() < best) best = dt.count();
+        }
+        std::printf("   unpack12 only, %-7s %7.1f ns per list\n", simdName(level), 1.e9*best/nLists);
+    }
+    return nBad;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int nLists = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int nPasses = argc > 2 ? std::atoi(argv[2]) : 5;
+    std::vector<SimdLevel> levels = {SimdLevel::Scalar};
+    if (simdLevel() >= SimdLevel::SSE41) levels.push_back(SimdLevel::SSE41);
+    if (simdLevel() >= SimdLevel::AVX2) levels.push_back(SimdLevel::AVX2);
+    std::printf("best SIMD level on this machine: %s\n", simdName(simdLevel()));
+    int nBad = runSample("flight", flightOccupancy(), nLists, nPasses, levels);
+    nBad += runSample("shower", showerOccupancy(), nLists/4, nPasses, levels);
+    return nBad == 0 ? 0 : 1;
+}
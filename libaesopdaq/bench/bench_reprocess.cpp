@@ -0,0 +1,48 @@
+// Scaling of reprocess with the number of threads, on a synthetic stream (mkEventStream in synthetic.hpp).
+//    bench_reprocess [number of events] [directory]
+// The run files go to the directory (default /tmp) as run0_*.npy, and the stream is saved there as
+// synthetic_stream.bin, for trying aesop_reprocess or the Python side on it.
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aesopdaq/reprocess.hpp"
+#include "synthetic.hpp"
+
+using namespace aesopdaq;
+using namespace aesopdaq::bench;
+
+int main(int argc, char** argv) {
+    int nEvents = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::string directory = argc > 2 ? argv[2] : "/tmp";
+    std::vector<uint8_t> stream = mkEventStream(nEvents);
+    std::FILE* f = std::fopen((directory + "/synthetic_stream.bin").c_str(), "wb");
+    if (f != nullptr) {
+        std::fwrite(stream.data(), 1, stream.size(), f);
+        std::fclose(f);
+    }
+    std::printf("%d events, %zu bytes, %u hardware threads\n", nEvents, stream.size(),
+                std::thread::hardware_concurrency());
+
+    ReprocessOptions options;
+    options.chunkSize = size_t(4) << 20;
+    double t1 = 0;
+    unsigned maxThreads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    for (unsigned nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+        options.nThreads = nThreads;
+        ReprocessResult result;
+        std::string error = reprocess(ByteSpan(stream.data(), stream.size()), directory, 0, options, result);
+        if (!error.empty()) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        if (nThreads == 1) t1 = result.seconds;
+        std::printf("%2u threads: %zu chunks, %llu events in %.3f s, %.0f events/s, speed-up %.2f\n", nThreads,
+                    result.nChunks, (unsigned long long)result.stats.nEvents, result.seconds,
+                    result.stats.nEvents/result.seconds, t1/result.seconds);
+        if (result.stats.nEvents != size_t(nEvents)) return 1;
+    }
+    return 0;
+}
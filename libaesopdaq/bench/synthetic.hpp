@@ -0,0 +1,120 @@
+// Synthetic hit lists and event frames for the benchmarks.
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "aesopdaq/frames.hpp"
+#include "aesopdaq/hitlist.hpp"
+
+namespace aesopdaq {
+namespace bench {
+
+class BitWriter {
+public:
+    void put(uint32_t value, int n) {
+        for (int i = n - 1; i >= 0; --i) bits_.push_back((value >> i) & 1);
+    }
+    size_t size() const { return bits_.size(); }
+    std::vector<uint8_t> bytes() const {
+        std::vector<uint8_t> out((bits_.size() + 7)/8, 0);
+        for (size_t i = 0; i < bits_.size(); ++i) out[i/8] |= bits_[i] << (7 - i%8);
+        return out;
+    }
+
+private:
+    std::vector<uint8_t> bits_;
+};
+
+// Chips hit and clusters per chip of one layer
+struct Occupancy {
+    std::discrete_distribution<int> nChips;
+    std::discrete_distribution<int> nClusters;
+    std::discrete_distribution<int> width;
+};
+
+// Mostly single tracks, as in flight: a layer has no hit chip or one chip with a narrow cluster
+inline Occupancy flightOccupancy() {
+    return Occupancy{std::discrete_distribution<int>{20, 65, 12, 2, 1},
+                     std::discrete_distribution<int>{0, 85, 12, 2, 1},
+                     std::discrete_distribution<int>{0, 70, 22, 5, 3}};
+}
+
+// Showers and noisy layers: many chips with several clusters each
+inline Occupancy showerOccupancy() {
+    return Occupancy{std::discrete_distribution<int>{0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2},
+                     std::discrete_distribution<int>{0, 2, 3, 3, 2, 2, 1},
+                     std::discrete_distribution<int>{0, 40, 30, 15, 10, 5}};
+}
+
+// A well formed hit list with a correct CRC and trailer
+inline std::vector<uint8_t> mkHitList(std::mt19937& rng, int fpga, Occupancy& occ) {
+    BitWriter w;
+    w.put(0xE7, 8);
+    w.put(0, 1);
+    w.put(fpga, 7);
+    int nChips = occ.nChips(rng);
+    w.put(rng() % 128, 7);
+    w.put(0, 1);
+    w.put(nChips, 4);
+    for (int chip = 0; chip < nChips; ++chip) {
+        int nClust = occ.nClusters(rng);
+        w.put(0, 2);
+        w.put(nClust, 4);
+        w.put(0, 2);
+        w.put(rng() % 12, 4);
+        for (int i = 0; i < nClust; ++i) {
+            w.put(occ.width(rng) - 1, 6);
+            w.put(rng() % 64, 6);
+        }
+    }
+    std::vector<uint8_t> body = w.bytes();
+    w.put(crc6(ByteSpan(body.data(), body.size()), w.size()), 6);
+    w.put(3, 2);
+    return w.bytes();
+}
+
+inline void addFrame(std::vector<uint8_t>& out, uint8_t packetType, const std::vector<uint8_t>& data) {
+    size_t L = data.size();
+    out.insert(out.end(), {0xDC, 0x00, 0xFF, uint8_t(L), packetType, 0x00});
+    out.insert(out.end(), data.begin(), data.end());
+    out.resize(out.size() + frameLength(L) - 9 - L, 0);
+    out.insert(out.end(), {0xFF, 0x00, 0xFF});
+}
+
+inline void put32(std::vector<uint8_t>& d, uint32_t v) {
+    d.insert(d.end(), {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v)});
+}
+
+// Event records with 8 tracker layers of hit lists at flight occupancy, and a housekeeping record every 1000 events
+inline std::vector<uint8_t> mkEventStream(int nEvents) {
+    std::mt19937 rng(12345);
+    Occupancy occ = flightOccupancy();
+    std::vector<uint8_t> stream;
+    for (int evt = 0; evt < nEvents; ++evt) {
+        std::vector<uint8_t> d = {'Z', 'E', 'R', 'O', 0x00, 0x01};
+        put32(d, evt + 1);
+        put32(d, 2*evt);
+        put32(d, rng() % 10);
+        put32(d, 0x5A4B1234);
+        d.push_back(0x03);
+        for (int i = 0; i < 12; ++i) d.push_back(rng() & 0xFF);
+        d.insert(d.end(), {0x00, uint8_t(evt), 0x00});
+        d.push_back(0x08);                  // Re-arm to GO interval present
+        d.insert(d.end(), {0x00, 0x01, 0x20, 0x00});
+        d.push_back(8);
+        for (int lyr = 0; lyr < 8; ++lyr) {
+            std::vector<uint8_t> hits = mkHitList(rng, lyr == 0 ? 8 : lyr, occ);
+            while (d.size() + 1 + hits.size() > 255 - 8 + lyr) hits = mkHitList(rng, lyr == 0 ? 8 : lyr, occ);
+            d.push_back(uint8_t(hits.size()));
+            d.insert(d.end(), hits.begin(), hits.end());
+        }
+        addFrame(stream, PKT_EVENT, d);
+        if (evt % 1000 == 999) addFrame(stream, PKT_HOUSEKEEPING, std::vector<uint8_t>(121, 0x48));
+    }
+    return stream;
+}
+
+}  // namespace bench
+}  // namespace aesopdaq
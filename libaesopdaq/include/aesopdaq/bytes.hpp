@@ -0,0 +1,58 @@
+// Non-owning view of a byte buffer, with the big-endian readers used by all of the record views.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aesopdaq {
+
+class ByteSpan {
+public:
+    constexpr ByteSpan() noexcept : data_(nullptr), size_(0) {}
+    constexpr ByteSpan(const uint8_t* data, size_t size) noexcept : data_(data), size_(size) {}
+
+    constexpr const uint8_t* data() const noexcept { return data_; }
+    constexpr size_t size() const noexcept { return size_; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr uint8_t operator[](size_t i) const noexcept { return data_[i]; }
+    constexpr const uint8_t* begin() const noexcept { return data_; }
+    constexpr const uint8_t* end() const noexcept { return data_ + size_; }
+
+    // Bytes [offset, offset+count), clipped to the span
+    constexpr ByteSpan subspan(size_t offset, size_t count = SIZE_MAX) const noexcept {
+        if (offset > size_) offset = size_;
+        if (count > size_ - offset) count = size_ - offset;
+        return ByteSpan(data_ + offset, count);
+    }
+
+    constexpr uint16_t be16(size_t i) const noexcept {
+        return static_cast<uint16_t>((data_[i] << 8) | data_[i+1]);
+    }
+    constexpr uint32_t be24(size_t i) const noexcept {
+        return (uint32_t(data_[i]) << 16) | (uint32_t(data_[i+1]) << 8) | data_[i+2];
+    }
+    constexpr uint32_t be32(size_t i) const noexcept {
+        return (uint32_t(data_[i]) << 24) | (uint32_t(data_[i+1]) << 16) | (uint32_t(data_[i+2]) << 8) | data_[i+3];
+    }
+
+    // True if the span starts with the given ASCII tag, e.g. "HAUS"
+    bool startsWith(const char* tag) const noexcept;
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+// Date and time packed by the event PSOC: 5 bits year-2000, 4 bits month, 5 bits day, 5 bits hour, 6 bits minute,
+// 6 bits second
+struct PackedTime {
+    uint32_t word;
+    int year() const noexcept { return int((word & 0x7C000000u) >> 26) + 2000; }
+    int month() const noexcept { return int((word & 0x03C00000u) >> 22); }
+    int day() const noexcept { return int((word & 0x003E0000u) >> 17); }
+    int hour() const noexcept { return int((word & 0x0001F000u) >> 12); }
+    int minute() const noexcept { return int((word & 0x00000FC0u) >> 6); }
+    int second() const noexcept { return int(word & 0x0000003Fu); }
+};
+
+}  // namespace aesopdaq
@@ -0,0 +1,208 @@
+// C interface to libaesopdaq, for the ctypes binding in aesopdaq.py.
+// The bulk decoder writes events and clusters in the record layouts of runFile.eventDtype and runFile.clusterDtype
+// (packed, native byte order), so that Python can view the output arrays with numpy without copying them.
+// The record decoders return 0, or -1 if the data do not hold a record of that kind.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma pack(push, 1)
+typedef struct {
+    uint32_t trigger;
+    uint16_t run;
+    uint32_t timeStamp;
+    uint32_t timeDate;
+    int64_t deltaTime;          // Time stamp counts since the previous event
+    uint32_t cntGo1;
+    uint8_t trgStatus;
+    uint16_t trgCount;
+    uint16_t T1, T2, T3, T4, G;
+    int32_t dtmin;
+    uint8_t nTOFA, nTOFB;
+    int32_t tofA, tofB;
+    uint16_t clkA, clkB;
+    int32_t liveUsec;
+    uint8_t nGO1live;
+    uint8_t nTkrLyrs;
+    uint16_t tkrErrors;         // Sum of the hit list error counts over the layers
+    uint32_t firstCluster;
+    uint16_t nClusters;
+} adq_event;
+
+typedef struct {
+    uint32_t event;
+    uint8_t layer;              // FPGA address
+    uint8_t chip;
+    uint16_t strip;             // 64*(chip+1) - first strip
+    uint8_t width;
+    uint8_t error;
+    uint8_t parity;
+} adq_cluster;
+
+// Entry of a stream index, one per record (runIndex.indexDtype)
+typedef struct {
+    uint32_t event;             // Event number (accepted trigger count) at or carried by the record
+    uint32_t timeStamp;         // Of the event, or of the last event before the record
+    uint64_t offset;            // Of the frame header in the stream
+    uint16_t run;
+    uint8_t packetType;
+} adq_index_entry;
+#pragma pack(pop)
+
+typedef struct {
+    uint64_t offset;            // Of the frame header in the buffer
+    uint64_t dataOffset;        // Of the output data in the buffer
+    uint16_t dataLength;
+    uint8_t packetType;
+    uint8_t nCmdData;           // Command data bytes, just before the output data
+} adq_frame;
+
+typedef struct {
+    uint64_t consumed;          // Bytes of the buffer used up; the rest is an incomplete frame or did not fit
+    uint64_t nFrames;
+    uint64_t nEvents;
+    uint64_t nClusters;
+    uint64_t nBadEvents;        // Event frames too short for their layer lists
+    uint64_t nOther;            // Frames other than events
+    uint64_t nSkipped;          // Bytes thrown away looking for a frame header
+    uint64_t nBadFrames;        // Frames with a bad trailer
+} adq_stats;
+
+typedef struct {
+    uint8_t chip, nClusters, overflow, error, parity;
+} adq_chip;
+
+typedef struct {
+    uint8_t chip, firstStrip, width, error, parity;
+} adq_hit;
+
+typedef struct {
+    int32_t rc;
+    uint8_t fpga, tag, errorFlag, nChips;
+    uint8_t crc, crcLength, crcCalc, trailerOK;
+    int32_t nChipHeaders;
+    int32_t nClusters;
+    adq_chip chips[15];
+    adq_hit clusters[225];
+} adq_hitlist;
+
+typedef struct {
+    uint16_t run;
+    uint32_t timeDate;
+    uint16_t lastCommand, cmdCount;
+    uint8_t nBadCmd, nErrors;
+    uint32_t cntGO, cntGO1;
+    uint16_t avgReadTime;
+    uint16_t pmtRate[5];        // T1, T2, T3, T4, G
+    uint16_t tkrCmdCount;
+    uint8_t tkrTrigPercent[2];
+    uint8_t nTkrDataErrors, nTkrTimeouts;
+    uint8_t chipsHitX10[8];
+    uint16_t layerRate[8];
+    uint16_t dieTemp;
+    uint16_t tkrTempRaw[2];
+    uint8_t tofStops[4];
+    uint8_t spiBusyPercent, livePercent;
+    uint16_t nLiveSamples;
+    uint8_t adcLivePercent, diagPeriod;
+    uint16_t nDiagEscalations;
+    uint8_t hasPower, hasPmtWindow, hasLiveFraction;
+    uint16_t boardTempRaw;
+    uint16_t busRaw[7], shuntRaw[7];
+    uint8_t sensorAge[4];
+    uint8_t pmtWindow;
+    uint16_t liveFraction10k;
+} adq_housekeeping;
+
+typedef struct {
+    uint16_t run;
+    uint32_t timeDate;
+    int32_t nBoards;
+    uint16_t value[8][12];
+} adq_tkr_housekeeping;
+
+typedef struct {
+    uint16_t run;
+    uint32_t timeDate;
+    uint8_t version[2];
+    uint16_t pmtDAC[5];         // G, T3, T1, T4, T2
+    uint16_t tofDAC[2];
+    uint8_t setting[12];
+    uint8_t tkrThresholdOffset[8];
+    uint8_t tkrMasterDelay, tkrTriggerSource, tkrLogic;
+    uint8_t tkrBoard[8][5];
+} adq_bor;
+
+typedef struct {
+    uint16_t run;
+    uint32_t cntGo1, cntGo;
+    uint8_t nBadCRC;
+    uint32_t nTkrReadReady;
+    uint16_t nTkrReadNotReady;
+    uint8_t tofStops[4];
+    uint32_t nBusy;
+    uint16_t nTkrMasterGo;
+    uint16_t layerTriggers[8], layerReads[8];
+    uint8_t layerCounts[8][5];
+    uint8_t runCounters[47];
+} adq_eor;
+
+typedef struct {
+    uint8_t code;
+    uint8_t info[2];
+    uint32_t usec;
+    uint32_t event;
+} adq_error_entry;
+
+typedef struct {
+    uint8_t nErrors, nLost;
+    adq_error_entry entries[255];
+} adq_error_stream;
+
+typedef struct {
+    uint32_t eventCount;
+    uint32_t timeDate;
+    uint64_t payloadOffset;     // Of the rest of the record in the data
+} adq_error_record;
+
+// Sizes of the structures, checked by the binding against its own layouts
+size_t adq_sizeof(const char* name);
+
+// Index up to maxFrames frames of the buffer
+size_t adq_frames(const uint8_t* buf, size_t len, adq_frame* frames, size_t maxFrames, adq_stats* stats);
+
+// Decode the event frames of the buffer into events and clusters, skipping other frames, until the buffer or one of
+// the output arrays runs out. Frames of type 0xDB carry the TOF debug fields. Event and cluster indices are counted from firstEvent and firstCluster, and lastTime
+// (the time stamp of the previous event) is updated, so that a stream can be decoded a buffer at a time.
+// Returns the number of events written.
+size_t adq_decode_events(const uint8_t* buf, size_t len, uint32_t firstEvent, uint32_t firstCluster, int64_t* lastTime,
+                         adq_event* events, size_t maxEvents, adq_cluster* clusters, size_t maxClusters,
+                         adq_stats* stats);
+
+// Reprocess a raw stream file into run<N>_events.npy, run<N>_clusters.npy and run<N>_occupancy.npy in the
+// directory, decoding chunks of the file on nThreads threads (0 for all). Returns 0, or -1 with the reason in error.
+int adq_reprocess(const char* fileName, const char* directory, int runNumber, unsigned nThreads, size_t chunkSize,
+                  adq_stats* stats, char* error, size_t errorSize);
+
+// Write the index of the records of a raw stream file to indexFile (see index.hpp). Returns the number of records
+// indexed, or -1 with the reason in error.
+int64_t adq_index_file(const char* fileName, const char* indexFile, adq_stats* stats, char* error, size_t errorSize);
+
+int adq_decode_hitlist(const uint8_t* data, size_t len, adq_hitlist* out);
+uint8_t adq_crc6(const uint8_t* data, size_t nBits);
+
+int adq_decode_housekeeping(const uint8_t* data, size_t len, adq_housekeeping* out);
+int adq_decode_tkr_housekeeping(const uint8_t* data, size_t len, adq_tkr_housekeeping* out);
+int adq_decode_bor(const uint8_t* data, size_t len, adq_bor* out);
+int adq_decode_eor(const uint8_t* data, size_t len, adq_eor* out);
+int adq_decode_error_stream(const uint8_t* data, size_t len, adq_error_stream* out);
+int adq_decode_error_record(const uint8_t* data, size_t len, adq_error_record* out);
+
+#ifdef __cplusplus
+}
+#endif
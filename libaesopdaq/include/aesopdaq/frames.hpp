@@ -0,0 +1,61 @@
+// Zero-copy iterator over the packets sent by the event PSOC. Each packet is framed as
+//    DC 00 FF, length L, packet type, number of command data bytes N, L bytes (N command data bytes followed by
+//    the output data), padding to a multiple of 3 bytes, FF 00 FF
+// the same framing that frameReader.py reads. Frames are returned as views into the caller's buffer.
+#pragma once
+
+#include <vector>
+
+#include "aesopdaq/bytes.hpp"
+
+namespace aesopdaq {
+
+// Packet types of the records that the event PSOC sends on its own
+enum PacketType : uint8_t {
+    PKT_ERROR_STREAM = 0xD9,
+    PKT_ERROR_RECORD = 0xDA,
+    PKT_EVENT_DEBUG = 0xDB,     // Event with the TOF debug fields
+    PKT_EVENT = 0xDD,
+    PKT_HOUSEKEEPING = 0xDE,
+    PKT_TKR_HOUSEKEEPING = 0xDF,
+    PKT_EOR = 0x44,             // Response to the end-run command
+};
+
+struct Frame {
+    size_t offset;          // Position of the frame header in the buffer
+    uint8_t packetType;
+    ByteSpan cmdData;       // Command data echoed back, empty for records sent by the PSOC on its own
+    ByteSpan data;          // Output data
+};
+
+// Number of bytes in a frame with L data bytes
+constexpr size_t frameLength(size_t L) noexcept { return 9 + L + (3 - L%3)%3; }
+
+class FrameIterator {
+public:
+    explicit FrameIterator(ByteSpan buffer) noexcept : buf_(buffer) {}
+
+    // Find the next good frame. Returns false when no complete frame is left; position() then tells where the
+    // unconsumed bytes start, so that a streaming caller can keep them for the next buffer.
+    bool next(Frame& frame) noexcept;
+
+    size_t position() const noexcept { return pos_; }
+    size_t nSkipped() const noexcept { return nSkipped_; }      // Bytes thrown away looking for a header
+    size_t nBadFrames() const noexcept { return nBadFrames_; }  // Frames with a bad trailer
+
+private:
+    ByteSpan buf_;
+    size_t pos_ = 0;
+    size_t nSkipped_ = 0;
+    size_t nBadFrames_ = 0;
+};
+
+// True if a frame with a good trailer starts at pos and is followed by another frame header or by the end of the
+// buffer. Checking two frames in a row makes a false start in the middle of the data very unlikely.
+bool isFrameStart(ByteSpan buf, size_t pos) noexcept;
+
+// Split a stream into pieces of about chunkSize bytes that start on frame boundaries, so that they can be decoded
+// independently. Returns the start of each piece followed by the end of the buffer.
+std::vector<size_t> splitAtFrames(ByteSpan buf, size_t chunkSize);
+
+}  // namespace aesopdaq
@@ -0,0 +1,68 @@
+// Decoder for the ASIC hit lists sent by the tracker FPGAs, the same as hitDecoder.decodeHitList in Python.
+// The hit list is a bit stream (most significant bit of each byte first):
+//    11100111, 1 bit (not used), 7-bit FPGA address,
+//    FPGA header: 7-bit event tag, error flag, 4-bit number of chips,
+//    for each chip: 12-bit header (overflow, unused, 4-bit number of clusters, error, parity error, 4-bit chip address)
+//                   followed by 12 bits per cluster (6-bit width-1, 6-bit first strip),
+//    6-bit CRC, trailing 11
+#pragma once
+
+#include "aesopdaq/bytes.hpp"
+#include "aesopdaq/unpack.hpp"
+
+namespace aesopdaq {
+
+constexpr int MAX_CHIPS = 15;       // The chip count is a 4-bit field, and so is the cluster count of each chip
+constexpr int MAX_HIT_CLUSTERS = MAX_CHIPS*15;
+constexpr size_t MAX_HIT_BYTES = 255;              // Longest list that an event record can carry
+constexpr size_t MAX_HIT_WORDS = (8*MAX_HIT_BYTES - 16)/12;
+
+struct ChipHeader {
+    uint8_t chip;
+    uint8_t nClusters;
+    uint8_t overflow;
+    uint8_t error;
+    uint8_t parity;
+};
+
+struct HitCluster {
+    uint8_t chip;
+    uint8_t firstStrip;
+    uint8_t width;
+    uint8_t error;          // Error and parity bits of the chip header
+    uint8_t parity;
+};
+
+struct HitList {
+    int rc;                 // Number of errors found, -1 for an empty list, -2 if it does not start with 11100111
+    uint8_t fpga;
+    uint8_t tag;
+    uint8_t errorFlag;
+    uint8_t nChips;         // From the FPGA header
+    uint8_t crc;            // Received
+    uint8_t crcLength;      // Number of CRC bits present (6 unless the list is truncated)
+    uint8_t crcCalc;
+    bool trailerOK;
+    int nChipHeaders;       // Chip headers actually present
+    int nClusters;
+    ChipHeader chips[MAX_CHIPS];
+    HitCluster clusters[MAX_HIT_CLUSTERS];
+
+    // Strip number used for plots and occupancy, 64*(chip+1) - first strip
+    int strip(int i) const noexcept { return 64*(clusters[i].chip + 1) - clusters[i].firstStrip; }
+};
+
+// CRC6 (polynomial 1'100101) of a 1 followed by the first nBits bits of the bytes, as computed by the FPGA, which
+// included the start bit that is suppressed in the output
+uint8_t crc6(ByteSpan bytes, size_t nBits) noexcept;
+
+// Decode one hit list. Returns out.rc.
+// The list is first expanded into 12-bit and 6-bit lanes with unpack12, at the given or the best SIMD level, and
+// the chip and cluster counts are then walked on the expanded words.
+int decodeHitList(ByteSpan hitList, HitList& out) noexcept;
+int decodeHitList(ByteSpan hitList, HitList& out, SimdLevel level) noexcept;
+
+// The same, pulling each field out of the bit stream in turn. The reference for the unpacked decoder.
+int decodeHitListScalar(ByteSpan hitList, HitList& out) noexcept;
+
+}  // namespace aesopdaq
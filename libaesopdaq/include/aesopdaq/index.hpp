@@ -0,0 +1,29 @@
+// Index of the records of a raw event PSOC stream, for going straight to an event or a time range without
+// decoding the stream from the start. There is one adq_index_entry per good frame, in stream order, holding the
+// frame offset, the packet type, the run, and the event number and time stamp that the record belongs to:
+//    events (0xDD, 0xDB)     their own trigger number and time stamp
+//    housekeeping (0xDE)     cntGO, the events accepted so far
+//    error record (0xDA)     the event count of the record
+//    error stream (0xD9)     the event of its first error
+//    end of run (0x44)       cntGo at the end of the run
+// and anything else the event and time stamp of the last event before it. Only events, housekeeping and the end of
+// run move the running event number on; a begin-of-run record restarts it at 0 with the new run number.
+// The index is written as <stream>.idx.npy, an array of runIndex.indexDtype.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "aesopdaq/bytes.hpp"
+#include "aesopdaq/capi.h"
+
+namespace aesopdaq {
+
+// Index a stream held in memory; stats counts the frames and the bytes skipped, as adq_frames does
+std::vector<adq_index_entry> buildIndex(ByteSpan stream, adq_stats& stats);
+
+// Index a stream file into indexFile. Return an empty string, or what went wrong.
+std::string indexStreamFile(const std::string& fileName, const std::string& indexFile, size_t& nRecords,
+                            adq_stats& stats);
+
+}  // namespace aesopdaq
@@ -0,0 +1,202 @@
+// Typed views of the records sent by the event PSOC, over the output data of a frame (see frames.hpp).
+// The byte offsets are those used by the print functions in PSOC_cmd.py. Each view only checks the record tag and
+// length in valid(); the accessors do no bounds checking of their own.
+#pragma once
+
+#include "aesopdaq/bytes.hpp"
+#include "aesopdaq/frames.hpp"
+
+namespace aesopdaq {
+
+constexpr int MAX_TKR_LAYERS = 8;
+
+// Event record, "ZERO"
+class EventView {
+public:
+    EventView(uint8_t packetType, ByteSpan data) noexcept;
+    bool valid() const noexcept { return valid_; }
+
+    uint16_t run() const noexcept { return d_.be16(4); }
+    uint32_t trigger() const noexcept { return d_.be32(6); }       // Accepted trigger count
+    uint32_t timeStamp() const noexcept { return d_.be32(10); }    // 200 Hz clock
+    uint32_t cntGo1() const noexcept { return d_.be32(14); }       // Triggers not accepted
+    PackedTime time() const noexcept { return PackedTime{d_.be32(18)}; }
+    uint8_t trgStatus() const noexcept { return d_[22]; }
+    uint16_t pha(int ch) const noexcept { return d_.be16(23 + 2*ch); }   // 0-4: T1, T2, T3, T4, G
+    int32_t dtmin() const noexcept { return 10*int16_t(d_.be16(33)); }  // TOF time difference, 10 ps units
+    uint16_t trgCount() const noexcept { return d_.be16(35); }
+    uint8_t flags() const noexcept { return d_[38]; }
+
+    bool hasTofDebug() const noexcept { return packetType_ == PKT_EVENT_DEBUG; }
+    uint8_t nTOFA() const noexcept { return hasTofDebug() ? d_[39] : 0; }
+    uint8_t nTOFB() const noexcept { return hasTofDebug() ? d_[40] : 0; }
+    int32_t tofA() const noexcept { return hasTofDebug() ? 10*d_.be16(41) : 9999; }
+    int32_t tofB() const noexcept { return hasTofDebug() ? 10*d_.be16(43) : 9999; }
+    uint16_t clkA() const noexcept { return hasTofDebug() ? d_.be16(45) : 9999; }
+    uint16_t clkB() const noexcept { return hasTofDebug() ? d_.be16(47) : 9999; }
+
+    bool hasRearm() const noexcept { return (flags() & 0x08) != 0; }
+    int32_t rearmUsec() const noexcept { return hasRearm() ? int32_t(d_.be24(rearmOffset_)) : -1; }
+    uint8_t nGO1live() const noexcept { return hasRearm() ? d_[rearmOffset_ + 3] : 0; }
+
+    int nLayers() const noexcept { return nLayers_; }
+    ByteSpan hitList(int layer) const noexcept { return d_.subspan(layerOffset_[layer], layerLength_[layer]); }
+
+private:
+    ByteSpan d_;
+    uint8_t packetType_;
+    bool valid_ = false;
+    size_t rearmOffset_ = 0;
+    int nLayers_ = 0;
+    size_t layerOffset_[MAX_TKR_LAYERS] = {};
+    size_t layerLength_[MAX_TKR_LAYERS] = {};
+};
+
+// Housekeeping record, "HAUS"
+class HousekeepingView {
+public:
+    explicit HousekeepingView(ByteSpan data) noexcept : d_(data) {}
+    bool valid() const noexcept { return d_.size() >= 84 && d_.startsWith("HAUS"); }
+
+    uint16_t run() const noexcept { return d_.be16(4); }
+    PackedTime time() const noexcept { return PackedTime{d_.be32(6)}; }
+    uint16_t lastCommand() const noexcept { return d_.be16(10); }
+    uint16_t cmdCount() const noexcept { return d_.be16(12); }
+    uint8_t nBadCmd() const noexcept { return d_[14]; }
+    uint8_t nErrors() const noexcept { return d_[15]; }
+    uint32_t cntGO() const noexcept { return d_.be32(16); }
+    uint32_t cntGO1() const noexcept { return d_.be32(20); }
+    uint16_t avgReadTime() const noexcept { return d_.be16(24); }                 // Microseconds
+    uint16_t pmtRate(int ch) const noexcept { return d_.be16(26 + 2*ch); }       // 0-4: T1, T2, T3, T4, G (Hz)
+    uint16_t tkrCmdCount() const noexcept { return d_.be16(36); }
+    uint8_t tkrTrig1Percent() const noexcept { return d_[38]; }
+    uint8_t tkrTrig2Percent() const noexcept { return d_[39]; }
+    uint8_t nTkrDataErrors() const noexcept { return d_[40]; }
+    uint8_t nTkrTimeouts() const noexcept { return d_[41]; }
+    uint8_t chipsHitX10(int brd) const noexcept { return d_[42 + brd]; }         // Chips hit per event times 10
+    uint16_t layerRate(int brd) const noexcept { return d_.be16(50 + 2*brd); }   // Hz
+    uint16_t dieTemp() const noexcept { return d_.be16(66); }                     // Celsius
+    uint16_t tkrTempRaw(int i) const noexcept { return d_.be16(68 + 2*i); }      // Two tracker boards, 1/256 Celsius
+    uint8_t tofStops(int i) const noexcept { return d_[72 + i]; }    // Average A, average B, maximum A, maximum B
+    uint8_t spiBusyPercent() const noexcept { return d_[76]; }
+    uint8_t livePercent() const noexcept { return d_[77]; }
+    uint16_t nLiveSamples() const noexcept { return d_.be16(78); }
+    uint8_t adcLivePercent() const noexcept { return d_[80]; }
+    uint8_t diagPeriod() const noexcept { return d_[81]; }
+    uint16_t nDiagEscalations() const noexcept { return d_.be16(82); }
+
+    bool hasPower() const noexcept { return d_.size() >= 118; }
+    uint16_t boardTempRaw() const noexcept { return d_.be16(84); }                // TMP100, 1/256 Celsius
+    uint16_t busRaw(int i) const noexcept { return d_.be16(86 + 4*i); }          // INA226 bus, 1.25 mV
+    uint16_t shuntRaw(int i) const noexcept { return d_.be16(88 + 4*i); }        // INA226 shunt register
+    uint8_t sensorAge(int i) const noexcept { return d_[114 + i]; }              // Seconds
+    bool hasPmtWindow() const noexcept { return d_.size() >= 119; }
+    uint8_t pmtWindow() const noexcept { return d_[118]; }                        // Seconds
+    bool hasLiveFraction() const noexcept { return d_.size() >= 121; }
+    uint16_t liveFraction10k() const noexcept { return d_.be16(119); }           // 0.01% units
+
+private:
+    ByteSpan d_;
+};
+
+// Tracker housekeeping record, "TRAK"
+class TkrHousekeepingView {
+public:
+    explicit TkrHousekeepingView(ByteSpan data) noexcept : d_(data) {}
+    bool valid() const noexcept { return d_.size() >= 10 && d_.startsWith("TRAK"); }
+
+    uint16_t run() const noexcept { return d_.be16(4); }
+    PackedTime time() const noexcept { return PackedTime{d_.be32(6)}; }
+    int nBoards() const noexcept;                 // Boards up to the first one with no temperature
+    // Raw register values of a board: 0 temperature, 1 bias shunt, then bus and shunt pairs for the digital 1.2V,
+    // 2.5V and 3.3V and the analog 2.1V and 3.3V supplies
+    uint16_t value(int brd, int i) const noexcept { return d_.be16(10 + 24*brd + 2*i); }
+
+private:
+    ByteSpan d_;
+};
+
+// Begin-of-run record, "BOFR"
+class BorView {
+public:
+    explicit BorView(ByteSpan data) noexcept : d_(data) {}
+    bool valid() const noexcept { return d_.size() >= 85 && d_.startsWith("BOFR"); }
+
+    uint16_t run() const noexcept { return d_.be16(4); }
+    PackedTime time() const noexcept { return PackedTime{d_.be32(6)}; }
+    uint8_t versionMajor() const noexcept { return d_[10]; }
+    uint8_t versionMinor() const noexcept { return d_[11]; }
+    uint16_t pmtDAC(int ch) const noexcept;       // 0-4: G, T3, T1, T4, T2
+    uint16_t tofDAC(int i) const noexcept { return d_.be16(18 + 2*i); }
+    uint8_t setting(int i) const noexcept { return d_[22 + i]; }   // Delays, settling times, prescales and masks
+    uint8_t tkrThresholdOffset(int lyr) const noexcept { return d_[34 + lyr]; }
+    uint8_t tkrMasterDelay() const noexcept { return d_[42]; }
+    uint8_t tkrTriggerSource() const noexcept { return d_[43]; }
+    uint8_t tkrLogic() const noexcept { return d_[44]; }
+    // Per board: 0 firmware version, 1 configuration register, 2 readout layers, 3 trigger length, 4 trigger delay
+    uint8_t tkrBoard(int brd, int i) const noexcept { return d_[45 + 5*brd + i]; }
+
+private:
+    ByteSpan d_;
+};
+
+// End-of-run record, the reply to the end-run command
+class EorView {
+public:
+    explicit EorView(ByteSpan data) noexcept : d_(data) {}
+    bool valid() const noexcept { return d_.size() >= 149; }
+
+    uint16_t run() const noexcept { return d_.be16(3); }
+    uint32_t cntGo1() const noexcept { return d_.be32(5); }
+    uint32_t cntGo() const noexcept { return d_.be32(9); }
+    uint8_t nBadCRC() const noexcept { return d_[13]; }
+    uint32_t nTkrReadReady() const noexcept { return d_.be32(14); }
+    uint16_t nTkrReadNotReady() const noexcept { return d_.be16(18); }
+    uint8_t tofStops(int i) const noexcept { return d_[20 + i]; }  // Average A, average B, maximum A, maximum B
+    uint32_t nBusy() const noexcept { return d_.be32(24); }
+    uint16_t nTkrMasterGo() const noexcept { return d_.be16(28); }
+    uint16_t layerTriggers(int lyr) const noexcept { return d_.be16(30 + 9*lyr); }
+    uint16_t layerReads(int lyr) const noexcept { return d_.be16(32 + 9*lyr); }
+    // Per layer: 0 missed triggers, 1 reads with no trigger, 2 error codes, 3 ASIC error codes, 4 bad commands
+    uint8_t layerCount(int lyr, int i) const noexcept { return d_[34 + 9*lyr + i]; }
+    ByteSpan runCounters() const noexcept { return d_.subspan(102, 47); }
+
+private:
+    ByteSpan d_;
+};
+
+// Error record sent at the end of a run for each tracker read time-out, "ERR"
+class ErrorRecordView {
+public:
+    explicit ErrorRecordView(ByteSpan data) noexcept : d_(data) {}
+    bool valid() const noexcept { return d_.size() >= 11 && d_.startsWith("ERR"); }
+
+    uint32_t eventCount() const noexcept { return d_.be32(3); }
+    PackedTime time() const noexcept { return PackedTime{d_.be32(7)}; }
+    ByteSpan payload() const noexcept { return d_.subspan(11); }
+
+private:
+    ByteSpan d_;
+};
+
+// Buffered error stream, "ERS"
+class ErrorStreamView {
+public:
+    struct Entry {
+        uint8_t code;
+        uint8_t info[2];
+        uint32_t usec;
+        uint32_t event;
+    };
+    explicit ErrorStreamView(ByteSpan data) noexcept : d_(data) {}
+    bool valid() const noexcept { return d_.size() >= 5 && d_.startsWith("ERS") && d_.size() >= 5u + 11u*d_[3]; }
+
+    uint8_t nErrors() const noexcept { return d_[3]; }
+    uint8_t nLost() const noexcept { return d_[4]; }
+    Entry entry(int i) const noexcept;
+
+private:
+    ByteSpan d_;
+};
+
+}  // namespace aesopdaq
@@ -0,0 +1,37 @@
+// Offline reprocessing of a raw event PSOC stream, as read from the port and saved by limitedRun in
+// run<N>_stream.bin, into the run files of runFile.py:
+//    run<N>_events.npy, run<N>_clusters.npy, run<N>_occupancy.npy
+// with the columns that limitedRun writes, so that runFile.loadRun reads them. The stream is split into chunks at
+// frame boundaries (splitAtFrames), the chunks are decoded in parallel on a ThreadPool, and each chunk is appended
+// to the files once it and all of the chunks before it are done, which keeps the events in stream order, i.e. in
+// event number order. Event and cluster indices and the time since the previous event are fixed up across the
+// chunk boundaries as they are appended.
+#pragma once
+
+#include <string>
+
+#include "aesopdaq/bytes.hpp"
+#include "aesopdaq/capi.h"
+
+namespace aesopdaq {
+
+struct ReprocessOptions {
+    unsigned nThreads = 0;                  // 0 for one per hardware thread
+    size_t chunkSize = size_t(8) << 20;
+};
+
+struct ReprocessResult {
+    adq_stats stats = {};                   // Summed over the chunks
+    size_t nChunks = 0;
+    unsigned nThreads = 0;
+    size_t nStolen = 0;                     // Chunks taken by a worker from another worker's deque
+    double seconds = 0;
+};
+
+// Return an empty string, or what went wrong
+std::string reprocess(ByteSpan stream, const std::string& directory, int runNumber, const ReprocessOptions& options,
+                      ReprocessResult& result);
+std::string reprocessFile(const std::string& fileName, const std::string& directory, int runNumber,
+                          const ReprocessOptions& options, ReprocessResult& result);
+
+}  // namespace aesopdaq
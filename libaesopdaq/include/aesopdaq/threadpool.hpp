@@ -0,0 +1,49 @@
+// Work-stealing thread pool. Each worker has its own deque of tasks: it runs its newest task first, and when its
+// deque is empty it steals the oldest task of another worker. Tasks submitted from outside the pool are dealt out
+// round robin; tasks submitted by a task go to the deque of the worker running it.
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace aesopdaq {
+
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned nThreads = 0);     // 0 for one per hardware thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+    void wait();                                    // Until every task submitted so far has run
+    unsigned size() const noexcept { return unsigned(queues_.size()); }   // Complete before any worker starts
+    size_t nStolen() const noexcept { return nStolen_; }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(unsigned self, std::function<void()>& task);
+    void work(unsigned self);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;                  // Guards the counts below
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    size_t nQueued_ = 0;                // Tasks waiting in the deques
+    size_t nPending_ = 0;               // Tasks submitted and not finished
+    size_t nStolen_ = 0;
+    unsigned next_ = 0;
+    bool stopping_ = false;
+};
+
+}  // namespace aesopdaq
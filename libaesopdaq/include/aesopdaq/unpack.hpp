@@ -0,0 +1,24 @@
+// Bulk expansion of packed 12-bit words, the unit of everything in a hit list after the FPGA address.
+// Each 3 bytes hold two words, most significant bits first. The words are written out both as 12-bit lanes and
+// as pairs of 6-bit lanes (upper half first), the latter being the width-1 and first strip fields of a cluster
+// word. The x86 versions use SSE4.1 (8 words per step) or AVX2 (16 words per step), chosen at run time.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aesopdaq {
+
+enum class SimdLevel { Scalar, SSE41, AVX2 };
+
+// Best level supported by the compiler and the CPU
+SimdLevel simdLevel() noexcept;
+const char* simdName(SimdLevel level) noexcept;
+
+// Expand nWords words from src, which must hold at least (3*nWords + 1)/2 bytes; srcSize is the number of bytes
+// that may be read, which lets the vector loops run closer to the end. words needs nWords + 16 entries and fields
+// 2*nWords + 32, since the vector loops store whole registers.
+void unpack12(const uint8_t* src, size_t srcSize, size_t nWords, uint16_t* words, uint8_t* fields,
+              SimdLevel level) noexcept;
+
+}  // namespace aesopdaq
@@ -0,0 +1,303 @@
+#include "aesopdaq/capi.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "aesopdaq/frames.hpp"
+#include "aesopdaq/hitlist.hpp"
+#include "aesopdaq/index.hpp"
+#include "aesopdaq/records.hpp"
+#include "aesopdaq/reprocess.hpp"
+
+using namespace aesopdaq;
+
+static_assert(sizeof(adq_event) == 71, "adq_event must match runFile.eventDtype");
+static_assert(sizeof(adq_cluster) == 11, "adq_cluster must match runFile.clusterDtype");
+static_assert(sizeof(adq_index_entry) == 19, "adq_index_entry must match runIndex.indexDtype");
+static_assert(sizeof(adq_chip) == sizeof(ChipHeader) && sizeof(adq_hit) == sizeof(HitCluster), "hit list layouts");
+
+size_t adq_sizeof(const char* name) {
+    struct { const char* name; size_t size; } sizes[] = {
+        {"event", sizeof(adq_event)}, {"cluster", sizeof(adq_cluster)}, {"frame", sizeof(adq_frame)},
+        {"stats", sizeof(adq_stats)}, {"hitlist", sizeof(adq_hitlist)}, {"housekeeping", sizeof(adq_housekeeping)},
+        {"tkr_housekeeping", sizeof(adq_tkr_housekeeping)}, {"bor", sizeof(adq_bor)}, {"eor", sizeof(adq_eor)},
+        {"error_stream", sizeof(adq_error_stream)}, {"error_record", sizeof(adq_error_record)},
+        {"index_entry", sizeof(adq_index_entry)},
+    };
+    for (const auto& s : sizes) {
+        if (std::strcmp(s.name, name) == 0) return s.size;
+    }
+    return 0;
+}
+
+static void copyStats(const FrameIterator& it, adq_stats* stats) {
+    stats->consumed = it.position();
+    stats->nSkipped = it.nSkipped();
+    stats->nBadFrames = it.nBadFrames();
+}
+
+size_t adq_frames(const uint8_t* buf, size_t len, adq_frame* frames, size_t maxFrames, adq_stats* stats) {
+    std::memset(stats, 0, sizeof(*stats));
+    FrameIterator it(ByteSpan(buf, len));
+    Frame frame;
+    size_t n = 0;
+    while (n < maxFrames && it.next(frame)) {
+        adq_frame& f = frames[n++];
+        f.offset = frame.offset;
+        f.dataOffset = frame.data.data() - buf;
+        f.dataLength = uint16_t(frame.data.size());
+        f.packetType = frame.packetType;
+        f.nCmdData = uint8_t(frame.cmdData.size());
+    }
+    copyStats(it, stats);
+    stats->nFrames = n;
+    return n;
+}
+
+size_t adq_decode_events(const uint8_t* buf, size_t len, uint32_t firstEvent, uint32_t firstCluster, int64_t* lastTime,
+                         adq_event* events, size_t maxEvents, adq_cluster* clusters, size_t maxClusters,
+                         adq_stats* stats) {
+    std::memset(stats, 0, sizeof(*stats));
+    FrameIterator it(ByteSpan(buf, len));
+    Frame frame;
+    HitList hits;
+    size_t nEvents = 0;
+    size_t nClusters = 0;
+    size_t resume = SIZE_MAX;
+    while (nEvents < maxEvents && it.next(frame)) {
+        ++stats->nFrames;
+        if (frame.packetType != PKT_EVENT && frame.packetType != PKT_EVENT_DEBUG) {
+            ++stats->nOther;
+            continue;
+        }
+        EventView evt(frame.packetType, frame.data);
+        if (!evt.valid()) {
+            ++stats->nBadEvents;
+            continue;
+        }
+        // Stop short of an event whose clusters might not fit, so that it can be decoded with the next call
+        if (maxClusters - nClusters < size_t(evt.nLayers())*MAX_HIT_CLUSTERS) {
+            --stats->nFrames;
+            resume = frame.offset;
+            break;
+        }
+        adq_event& e = events[nEvents];
+        e.trigger = evt.trigger();
+        e.run = evt.run();
+        e.timeStamp = evt.timeStamp();
+        e.timeDate = evt.time().word;
+        e.deltaTime = int64_t(e.timeStamp) - *lastTime;
+        *lastTime = e.timeStamp;
+        e.cntGo1 = evt.cntGo1();
+        e.trgStatus = evt.trgStatus();
+        e.trgCount = evt.trgCount();
+        e.T1 = evt.pha(0);
+        e.T2 = evt.pha(1);
+        e.T3 = evt.pha(2);
+        e.T4 = evt.pha(3);
+        e.G = evt.pha(4);
+        e.dtmin = evt.dtmin();
+        e.nTOFA = evt.nTOFA();
+        e.nTOFB = evt.nTOFB();
+        e.tofA = evt.tofA();
+        e.tofB = evt.tofB();
+        e.clkA = evt.clkA();
+        e.clkB = evt.clkB();
+        e.liveUsec = evt.rearmUsec();
+        e.nGO1live = evt.nGO1live();
+        e.nTkrLyrs = uint8_t(evt.nLayers());
+        e.firstCluster = firstCluster + uint32_t(nClusters);
+        int tkrErrors = 0;
+        size_t first = nClusters;
+        for (int lyr = 0; lyr < evt.nLayers(); ++lyr) {
+            decodeHitList(evt.hitList(lyr), hits);
+            tkrErrors += std::abs(hits.rc);
+            for (int i = 0; i < hits.nClusters; ++i) {
+                const HitCluster& h = hits.clusters[i];
+                adq_cluster& c = clusters[nClusters++];
+                c.event = firstEvent + uint32_t(nEvents);
+                c.layer = hits.fpga;
+                c.chip = h.chip;
+                c.strip = uint16_t(hits.strip(i));
+                c.width = h.width;
+                c.error = h.error;
+                c.parity = h.parity;
+            }
+        }
+        e.tkrErrors = uint16_t(tkrErrors);
+        e.nClusters = uint16_t(nClusters - first);
+        ++nEvents;
+    }
+    copyStats(it, stats);
+    if (resume != SIZE_MAX) stats->consumed = resume;
+    stats->nEvents = nEvents;
+    stats->nClusters = nClusters;
+    return nEvents;
+}
+
+int adq_reprocess(const char* fileName, const char* directory, int runNumber, unsigned nThreads, size_t chunkSize,
+                  adq_stats* stats, char* error, size_t errorSize) {
+    ReprocessOptions options;
+    options.nThreads = nThreads;
+    if (chunkSize > 0) options.chunkSize = chunkSize;
+    ReprocessResult result;
+    std::string message = reprocessFile(fileName, directory, runNumber, options, result);
+    *stats = result.stats;
+    if (errorSize > 0) std::snprintf(error, errorSize, "%s", message.c_str());
+    return message.empty() ? 0 : -1;
+}
+
+int64_t adq_index_file(const char* fileName, const char* indexFile, adq_stats* stats, char* error, size_t errorSize) {
+    size_t nRecords = 0;
+    std::string message = indexStreamFile(fileName, indexFile, nRecords, *stats);
+    if (errorSize > 0) std::snprintf(error, errorSize, "%s", message.c_str());
+    return message.empty() ? int64_t(nRecords) : -1;
+}
+
+int adq_decode_hitlist(const uint8_t* data, size_t len, adq_hitlist* out) {
+    HitList hits;
+    int rc = decodeHitList(ByteSpan(data, len), hits);
+    out->rc = hits.rc;
+    out->fpga = hits.fpga;
+    out->tag = hits.tag;
+    out->errorFlag = hits.errorFlag;
+    out->nChips = hits.nChips;
+    out->crc = hits.crc;
+    out->crcLength = hits.crcLength;
+    out->crcCalc = hits.crcCalc;
+    out->trailerOK = hits.trailerOK;
+    out->nChipHeaders = hits.nChipHeaders;
+    out->nClusters = hits.nClusters;
+    std::memcpy(out->chips, hits.chips, hits.nChipHeaders*sizeof(adq_chip));
+    std::memcpy(out->clusters, hits.clusters, hits.nClusters*sizeof(adq_hit));
+    return rc;
+}
+
+uint8_t adq_crc6(const uint8_t* data, size_t nBits) {
+    return crc6(ByteSpan(data, (nBits + 7)/8), nBits);
+}
+
+int adq_decode_housekeeping(const uint8_t* data, size_t len, adq_housekeeping* out) {
+    HousekeepingView v(ByteSpan(data, len));
+    if (!v.valid()) return -1;
+    std::memset(out, 0, sizeof(*out));
+    out->run = v.run();
+    out->timeDate = v.time().word;
+    out->lastCommand = v.lastCommand();
+    out->cmdCount = v.cmdCount();
+    out->nBadCmd = v.nBadCmd();
+    out->nErrors = v.nErrors();
+    out->cntGO = v.cntGO();
+    out->cntGO1 = v.cntGO1();
+    out->avgReadTime = v.avgReadTime();
+    for (int i = 0; i < 5; ++i) out->pmtRate[i] = v.pmtRate(i);
+    out->tkrCmdCount = v.tkrCmdCount();
+    out->tkrTrigPercent[0] = v.tkrTrig1Percent();
+    out->tkrTrigPercent[1] = v.tkrTrig2Percent();
+    out->nTkrDataErrors = v.nTkrDataErrors();
+    out->nTkrTimeouts = v.nTkrTimeouts();
+    for (int brd = 0; brd < 8; ++brd) {
+        out->chipsHitX10[brd] = v.chipsHitX10(brd);
+        out->layerRate[brd] = v.layerRate(brd);
+    }
+    out->dieTemp = v.dieTemp();
+    for (int i = 0; i < 2; ++i) out->tkrTempRaw[i] = v.tkrTempRaw(i);
+    for (int i = 0; i < 4; ++i) out->tofStops[i] = v.tofStops(i);
+    out->spiBusyPercent = v.spiBusyPercent();
+    out->livePercent = v.livePercent();
+    out->nLiveSamples = v.nLiveSamples();
+    out->adcLivePercent = v.adcLivePercent();
+    out->diagPeriod = v.diagPeriod();
+    out->nDiagEscalations = v.nDiagEscalations();
+    out->hasPower = v.hasPower();
+    if (v.hasPower()) {
+        out->boardTempRaw = v.boardTempRaw();
+        for (int i = 0; i < 7; ++i) {
+            out->busRaw[i] = v.busRaw(i);
+            out->shuntRaw[i] = v.shuntRaw(i);
+        }
+        for (int i = 0; i < 4; ++i) out->sensorAge[i] = v.sensorAge(i);
+    }
+    out->hasPmtWindow = v.hasPmtWindow();
+    if (v.hasPmtWindow()) out->pmtWindow = v.pmtWindow();
+    out->hasLiveFraction = v.hasLiveFraction();
+    if (v.hasLiveFraction()) out->liveFraction10k = v.liveFraction10k();
+    return 0;
+}
+
+int adq_decode_tkr_housekeeping(const uint8_t* data, size_t len, adq_tkr_housekeeping* out) {
+    TkrHousekeepingView v(ByteSpan(data, len));
+    if (!v.valid()) return -1;
+    std::memset(out, 0, sizeof(*out));
+    out->run = v.run();
+    out->timeDate = v.time().word;
+    out->nBoards = v.nBoards();
+    for (int brd = 0; brd < out->nBoards; ++brd) {
+        for (int i = 0; i < 12; ++i) out->value[brd][i] = v.value(brd, i);
+    }
+    return 0;
+}
+
+int adq_decode_bor(const uint8_t* data, size_t len, adq_bor* out) {
+    BorView v(ByteSpan(data, len));
+    if (!v.valid()) return -1;
+    out->run = v.run();
+    out->timeDate = v.time().word;
+    out->version[0] = v.versionMajor();
+    out->version[1] = v.versionMinor();
+    for (int i = 0; i < 5; ++i) out->pmtDAC[i] = v.pmtDAC(i);
+    for (int i = 0; i < 2; ++i) out->tofDAC[i] = v.tofDAC(i);
+    for (int i = 0; i < 12; ++i) out->setting[i] = v.setting(i);
+    for (int lyr = 0; lyr < 8; ++lyr) out->tkrThresholdOffset[lyr] = v.tkrThresholdOffset(lyr);
+    out->tkrMasterDelay = v.tkrMasterDelay();
+    out->tkrTriggerSource = v.tkrTriggerSource();
+    out->tkrLogic = v.tkrLogic();
+    for (int brd = 0; brd < 8; ++brd) {
+        for (int i = 0; i < 5; ++i) out->tkrBoard[brd][i] = v.tkrBoard(brd, i);
+    }
+    return 0;
+}
+
+int adq_decode_eor(const uint8_t* data, size_t len, adq_eor* out) {
+    EorView v(ByteSpan(data, len));
+    if (!v.valid()) return -1;
+    out->run = v.run();
+    out->cntGo1 = v.cntGo1();
+    out->cntGo = v.cntGo();
+    out->nBadCRC = v.nBadCRC();
+    out->nTkrReadReady = v.nTkrReadReady();
+    out->nTkrReadNotReady = v.nTkrReadNotReady();
+    for (int i = 0; i < 4; ++i) out->tofStops[i] = v.tofStops(i);
+    out->nBusy = v.nBusy();
+    out->nTkrMasterGo = v.nTkrMasterGo();
+    for (int lyr = 0; lyr < 8; ++lyr) {
+        out->layerTriggers[lyr] = v.layerTriggers(lyr);
+        out->layerReads[lyr] = v.layerReads(lyr);
+        for (int i = 0; i < 5; ++i) out->layerCounts[lyr][i] = v.layerCount(lyr, i);
+    }
+    ByteSpan counters = v.runCounters();
+    std::memcpy(out->runCounters, counters.data(), counters.size());
+    return 0;
+}
+
+int adq_decode_error_stream(const uint8_t* data, size_t len, adq_error_stream* out) {
+    ErrorStreamView v(ByteSpan(data, len));
+    if (!v.valid()) return -1;
+    out->nErrors = v.nErrors();
+    out->nLost = v.nLost();
+    for (int i = 0; i < v.nErrors(); ++i) {
+        ErrorStreamView::Entry entry = v.entry(i);
+        out->entries[i] = adq_error_entry{entry.code, {entry.info[0], entry.info[1]}, entry.usec, entry.event};
+    }
+    return 0;
+}
+
+int adq_decode_error_record(const uint8_t* data, size_t len, adq_error_record* out) {
+    ErrorRecordView v(ByteSpan(data, len));
+    if (!v.valid()) return -1;
+    out->eventCount = v.eventCount();
+    out->timeDate = v.time().word;
+    out->payloadOffset = v.payload().data() - data;
+    return 0;
+}
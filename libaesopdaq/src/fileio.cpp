@@ -0,0 +1,48 @@
+#include "fileio.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace aesopdaq {
+
+void writeNpyHeader(std::FILE* f, const char* header, int n) {
+    size_t nHeader = n + 1;
+    nHeader += (64 - (10 + nHeader)%64)%64;
+    std::string out("\x93NUMPY\x01\x00", 8);
+    out += char(nHeader & 0xFF);
+    out += char(nHeader >> 8);
+    out += std::string(header, n);
+    out.resize(10 + nHeader - 1, ' ');
+    out += '\n';
+    std::fseek(f, 0, SEEK_SET);
+    std::fwrite(out.data(), 1, out.size(), f);
+}
+
+MappedFile::~MappedFile() {
+    if (data_ != nullptr) munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+std::string MappedFile::open(const std::string& fileName) {
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return "cannot open " + fileName + ": " + std::strerror(errno);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return "cannot read " + fileName + ": " + std::strerror(errno);
+    }
+    size_t size = size_t(st.st_size);
+    void* map = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+    close(fd);
+    if (map == MAP_FAILED) return "cannot map " + fileName + ": " + std::strerror(errno);
+    if (map != nullptr) madvise(map, size, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(map);
+    size_ = size;
+    return "";
+}
+
+}  // namespace aesopdaq
@@ -0,0 +1,31 @@
+// File helpers shared by the reprocessing and index writers; not part of the installed headers.
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "aesopdaq/bytes.hpp"
+
+namespace aesopdaq {
+
+// Write a version 1.0 .npy header, padded as numpy pads it, at the start of the file
+void writeNpyHeader(std::FILE* f, const char* header, int n);
+
+// Read-only memory map of a whole file, advised for one sequential pass. An empty file maps to an empty span.
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // Return an empty string, or what went wrong
+    std::string open(const std::string& fileName);
+    ByteSpan bytes() const noexcept { return ByteSpan(data_, size_); }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}  // namespace aesopdaq
@@ -0,0 +1,80 @@
+#include "aesopdaq/frames.hpp"
+
+#include <cstring>
+
+namespace aesopdaq {
+
+static const uint8_t HEADER[3] = {0xDC, 0x00, 0xFF};
+static const uint8_t TRAILER[3] = {0xFF, 0x00, 0xFF};
+
+bool ByteSpan::startsWith(const char* tag) const noexcept {
+    size_t n = std::strlen(tag);
+    return size_ >= n && std::memcmp(data_, tag, n) == 0;
+}
+
+// Position of the next frame header at or after pos, or size if there is none
+static size_t findHeader(ByteSpan buf, size_t pos) noexcept {
+    while (pos + 3 <= buf.size()) {
+        const void* p = std::memchr(buf.data() + pos, HEADER[0], buf.size() - pos - 2);
+        if (p == nullptr) break;
+        pos = static_cast<const uint8_t*>(p) - buf.data();
+        if (buf[pos+1] == HEADER[1] && buf[pos+2] == HEADER[2]) return pos;
+        ++pos;
+    }
+    return buf.size();
+}
+
+bool FrameIterator::next(Frame& frame) noexcept {
+    while (true) {
+        size_t start = findHeader(buf_, pos_);
+        if (start == buf_.size()) {
+            size_t keep = buf_.size() >= 2 ? buf_.size() - 2 : 0;   // The end could be the start of a header
+            if (keep < pos_) keep = pos_;
+            nSkipped_ += keep - pos_;
+            pos_ = keep;
+            return false;
+        }
+        nSkipped_ += start - pos_;
+        pos_ = start;
+        if (buf_.size() - start < 6) return false;
+        size_t L = buf_[start+3];
+        size_t end = start + frameLength(L);
+        if (buf_.size() < end) return false;
+        if (std::memcmp(buf_.data() + end - 3, TRAILER, 3) != 0) {
+            ++nBadFrames_;
+            pos_ = start + 1;                   // Resynchronize on the next header
+            continue;
+        }
+        size_t nCmd = buf_[start+5];
+        if (nCmd > L) nCmd = L;
+        frame.offset = start;
+        frame.packetType = buf_[start+4];
+        frame.cmdData = buf_.subspan(start + 6, nCmd);
+        frame.data = buf_.subspan(start + 6 + nCmd, L - nCmd);
+        pos_ = end;
+        return true;
+    }
+}
+
+bool isFrameStart(ByteSpan buf, size_t pos) noexcept {
+    if (pos + 6 > buf.size() || std::memcmp(buf.data() + pos, HEADER, 3) != 0) return false;
+    size_t end = pos + frameLength(buf[pos+3]);
+    if (end > buf.size() || std::memcmp(buf.data() + end - 3, TRAILER, 3) != 0) return false;
+    return end == buf.size() || (end + 3 <= buf.size() && std::memcmp(buf.data() + end, HEADER, 3) == 0);
+}
+
+std::vector<size_t> splitAtFrames(ByteSpan buf, size_t chunkSize) {
+    std::vector<size_t> starts = {0};
+    size_t pos = chunkSize;
+    while (pos < buf.size()) {
+        pos = findHeader(buf, pos);
+        while (pos < buf.size() && !isFrameStart(buf, pos)) pos = findHeader(buf, pos + 1);
+        if (pos >= buf.size()) break;
+        starts.push_back(pos);
+        pos += chunkSize;
+    }
+    starts.push_back(buf.size());
+    return starts;
+}
+
+}  // namespace aesopdaq
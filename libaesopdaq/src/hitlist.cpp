@@ -0,0 +1,195 @@
+#include "aesopdaq/hitlist.hpp"
+#include "aesopdaq/unpack.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace aesopdaq {
+
+static constexpr unsigned CRC6_POLY = 0x65;      // 1'100101
+
+// Remainder of every 14-bit value (6-bit remainder followed by a new byte) divided by the CRC polynomial
+static std::array<uint8_t, 1 << 14> mkCRC6table() noexcept {
+    std::array<uint8_t, 1 << 14> table{};
+    for (unsigned v = 0; v < (1u << 14); ++v) {
+        unsigned r = v;
+        for (int bit = 13; bit >= 6; --bit) {
+            if (r & (1u << bit)) r ^= CRC6_POLY << (bit - 6);
+        }
+        table[v] = uint8_t(r);
+    }
+    return table;
+}
+
+static const std::array<uint8_t, 1 << 14> CRC6_TABLE = mkCRC6table();
+
+static inline unsigned crcBit(unsigned r, unsigned bit) noexcept {
+    r = (r << 1) | bit;
+    return (r & 0x40) ? r ^ CRC6_POLY : r;
+}
+
+// Continue the CRC remainder r over the first nBits bits of the bytes
+static unsigned crcBits(unsigned r, ByteSpan bytes, size_t nBits) noexcept {
+    size_t nBytes = nBits/8;
+    for (size_t i = 0; i < nBytes; ++i) r = CRC6_TABLE[(r << 8) | bytes[i]];
+    for (size_t i = 8*nBytes; i < nBits; ++i) r = crcBit(r, (bytes[i/8] >> (7 - i%8)) & 1);
+    return r;
+}
+
+uint8_t crc6(ByteSpan bytes, size_t nBits) noexcept {
+    return uint8_t(crcBits(1, bytes, nBits));     // The remainder after the leading 1 is 1
+}
+
+namespace {
+
+// Bit fields of a hit list, counted from the most significant bit of the first byte
+class BitReader {
+public:
+    explicit BitReader(ByteSpan d) noexcept : d_(d), nBits_(8*d.size()) {}
+    size_t size() const noexcept { return nBits_; }
+
+    // n <= 32 bits starting at bit pointer. Bits past the end of the list are dropped and the ones present are
+    // returned right-aligned, as hitDecoder.field does.
+    uint32_t field(size_t pointer, int n) const noexcept {
+        size_t end = std::min(pointer + n, nBits_);
+        if (end <= pointer) return 0;
+        size_t first = pointer/8;
+        if (first + 8 <= d_.size()) {           // Common case: one 64-bit load
+            uint64_t word = 0;
+            for (int i = 0; i < 8; ++i) word = (word << 8) | d_[first + i];
+            return uint32_t((word << (pointer%8)) >> (64 - (end - pointer)));
+        }
+        uint64_t word = 0;
+        size_t last = (end - 1)/8;
+        for (size_t i = first; i <= last; ++i) word = (word << 8) | d_[i];
+        word >>= 8*(last + 1) - end;
+        return uint32_t(word & ((uint64_t(1) << (end - pointer)) - 1));
+    }
+
+private:
+    ByteSpan d_;
+    size_t nBits_;
+};
+
+}  // namespace
+
+// Reset the result and check the start of the list. Returns false if there is nothing more to decode.
+static bool startHitList(ByteSpan data, HitList& out) noexcept {
+    out.rc = 0;
+    out.fpga = out.tag = out.errorFlag = out.nChips = 0;
+    out.crc = out.crcLength = out.crcCalc = 0;
+    out.trailerOK = false;
+    out.nChipHeaders = out.nClusters = 0;
+    if (data.empty()) {
+        out.rc = -1;
+        return false;
+    }
+    if (data[0] != 0xE7) {
+        out.rc = -2;
+        return false;
+    }
+    return true;
+}
+
+static void setFpgaHeader(uint32_t fpgaHeader, HitList& out) noexcept {
+    out.tag = uint8_t(fpgaHeader >> 5);
+    out.errorFlag = (fpgaHeader >> 4) & 1;
+    out.nChips = fpgaHeader & 0xF;
+}
+
+// Check the CRC and trailer that follow the chip list, which ends at bit pointer
+static int finishHitList(ByteSpan data, const BitReader& bits, size_t pointer, int rc, HitList& out) noexcept {
+    const size_t nBits = bits.size();
+    out.crc = uint8_t(bits.field(pointer, 6));
+    out.crcLength = uint8_t(nBits > pointer ? std::min<size_t>(6, nBits - pointer) : 0);
+    // CRC of the suppressed start bit followed by the list up to the CRC. A list too short for the FPGA header
+    // leaves pointer past the end; hitDecoder then right-aligns what is there, i.e. puts zeros in front of it.
+    size_t nPresent = std::min(pointer, nBits);
+    unsigned r = 1;
+    for (size_t i = nPresent; i < pointer; ++i) r = crcBit(r, 0);
+    out.crcCalc = uint8_t(crcBits(r, data, nPresent));
+    if (nBits < pointer + 6 || out.crc != out.crcCalc) ++rc;
+    out.trailerOK = nBits >= pointer + 8 && bits.field(pointer + 6, 2) == 3;
+    if (!out.trailerOK) ++rc;
+    return out.rc = rc;
+}
+
+int decodeHitListScalar(ByteSpan data, HitList& out) noexcept {
+    if (!startHitList(data, out)) return out.rc;
+    BitReader bits(data);
+    const size_t nBits = bits.size();
+
+    int rc = 0;
+    out.fpga = uint8_t(bits.field(9, 7));
+    setFpgaHeader(bits.field(16, 12), out);
+    size_t pointer = 28;
+    for (int chip = 0; chip < out.nChips; ++chip) {
+        if (nBits < pointer + 12) continue;
+        uint32_t head = bits.field(pointer, 12);
+        int nClust = (head >> 6) & 0xF;
+        uint8_t chipNum = head & 0xF;
+        uint8_t error = (head >> 5) & 1;
+        uint8_t parity = (head >> 4) & 1;
+        if (chipNum > 12) ++rc;
+        out.chips[out.nChipHeaders++] = ChipHeader{chipNum, uint8_t(nClust), uint8_t(head >> 11), error, parity};
+        if (nBits < pointer + 12 + 12*size_t(nClust)) {    // Truncated cluster list
+            ++rc;
+            pointer = nBits;
+            break;
+        }
+        if (nClust == 0) ++rc;
+        for (int i = 0; i < nClust; ++i) {
+            uint32_t word = bits.field(pointer + 12 + 12*i, 12);
+            out.clusters[out.nClusters++] = HitCluster{chipNum, uint8_t(word & 0x3F), uint8_t((word >> 6) + 1), error, parity};
+        }
+        pointer += 12 + 12*size_t(nClust);
+    }
+    return finishHitList(data, bits, pointer, rc, out);
+}
+
+int decodeHitList(ByteSpan data, HitList& out, SimdLevel level) noexcept {
+    if (data.size() < 4 || data.size() > MAX_HIT_BYTES) return decodeHitListScalar(data, out);   // No FPGA header
+    if (!startHitList(data, out)) return out.rc;
+    BitReader bits(data);
+    const size_t nBits = bits.size();
+
+    // The FPGA header, chip headers and cluster words are 12-bit words from bit 16 on
+    const size_t nWords = (nBits - 16)/12;
+    uint16_t words[MAX_HIT_WORDS + 16];
+    uint8_t fields[2*MAX_HIT_WORDS + 32];
+    unpack12(data.data() + 2, data.size() - 2, nWords, words, fields, level);
+
+    int rc = 0;
+    out.fpga = data[1] & 0x7F;
+    setFpgaHeader(words[0], out);
+    size_t w = 1;
+    bool truncated = false;
+    for (int chip = 0; chip < out.nChips; ++chip) {
+        if (w >= nWords) continue;
+        uint32_t head = words[w];
+        int nClust = (head >> 6) & 0xF;
+        uint8_t chipNum = head & 0xF;
+        uint8_t error = (head >> 5) & 1;
+        uint8_t parity = (head >> 4) & 1;
+        if (chipNum > 12) ++rc;
+        out.chips[out.nChipHeaders++] = ChipHeader{chipNum, uint8_t(nClust), uint8_t(head >> 11), error, parity};
+        if (w + 1 + nClust > nWords) {                       // Truncated cluster list
+            ++rc;
+            truncated = true;
+            break;
+        }
+        if (nClust == 0) ++rc;
+        const uint8_t* f = fields + 2*(w + 1);
+        for (int i = 0; i < nClust; ++i) {
+            out.clusters[out.nClusters++] = HitCluster{chipNum, f[2*i+1], uint8_t(f[2*i] + 1), error, parity};
+        }
+        w += 1 + nClust;
+    }
+    return finishHitList(data, bits, truncated ? nBits : 16 + 12*w, rc, out);
+}
+
+int decodeHitList(ByteSpan data, HitList& out) noexcept {
+    return decodeHitList(data, out, simdLevel());
+}
+
+}  // namespace aesopdaq
@@ -0,0 +1,111 @@
+#include "aesopdaq/index.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "aesopdaq/frames.hpp"
+#include "aesopdaq/records.hpp"
+#include "fileio.hpp"
+
+namespace aesopdaq {
+
+namespace {
+
+// numpy description of adq_index_entry on a little-endian host
+const char* INDEX_DESCR = "[('event', '<u4'), ('timeStamp', '<u4'), ('offset', '<u8'), ('run', '<u2'), "
+    "('packetType', '|u1')]";
+
+}  // namespace
+
+std::vector<adq_index_entry> buildIndex(ByteSpan stream, adq_stats& stats) {
+    std::memset(&stats, 0, sizeof(stats));
+    std::vector<adq_index_entry> index;
+    index.reserve(stream.size()/64);
+    FrameIterator it(stream);
+    Frame frame;
+    uint32_t event = 0;
+    uint32_t timeStamp = 0;
+    uint16_t run = 0;
+    while (it.next(frame)) {
+        ++stats.nFrames;
+        const ByteSpan& d = frame.data;
+        adq_index_entry e = {event, timeStamp, frame.offset, run, frame.packetType};
+        switch (frame.packetType) {
+        case PKT_EVENT:
+        case PKT_EVENT_DEBUG:
+            if (d.size() >= 14 && d.startsWith("ZERO")) {       // The fields ahead of the hit lists are enough
+                ++stats.nEvents;
+                run = e.run = d.be16(4);
+                event = e.event = d.be32(6);
+                timeStamp = e.timeStamp = d.be32(10);
+            } else {
+                ++stats.nBadEvents;
+            }
+            break;
+        case PKT_HOUSEKEEPING: {
+            HousekeepingView hk(d);
+            if (hk.valid()) {
+                run = e.run = hk.run();
+                event = e.event = hk.cntGO();
+            }
+            break;
+        }
+        case PKT_ERROR_RECORD: {
+            ErrorRecordView err(d);
+            if (err.valid()) e.event = err.eventCount();
+            break;
+        }
+        case PKT_ERROR_STREAM: {
+            ErrorStreamView ers(d);
+            if (ers.valid() && ers.nErrors() > 0) e.event = ers.entry(0).event;
+            break;
+        }
+        case PKT_EOR: {
+            EorView eor(d);
+            if (eor.valid()) {
+                run = e.run = eor.run();
+                event = e.event = eor.cntGo();
+            }
+            break;
+        }
+        default: {
+            BorView bor(d);
+            if (bor.valid()) {
+                run = e.run = bor.run();
+                event = e.event = 0;
+            }
+            break;
+        }
+        }
+        if (frame.packetType != PKT_EVENT && frame.packetType != PKT_EVENT_DEBUG) ++stats.nOther;
+        index.push_back(e);
+    }
+    stats.consumed = it.position();
+    stats.nSkipped = it.nSkipped();
+    stats.nBadFrames = it.nBadFrames();
+    return index;
+}
+
+std::string indexStreamFile(const std::string& fileName, const std::string& indexFile, size_t& nRecords,
+                            adq_stats& stats) {
+    nRecords = 0;
+    std::memset(&stats, 0, sizeof(stats));
+    MappedFile map;
+    std::string error = map.open(fileName);
+    if (!error.empty()) return error;
+    std::vector<adq_index_entry> index = buildIndex(map.bytes(), stats);
+
+    std::FILE* f = std::fopen(indexFile.c_str(), "wb");
+    if (f == nullptr) return "cannot create " + indexFile;
+    char header[256];
+    int n = std::snprintf(header, sizeof(header), "{'descr': %s, 'fortran_order': False, 'shape': (%zu,), }",
+                          INDEX_DESCR, index.size());
+    writeNpyHeader(f, header, n);
+    bool failed = std::fwrite(index.data(), sizeof(adq_index_entry), index.size(), f) != index.size();
+    failed |= std::fclose(f) != 0;
+    if (failed) return "error writing " + indexFile;
+    nRecords = index.size();
+    return "";
+}
+
+}  // namespace aesopdaq
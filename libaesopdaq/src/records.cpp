@@ -0,0 +1,42 @@
+#include "aesopdaq/records.hpp"
+
+namespace aesopdaq {
+
+EventView::EventView(uint8_t packetType, ByteSpan data) noexcept : d_(data), packetType_(packetType) {
+    size_t p = hasTofDebug() ? 49 : 39;
+    if (d_.size() <= p || !d_.startsWith("ZERO")) return;
+    if (hasRearm()) {                   // Re-arm to GO interval and missed triggers in it
+        rearmOffset_ = p;
+        p += 4;
+        if (d_.size() <= p) return;
+    }
+    int nLayers = d_[p++];
+    if (nLayers > MAX_TKR_LAYERS) return;
+    for (int lyr = 0; lyr < nLayers; ++lyr) {
+        if (p >= d_.size()) return;
+        size_t nBytes = d_[p++];
+        if (p + nBytes > d_.size()) return;
+        layerOffset_[lyr] = p;
+        layerLength_[lyr] = nBytes;
+        p += nBytes;
+    }
+    nLayers_ = nLayers;
+    valid_ = true;
+}
+
+int TkrHousekeepingView::nBoards() const noexcept {
+    int brd = 0;
+    while (brd < 8 && d_.size() >= 10 + 24*size_t(brd + 1) && (d_[10 + 24*brd] != 0 || d_[11 + 24*brd] != 0)) ++brd;
+    return brd;
+}
+
+uint16_t BorView::pmtDAC(int ch) const noexcept {
+    return ch < 4 ? d_[12 + ch] : d_.be16(16);
+}
+
+ErrorStreamView::Entry ErrorStreamView::entry(int i) const noexcept {
+    size_t p = 5 + 11*size_t(i);
+    return Entry{d_[p], {d_[p+1], d_[p+2]}, d_.be32(p+3), d_.be32(p+7)};
+}
+
+}  // namespace aesopdaq
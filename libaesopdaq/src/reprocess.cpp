@@ -0,0 +1,217 @@
+#include "aesopdaq/reprocess.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <future>
+#include <vector>
+
+#include "aesopdaq/frames.hpp"
+#include "aesopdaq/hitlist.hpp"
+#include "aesopdaq/records.hpp"
+#include "aesopdaq/threadpool.hpp"
+#include "fileio.hpp"
+
+namespace aesopdaq {
+
+namespace {
+
+constexpr int NLAYERS = 8;                  // As in runFile.py
+constexpr int NSTRIPS = 768;
+
+// numpy descriptions of adq_event and adq_cluster, i.e. of runFile.eventDtype and runFile.clusterDtype on a
+// little-endian host
+const char* EVENT_DESCR = "[('trigger', '<u4'), ('run', '<u2'), ('timeStamp', '<u4'), ('timeDate', '<u4'), "
+    "('deltaTime', '<i8'), ('cntGo1', '<u4'), ('trgStatus', '|u1'), ('trgCount', '<u2'), ('T1', '<u2'), "
+    "('T2', '<u2'), ('T3', '<u2'), ('T4', '<u2'), ('G', '<u2'), ('dtmin', '<i4'), ('nTOFA', '|u1'), "
+    "('nTOFB', '|u1'), ('tofA', '<i4'), ('tofB', '<i4'), ('clkA', '<u2'), ('clkB', '<u2'), ('liveUsec', '<i4'), "
+    "('nGO1live', '|u1'), ('nTkrLyrs', '|u1'), ('tkrErrors', '<u2'), ('firstCluster', '<u4'), ('nClusters', '<u2')]";
+const char* CLUSTER_DESCR = "[('event', '<u4'), ('layer', '|u1'), ('chip', '|u1'), ('strip', '<u2'), "
+    "('width', '|u1'), ('error', '|u1'), ('parity', '|u1')]";
+
+struct Chunk {
+    std::vector<adq_event> events;
+    std::vector<adq_cluster> clusters;
+    std::vector<int64_t> occupancy;
+    adq_stats stats = {};
+    int64_t lastTime = 0;                   // Time stamp of the last event
+};
+
+void addStats(adq_stats& sum, const adq_stats& s) {
+    sum.consumed += s.consumed;
+    sum.nFrames += s.nFrames;
+    sum.nEvents += s.nEvents;
+    sum.nClusters += s.nClusters;
+    sum.nBadEvents += s.nBadEvents;
+    sum.nOther += s.nOther;
+    sum.nSkipped += s.nSkipped;
+    sum.nBadFrames += s.nBadFrames;
+}
+
+// Decode one chunk, with event and cluster indices counted from the start of the chunk
+void decodeChunk(ByteSpan data, Chunk& chunk) {
+    chunk.events.resize(data.size()/48 + 1);       // An event frame is at least 48 bytes long
+    chunk.clusters.resize(data.size()/4 + MAX_TKR_LAYERS*MAX_HIT_CLUSTERS);
+    size_t nEvents = 0;
+    size_t nClusters = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        if (chunk.clusters.size() - nClusters < size_t(MAX_TKR_LAYERS*MAX_HIT_CLUSTERS)) {
+            chunk.clusters.resize(2*chunk.clusters.size());
+        }
+        adq_stats stats;
+        nEvents += adq_decode_events(data.data() + pos, data.size() - pos, uint32_t(nEvents), uint32_t(nClusters),
+                                     &chunk.lastTime, chunk.events.data() + nEvents, chunk.events.size() - nEvents,
+                                     chunk.clusters.data() + nClusters, chunk.clusters.size() - nClusters, &stats);
+        nClusters += stats.nClusters;
+        addStats(chunk.stats, stats);
+        if (stats.consumed == 0) break;
+        pos += stats.consumed;
+    }
+    chunk.stats.nSkipped += data.size() - pos;      // Garbage, or a frame cut off at the end of the stream
+    chunk.stats.consumed = data.size();
+    chunk.events.resize(nEvents);
+    chunk.clusters.resize(nClusters);
+
+    // Strip occupancy, as in runFile.RunWriter.flush
+    chunk.occupancy.assign(NLAYERS*NSTRIPS, 0);
+    for (const adq_cluster& c : chunk.clusters) {
+        int lyr = c.layer == 8 ? 0 : c.layer;       // FPGA address 8 is layer 0
+        if (lyr >= NLAYERS) continue;
+        for (int k = 0; k < c.width; ++k) {
+            int strip = int(c.strip) - k;
+            if (strip >= 0 && strip < NSTRIPS) ++chunk.occupancy[lyr*NSTRIPS + strip];
+        }
+    }
+}
+
+// A .npy file of records, appended to a chunk at a time, with a fixed-width header that is rewritten with the new
+// length after each append, as runFile.RecordFile does
+class NpyFile {
+public:
+    NpyFile(const std::string& fileName, const char* descr) : descr_(descr) {
+        f_ = std::fopen(fileName.c_str(), "wb");
+        if (f_ != nullptr) {
+            writeHeader(0);
+        } else {
+            failed_ = true;
+        }
+    }
+    ~NpyFile() { close(); }
+    bool ok() const { return !failed_; }
+
+    void append(const void* records, size_t size, size_t count) {
+        if (f_ == nullptr || count == 0) return;
+        std::fseek(f_, 0, SEEK_END);
+        failed_ |= std::fwrite(records, size, count, f_) != count;
+        length_ += count;
+        writeHeader(length_);
+        failed_ |= std::fflush(f_) != 0;
+    }
+
+    void close() {
+        if (f_ != nullptr) failed_ |= std::fclose(f_) != 0;
+        f_ = nullptr;
+    }
+
+private:
+    void writeHeader(size_t length) {
+        char header[1024];
+        int n = std::snprintf(header, sizeof(header), "{'descr': %s, 'fortran_order': False, 'shape': (%20zu,), }",
+                              descr_, length);
+        writeNpyHeader(f_, header, n);
+    }
+
+    const char* descr_;
+    std::FILE* f_ = nullptr;
+    size_t length_ = 0;
+    bool failed_ = false;
+};
+
+}  // namespace
+
+std::string reprocess(ByteSpan stream, const std::string& directory, int runNumber, const ReprocessOptions& options,
+                      ReprocessResult& result) {
+    auto t0 = std::chrono::steady_clock::now();
+    result = ReprocessResult();
+    std::string base = (directory.empty() ? std::string(".") : directory) + "/run" + std::to_string(runNumber);
+    NpyFile eventFile(base + "_events.npy", EVENT_DESCR);
+    NpyFile clusterFile(base + "_clusters.npy", CLUSTER_DESCR);
+    if (!eventFile.ok() || !clusterFile.ok()) return "cannot create the run files " + base + "_*.npy";
+
+    std::vector<size_t> starts = splitAtFrames(stream, options.chunkSize);
+    size_t nChunks = starts.size() - 1;
+    std::vector<Chunk> chunks(nChunks);
+    std::vector<std::promise<void>> done(nChunks);
+    ThreadPool pool(options.nThreads);
+    for (size_t k = 0; k < nChunks; ++k) {
+        pool.submit([&, k] {
+            try {
+                decodeChunk(stream.subspan(starts[k], starts[k+1] - starts[k]), chunks[k]);
+                done[k].set_value();
+            } catch (...) {
+                done[k].set_exception(std::current_exception());
+            }
+        });
+    }
+
+    // Append the chunks in order as they come in
+    std::vector<int64_t> occupancy(NLAYERS*NSTRIPS, 0);
+    uint32_t eventBase = 0;
+    uint32_t clusterBase = 0;
+    bool haveTime = false;
+    int64_t lastTime = 0;
+    for (size_t k = 0; k < nChunks; ++k) {
+        try {
+            done[k].get_future().get();
+        } catch (const std::exception& e) {
+            return "error decoding chunk " + std::to_string(k) + " of the stream: " + e.what();
+        }
+        Chunk& chunk = chunks[k];
+        for (adq_event& e : chunk.events) e.firstCluster += clusterBase;
+        for (adq_cluster& c : chunk.clusters) c.event += eventBase;
+        if (!chunk.events.empty()) {
+            if (haveTime) chunk.events[0].deltaTime = int64_t(chunk.events[0].timeStamp) - lastTime;
+            haveTime = true;
+            lastTime = chunk.lastTime;
+        }
+        eventFile.append(chunk.events.data(), sizeof(adq_event), chunk.events.size());
+        clusterFile.append(chunk.clusters.data(), sizeof(adq_cluster), chunk.clusters.size());
+        for (size_t i = 0; i < occupancy.size(); ++i) occupancy[i] += chunk.occupancy[i];
+        eventBase += uint32_t(chunk.events.size());
+        clusterBase += uint32_t(chunk.clusters.size());
+        addStats(result.stats, chunk.stats);
+        chunk = Chunk();                            // Free it
+    }
+    pool.wait();
+    result.nChunks = nChunks;
+    result.nThreads = pool.size();
+    result.nStolen = pool.nStolen();
+    eventFile.close();
+    clusterFile.close();
+    if (!eventFile.ok() || !clusterFile.ok()) return "error writing the run files " + base + "_*.npy";
+
+    std::FILE* f = std::fopen((base + "_occupancy.npy").c_str(), "wb");
+    if (f == nullptr) return "cannot create " + base + "_occupancy.npy";
+    char header[128];
+    int n = std::snprintf(header, sizeof(header), "{'descr': '<i8', 'fortran_order': False, 'shape': (%d, %d), }",
+                          NLAYERS, NSTRIPS);
+    writeNpyHeader(f, header, n);
+    bool failed = std::fwrite(occupancy.data(), sizeof(int64_t), occupancy.size(), f) != occupancy.size();
+    failed |= std::fclose(f) != 0;
+    if (failed) return "error writing " + base + "_occupancy.npy";
+
+    std::chrono::duration<double> dt = std::chrono::steady_clock::now() - t0;
+    result.seconds = dt.count();
+    return "";
+}
+
+std::string reprocessFile(const std::string& fileName, const std::string& directory, int runNumber,
+                          const ReprocessOptions& options, ReprocessResult& result) {
+    MappedFile map;
+    std::string error = map.open(fileName);
+    if (!error.empty()) return error;
+    return reprocess(map.bytes(), directory, runNumber, options, result);
+}
+
+}  // namespace aesopdaq
@@ -0,0 +1,92 @@
+#include "aesopdaq/threadpool.hpp"
+
+namespace aesopdaq {
+
+// The pool and worker index of the current thread, for tasks that submit tasks
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local unsigned currentWorker = 0;
+
+ThreadPool::ThreadPool(unsigned nThreads) {
+    if (nThreads == 0) nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0) nThreads = 1;
+    for (unsigned i = 0; i < nThreads; ++i) queues_.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < nThreads; ++i) threads_.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : threads_) t.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unsigned q = currentPool == this ? currentWorker : next_++ % size();
+        {
+            std::lock_guard<std::mutex> qlock(queues_[q]->mutex);
+            queues_[q]->tasks.push_back(std::move(task));
+        }
+        ++nQueued_;
+        ++nPending_;
+    }
+    wake_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return nPending_ == 0; });
+}
+
+// Take the newest task of our own deque, or else the oldest of another one
+bool ThreadPool::take(unsigned self, std::function<void()>& task) {
+    bool stolen = false;
+    bool found = false;
+    {
+        Queue& own = *queues_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            found = true;
+        }
+    }
+    for (unsigned i = 1; !found && i < size(); ++i) {
+        Queue& other = *queues_[(self + i) % size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            found = stolen = true;
+        }
+    }
+    if (found) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --nQueued_;
+        if (stolen) ++nStolen_;
+    }
+    return found;
+}
+
+void ThreadPool::work(unsigned self) {
+    currentPool = this;
+    currentWorker = self;
+    std::function<void()> task;
+    while (true) {
+        if (take(self, task)) {
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--nPending_ == 0) idle_.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [this] { return stopping_ || nQueued_ > 0; });
+        if (stopping_ && nQueued_ == 0) return;
+    }
+}
+
+}  // namespace aesopdaq
@@ -0,0 +1,104 @@
+#include "aesopdaq/unpack.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(AESOPDAQ_NO_SIMD)
+#define AESOPDAQ_X86 1
+#include <immintrin.h>
+#endif
+
+namespace aesopdaq {
+
+// Words i0 up to nWords, i0 even
+static void unpackScalar(const uint8_t* src, size_t i0, size_t nWords, uint16_t* words, uint8_t* fields) noexcept {
+    for (size_t i = i0; i < nWords; i += 2) {
+        const uint8_t* b = src + 3*i/2;
+        words[i] = uint16_t((b[0] << 4) | (b[1] >> 4));
+        fields[2*i] = b[0] >> 2;
+        fields[2*i+1] = uint8_t(((b[0] & 0x03) << 4) | (b[1] >> 4));
+        if (i + 1 == nWords) break;
+        words[i+1] = uint16_t(((b[1] & 0x0F) << 8) | b[2]);
+        fields[2*i+2] = uint8_t(((b[1] & 0x0F) << 2) | (b[2] >> 6));
+        fields[2*i+3] = b[2] & 0x3F;
+    }
+}
+
+#ifdef AESOPDAQ_X86
+
+// Byte pairs of 4 groups of 3 bytes, each pair little-endian in a 16-bit lane: b1 b0, b2 b1, b4 b3, b5 b4, ...
+// An even word is then the lane shifted right by 4, an odd word the lane masked to 12 bits.
+#define PAIRS 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+
+__attribute__((target("sse4.1")))
+static size_t unpackSSE41(const uint8_t* src, size_t srcSize, size_t nWords, uint16_t* words, uint8_t* fields) noexcept {
+    const __m128i pairs = _mm_setr_epi8(PAIRS);
+    const __m128i mask12 = _mm_set1_epi16(0x0FFF);
+    const __m128i mask6 = _mm_set1_epi16(0x003F);
+    size_t i = 0;
+    for (; i + 8 <= nWords && 3*i/2 + 16 <= srcSize; i += 8) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3*i/2)), pairs);
+        __m128i w = _mm_blend_epi16(_mm_srli_epi16(v, 4), _mm_and_si128(v, mask12), 0xAA);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(words + i), w);
+        // 6-bit lanes: upper half in the low byte of each 16-bit lane, lower half in the high byte
+        __m128i f = _mm_or_si128(_mm_srli_epi16(w, 6), _mm_slli_epi16(_mm_and_si128(w, mask6), 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(fields + 2*i), f);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t unpackAVX2(const uint8_t* src, size_t srcSize, size_t nWords, uint16_t* words, uint8_t* fields) noexcept {
+    const __m256i pairs = _mm256_setr_epi8(PAIRS, PAIRS);
+    const __m256i mask12 = _mm256_set1_epi16(0x0FFF);
+    const __m256i mask6 = _mm256_set1_epi16(0x003F);
+    size_t i = 0;
+    for (; i + 16 <= nWords && 3*i/2 + 28 <= srcSize; i += 16) {
+        const uint8_t* b = src + 3*i/2;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b))),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + 12)), 1);
+        v = _mm256_shuffle_epi8(v, pairs);
+        __m256i w = _mm256_blend_epi16(_mm256_srli_epi16(v, 4), _mm256_and_si256(v, mask12), 0xAA);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(words + i), w);
+        __m256i f = _mm256_or_si256(_mm256_srli_epi16(w, 6), _mm256_slli_epi16(_mm256_and_si256(w, mask6), 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(fields + 2*i), f);
+    }
+    return i + unpackSSE41(src + 3*i/2, srcSize - 3*i/2, nWords - i, words + i, fields + 2*i);
+}
+
+#undef PAIRS
+
+#endif
+
+SimdLevel simdLevel() noexcept {
+#ifdef AESOPDAQ_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx2") ? SimdLevel::AVX2
+                                 : __builtin_cpu_supports("sse4.1") ? SimdLevel::SSE41 : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdName(SimdLevel level) noexcept {
+    switch (level) {
+    case SimdLevel::AVX2: return "AVX2";
+    case SimdLevel::SSE41: return "SSE4.1";
+    default: return "scalar";
+    }
+}
+
+void unpack12(const uint8_t* src, size_t srcSize, size_t nWords, uint16_t* words, uint8_t* fields,
+              SimdLevel level) noexcept {
+    size_t i = 0;
+#ifdef AESOPDAQ_X86
+    if (level == SimdLevel::AVX2) {
+        i = unpackAVX2(src, srcSize, nWords, words, fields);
+    } else if (level == SimdLevel::SSE41) {
+        i = unpackSSE41(src, srcSize, nWords, words, fields);
+    }
+#else
+    (void)srcSize;
+    (void)level;
+#endif
+    unpackScalar(src, i, nWords, words, fields);
+}
+
+}  // namespace aesopdaq
@@ -0,0 +1,50 @@
+// Reprocess a raw event PSOC stream into the run files that limitedRun writes (see reprocess.hpp).
+//    aesop_reprocess [-j threads] [-c chunk MB] stream runNumber [directory]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "aesopdaq/reprocess.hpp"
+
+using namespace aesopdaq;
+
+static int usage() {
+    std::fprintf(stderr, "usage: aesop_reprocess [-j threads] [-c chunk MB] stream runNumber [directory]\n");
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    ReprocessOptions options;
+    int i = 1;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (std::strcmp(argv[i], "-j") == 0) {
+            options.nThreads = unsigned(std::atoi(argv[i+1]));
+        } else if (std::strcmp(argv[i], "-c") == 0) {
+            options.chunkSize = size_t(std::atof(argv[i+1])*(1 << 20));
+        } else {
+            return usage();
+        }
+    }
+    if (argc - i < 2 || argc - i > 3 || options.chunkSize == 0) return usage();
+    std::string fileName = argv[i];
+    int runNumber = std::atoi(argv[i+1]);
+    std::string directory = argc - i == 3 ? argv[i+2] : ".";
+
+    ReprocessResult result;
+    std::string error = reprocessFile(fileName, directory, runNumber, options, result);
+    if (!error.empty()) {
+        std::fprintf(stderr, "aesop_reprocess: %s\n", error.c_str());
+        return 1;
+    }
+    const adq_stats& s = result.stats;
+    std::printf("%s: %llu bytes in %zu chunks on %u threads (%zu chunks stolen)\n", fileName.c_str(),
+                (unsigned long long)s.consumed, result.nChunks, result.nThreads, result.nStolen);
+    std::printf("%llu events, %llu clusters, %llu other records, %llu bad events\n", (unsigned long long)s.nEvents,
+                (unsigned long long)s.nClusters, (unsigned long long)s.nOther, (unsigned long long)s.nBadEvents);
+    std::printf("%llu bytes skipped, %llu bad frames\n", (unsigned long long)s.nSkipped,
+                (unsigned long long)s.nBadFrames);
+    std::printf("%.3f s, %.0f events/s, %.1f MB/s\n", result.seconds, s.nEvents/result.seconds,
+                s.consumed/result.seconds/1.e6);
+    return 0;
+}
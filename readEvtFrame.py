@@ -1,99 +1,199 @@
-import re
+# Extract the Event PSOC records from a Main PSOC capture file.
+# The capture is a sequence of 33-byte frames: 2-byte frame sequence number (most significant byte first),
+# sync word 55 AB 55 AB, 27 data bytes. The data bytes of consecutive frames form the Event PSOC output stream,
+# with records either in 9-byte packets (older code) or in single frames, both starting with DC 00 FF and ending
+# with FF 00 FF.
+# The file is memory-mapped and read in one pass. The frames are checked and their data extracted a block at a time
+# with numpy, records are reassembled across frame boundaries in memory, and a jump in the frame sequence numbers
+# is reported as a gap, dropping the record that was cut by it.
+#    python readEvtFrame.py [-v] captureFile
+import bisect
+import mmap
 import sys
+import time
+import numpy as np
+from frameReader import frameLength
 
-def bytes2int(str):
-   if str == b'':
-       return 0
-   return int(str.hex(), 16)
+SYNC = b'\x55\xab\x55\xab'
+FRAME_LEN = 33
+FRAME_DATA = 6            # Offset of the data bytes in a frame
+BLOCK_FRAMES = 1 << 20    # Frames checked per numpy pass, 33 MB
 
-captFileName = sys.argv[-1]
-print(captFileName)
-captFile = open(captFileName, "rb")
+HEADER = b'\xDC\x00\xFF'
+TRAILER = b'\xFF\x00\xFF'
+RECORD_IDS = (b'ZER', b'HAU', b'TRA', b'ERR', b'ERS')   # Start of the event, housekeeping and error records
 
-frameRe = re.compile(rb"(?P<num>[\x00-\xff]{2})\x55\xab\x55\xab(?P<data>[\x00-\xff]{27})")
-print(frameRe)
+class CaptureDeframer:
+    def __init__(self, fileName, verbose = False):
+        self.fileName = fileName
+        self.verbose = verbose
+        self.nFrames = 0          # Good frames
+        self.nGaps = 0            # Jumps in the frame sequence number
+        self.nMissing = 0         # Frames missing according to the sequence numbers
+        self.nResync = 0          # Times the frame sync was lost
+        self.nSkipped = 0         # Capture bytes skipped looking for the frame sync
+        self.nRecords = 0
+        self.nBadRecords = 0      # Records with a bad header or data packet
+        self.nCutRecords = 0      # Records dropped because a gap fell inside them
+        self.lastSeq = None
+        self.pending = bytearray()    # Event PSOC stream not yet made into records
+        self.pendingPos = 0
+        self.segStart = []            # Start in pending of each run of consecutive frames,
+        self.segOffset = []           # and the capture offset of its first frame
+        self.afterGap = False         # Looking for the first record after a gap
 
+    # Yield (capture offset of the frame holding the record header, packet type, output data) for every record
+    def records(self):
+        with open(self.fileName, "rb") as f:
+            f.seek(0, 2)
+            if f.tell() == 0: return
+            mm = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        yield from self._scan(mm)
 
-captFileBuff = captFile.read(3300)
-# print(captFileBuff)
-frameBuff = frameRe.findall(captFileBuff)
-# print(frameBuff)
-evtRe = re.compile(rb"\x5a\x45\x52")
-# evtRe = re.compile(rb"\xdc\x00\xff")
-framesWritten = 0
-framesToWrite = 10
-tmpFileName = "./temp-evt.bin"
-outTmpFile = open(tmpFileName, "wb")
-#inTmpFile = captFile
-while frameBuff:
-    for curFrame in frameBuff:
-        if 0 == framesWritten:
-            findRes = evtRe.search(curFrame[1])
-            if findRes:
-                startHead = findRes.start() - 3
-                if 0 <= startHead:
-                    outTmpFile = open(tmpFileName, "wb")
-                    outTmpFile.write(curFrame[1][startHead:27])
-                    print(curFrame[1])
-                    print(startHead)
-                    print(curFrame[1][startHead:27])
-                    framesWritten = framesWritten + 1
-        else:
-            outTmpFile.write(curFrame[1])
-            framesWritten = framesWritten + 1
-            if framesToWrite <= framesWritten:
-                outTmpFile.close()
-                framesWritten = 0
-                ser = open(tmpFileName, "rb")
-                # print("first ")
-                # print(ser.read(1)) #debug alignment issue
-                while True:
-                    ret = ser.read(3)
-                    # print(ret)
-                    #print("limitedRun: looking for start of event. Received bytes " + str(ret.hex()))
-                    if ret == b'\xDC\x00\xFF': break
-                    # if ret == b'': break
-                    #time.sleep(0.1)
-                verbose = True
-                print("limitedRun: reading event " )#+ str(event) + " of run " + str(runNumber))
-                ret = ser.read(1)
-                nData = bytes2int(ret)
-                ser.read(2)
-                ret = ser.read(3)
-                if ret != b'\xFF\x00\xFF':
-                    print("limitedRun: invalid trailer returned: " + str(ret))  
-                R = nData % 3
-                nPackets = int(nData/3)
-                if (R != 0): nPackets = nPackets + 1
-                dataList = []
-                byteList = []
-                if verbose: print("limitedRun: reading " + str(nData) + " data bytes in " + str(nPackets) + " packets")
-                for i in range(nPackets):
-                    ret = ser.read(3)
-                    if ret != b'\xDC\x00\xFF':
-                        print("limitedRun: invalid header returned: " + str(ret))
-                    byte1 = ser.read(1)
-                    if verbose: print("   Packet " + str(i) + ", byte 1 = " + str(bytes2int(byte1)) + " decimal, " + str(byte1.hex()) + " hex")
-                    dataList.append(bytes2int(byte1))
-                    byteList.append(byte1)
-                    byte2 = ser.read(1)
-                    if verbose: print("   Packet " + str(i) + ", byte 2 = " + str(bytes2int(byte2)) + " decimal, " + str(byte2.hex()) + " hex")
-                    dataList.append(bytes2int(byte2))
-                    byteList.append(byte2)
-                    byte3 = ser.read(1)
-                    if verbose: print("   Packet " + str(i) + ", byte 3 = " + str(bytes2int(byte3)) + " decimal, " + str(byte3.hex()) + " hex")
-                    dataList.append(bytes2int(byte3))
-                    byteList.append(byte3)
-                    ret = ser.read(3)
-                    if ret != b'\xFF\x00\xFF':
-                        print("limitedRun: invalid trailer returned: " + str(ret)) 
-                run = dataList[4]*256 + dataList[5]
-                trigger = dataList[6]*16777216 + dataList[7]*65536 + dataList[8]*256 + dataList[9]
-                if verbose: print("   Trigger " + str(trigger) + ", Data List length = " + str(len(dataList)))            
-                timeStamp = dataList[10]*16777216 + dataList[11]*65536 + dataList[12]*256 + dataList[13]
+    def _scan(self, mm):
+        size = len(mm)
+        raw = np.frombuffer(mm, dtype=np.uint8)
+        pos = self._resync(mm, 0)
+        while pos + FRAME_LEN <= size:
+            n = min(BLOCK_FRAMES, (size - pos)//FRAME_LEN)
+            frames = raw[pos:pos + n*FRAME_LEN].reshape(n, FRAME_LEN)
+            ok = (frames[:,2] == 0x55) & (frames[:,3] == 0xAB) & (frames[:,4] == 0x55) & (frames[:,5] == 0xAB)
+            nGood = n if ok.all() else int(np.argmin(ok))
+            frames = frames[:nGood]
+            seq = (frames[:,0].astype(np.uint16) << 8) | frames[:,1]
+            breaks = np.flatnonzero(np.diff(seq) != 1) + 1       # uint16 difference wraps around at 65535
+            first = 0
+            for last in list(breaks) + [nGood]:
+                if last > first:
+                    self._checkSeq(int(seq[first]), pos + first*FRAME_LEN)
+                    self.lastSeq = int(seq[last - 1])
+                    self.segStart.append(len(self.pending))
+                    self.segOffset.append(pos + first*FRAME_LEN)
+                    self.pending += frames[first:last, FRAME_DATA:].tobytes()
+                    self.nFrames += last - first
+                    yield from self._records()
+                first = last
+            del frames, ok
+            pos += nGood*FRAME_LEN
+            if nGood < n:
+                self.nResync += 1
+                newPos = self._resync(mm, pos)
+                if self.verbose: print("Frame sync lost at byte " + str(pos) + ", skipped " + str(newPos - pos) + " bytes")
+                pos = newPos
+        self.nSkipped += size - pos
 
+    # Find the start of the next frame, checking that the one after it is also in sync
+    def _resync(self, mm, pos):
+        size = len(mm)
+        first = pos
+        while True:
+            i = mm.find(SYNC, pos + 2)
+            if i < 0: i = size + 2
+            start = max(i - 2, pos)
+            if start + FRAME_LEN + 6 > size or mm[start + FRAME_LEN + 2:start + FRAME_LEN + 6] == SYNC:
+                self.nSkipped += start - first
+                return start
+            pos = start + 1
 
+    def _checkSeq(self, seq, offset):
+        if self.lastSeq is None: return
+        nMissing = (seq - self.lastSeq - 1) & 0xFFFF
+        if nMissing == 0: return
+        self.nGaps += 1
+        self.nMissing += nMissing
+        print("Gap at byte " + str(offset) + ": frame " + str(seq) + " follows frame " + str(self.lastSeq) + ", " + str(nMissing) + " frames missing")
+        if self.pending.find(HEADER, self.pendingPos) >= 0: self.nCutRecords += 1
+        self.afterGap = True
+        self.pending = bytearray()
+        self.pendingPos = 0
+        self.segStart = []
+        self.segOffset = []
 
-    captFileBuff = captFile.read(3300)
-    frameBuff = frameRe.findall(captFileBuff)
+    # Capture offset of the frame that holds byte i of the pending stream
+    def _captureOffset(self, i):
+        seg = bisect.bisect_right(self.segStart, i) - 1
+        return self.segOffset[seg] + FRAME_LEN*((i - self.segStart[seg])//(FRAME_LEN - FRAME_DATA))
 
+    # Make records out of the pending stream
+    def _records(self):
+        buf = self.pending
+        i = self.pendingPos
+        while True:
+            h = buf.find(HEADER, i)
+            if h < 0:
+                i = max(i, len(buf) - 2)
+                break
+            i = h
+            if len(buf) < h + 9: break
+            record = self._packetRecord(buf, h) if buf[h + 6:h + 9] == TRAILER else None
+            if record is None:
+                record = self._frameRecord(buf, h)
+            if record is None:
+                if not self.afterGap: self.nBadRecords += 1
+                i = h + 1
+                continue
+            if record == 0: break              # Not all in yet
+            end, packetType, data = record
+            if self.afterGap:                  # A data packet cut by a gap looks like a header packet, so resume
+                if buf[h + 5] != 0 or data[0:3] not in RECORD_IDS:   # at an event, housekeeping or error record
+                    i = h + 1
+                    continue
+                self.afterGap = False
+            self.nRecords += 1
+            yield self._captureOffset(h), packetType, data
+            i = end
+        if i > 65536:                       # Drop the consumed stream now and then
+            del buf[:i]
+            seg = bisect.bisect_right(self.segStart, i) - 1
+            self.segOffset = self.segOffset[seg:]
+            self.segStart = [start - i for start in self.segStart[seg:]]   # The first one can go negative
+            i = 0
+        self.pendingPos = i
+
+    # Record sent as a header packet DC 00 FF, n, packet type, N, FF 00 FF, followed by the n bytes (N command data
+    # bytes and the output data) in 3-byte packets DC 00 FF b1 b2 b3 FF 00 FF.
+    # Returns (end, packet type, output data), 0 if incomplete, None if not such a record.
+    def _packetRecord(self, buf, h):
+        nData = buf[h + 3]
+        nPackets = (nData + 2)//3
+        end = h + 9 + 9*nPackets
+        if len(buf) < end: return 0
+        for k in range(3):                 # Check the packet headers and trailers with strided slices
+            if buf[h + 9 + k:end:9] != HEADER[k:k+1]*nPackets: return None
+            if buf[h + 15 + k:end:9] != TRAILER[k:k+1]*nPackets: return None
+        data = bytearray(3*nPackets)
+        for k in range(3): data[k::3] = buf[h + 12 + k:end:9]
+        return end, buf[h + 4], bytes(data[buf[h + 5]:nData])
+
+    # Record sent as a single frame DC 00 FF, n, packet type, N, n bytes, padding to a multiple of 3, FF 00 FF,
+    # as read by frameReader.FrameReader
+    def _frameRecord(self, buf, h):
+        L = buf[h + 3]
+        end = h + frameLength(L)
+        if len(buf) < end: return 0
+        if buf[end - 3:end] != TRAILER: return None
+        return end, buf[h + 4], bytes(buf[h + 6 + buf[h + 5]:h + 6 + L])
+
+def printRecord(offset, packetType, data, verbose):
+    if data[0:4] != b'ZERO' or len(data) < 14:
+        print("Record of type " + hex(packetType) + " at byte " + str(offset) + " with " + str(len(data)) + " data bytes")
+        if verbose: print("   " + data.hex())
+        return
+    run = data[4]*256 + data[5]
+    trigger = data[6]*16777216 + data[7]*65536 + data[8]*256 + data[9]
+    timeStamp = data[10]*16777216 + data[11]*65536 + data[12]*256 + data[13]
+    print("Run " + str(run) + " trigger " + str(trigger) + ", time stamp " + str(timeStamp) + ", " + str(len(data)) + " data bytes")
+    if verbose: print("   " + data.hex())
+
+if __name__ == "__main__":
+    verbose = "-v" in sys.argv[1:-1]
+    captFileName = sys.argv[-1]
+    print(captFileName)
+    deframer = CaptureDeframer(captFileName, verbose)
+    tStart = time.time()
+    for offset, packetType, data in deframer.records():
+        printRecord(offset, packetType, data, verbose)
+    tElapsed = time.time() - tStart
+    print(str(deframer.nFrames) + " frames, " + str(deframer.nRecords) + " records in " + "{:.1f}".format(tElapsed) + " seconds")
+    print(str(deframer.nGaps) + " sequence gaps with " + str(deframer.nMissing) + " frames missing, " + str(deframer.nCutRecords) + " records cut by a gap")
+    print(str(deframer.nResync) + " losses of frame sync, " + str(deframer.nSkipped) + " bytes skipped, " + str(deframer.nBadRecords) + " bad records")
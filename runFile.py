@@ -0,0 +1,146 @@
+# Binary output of the events of a run, written by limitedRun:
+#    run<N>_events.npy    one fixed-width record per event (see eventDtype)
+#    run<N>_clusters.npy  one record per tracker cluster, pointing back to its event (see clusterDtype)
+#    run<N>_occupancy.npy strip hit counts, 8 layers x 768 strips, written at the end of the run
+# The events and clusters are buffered in numpy arrays and appended to the files every chunkSize events. The .npy
+# header is rewritten with the new length at each flush, so the files can be read while the run is going, and
+# whatever was flushed before a crash can still be loaded. loadRun memory-maps the files.
+import os
+import numpy as np
+
+eventDtype = np.dtype([
+    ('trigger', np.uint32),      # Accepted trigger number
+    ('run', np.uint16),
+    ('timeStamp', np.uint32),    # 200 Hz clock counts
+    ('timeDate', np.uint32),     # Packed RTC date and time
+    ('deltaTime', np.int64),     # Time stamp counts since the previous event
+    ('cntGo1', np.uint32),       # Triggers not accepted since the start of run
+    ('trgStatus', np.uint8),
+    ('trgCount', np.uint16),     # Tracker trigger count
+    ('T1', np.uint16), ('T2', np.uint16), ('T3', np.uint16), ('T4', np.uint16), ('G', np.uint16),
+    ('dtmin', np.int32),         # TOF time difference, 10 ps units
+    ('nTOFA', np.uint8), ('nTOFB', np.uint8),
+    ('tofA', np.int32), ('tofB', np.int32), ('clkA', np.uint16), ('clkB', np.uint16),
+    ('liveUsec', np.int32),      # Re-arm to GO interval, -1 if not sent
+    ('nGO1live', np.uint8),
+    ('nTkrLyrs', np.uint8),
+    ('tkrErrors', np.uint16),    # Sum of the hit list error counts over the layers
+    ('firstCluster', np.uint32), # Index of the first cluster of the event in the cluster file
+    ('nClusters', np.uint16)])
+
+clusterDtype = np.dtype([
+    ('event', np.uint32),        # Index of the event in the event file
+    ('layer', np.uint8),         # FPGA address
+    ('chip', np.uint8),
+    ('strip', np.uint16),        # 64*(chip+1) - first strip, as used for plots and occupancy
+    ('width', np.uint8),
+    ('error', np.uint8),
+    ('parity', np.uint8)])
+
+NLAYERS = 8
+NSTRIPS = 768
+
+def fileNames(runNumber, directory = "."):
+    base = os.path.join(directory, "run" + str(runNumber))
+    return base + "_events.npy", base + "_clusters.npy", base + "_occupancy.npy"
+
+# Write a version 1.0 .npy header of fixed length, so that it can be rewritten in place when the length changes
+def _writeHeader(f, dtype, length):
+    header = "{{'descr': {!r}, 'fortran_order': False, 'shape': ({:20d},), }}".format(np.lib.format.dtype_to_descr(dtype), length)
+    nHeader = len(header) + 1
+    nHeader += (64 - (10 + nHeader)%64)%64
+    f.seek(0)
+    f.write(b'\x93NUMPY\x01\x00' + nHeader.to_bytes(2, 'little') + (header.ljust(nHeader - 1) + '\n').encode('latin1'))
+
+class RecordFile:
+    def __init__(self, fileName, dtype):
+        self.dtype = dtype
+        self.length = 0
+        self.f = open(fileName, "wb")
+        _writeHeader(self.f, dtype, 0)
+
+    def append(self, records):
+        if len(records) == 0: return
+        self.f.seek(0, 2)
+        self.f.write(records.tobytes())
+        self.length += len(records)
+        _writeHeader(self.f, self.dtype, self.length)
+        self.f.flush()
+
+    def close(self):
+        self.f.close()
+
+class RunWriter:
+    def __init__(self, runNumber, chunkSize = 1000, directory = "."):
+        self.runNumber = runNumber
+        self.chunkSize = chunkSize
+        eventFile, clusterFile, self.occupancyFile = fileNames(runNumber, directory)
+        self.eventFile = RecordFile(eventFile, eventDtype)
+        self.clusterFile = RecordFile(clusterFile, clusterDtype)
+        self.events = np.zeros(chunkSize, dtype=eventDtype)
+        self.nEvents = 0                # Events in the buffer
+        self.clusters = np.zeros(16*chunkSize, dtype=clusterDtype)
+        self.nClusters = 0              # Clusters in the buffer
+        self.occupancy = np.zeros((NLAYERS, NSTRIPS), dtype=np.int64)
+
+    # Index of the next event in the event file
+    def eventIndex(self):
+        return self.eventFile.length + self.nEvents
+
+    # Add the clusters of one layer of the current event, from a hitDecoder.decodeHitList result
+    def addClusters(self, layer, clusters):
+        n = len(clusters)
+        if self.nClusters + n > len(self.clusters):
+            self.clusters = np.resize(self.clusters, 2*len(self.clusters) + n)
+        out = self.clusters[self.nClusters:self.nClusters + n]
+        out['event'] = self.eventIndex()
+        out['layer'] = layer
+        out['chip'] = clusters['chip']
+        out['strip'] = 64*(clusters['chip'].astype(np.uint16) + 1) - clusters['firstStrip']
+        out['width'] = clusters['width']
+        out['error'] = clusters['error']
+        out['parity'] = clusters['parity']
+        self.nClusters += n
+
+    # Add an event, given as keyword arguments named as the fields of eventDtype. Fields not given are 0.
+    # The clusters of the event must be added first.
+    def addEvent(self, **fields):
+        event = self.events[self.nEvents]
+        event.fill(0)
+        for name, value in fields.items(): event[name] = value
+        index = self.eventIndex()
+        first = np.searchsorted(self.clusters['event'][:self.nClusters], index)
+        event['firstCluster'] = self.clusterFile.length + first
+        event['nClusters'] = self.nClusters - first
+        self.nEvents += 1
+        if self.nEvents == self.chunkSize: self.flush()
+
+    def flush(self):
+        clusters = self.clusters[:self.nClusters]
+        if self.nClusters > 0:
+            lyr = clusters['layer'].astype(np.intp)
+            lyr[lyr == 8] = 0                  # FPGA address 8 is layer 0
+            width = clusters['width'].astype(np.intp)
+            offset = np.arange(width.sum()) - np.repeat(np.cumsum(width) - width, width)
+            strip = np.repeat(clusters['strip'].astype(np.intp), width) - offset
+            good = (strip >= 0) & (strip < NSTRIPS) & (np.repeat(lyr, width) < NLAYERS)
+            np.add.at(self.occupancy, (np.repeat(lyr, width)[good], strip[good]), 1)
+        self.eventFile.append(self.events[:self.nEvents])
+        self.clusterFile.append(clusters)
+        self.nEvents = 0
+        self.nClusters = 0
+
+    def close(self):
+        self.flush()
+        self.eventFile.close()
+        self.clusterFile.close()
+        np.save(self.occupancyFile, self.occupancy)
+
+# Memory-map the files of a run. Returns (events, clusters, occupancy); occupancy is None if the run did not end.
+# The clusters of event i are clusters[events['firstCluster'][i]:][:events['nClusters'][i]].
+def loadRun(runNumber, directory = "."):
+    eventFile, clusterFile, occupancyFile = fileNames(runNumber, directory)
+    events = np.load(eventFile, mmap_mode='r')
+    clusters = np.load(clusterFile, mmap_mode='r')
+    occupancy = np.load(occupancyFile) if os.path.exists(occupancyFile) else None
+    return events, clusters, occupancy
@@ -0,0 +1,150 @@
+# Index of the records of a raw event PSOC stream (the port output saved to a file, as limitedRun does in
+# run<N>_stream.bin and as aesop_reprocess reads it), for going straight to an event, a time range or the error
+# records without reading the stream from the start.
+# The index is a sidecar file <stream>.idx.npy with one record of indexDtype per good frame, in stream order:
+#    events (0xDD, 0xDB)     their own trigger number and time stamp
+#    housekeeping (0xDE)     cntGO, the events accepted so far
+#    error record (0xDA)     the event count of the record
+#    error stream (0xD9)     the event of its first error
+#    end of run (0x44)       cntGo at the end of the run
+# and anything else the event number and time stamp of the last event before it. A begin-of-run record restarts the
+# event number at 0 with the new run number. The index is written by libaesopdaq if it has been built (see
+# aesopdaq.indexFile), otherwise here, and is rebuilt when the stream is newer than it.
+#    python runIndex.py streamFile [event]
+import mmap
+import os
+import sys
+import numpy as np
+from frameReader import HEADER, TRAILER, frameLength
+
+indexDtype = np.dtype([
+    ('event', np.uint32),        # Event number (accepted trigger count) at or carried by the record
+    ('timeStamp', np.uint32),    # 200 Hz clock counts, of the event or of the last event before the record
+    ('offset', np.uint64),       # Of the frame header in the stream
+    ('run', np.uint16),
+    ('packetType', np.uint8)])
+
+EVENT_TYPES = (0xDD, 0xDB)
+ERROR_TYPES = (0xD9, 0xDA)
+
+def indexFileName(streamFile):
+    return streamFile + ".idx.npy"
+
+def _mapFile(fileName):
+    with open(fileName, "rb") as f:
+        f.seek(0, 2)
+        if f.tell() == 0: return b''
+        return mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+# Yield (offset, packet type, output data) for each good frame, as frameReader.FrameReader finds them
+def _frames(buf):
+    pos = 0
+    while True:
+        start = buf.find(HEADER, pos)
+        if start < 0 or len(buf) - start < 6: return
+        L = buf[start + 3]
+        end = start + frameLength(L)
+        if end > len(buf): return
+        if buf[end - 3:end] != TRAILER:
+            pos = start + 1
+            continue
+        yield start, buf[start + 4], buf[start + 6 + buf[start + 5]:start + 6 + L]
+        pos = end
+
+def _be32(d, i):
+    return int.from_bytes(d[i:i+4], 'big')
+
+# Pure Python index builder, the same as the one in libaesopdaq
+def _buildIndex(buf):
+    entries = []
+    event = 0
+    timeStamp = 0
+    run = 0
+    for offset, packetType, d in _frames(buf):
+        recEvent = event
+        if packetType in EVENT_TYPES:
+            if len(d) >= 14 and d[0:4] == b'ZERO':
+                run = d[4]*256 + d[5]
+                recEvent = event = _be32(d, 6)
+                timeStamp = _be32(d, 10)
+        elif packetType == 0xDE:
+            if len(d) >= 84 and d[0:4] == b'HAUS':
+                run = d[4]*256 + d[5]
+                recEvent = event = _be32(d, 16)
+        elif packetType == 0xDA:
+            if len(d) >= 11 and d[0:3] == b'ERR': recEvent = _be32(d, 3)
+        elif packetType == 0xD9:
+            if len(d) >= 5 and d[0:3] == b'ERS' and d[3] > 0 and len(d) >= 5 + 11*d[3]: recEvent = _be32(d, 12)
+        elif packetType == 0x44:
+            if len(d) >= 149:
+                run = d[3]*256 + d[4]
+                recEvent = event = _be32(d, 9)
+        elif len(d) >= 85 and d[0:4] == b'BOFR':
+            run = d[4]*256 + d[5]
+            recEvent = event = 0
+        entries.append((recEvent, timeStamp, offset, run, packetType))
+    return np.array(entries, dtype=indexDtype)
+
+# Write the index of a stream file. Returns the number of records indexed.
+def buildIndex(streamFile, indexFile = None):
+    if indexFile is None: indexFile = indexFileName(streamFile)
+    try:
+        import aesopdaq
+        aesopdaq.library()
+    except (ImportError, OSError):
+        aesopdaq = None
+    if aesopdaq is not None:
+        return aesopdaq.indexFile(streamFile, indexFile)[0]
+    index = _buildIndex(_mapFile(streamFile))
+    np.save(indexFile, index)
+    return len(index)
+
+class RunIndex:
+    def __init__(self, streamFile, indexFile = None, rebuild = False):
+        self.streamFile = streamFile
+        self.indexFile = indexFileName(streamFile) if indexFile is None else indexFile
+        if rebuild or not os.path.exists(self.indexFile) or os.path.getmtime(self.indexFile) < os.path.getmtime(streamFile):
+            buildIndex(streamFile, self.indexFile)
+        self.index = np.load(self.indexFile, mmap_mode='r')
+        self.stream = _mapFile(streamFile)
+
+    def __len__(self):
+        return len(self.index)
+
+    # Record i of the index as (packet type, body), where body is the same memoryview as FrameReader.readFrame
+    # returns: the number of command data bytes, followed by the command data and the output data
+    def record(self, i):
+        offset = int(self.index['offset'][i])
+        L = self.stream[offset + 3]
+        return self.stream[offset + 4], memoryview(self.stream)[offset + 5:offset + 6 + L]
+
+    # Indices of the event records of an event number, optionally only in one run
+    def findEvent(self, event, run = None):
+        sel = np.isin(self.index['packetType'], EVENT_TYPES) & (self.index['event'] == event)
+        if run is not None: sel &= self.index['run'] == run
+        return np.flatnonzero(sel)
+
+    # Indices of the records with time stamps t0 <= t < t1, optionally only those of the given packet types
+    def timeRange(self, t0, t1, packetTypes = None):
+        t = self.index['timeStamp']
+        sel = (t >= t0) & (t < t1)
+        if packetTypes is not None: sel &= np.isin(self.index['packetType'], packetTypes)
+        return np.flatnonzero(sel)
+
+    # Indices of the error records and error streams, optionally only those of one run
+    def errors(self, run = None):
+        sel = np.isin(self.index['packetType'], ERROR_TYPES)
+        if run is not None: sel &= self.index['run'] == run
+        return np.flatnonzero(sel)
+
+if __name__ == "__main__":
+    runIndex = RunIndex(sys.argv[1])
+    index = runIndex.index
+    print(sys.argv[1] + ": " + str(len(index)) + " records, " + str(np.isin(index['packetType'], EVENT_TYPES).sum())
+          + " events, " + str(len(runIndex.errors())) + " error records")
+    if len(sys.argv) > 2:
+        for i in runIndex.findEvent(int(sys.argv[2])):
+            packetType, body = runIndex.record(i)
+            print("Event " + sys.argv[2] + " of run " + str(index['run'][i]) + " at byte " + str(index['offset'][i])
+                  + ", time stamp " + str(index['timeStamp'][i]) + ", packet type " + hex(packetType) + ", "
+                  + str(len(body) - 1 - body[0]) + " data bytes")
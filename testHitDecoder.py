@@ -0,0 +1,132 @@
+# Regression check of hitDecoder against the bit-string parser in PSOC_cmd (ParseASIChitList and CRC6).
+# The corpus is generated here: well formed hit lists with a correct CRC, plus copies with flipped bits, truncated
+# lists, bad chip numbers, chips without clusters and missing trailers. Both decoders are run on every list and the
+# return values and printout must agree. On the truncated lists that make the bit-string parser raise an exception,
+# parseHitList must instead report a truncated hit list, with the rc of decodeHitList. decodeHitList and
+# printHitList are checked on the lists that the bit-string parser gets through. If libaesopdaq has been built, its
+# decodeHitList is checked against hitDecoder on the whole corpus.
+import io
+import sys
+import time
+import random
+import contextlib
+import numpy as np
+
+from PSOC_cmd import ParseASIChitList, CRC6, getBinaryString
+from hitDecoder import parseHitList, decodeHitList, printHitList, crc6
+
+def mkHitList(rng):
+    bits = "11100111" + str(rng.randint(0,1)) + format(rng.randint(0,127), '07b')
+    nChips = rng.randint(0,12)
+    bits += format(rng.randint(0,127), '07b') + str(rng.randint(0,1)) + format(nChips, '04b')
+    for chip in range(nChips):
+        nClust = rng.choice([0, 1, 1, 1, 2, 2, 3, 5, 10, 15])
+        chipNum = rng.randint(0,12) if rng.random() > 0.05 else rng.randint(13,15)
+        bits += str(int(rng.random() < 0.1)) + str(rng.randint(0,1)) + format(nClust, '04b')
+        bits += str(int(rng.random() < 0.1)) + str(int(rng.random() < 0.1)) + format(chipNum, '04b')
+        for clust in range(nClust):
+            bits += format(rng.randint(0,63), '06b') + format(rng.randint(0,63), '06b')
+    bits += CRC6('1' + bits) + "11"
+    bits += "0"*((8 - len(bits)%8)%8)
+    return bytes(int(bits[i:i+8], 2) for i in range(0, len(bits), 8))
+
+def corrupt(data, rng):
+    data = bytearray(data)
+    kind = rng.randint(0,3)
+    if kind == 0 and len(data) > 0:
+        pos = rng.randrange(8*len(data))
+        data[pos//8] ^= 0x80 >> (pos%8)
+    elif kind == 1:
+        data = data[:rng.randint(0, len(data))]
+    elif kind == 2 and len(data) > 1:
+        data[-1] ^= rng.randint(1,255)
+    elif len(data) > 0:
+        data[0] ^= rng.randint(1,255)
+    return bytes(data)
+
+def run(parser, arg, verbose):
+    out = io.StringIO()
+    with contextlib.redirect_stdout(out):
+        try:
+            result = parser(arg, verbose)
+        except ValueError:
+            result = "ValueError"
+    return result, out.getvalue()
+
+def main(nLists = 20000, seed = 12345):
+    rng = random.Random(seed)
+    corpus = []
+    for i in range(nLists):
+        data = mkHitList(rng)
+        corpus.append(data)
+        corpus.append(corrupt(data, rng))
+    corpus.append(b'')
+
+    nBad = 0
+    for data in corpus:
+        byteList = [bytes([b]) for b in data]
+        decoded = decodeHitList(data)
+        for verbose in (False, True):
+            ref = run(ParseASIChitList, getBinaryString(byteList), verbose)
+            new = run(parseHitList, byteList, verbose)
+            if ref[0] == "ValueError":
+                ok = "truncated hit list" in new[1] and new[0][0] == decoded["rc"]
+            else:
+                ok = ref == new
+            if not ok:
+                nBad += 1
+                if nBad <= 10: print("Mismatch for " + data.hex() + ":\n" + str(ref) + "\n" + str(new))
+        result = ref[0]
+        if result == "ValueError" or len(result) < 4: continue
+        clusters = decoded["clusters"]
+        strips = [64*(int(c)+1) - int(s) for c, s in zip(clusters["chip"], clusters["firstStrip"])]
+        if decoded["rc"] != result[0] or decoded["FPGA"] != result[1] or strips != result[2]:
+            nBad += 1
+            if nBad <= 10: print("decodeHitList mismatch for " + data.hex())
+        for verbose in (False, True):
+            out = io.StringIO()
+            with contextlib.redirect_stdout(out): printHitList(decoded, verbose)
+            if out.getvalue() != run(ParseASIChitList, getBinaryString(byteList), verbose)[1]:
+                nBad += 1
+                if nBad <= 10: print("printHitList mismatch for " + data.hex())
+        bits = getBinaryString(byteList)
+        if len(bits) >= 6 and crc6(int(bits, 2), len(bits)) != int(CRC6(bits), 2):
+            nBad += 1
+            if nBad <= 10: print("CRC6 mismatch for " + data.hex())
+    print(str(len(corpus)) + " hit lists compared, " + str(nBad) + " mismatches")
+
+    try:
+        import aesopdaq
+        aesopdaq.library()
+    except (ImportError, OSError) as err:
+        print("libaesopdaq not checked: " + str(err))
+        aesopdaq = None
+    if aesopdaq is not None:
+        nLibBad = 0
+        for data in corpus:
+            ref = decodeHitList(data)
+            new = aesopdaq.decodeHitList(data)
+            for key, value in ref.items():
+                if not (np.array_equal(value, new[key]) if isinstance(value, np.ndarray) else value == new[key]):
+                    nLibBad += 1
+                    if nLibBad <= 10: print("libaesopdaq mismatch in " + key + " for " + data.hex())
+                    break
+        print(str(len(corpus)) + " hit lists compared with libaesopdaq, " + str(nLibBad) + " mismatches")
+        nBad += nLibBad
+
+    sample = corpus[0:4000:2]     # Well formed lists only
+    with contextlib.redirect_stdout(io.StringIO()):   # Chip number errors are printed even when not verbose
+        t0 = time.time()
+        for data in sample: ParseASIChitList(getBinaryString([bytes([b]) for b in data]), False)
+        t1 = time.time()
+        for data in sample: decodeHitList(data)
+        t2 = time.time()
+    print("Bit-string parser: {:.1f} us per list, hitDecoder: {:.1f} us per list".format(1.e6*(t1-t0)/len(sample), 1.e6*(t2-t1)/len(sample)))
+    if aesopdaq is not None:
+        t0 = time.time()
+        for data in sample: aesopdaq.decodeHitList(data)
+        print("libaesopdaq through ctypes: {:.1f} us per list".format(1.e6*(time.time()-t0)/len(sample)))
+    return nBad
+
+if __name__ == "__main__":
+    sys.exit(1 if main() else 0)
@@ -260,8 +260,8 @@ except IOError as err:
 for x in range(numberOfRuns) :
     # Run a fixed number of events.
     # This program opens a file for each event for a single-event plot (can be commented out)
-    # plus an nTuple file with PMT readings, and a text output file with most of the information per event
-    # printed in an ASCII format.
+    # plus binary event and cluster files (load them with runFile.loadRun), and a text output file with most of
+    # the information per event printed in an ASCII format.
     # The gnuplot program is needed for viewing the event plots.
     ADC, Sigma, TOF, sigmaTOF = limitedRun(runNumber, numberEvents, False)
     f2 = open("dataOutput_run" + str(runNumber) + ".txt", "a")